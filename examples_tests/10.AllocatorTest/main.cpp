@@ -1,7 +1,10 @@
 #define _IRR_STATIC_LIB_
 #include <nabla.h>
+#include "../common/TestUtils.h"
 #include <random>
 #include <cmath>
+#include <thread>
+#include <chrono>
 
 using namespace nbl;
 using namespace core;
@@ -300,6 +303,471 @@ void AllocatorHandler<core::LinearAddressAllocator<uint32_t>>::randFreeAllocated
 	}
 }
 
+// the basic concurrency adaptor does not expose its free size
+template<class AlctrType>
+static bool drainAndCheckForLeaks(AlctrType& alctr)
+{
+	return true;
+}
+template<class AddressAllocator, class RecursiveLockable, uint32_t MagazineSize, uint32_t MaxCachedSizeLog2, uint32_t MaxThreads>
+static bool drainAndCheckForLeaks(core::AddressAllocatorThreadCachingAdaptor<AddressAllocator,RecursiveLockable,MagazineSize,MaxCachedSizeLog2,MaxThreads>& alctr)
+{
+	alctr.drainCaches();
+	return alctr.get_free_size()==alctr.get_total_size();
+}
+
+// hammers one allocator from many threads at once, every thread stamps its allocations in a shadow buffer to catch handing out the same range twice
+template<typename AlctrType>
+class ContentionBenchmark
+{
+	using Traits = core::address_allocator_traits<AlctrType>;
+
+public:
+	ContentionBenchmark(uint32_t _bufferSize, uint32_t _blockSz, uint32_t _maxAllocSize) : bufferSize(_bufferSize), blockSz(_blockSz), maxAllocSize(_maxAllocSize), shadow(_bufferSize) {}
+
+	bool run(const char* name, const uint32_t threadCount)
+	{
+		constexpr uint32_t maxAlign = 64u;
+		void* reservedSpace = _NBL_ALIGNED_MALLOC(AlctrType::reserved_size(maxAlign,bufferSize,blockSz),_NBL_SIMD_ALIGNMENT);
+		bool success = true;
+		{
+			AlctrType alctr(reservedSpace,0u,0u,maxAlign,bufferSize,blockSz);
+			std::atomic<uint32_t> overlaps(0u);
+
+			core::vector<std::thread> threads;
+			const auto start = std::chrono::high_resolution_clock::now();
+			for (uint32_t t=0u; t<threadCount; t++)
+				threads.emplace_back([&,t]() {overlaps += runThread(alctr,t);});
+			for (auto& thread : threads)
+				thread.join();
+			const double time = std::chrono::duration<double>(std::chrono::high_resolution_clock::now()-start).count();
+
+			const bool leaked = !drainAndCheckForLeaks(alctr);
+			printf("%s, %d threads: %f M alloc+free/s%s%s\n",name,threadCount,double(threadCount)*double(opsPerThread)/(time*1000000.0),overlaps.load() ? ", OVERLAPPING ALLOCATIONS":"",leaked ? ", LEAKED":"");
+			success = !overlaps.load() && !leaked;
+		}
+		_NBL_ALIGNED_FREE(reservedSpace);
+		return success;
+	}
+
+private:
+	_NBL_STATIC_INLINE_CONSTEXPR uint32_t opsPerThread = 1u<<18u;
+	_NBL_STATIC_INLINE_CONSTEXPR uint32_t maxLiveAllocsPerThread = 256u;
+
+	uint32_t runThread(AlctrType& alctr, const uint32_t threadID)
+	{
+		std::mt19937 mt(threadID);
+		std::uniform_int_distribution<uint32_t> sizeDist(1u,maxAllocSize);
+		std::uniform_int_distribution<uint32_t> alignDist(0u,3u);
+
+		uint32_t overlaps = 0u;
+		core::vector<std::pair<uint32_t,uint32_t>> live;
+		live.reserve(maxLiveAllocsPerThread);
+		auto freeOne = [&]()
+		{
+			const auto allocation = live.back();
+			live.pop_back();
+			if (shadow[allocation.first].load(std::memory_order_relaxed)!=uint8_t(threadID+1u) || shadow[allocation.first+allocation.second-1u].load(std::memory_order_relaxed)!=uint8_t(threadID+1u))
+				overlaps++;
+			Traits::multi_free_addr(alctr,1u,&allocation.first,&allocation.second);
+		};
+		for (uint32_t i=0u; i<opsPerThread; i++)
+		{
+			// frees trail allocations to keep a working set, and the order gets shuffled to fragment
+			if (live.size()==maxLiveAllocsPerThread || (live.size() && (mt()&0x3u)==0u))
+			{
+				std::swap(live[mt()%live.size()],live.back());
+				freeOne();
+				continue;
+			}
+
+			const uint32_t size = sizeDist(mt);
+			const uint32_t alignment = 0x1u<<alignDist(mt);
+			uint32_t addr = AlctrType::invalid_address;
+			Traits::multi_alloc_addr(alctr,1u,&addr,&size,&alignment);
+			if (addr==AlctrType::invalid_address)
+				continue;
+			shadow[addr].store(threadID+1u,std::memory_order_relaxed);
+			shadow[addr+size-1u].store(threadID+1u,std::memory_order_relaxed);
+			live.emplace_back(addr,size);
+		}
+		while (live.size())
+			freeOne();
+		return overlaps;
+	}
+
+	const uint32_t bufferSize;
+	const uint32_t blockSz;
+	const uint32_t maxAllocSize;
+	core::vector<std::atomic<uint8_t>> shadow;
+};
+
+// host memory `BufferAllocator` which keeps the contents when the resizable allocator grows or shrinks the buffer
+class HostBufferAllocator
+{
+public:
+	typedef uint8_t* value_type;
+
+	inline value_type allocate(size_t bytes, size_t alignment) noexcept
+	{
+		size = bytes;
+		return reinterpret_cast<value_type>(_NBL_ALIGNED_MALLOC(bytes,alignment));
+	}
+
+	template<class AddressAllocator>
+	inline void reallocate(value_type& allocation, size_t bytes, size_t alignment, const AddressAllocator& allocToQueryOffsets) noexcept
+	{
+		const size_t oldSize = size;
+		value_type newAllocation = allocate(bytes,alignment);
+		memcpy(newAllocation,allocation,core::min(oldSize,bytes));
+		deallocate(allocation);
+		allocation = newAllocation;
+	}
+
+	inline void deallocate(value_type& allocation) noexcept
+	{
+		_NBL_ALIGNED_FREE(allocation);
+		allocation = nullptr;
+	}
+
+private:
+	size_t size = 0u;
+};
+
+// allocations get tagged with the subsystem scope alive when they were made, frees from anywhere go back to that subsystem
+static bool memoryStatisticsTest()
+{
+	const auto before = CMemoryStatistics::getSnapshot();
+	const auto& beforeLoaders = before.subsystems[EMS_ASSET_LOADERS];
+
+	// tagged by the scope alive at allocation, nested scopes restore the outer tag
+	void* loaderBlob;
+	void* filterBlob;
+	{
+		CMemoryStatistics::CSubsystemScope scope(EMS_ASSET_LOADERS);
+		loaderBlob = _NBL_ALIGNED_MALLOC(1000u,_NBL_SIMD_ALIGNMENT);
+		{
+			CMemoryStatistics::CSubsystemScope inner(EMS_IMAGE_FILTERS);
+			filterBlob = _NBL_ALIGNED_MALLOC(300u,256u);
+		}
+		core::vector<uint32_t> indices(250u); // `core::allocator` counts too
+		const auto during = CMemoryStatistics::getSnapshot();
+		CHECK(during.subsystems[EMS_ASSET_LOADERS].liveBytes==beforeLoaders.liveBytes+2000);
+		CHECK(during.subsystems[EMS_ASSET_LOADERS].liveAllocations==beforeLoaders.liveAllocations+2);
+		CHECK(during.subsystems[EMS_IMAGE_FILTERS].liveBytes==before.subsystems[EMS_IMAGE_FILTERS].liveBytes+300);
+	}
+	CHECK(is_aligned_to(filterBlob,256u));
+
+	// freed by another thread outside of any scope, the counters of the subsystem which allocated go down
+	std::thread([&]() {_NBL_ALIGNED_FREE(loaderBlob); _NBL_ALIGNED_FREE(filterBlob);}).join();
+	const auto after = CMemoryStatistics::getSnapshot();
+	CHECK(after.subsystems[EMS_ASSET_LOADERS].liveBytes==beforeLoaders.liveBytes);
+	CHECK(after.subsystems[EMS_ASSET_LOADERS].liveAllocations==beforeLoaders.liveAllocations);
+	CHECK(after.subsystems[EMS_ASSET_LOADERS].allocations==beforeLoaders.allocations+2u);
+	CHECK(after.subsystems[EMS_IMAGE_FILTERS].liveBytes==before.subsystems[EMS_IMAGE_FILTERS].liveBytes);
+
+	// the high-water mark stays after the memory is gone, it only lags by what threads have not published yet
+	CMemoryStatistics::resetPeaks();
+	constexpr size_t bigSize = 64ull<<20ull;
+	{
+		CMemoryStatistics::CSubsystemScope scope(EMS_APPLICATION);
+		void* big = _NBL_ALIGNED_MALLOC(bigSize,_NBL_SIMD_ALIGNMENT);
+		_NBL_ALIGNED_FREE(big);
+	}
+	const auto peaked = CMemoryStatistics::getSnapshot();
+	const int64_t slack = CMemoryStatistics::PeakGranularity*EMS_COUNT;
+	CHECK(peaked.subsystems[EMS_APPLICATION].peakBytes>=int64_t(bigSize)-slack);
+	CHECK(peaked.peakBytes>=int64_t(bigSize)-slack);
+	CHECK(peaked.subsystems[EMS_APPLICATION].liveBytes==after.subsystems[EMS_APPLICATION].liveBytes);
+	return true;
+}
+
+// what tracking costs per _NBL_ALIGNED_MALLOC and _NBL_ALIGNED_FREE pair
+static void memoryStatisticsOverhead()
+{
+	constexpr uint32_t pairsPerThread = 1u<<22u;
+	constexpr uint32_t liveSetSize = 256u;
+	// small allocations are where a fixed overhead per call shows most
+	auto churn = [](auto&& alloc, auto&& dealloc) -> void
+	{
+		void* live[liveSetSize] = {};
+		for (uint32_t i=0u; i<pairsPerThread; i++)
+		{
+			auto& slot = live[i%liveSetSize];
+			dealloc(slot);
+			slot = alloc(16u+(i&0xffu));
+		}
+		for (auto* ptr : live)
+			dealloc(ptr);
+	};
+	auto untracked = [&]() -> void
+	{
+		churn([](size_t size) {return _NBL_UNTRACKED_ALIGNED_MALLOC(size,_NBL_SIMD_ALIGNMENT);},[](void* ptr) {if (ptr) _NBL_UNTRACKED_ALIGNED_FREE(ptr);});
+	};
+	auto tracked = [&]() -> void
+	{
+		churn([](size_t size) {return _NBL_ALIGNED_MALLOC(size,_NBL_SIMD_ALIGNMENT);},[](void* ptr) {_NBL_ALIGNED_FREE(ptr);});
+	};
+	const auto nsPerPair = [](const double ms) {return (ms*1000000.0)/double(pairsPerThread);};
+
+	const uint32_t hardwareThreads = core::max(std::thread::hardware_concurrency(),1u);
+	for (uint32_t threadCount=1u; threadCount<=hardwareThreads; threadCount*=2u)
+	{
+		auto onThreads = [threadCount](auto& f) -> double
+		{
+			return timeIt([&]()
+			{
+				core::vector<std::thread> threads;
+				for (uint32_t t=0u; t<threadCount; t++)
+					threads.emplace_back(f);
+				for (auto& thread : threads)
+					thread.join();
+			});
+		};
+		const double untrackedTime = onThreads(untracked);
+		const double trackedTime = onThreads(tracked);
+		std::cout << threadCount << " threads, malloc+free pair:\n";
+		std::cout << "\tuntracked: " << nsPerPair(untrackedTime) << " ns\n";
+		std::cout << "\t_NBL_ALIGNED_MALLOC: " << nsPerPair(trackedTime) << " ns, overhead " << nsPerPair(trackedTime-untrackedTime) << " ns\n";
+	}
+}
+
+// bump allocation, rollback of the last allocation, dedicated allocations and container use
+static bool monotonicArenaTest()
+{
+	constexpr size_t blockSize = 4096u;
+	MonotonicArena<> arena(blockSize,4u);
+	CHECK(arena.getReservedSize()==0u);
+
+	// bump allocation with natural alignment
+	auto* a = reinterpret_cast<uint8_t*>(arena.allocate(3u,1u));
+	auto* b = reinterpret_cast<uint8_t*>(arena.allocate(8u,8u));
+	CHECK(a && b && is_aligned_to(b,8u) && b==a+8);
+	const size_t oneBlock = arena.getReservedSize();
+	CHECK(oneBlock>=blockSize);
+
+	// freeing the last allocation rolls it back, anything else is a no-op
+	arena.deallocate(a,3u);
+	CHECK(arena.allocate(8u,8u)==b+8);
+	arena.deallocate(b+8,8u);
+	CHECK(arena.allocate(16u,8u)==b+8);
+
+	// big or overaligned requests get their own memory which is returned right away
+	void* big = arena.allocate(blockSize,16u);
+	void* overaligned = arena.allocate(64u,4096u);
+	CHECK(big && overaligned && is_aligned_to(overaligned,4096u));
+	const size_t withDedicated = arena.getReservedSize();
+	CHECK(withDedicated>oneBlock+blockSize);
+	arena.deallocate(big,blockSize);
+	CHECK(arena.getReservedSize()<=withDedicated-blockSize);
+	// small, but dedicated all the same
+	const size_t beforeSmallDedicated = arena.getReservedSize();
+	void* smallOveraligned = arena.allocate(32u,1024u);
+	CHECK(smallOveraligned && arena.getReservedSize()>beforeSmallDedicated);
+	arena.deallocate(smallOveraligned,32u);
+	CHECK(arena.getReservedSize()==beforeSmallDedicated);
+
+	// spills into the next block when the current is full
+	for (uint32_t i=0u; i<8u; i++)
+		CHECK(arena.allocate(blockSize/4u,16u));
+	CHECK(arena.getReservedSize()>=2u*oneBlock);
+
+	// once the arena moved on, freeing from an older block is a no-op while dedicated allocations still get returned
+	{
+		void* dedicated = arena.allocate(blockSize,16u);
+		const size_t beforeFrees = arena.getReservedSize();
+		arena.deallocate(a,3u);
+		CHECK(arena.getReservedSize()==beforeFrees);
+		arena.deallocate(dedicated,blockSize);
+		CHECK(arena.getReservedSize()<=beforeFrees-blockSize);
+	}
+
+	// reset keeps the blocks, but drops the dedicated allocations
+	const size_t beforeReset = arena.getReservedSize();
+	arena.reset();
+	CHECK(arena.getReservedSize()<beforeReset && arena.getReservedSize()%oneBlock==0u);
+	CHECK(arena.allocate(3u,1u)==a);
+	arena.release();
+	CHECK(arena.getReservedSize()==0u);
+
+	// out of blocks small allocations fall back to dedicated ones, which need to be returned too
+	{
+		MonotonicArena<> single(blockSize,1u);
+		void* last = single.allocate(blockSize/8u,16u);
+		const size_t blockOnly = single.getReservedSize();
+		while (last && single.getReservedSize()==blockOnly)
+			last = single.allocate(blockSize/8u,16u);
+		CHECK(last);
+		single.deallocate(last,blockSize/8u);
+		CHECK(single.getReservedSize()==blockOnly);
+	}
+
+	// as a container allocator
+	{
+		MonotonicArena<> scratch(blockSize);
+		using alloc_t = monotonic_arena_allocator<std::pair<const uint32_t,uint32_t>>;
+		core::map<uint32_t,uint32_t,std::less<uint32_t>,alloc_t> map(alloc_t{scratch});
+		core::vector<uint32_t,monotonic_arena_allocator<uint32_t>> vec(monotonic_arena_allocator<uint32_t>{scratch});
+		for (uint32_t i=0u; i<10000u; i++)
+		{
+			map[i*7u%10007u] = i;
+			vec.push_back(i);
+		}
+		CHECK(map.size()==10000u && vec.size()==10000u);
+		for (uint32_t i=0u; i<10000u; i++)
+			CHECK(map[i*7u%10007u]==i && vec[i]==i);
+	}
+	return true;
+}
+
+// the position, normal and uv tuples the OBJ loader deduplicates
+struct SVertex
+{
+	float pos[3];
+	float uv[2];
+	uint32_t normal;
+
+	inline bool operator<(const SVertex& other) const
+	{
+		return memcmp(this,&other,sizeof(SVertex))<0;
+	}
+};
+
+// a loader deduplicating vertices in a map, with the map nodes coming from the heap and from an arena
+static bool monotonicArenaBenchmark()
+{
+	constexpr uint32_t loadCount = 16u;
+	constexpr uint32_t verticesPerLoad = 1u<<18u;
+
+	// corners get shared by neighbouring faces, like in a closed mesh
+	std::mt19937 mt(0x45u);
+	core::vector<SVertex> corners(verticesPerLoad);
+	for (auto& corner : corners)
+	{
+		const uint32_t id = mt()%(verticesPerLoad*3u/4u);
+		corner = {{float(id),float(id>>8u),0.f},{0.f,1.f},id};
+	}
+
+	auto dedup = [&](auto& map) -> uint32_t
+	{
+		uint32_t unique = 0u;
+		for (const auto& corner : corners)
+		if (map.insert({corner,unique}).second)
+			unique++;
+		return unique;
+	};
+
+	uint32_t heapUnique = 0u;
+	const double heapTime = timeIt([&]()
+	{
+		for (uint32_t i=0u; i<loadCount; i++)
+		{
+			core::map<SVertex,uint32_t> map;
+			heapUnique = dedup(map);
+		}
+	});
+	uint32_t arenaUnique = 0u;
+	size_t arenaReserved = 0u;
+	const double arenaTime = timeIt([&]()
+	{
+		for (uint32_t i=0u; i<loadCount; i++)
+		{
+			MonotonicArena<> scratch;
+			using alloc_t = monotonic_arena_allocator<std::pair<const SVertex,uint32_t>>;
+			core::map<SVertex,uint32_t,std::less<SVertex>,alloc_t> map(alloc_t{scratch});
+			arenaUnique = dedup(map);
+			arenaReserved = scratch.getReservedSize();
+		}
+	});
+	CHECK(heapUnique==arenaUnique);
+
+	std::cout << loadCount << " loads deduplicating " << verticesPerLoad << " corners into " << arenaUnique << " vertices\n";
+	std::cout << "\tcore::allocator: " << heapTime/double(loadCount) << " ms per load\n";
+	std::cout << "\tMonotonicArena: " << arenaTime/double(loadCount) << " ms per load, " << arenaReserved/1024u << " KiB of blocks\n";
+
+	return true;
+}
+
+// fragments a resizable allocator, then compacts it in budgeted steps checking that the relocated contents survive and the buffer shrinks
+static bool compactionTest()
+{
+	using CompactableAllocator = core::ResizableHeterogenousMemoryAllocator<core::HeterogenousMemoryAddressAllocatorAdaptor<core::GeneralpurposeAddressAllocator<uint32_t>,HostBufferAllocator>>;
+	constexpr uint32_t allocationCount = 8192u;
+	constexpr uint32_t maxAlign = 64u;
+	constexpr uint32_t byteBudget = 0x1u<<16u;
+
+	// big enough up front, the test is about shrinking
+	CompactableAllocator alctr(core::allocator<uint8_t>(),HostBufferAllocator(),0u,0u,maxAlign,0x1u<<24u,32u);
+	std::mt19937 mt(0x45u);
+	std::uniform_int_distribution<uint32_t> sizeDist(16u,2048u);
+
+	struct Allocation
+	{
+		uint32_t address;
+		uint32_t bytes;
+		uint8_t pattern;
+	};
+	core::vector<Allocation> allocations;
+	for (uint32_t i=0u; i<allocationCount; i++)
+	{
+		Allocation allocation = {CompactableAllocator::invalid_address,sizeDist(mt),static_cast<uint8_t>(mt())};
+		const uint32_t alignment = 0x1u<<(mt()%7u);
+		alctr.multi_alloc_addr(1u,&allocation.address,&allocation.bytes,&alignment);
+		if (allocation.address==CompactableAllocator::invalid_address)
+			return false;
+		memset(alctr.getCurrentBufferAllocation()+allocation.address,allocation.pattern,allocation.bytes);
+		allocations.push_back(allocation);
+	}
+	// keep every 8th allocation, which leaves holes everywhere a shrink cannot reclaim
+	core::vector<Allocation> survivors;
+	for (uint32_t i=0u; i<allocationCount; i++)
+	{
+		if (i%8u==0u)
+			survivors.push_back(allocations[i]);
+		else
+			alctr.multi_free_addr(1u,&allocations[i].address,&allocations[i].bytes);
+	}
+	const uint32_t fragmentedSize = alctr.getDataBufferSize();
+
+	core::vector<CompactableAllocator::SCompactionCandidate> candidates;
+	for (const auto& allocation : survivors)
+		candidates.push_back({allocation.address,allocation.bytes,0x1u<<findLSB(allocation.address|maxAlign)});
+	auto plan = alctr.planCompaction(candidates.data(),candidates.data()+candidates.size());
+
+	uint32_t steps = 0u;
+	core::vector<CompactableAllocator::SRelocation> relocations;
+	while (!plan.done())
+	{
+		relocations.clear();
+		alctr.compact(plan,byteBudget,relocations);
+		steps++;
+
+		uint32_t movedBytes = 0u;
+		for (const auto& relocation : relocations)
+		{
+			movedBytes += relocation.bytes;
+			auto found = std::find_if(survivors.begin(),survivors.end(),[&](const Allocation& a) {return a.address==relocation.oldAddress;});
+			if (found==survivors.end() || relocation.newAddress>=relocation.oldAddress)
+				return false;
+			found->address = relocation.newAddress;
+		}
+		// the budget can only be overshot by the last allocation of a step
+		if (movedBytes>byteBudget+2048u)
+			return false;
+		for (const auto& allocation : survivors)
+		{
+			const uint8_t* data = alctr.getCurrentBufferAllocation()+allocation.address;
+			if (allocation.address+allocation.bytes>alctr.getDataBufferSize() || data[0]!=allocation.pattern || data[allocation.bytes-1u]!=allocation.pattern)
+				return false;
+		}
+	}
+
+	printf("Compaction: %d bytes fragmented, %d bytes after %d steps, %d bytes perfectly packed\n",fragmentedSize,alctr.getDataBufferSize(),steps,plan.getPackedSize());
+	for (auto& allocation : survivors)
+		alctr.multi_free_addr(1u,&allocation.address,&allocation.bytes);
+	return alctr.getDataBufferSize()<fragmentedSize;
+}
+
 int main()
 {
 
@@ -324,6 +792,11 @@ int main()
 			AllocatorHandler<core::GeneralpurposeAddressAllocator<uint32_t>> generalpurposeAlctrHandler;
 			generalpurposeAlctrHandler.executeAllocatorTest();
 		}
+
+		{
+			AllocatorHandler<core::TLSFAddressAllocator<uint32_t>> tlsfAlctrHandler;
+			tlsfAlctrHandler.executeAllocatorTest();
+		}
 	}
 	
 
@@ -338,6 +811,8 @@ int main()
 		nbl::core::address_allocator_traits<core::PoolAddressAllocatorST<uint32_t> >::printDebugInfo();
 		printf("General \n");
 		nbl::core::address_allocator_traits<core::GeneralpurposeAddressAllocatorST<uint32_t> >::printDebugInfo();
+		printf("TLSF \n");
+		nbl::core::address_allocator_traits<core::TLSFAddressAllocatorST<uint32_t> >::printDebugInfo();
 
 		printf("MULTI THREADED=======================================================\n");
 		printf("Linear \n");
@@ -346,6 +821,66 @@ int main()
 		nbl::core::address_allocator_traits<core::PoolAddressAllocatorMT<uint32_t, std::recursive_mutex> >::printDebugInfo();
 		printf("General \n");
 		nbl::core::address_allocator_traits<core::GeneralpurposeAddressAllocatorMT<uint32_t, std::recursive_mutex> >::printDebugInfo();
+		printf("TLSF \n");
+		nbl::core::address_allocator_traits<core::TLSFAddressAllocatorMT<uint32_t, std::recursive_mutex> >::printDebugInfo();
+
+		printf("THREAD CACHING=======================================================\n");
+		printf("Pool \n");
+		nbl::core::address_allocator_traits<core::PoolAddressAllocatorTC<uint32_t, std::recursive_mutex> >::printDebugInfo();
+		printf("General \n");
+		nbl::core::address_allocator_traits<core::GeneralpurposeAddressAllocatorTC<uint32_t, std::recursive_mutex> >::printDebugInfo();
+		printf("TLSF \n");
+		nbl::core::address_allocator_traits<core::TLSFAddressAllocatorTC<uint32_t, std::recursive_mutex> >::printDebugInfo();
+	}
+
+	// Contention benchmark
+	{
+		printf("CONTENTION===========================================================\n");
+		constexpr uint32_t bufferSize = 0x1u<<26u;
+		constexpr uint32_t poolBlockSize = 256u;
+		constexpr uint32_t gpMinBlockSize = 32u;
+		constexpr uint32_t gpMaxAllocSize = 4096u;
+		const uint32_t maxThreads = core::max(std::thread::hardware_concurrency(),1u);
+
+		bool success = true;
+		for (uint32_t threadCount=1u; threadCount<=maxThreads; threadCount*=2u)
+		{
+			success = ContentionBenchmark<core::PoolAddressAllocatorMT<uint32_t,std::recursive_mutex>>(bufferSize,poolBlockSize,poolBlockSize).run("Pool MT",threadCount) && success;
+			success = ContentionBenchmark<core::PoolAddressAllocatorTC<uint32_t,std::recursive_mutex>>(bufferSize,poolBlockSize,poolBlockSize).run("Pool TC",threadCount) && success;
+			success = ContentionBenchmark<core::GeneralpurposeAddressAllocatorMT<uint32_t,std::recursive_mutex>>(bufferSize,gpMinBlockSize,gpMaxAllocSize).run("General MT",threadCount) && success;
+			success = ContentionBenchmark<core::GeneralpurposeAddressAllocatorTC<uint32_t,std::recursive_mutex>>(bufferSize,gpMinBlockSize,gpMaxAllocSize).run("General TC",threadCount) && success;
+			success = ContentionBenchmark<core::TLSFAddressAllocatorMT<uint32_t,std::recursive_mutex>>(bufferSize,gpMinBlockSize,gpMaxAllocSize).run("TLSF MT",threadCount) && success;
+			success = ContentionBenchmark<core::TLSFAddressAllocatorTC<uint32_t,std::recursive_mutex>>(bufferSize,gpMinBlockSize,gpMaxAllocSize).run("TLSF TC",threadCount) && success;
+		}
+		if (!success)
+			return 2;
+	}
+
+	// Compaction test
+	{
+		printf("COMPACTION===========================================================\n");
+		if (!compactionTest())
+		{
+			printf("Compaction test FAILED\n");
+			return 2;
+		}
+	}
+
+	// Memory statistics test
+	{
+		printf("MEMORY STATISTICS====================================================\n");
+		if (!CMemoryStatistics::isEnabled())
+			printf("NBL_MEMORY_STATISTICS is off, only measuring the baseline\n");
+		else if (!memoryStatisticsTest())
+			return 2;
+		memoryStatisticsOverhead();
+	}
+
+	// Monotonic arena test
+	{
+		printf("MONOTONIC ARENA======================================================\n");
+		if (!monotonicArenaTest() || !monotonicArenaBenchmark())
+			return 2;
 	}
 
 	// Alloc pref test
@@ -2,71 +2,220 @@
 // This file is part of the "Nabla Engine".
 // For conditions of distribution and use, see copyright notice in nabla.h
 
+#define _NBL_STATIC_LIB_
 #include <nabla.h>
-#include <omp.h>
-#include <cassert>
+#include "../common/TestUtils.h"
+
+#include <atomic>
 #include <random>
+#include <thread>
+
+using namespace nbl;
+using namespace core;
 
-uint32_t getRandom(uint32_t min, uint32_t max)
+template<typename F>
+static double timeOnThreads(const uint32_t threadCount, F&& f)
 {
-    static thread_local std::mt19937 generator;
-    return std::uniform_int_distribution<uint32_t>{min,max}(generator);
+	return timeIt([&]()
+	{
+		core::vector<std::thread> threads;
+		for (uint32_t t=0u; t<threadCount; t++)
+			threads.emplace_back(f,t);
+		for (auto& thread : threads)
+			thread.join();
+	});
 }
-#define RANDOM_MIN (1u<<18)
-#define RANDOM_MAX (1u<<19)
 
-class RefCounted : public nbl::core::IReferenceCounted {};
+class RefCounted : public IReferenceCounted
+{
+	protected:
+		~RefCounted() = default;
+};
+
+class ThreadBoundRefCounted : public IThreadBoundReferenceCounted
+{
+	protected:
+		~ThreadBoundRefCounted() = default;
+};
 
-#define TEST_COUNT_AFTER
-int main()
+// every thread writes its slot before dropping, whoever drops last must see all the writes in the destructor
+class Witness : public IReferenceCounted
+{
+	public:
+		Witness(const uint32_t threadCount, std::atomic<bool>& _allSeen) : slots(threadCount,0u), allSeen(_allSeen) {}
+
+		core::vector<uint32_t> slots;
+
+	protected:
+		~Witness()
+		{
+			bool seen = true;
+			for (auto slot : slots)
+				seen = seen && slot==1u;
+			allSeen.store(seen);
+		}
+
+		std::atomic<bool>& allSeen;
+};
+
+static bool raceTest(const uint32_t hardwareThreads)
+{
+	//! Random interleaving of grabs and drops from many more threads than cores, the count has to come back to 1
+	{
+		constexpr uint32_t threadCount = 64u;
+		auto* r = new RefCounted();
+		timeOnThreads(threadCount,[r](const uint32_t t)
+		{
+			std::mt19937 mt(t);
+			const uint32_t cnt = std::uniform_int_distribution<uint32_t>(1u<<14u,1u<<15u)(mt);
+			uint32_t ctr[2] = {0u,0u};
+			while (ctr[0]<cnt || ctr[1]<cnt)
+			{
+				if ((mt()&1u) && ctr[0]<cnt)
+				{
+					r->grab();
+					ctr[0]++;
+				}
+				else if (ctr[1]<ctr[0])
+				{
+					r->drop();
+					ctr[1]++;
+				}
+			}
+		});
+		CHECK(r->getReferenceCount()==1);
+		CHECK(r->drop());
+	}
+
+	//! The last drop has to see the writes every other thread made before its drop
+	for (uint32_t round=0u; round<64u; round++)
+	{
+		const uint32_t threadCount = core::max(hardwareThreads,4u);
+		std::atomic<bool> allSeen(false);
+		auto* w = new Witness(threadCount,allSeen);
+		for (uint32_t t=1u; t<threadCount; t++)
+			w->grab();
+		timeOnThreads(threadCount,[w](const uint32_t t)
+		{
+			w->slots[t] = 1u;
+			w->drop();
+		});
+		CHECK(allSeen.load());
+	}
+	return true;
+}
+
+static bool throughputBenchmark(const uint32_t hardwareThreads)
 {
-    auto r = new RefCounted();
-    omp_set_num_threads(256);
-#pragma omp parallel
+	constexpr uint32_t pairsPerThread = 1u<<22u;
+	const auto nsPerPair = [](const double ms, const uint32_t threadCount) {return (ms*1000000.0)/(double(pairsPerThread)*double(threadCount));};
+
+	//! Every thread works on its own object, the cost of the atomic instructions alone
+	{
+		std::cout << "grab+drop, one object per thread\n";
+		for (uint32_t threadCount=1u; threadCount<=hardwareThreads*2u; threadCount*=2u)
+		{
+			core::vector<RefCounted*> objects(threadCount);
+			for (auto& object : objects)
+				object = new RefCounted();
+			const double time = timeOnThreads(threadCount,[&objects](const uint32_t t)
+			{
+				const auto* object = objects[t];
+				for (uint32_t i=0u; i<pairsPerThread; i++)
+				{
+					object->grab();
+					object->drop();
+				}
+			});
+			for (auto object : objects)
+				object->drop();
+			std::cout << "\t" << threadCount << " threads: " << nsPerPair(time,threadCount) << " ns per pair\n";
+		}
+	}
+
+	//! All threads hammer the same object, i.e. a shared pipeline layout or shader
+	{
+		std::cout << "grab+drop, one object shared by all threads\n";
+		for (uint32_t threadCount=1u; threadCount<=hardwareThreads*2u; threadCount*=2u)
+		{
+			auto* object = new RefCounted();
+			const double time = timeOnThreads(threadCount,[object](const uint32_t t)
+			{
+				for (uint32_t i=0u; i<pairsPerThread; i++)
+				{
+					object->grab();
+					object->drop();
+				}
+			});
+			CHECK(object->drop());
+			std::cout << "\t" << threadCount << " threads: " << nsPerPair(time,threadCount) << " ns per pair\n";
+		}
+	}
+
+	//! What opting into thread confinement saves
+	{
+		auto* shared = new RefCounted();
+		auto* confined = new ThreadBoundRefCounted();
+		CHECK(!shared->isThreadConfined() && confined->isThreadConfined());
+		const double sharedTime = timeIt([shared]()
+		{
+			for (uint32_t i=0u; i<pairsPerThread; i++)
+			{
+				shared->grab();
+				shared->drop();
+			}
+		});
+		const double confinedTime = timeIt([confined]()
+		{
+			for (uint32_t i=0u; i<pairsPerThread; i++)
+			{
+				confined->grab();
+				confined->drop();
+			}
+		});
+		CHECK(confined->getReferenceCount()==1);
+		CHECK(shared->drop() && confined->drop());
+		std::cout << "grab+drop on the creating thread\n";
+		std::cout << "\tIReferenceCounted: " << nsPerPair(sharedTime,1u) << " ns per pair\n";
+		std::cout << "\tIThreadBoundReferenceCounted: " << nsPerPair(confinedTime,1u) << " ns per pair\n";
+	}
+
+	//! Copying vs moving smart pointers around, like the asset converter and loaders do with whole asset graphs
+	{
+		constexpr uint32_t pointerCount = 1u<<20u;
+		core::vector<smart_refctd_ptr<RefCounted>> source;
+		source.reserve(pointerCount);
+		for (uint32_t i=0u; i<pointerCount; i++)
+			source.push_back(make_smart_refctd_ptr<RefCounted>());
+
+		core::vector<smart_refctd_ptr<RefCounted>> destination(pointerCount);
+		const double copyTime = timeIt([&]()
+		{
+			for (uint32_t i=0u; i<pointerCount; i++)
+				destination[i] = source[i];
+		});
+		destination.clear();
+		destination.resize(pointerCount);
+		const double moveTime = timeIt([&]()
+		{
+			for (uint32_t i=0u; i<pointerCount; i++)
+				destination[i] = std::move(source[i]);
+		});
+		for (const auto& ptr : destination)
+			CHECK(ptr->getReferenceCount()==1);
+		std::cout << "smart_refctd_ptr assignment\n";
+		std::cout << "\tcopy: " << (copyTime*1000000.0)/double(pointerCount) << " ns\n";
+		std::cout << "\tmove: " << (moveTime*1000000.0)/double(pointerCount) << " ns\n";
+	}
+	return true;
+}
+
+int main()
 {
-    #pragma omp for
-    for (int i = 0; i<256; ++i)
-    {
-        r->grab();
-
-#ifndef TEST_COUNT_AFTER
-        if (omp_get_thread_num() == 0)
-        {
-            r->drop();
-        }
-#endif // TEST_COUNT_AFTER
-    }
-
-    #pragma omp for
-  	for (int i = 0; i < 256; ++i)
-    {
-        const size_t cnt = getRandom(RANDOM_MIN, RANDOM_MAX);
-        size_t ctr[2]{ 0u, 0u };
-        while (ctr[0] < cnt || ctr[1] < cnt)
-        {
-            switch (getRandom(0u, 1u))
-            {
-            case 0:
-                if (ctr[0] < cnt)
-                {
-                    r->grab();
-                    ctr[0]++;
-                }
-                break;
-            case 1:
-                if (ctr[1] < ctr[0])
-                {
-                    r->drop();
-                    ctr[1]++;
-                }
-                break;
-            }
-        }
-        r->drop();
-    }
-}//omp parallel
-#ifdef TEST_COUNT_AFTER
-    assert(r->getReferenceCount() == 1);
-    assert(r->drop());
-#endif
+	const uint32_t hardwareThreads = core::max(std::thread::hardware_concurrency(),1u);
+	std::cout << "Hardware threads: " << hardwareThreads << "\n";
+
+	if (!raceTest(hardwareThreads) || !throughputBenchmark(hardwareThreads))
+		return 1;
+	return 0;
 }
@@ -1,10 +1,94 @@
 #define _IRR_STATIC_LIB_
 #include <nabla.h>
-#include "nbl/core/containers/LRUcache.h"
+#include "nbl/core/containers/LRUCache.h"
+#include "nbl/core/containers/ConcurrentLRUCache.h"
+
+#include "../common/TestUtils.h"
 
 using namespace nbl;
 using namespace nbl::core;
 
+//! cost budget, i.e. bytes of decoded images
+static bool budgetCacheTest()
+{
+	core::vector<std::string> recycled;
+	core::LRUCache<int, std::string> budgetCache(16u, 100u, [&](int&& key, std::string&& value) { recycled.push_back(std::move(value)); });
+	budgetCache.insert(1, "forty", 40u);
+	budgetCache.insert(2, "thirty", 30u);
+	budgetCache.insert(3, "twenty", 20u);
+	CHECK(budgetCache.getTotalCost() == 90u && recycled.empty());
+
+	budgetCache.get(1); // 2 is least recently used now
+	budgetCache.insert(4, "thirty too", 30u);
+	CHECK(budgetCache.getTotalCost() == 90u);
+	CHECK(recycled.size() == 1u && recycled.back() == "thirty");
+	CHECK(budgetCache.peek(2) == nullptr);
+
+	//updating changes the cost, 3 and 1 have to go to fit 4 and 5
+	budgetCache.insert(5, "sixty", 60u);
+	CHECK(budgetCache.getTotalCost() == 90u && recycled.size() == 3u);
+	CHECK(budgetCache.peek(3) == nullptr && budgetCache.peek(1) == nullptr);
+	budgetCache.insert(5, "ten", 10u);
+	CHECK(budgetCache.getTotalCost() == 40u);
+
+	//does not fit at all, gets handed right back
+	budgetCache.insert(6, "too big", 1000u);
+	CHECK(budgetCache.peek(6) == nullptr && recycled.back() == "too big");
+	CHECK(budgetCache.getTotalCost() == 40u);
+
+	budgetCache.erase(4);
+	CHECK(budgetCache.getTotalCost() == 10u);
+
+	const auto& stats = budgetCache.getStatistics();
+	CHECK(stats.evictions == 4u);
+	CHECK(stats.hits == 1u && stats.misses == 4u);
+	budgetCache.resetStatistics();
+	CHECK(budgetCache.getStatistics().hits == 0u);
+	return true;
+}
+
+//! concurrent, 2 shards of 4 entries each
+static bool concurrentCacheTest()
+{
+	uint32_t evictions = 0u;
+	std::string lastEvicted;
+	core::ConcurrentLRUCache<std::string, int> shardedCache(8u, 2u, [&](std::string&& key, int&& value) { evictions++; lastEvicted = std::move(key); });
+	CHECK(shardedCache.getShardCount() == 2u && shardedCache.getCapacity() == 8u);
+
+	shardedCache.insert(std::string("a.png"), 1);
+	shardedCache.insert("b.png", 2);
+	const std::string_view cView = "c.png";
+	shardedCache.insert(cView, 3);
+
+	//heterogeneous lookups, none of these construct a `std::string`
+	int value = 0;
+	CHECK(shardedCache.get(std::string_view("a.png"), value) && value == 1);
+	CHECK(shardedCache.peek("b.png", value) && value == 2);
+	CHECK(shardedCache.get(cView, value) && value == 3);
+	CHECK(!shardedCache.get("d.png", value));
+
+	//update in place
+	shardedCache.insert("a.png", 10);
+	CHECK(shardedCache.peek(std::string("a.png"), value) && value == 10);
+	CHECK(shardedCache.getSize() == 3u && evictions == 0u);
+
+	//overflow every shard, each has to evict what is least recently used in it
+	for (uint32_t j = 0u; j < 64u; j++)
+		shardedCache.insert("filler" + std::to_string(j) + ".png", int(j));
+	CHECK(shardedCache.getSize() == shardedCache.getCapacity());
+	CHECK(evictions == 3u + 64u - shardedCache.getCapacity());
+	CHECK(shardedCache.peek("filler63.png", value) && value == 63);
+	CHECK(!shardedCache.peek("a.png", value));
+
+	CHECK(shardedCache.erase("filler63.png"));
+	CHECK(!shardedCache.erase("filler63.png"));
+	shardedCache.clear();
+	CHECK(shardedCache.getSize() == 0u);
+	shardedCache.insert(lastEvicted, 0);
+	CHECK(shardedCache.peek(lastEvicted, value) && value == 0);
+	return true;
+}
+
 int main()
 {
 	LRUCache<int, char> hugeCache(50000000u);
@@ -73,6 +157,12 @@ int main()
 	i = 111;
 	cache2.print();
 
+	if (!budgetCacheTest())
+		return 1;
+
+	if (!concurrentCacheTest())
+		return 1;
+
 
 	return 0;
 }
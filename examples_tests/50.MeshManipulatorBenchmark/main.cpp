@@ -0,0 +1,319 @@
+// Copyright (C) 2018-2020 - DevSH Graphics Programming Sp. z O.O.
+// This file is part of the "Nabla Engine".
+// For conditions of distribution and use, see copyright notice in nabla.h
+
+#define _NBL_STATIC_LIB_
+#include <nabla.h>
+#include "nbl/asset/CForsythVertexCacheOptimizer.h"
+#include "../common/TestUtils.h"
+
+#include <random>
+#include <numeric>
+#include <algorithm>
+#include <iostream>
+
+using namespace nbl;
+using namespace core;
+using namespace asset;
+
+static smart_refctd_ptr<ICPUMeshBuffer> createMeshBuffer(IGeometryCreator::return_type&& geometry)
+{
+	auto pipeline = make_smart_refctd_ptr<ICPURenderpassIndependentPipeline>(nullptr,nullptr,nullptr,geometry.inputParams,SBlendParams{},geometry.assemblyParams,SRasterizationParams{});
+	auto mb = make_smart_refctd_ptr<ICPUMeshBuffer>(std::move(pipeline),nullptr,geometry.bindings,std::move(geometry.indexBuffer));
+	mb->setIndexType(geometry.indexType);
+	mb->setIndexCount(geometry.indexCount);
+	mb->setBoundingBox(geometry.bbox);
+	return mb;
+}
+
+// imitates a scanned mesh, every triangle gets its own vertices and positions get jittered by less than the welding epsilon
+static smart_refctd_ptr<ICPUMeshBuffer> createScannedLikeMeshBuffer(const IGeometryCreator* gc, const uint32_t tesselation, const float jitter)
+{
+	auto unwelded = IMeshManipulator::createMeshBufferUniquePrimitives(createMeshBuffer(gc->createSphereMesh(5.f,tesselation,tesselation)).get(),true);
+
+	std::mt19937 mt(0x45u);
+	std::uniform_real_distribution<float> dist(-jitter,jitter);
+	const uint32_t posAttr = unwelded->getPositionAttributeIx();
+	for (uint32_t i=0u; i<unwelded->getIndexCount(); i++)
+	{
+		vectorSIMDf pos;
+		unwelded->getAttribute(pos,posAttr,i);
+		pos += vectorSIMDf(dist(mt),dist(mt),dist(mt),0.f);
+		unwelded->setAttribute(pos,posAttr,i);
+	}
+	return unwelded;
+}
+
+static uint32_t countReferencedVertices(const ICPUMeshBuffer* mb)
+{
+	core::unordered_set<uint32_t> referenced;
+	for (uint32_t i=0u; i<mb->getIndexCount(); i++)
+		referenced.insert(mb->getIndexValue(i));
+	return referenced.size();
+}
+
+// brute force all-pairs welding, how `createMeshBufferWelded` used to find its matches
+static uint32_t referenceWeldedVertexCount(const ICPUMeshBuffer* mb, const IMeshManipulator::SErrorMetric* errMetrics)
+{
+	const uint32_t vertexCount = mb->calcVertexCount();
+	auto cmp = [&](const uint32_t a, const uint32_t b) -> bool
+	{
+		for (uint32_t attr=0u; attr<ICPUMeshBuffer::MAX_VERTEX_ATTRIB_COUNT; attr++)
+		{
+			if (!mb->isAttributeEnabled(attr))
+				continue;
+			const E_FORMAT format = mb->getAttribFormat(attr);
+			if (isIntegerFormat(format) || isScaledFormat(format))
+			{
+				uint32_t va[4], vb[4];
+				mb->getAttribute(va,attr,a);
+				mb->getAttribute(vb,attr,b);
+				if (memcmp(va,vb,getFormatChannelCount(format)*sizeof(uint32_t)))
+					return false;
+			}
+			else
+			{
+				vectorSIMDf va, vb;
+				mb->getAttribute(va,attr,a);
+				mb->getAttribute(vb,attr,b);
+				if (!IMeshManipulator::compareFloatingPointAttribute(va,vb,getFormatChannelCount(format),errMetrics[attr]))
+					return false;
+			}
+		}
+		return true;
+	};
+
+	core::vector<uint32_t> redirects(vertexCount);
+	uint32_t uniqueCount = 0u;
+	for (uint32_t i=0u; i<vertexCount; i++)
+	{
+		redirects[i] = i;
+		for (uint32_t j=0u; j<i; j++)
+		if (redirects[j]==j && cmp(i,j))
+		{
+			redirects[i] = j;
+			break;
+		}
+		if (redirects[i]==i)
+			uniqueCount++;
+	}
+	return uniqueCount;
+}
+
+static smart_refctd_ptr<ICPUMeshBuffer> createWithIndices(const ICPUMeshBuffer* mb, const core::vector<uint32_t>& indices)
+{
+	auto ib = make_smart_refctd_ptr<ICPUBuffer>(indices.size()*sizeof(uint32_t));
+	memcpy(ib->getPointer(),indices.data(),ib->getSize());
+	auto retval = smart_refctd_ptr_static_cast<ICPUMeshBuffer>(mb->clone(0u));
+	retval->setIndexBufferBinding({0u,std::move(ib)});
+	retval->setIndexType(EIT_32BIT);
+	retval->setIndexCount(indices.size());
+	return retval;
+}
+
+static void printStatistics(const char* name, const IMeshManipulator::SVertexCacheStatistics& stats)
+{
+	std::cout << "	" << name << ": ACMR " << stats.acmr << " ATVR " << stats.atvr << " overfetch " << stats.overfetch << "\n";
+}
+
+int main()
+{
+	nbl::SIrrlichtCreationParameters params;
+	params.Bits = 24;
+	params.ZBufferBits = 24;
+	params.DriverType = video::EDT_NULL;
+	params.Fullscreen = false;
+	params.Vsync = false;
+	params.Doublebuffer = true;
+	params.Stencilbuffer = false;
+	auto device = createDeviceEx(params);
+	if (!device)
+		return 1;
+
+	auto* am = device->getAssetManager();
+	const auto* gc = am->getGeometryCreator();
+
+	constexpr float positionEpsilon = 1.0e-4f;
+	IMeshManipulator::SErrorMetric errMetrics[ICPUMeshBuffer::MAX_VERTEX_ATTRIB_COUNT];
+	errMetrics[0].set(IMeshManipulator::EEM_POSITIONS,vectorSIMDf(positionEpsilon));
+	errMetrics[3].set(IMeshManipulator::EEM_ANGLES,vectorSIMDf(0.001f));
+
+	//! Welding
+	{
+		std::cout << "Welding\n";
+		// small enough for the brute force reference to finish in reasonable time
+		{
+			auto mb = createScannedLikeMeshBuffer(gc,48u,positionEpsilon*0.25f);
+			const uint32_t inputCount = mb->getIndexCount();
+
+			uint32_t referenceCount;
+			const double referenceTime = timeIt([&]() {referenceCount = referenceWeldedVertexCount(mb.get(),errMetrics);});
+
+			smart_refctd_ptr<ICPUMeshBuffer> welded;
+			const double weldTime = timeIt([&]() {welded = IMeshManipulator::createMeshBufferWelded(mb.get(),errMetrics,true,true);});
+			const uint32_t weldedCount = countReferencedVertices(welded.get());
+
+			std::cout << "\tvertices: " << inputCount << "\n";
+			std::cout << "\tbrute force: " << referenceCount << " welded vertices in " << referenceTime << " ms\n";
+			std::cout << "\tcreateMeshBufferWelded: " << weldedCount << " welded vertices in " << weldTime << " ms\n";
+			// both weld greedily in vertex order, so apart from floating point noise the results should agree
+			const uint32_t tolerance = core::max(referenceCount/1000u,1u);
+			if (core::max(weldedCount,referenceCount)-core::min(weldedCount,referenceCount)>tolerance)
+			{
+				std::cout << "\tFAILED: welded vertex count differs from the reference by more than " << tolerance << "\n";
+				return 2;
+			}
+		}
+		// scanned mesh sized
+		{
+			auto mb = createScannedLikeMeshBuffer(gc,1024u,positionEpsilon*0.25f);
+			smart_refctd_ptr<ICPUMeshBuffer> welded;
+			const double weldTime = timeIt([&]() {welded = IMeshManipulator::createMeshBufferWelded(mb.get(),errMetrics,true,true);});
+			std::cout << "\t" << mb->getIndexCount() << " vertices welded into " << countReferencedVertices(welded.get()) << " in " << weldTime << " ms\n";
+		}
+	}
+
+	//! Requantization
+	{
+		std::cout << "Requantization\n";
+		auto mb = createScannedLikeMeshBuffer(gc,1024u,positionEpsilon*0.25f);
+		const size_t oldVertexSize = mb->calcVertexSize();
+		const double requantTime = timeIt([&]() {IMeshManipulator::requantizeMeshBuffer(mb.get(),errMetrics);});
+		std::cout << "\t" << mb->getIndexCount() << " vertices requantized from " << oldVertexSize << " to " << mb->calcVertexSize() << " bytes per vertex in " << requantTime << " ms\n";
+	}
+
+	//! Vertex cache optimization
+	{
+		std::cout << "Vertex cache optimization\n";
+		constexpr uint32_t FIFOSize = 16u;
+		// welded scan with triangles in random order, the worst case for all the optimizers
+		auto welded = IMeshManipulator::createMeshBufferWelded(createScannedLikeMeshBuffer(gc,512u,positionEpsilon*0.25f).get(),errMetrics,false,true);
+		const uint32_t triangleCount = welded->getIndexCount()/3u;
+		core::vector<uint32_t> triangles(triangleCount);
+		std::iota(triangles.begin(),triangles.end(),0u);
+		std::shuffle(triangles.begin(),triangles.end(),std::mt19937(0x45u));
+		core::vector<uint32_t> indices(triangleCount*3u);
+		for (uint32_t t=0u; t<triangleCount; t++)
+		for (uint32_t c=0u; c<3u; c++)
+			indices[t*3u+c] = welded->getIndexValue(triangles[t]*3u+c);
+		auto shuffled = createWithIndices(welded.get(),indices);
+		const size_t vertexCount = shuffled->calcVertexCount();
+
+		const auto inputStats = IMeshManipulator::calculateVertexCacheStatistics(shuffled.get(),FIFOSize);
+		std::cout << "	" << triangleCount << " triangles, " << vertexCount << " vertices\n";
+		printStatistics("input",inputStats);
+
+		// the previous path of `createOptimizedMeshBuffer`, only reorders triangles
+		smart_refctd_ptr<ICPUMeshBuffer> forsythOptimized;
+		const double forsythTime = timeIt([&]() {
+			core::vector<uint32_t> optimized(indices.size());
+			CForsythVertexCacheOptimizer().optimizeTriangleOrdering(vertexCount,indices.size(),indices.data(),optimized.data());
+			forsythOptimized = createWithIndices(shuffled.get(),optimized);
+		});
+		std::cout << "	Forsyth: " << forsythTime << " ms\n";
+		printStatistics("Forsyth",IMeshManipulator::calculateVertexCacheStatistics(forsythOptimized.get(),FIFOSize));
+
+		IMeshManipulator::SVertexCacheStatistics tipsifyStats;
+		smart_refctd_ptr<ICPUMeshBuffer> tipsifyOptimized;
+		const double tipsifyTime = timeIt([&]() {tipsifyOptimized = IMeshManipulator::createMeshBufferCacheOptimized(shuffled.get(),FIFOSize,1.05f,&tipsifyStats);});
+		std::cout << "	createMeshBufferCacheOptimized (Tipsify + overdraw + fetch): " << tipsifyTime << " ms\n";
+		printStatistics("Tipsify",tipsifyStats);
+		if (!tipsifyOptimized || tipsifyOptimized->getIndexCount()!=shuffled->getIndexCount() || tipsifyStats.acmr>=inputStats.acmr)
+		{
+			std::cout << "\tFAILED: createMeshBufferCacheOptimized did not improve the triangle order\n";
+			return 2;
+		}
+
+		// cache model sensitivity
+		for (const uint32_t fifoSize : {8u,12u,24u,32u})
+		{
+			IMeshManipulator::SVertexCacheStatistics stats;
+			IMeshManipulator::createMeshBufferCacheOptimized(shuffled.get(),fifoSize,1.05f,&stats);
+			const std::string name = "Tipsify FIFO " + std::to_string(fifoSize);
+			printStatistics(name.c_str(),stats);
+		}
+	}
+
+	//! Simplification
+	{
+		std::cout << "Simplification\n";
+		auto mb = IMeshManipulator::createMeshBufferWelded(createMeshBuffer(gc->createSphereMesh(5.f,512u,512u)).get(),errMetrics,false,true);
+		const uint32_t triangleCount = mb->getIndexCount()/3u;
+		std::cout << "\t" << triangleCount << " triangles\n";
+		for (const float targetError : {0.001f,0.01f})
+		{
+			IMeshManipulator::SSimplificationParams simplificationParams;
+			simplificationParams.targetTriangleCount = triangleCount/8u;
+			simplificationParams.targetError = targetError;
+			float error;
+			smart_refctd_ptr<ICPUMeshBuffer> simplified;
+			const double time = timeIt([&]() {simplified = IMeshManipulator::createMeshBufferSimplified(mb.get(),simplificationParams,&error);});
+			std::cout << "\ttarget error " << targetError << ": " << simplified->getIndexCount()/3u << " triangles, error " << error << " in " << time << " ms\n";
+			if (simplified->getIndexCount()/3u>=triangleCount || error>targetError)
+			{
+				std::cout << "\tFAILED: simplification did not respect its targets\n";
+				return 2;
+			}
+		}
+
+		core::vector<smart_refctd_ptr<ICPUMeshBuffer>> chain;
+		const double chainTime = timeIt([&]() {chain = IMeshManipulator::createMeshBufferLODChain(mb.get(),6u);});
+		std::cout << "\tLOD chain in " << chainTime << " ms:";
+		for (const auto& lod : chain)
+			std::cout << " " << lod->getIndexCount()/3u;
+		std::cout << "\n";
+
+		// meshbuffers get simplified in parallel
+		auto mesh = make_smart_refctd_ptr<CCPUMesh>();
+		for (uint32_t i=0u; i<8u; i++)
+			mesh->addMeshBuffer(IMeshManipulator::createMeshBufferWelded(createMeshBuffer(gc->createSphereMesh(1.f+float(i),256u,256u)).get(),errMetrics,false,true));
+		core::vector<smart_refctd_ptr<ICPUMesh>> meshChain;
+		const double meshChainTime = timeIt([&]() {meshChain = IMeshManipulator::createMeshLODChain(mesh.get(),6u);});
+		std::cout << "\tLOD chain of " << mesh->getMeshBufferCount() << " meshbuffers in " << meshChainTime << " ms\n";
+	}
+
+	//! Layout conversion
+	{
+		std::cout << "Layout conversion\n";
+		auto mb = createMeshBuffer(gc->createSphereMesh(5.f,1024u,1024u));
+		const size_t vertexCount = mb->calcVertexCount();
+		const uint32_t posAttr = mb->getPositionAttributeIx();
+		std::cout << "\t" << vertexCount << " vertices of " << mb->calcVertexSize() << " bytes\n";
+
+		const std::pair<IMeshManipulator::E_VERTEX_LAYOUT,const char*> layouts[] = {
+			{IMeshManipulator::EVL_INTERLEAVED,"interleaved"},
+			{IMeshManipulator::EVL_POSITION_SPLIT,"position split"},
+			{IMeshManipulator::EVL_PLANAR,"planar"}
+		};
+		for (const auto& layout : layouts)
+		{
+			smart_refctd_ptr<ICPUMeshBuffer> converted;
+			const double convertTime = timeIt([&]() {converted = IMeshManipulator::createMeshBufferWithLayout(mb.get(),layout.first);});
+
+			// what a depth-only pass touches, positions only
+			const uint8_t* positions = converted->getAttribPointer(posAttr);
+			const size_t stride = converted->getAttribStride(posAttr);
+			float sum = 0.f;
+			const double positionPassTime = timeIt([&]() {
+				for (size_t i=0u; i<vertexCount; i++)
+					sum += reinterpret_cast<const float*>(positions+i*stride)[1];
+			});
+			std::cout << "\t" << layout.second << ": converted in " << convertTime << " ms, position stride " << stride << " bytes, position pass " << positionPassTime << " ms (" << sum << ")\n";
+
+			for (uint32_t attr=0u; attr<ICPUMeshBuffer::MAX_VERTEX_ATTRIB_COUNT; attr++)
+			{
+				if (!mb->isAttributeEnabled(attr))
+					continue;
+				const size_t size = getTexelOrBlockBytesize(mb->getAttribFormat(attr));
+				for (size_t i=0u; i<vertexCount; i++)
+				if (memcmp(mb->getAttribPointer(attr)+i*mb->getAttribStride(attr),converted->getAttribPointer(attr)+i*converted->getAttribStride(attr),size))
+				{
+					std::cout << "\tFAILED: attribute " << attr << " of vertex " << i << " differs after conversion\n";
+					return 2;
+				}
+			}
+		}
+	}
+
+	return 0;
+}
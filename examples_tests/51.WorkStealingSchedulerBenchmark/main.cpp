@@ -0,0 +1,265 @@
+// Copyright (C) 2018-2020 - DevSH Graphics Programming Sp. z O.O.
+// This file is part of the "Nabla Engine".
+// For conditions of distribution and use, see copyright notice in nabla.h
+
+#define _NBL_STATIC_LIB_
+#include <nabla.h>
+#include "../common/TestUtils.h"
+
+#include <cmath>
+#include <random>
+#include <thread>
+
+using namespace nbl;
+using namespace core;
+
+// something the optimizer can't throw away, cost grows linearly with `iterations`
+static float burn(const uint32_t seed, const uint32_t iterations)
+{
+	float x = static_cast<float>(seed&0xffu);
+	for (uint32_t i=0u; i<iterations; i++)
+		x = std::sqrt(x*x+1.f);
+	return x;
+}
+
+// every item costs more than the last, a static split hands the last thread most of the work
+static uint32_t unevenCost(const size_t i, const size_t count)
+{
+	return static_cast<uint32_t>((i*i*64ull)/(count*count))*64u+1u;
+}
+
+// naive recursive fib, the classical spawn overhead test
+static uint64_t fib(CTaskGroup& parent, const uint32_t n)
+{
+	if (n<2u)
+		return n;
+	uint64_t a,b;
+	CTaskGroup group(parent.getScheduler());
+	group.run([&]() {a = fib(group,n-1u);});
+	b = fib(group,n-2u);
+	group.wait();
+	return a+b;
+}
+
+static uint64_t fibSerial(const uint32_t n)
+{
+	return n<2u ? n:(fibSerial(n-1u)+fibSerial(n-2u));
+}
+
+int main()
+{
+	auto* scheduler = CWorkStealingScheduler::getDefault();
+	const uint32_t threadCount = scheduler->getWorkerCount()+1u;
+	std::cout << "Workers: " << scheduler->getWorkerCount() << " (+ the waiting thread)\n";
+
+	//! Spawn overhead
+	{
+		std::cout << "Spawn overhead\n";
+		constexpr uint32_t taskCount = 1u<<20u;
+		std::atomic<uint32_t> counter(0u);
+		{
+			CTaskGroup group(scheduler);
+			const double time = timeIt([&]()
+			{
+				for (uint32_t i=0u; i<taskCount; i++)
+					group.run([&counter]() {counter.fetch_add(1u,std::memory_order_relaxed);});
+				group.wait();
+			});
+			std::cout << "\tfrom outside the pool: " << (time*1000000.0)/double(taskCount) << " ns per task\n";
+		}
+		{
+			CTaskGroup group(scheduler);
+			const double time = timeIt([&]()
+			{
+				// spawned by a worker, so everything goes through its own deque
+				group.run([&]()
+				{
+					for (uint32_t i=0u; i<taskCount; i++)
+						group.run([&counter]() {counter.fetch_add(1u,std::memory_order_relaxed);});
+				});
+				group.wait();
+			});
+			std::cout << "\tfrom a worker: " << (time*1000000.0)/double(taskCount+1u) << " ns per task\n";
+		}
+		if (counter.load()!=taskCount*2u)
+		{
+			std::cout << "\tFAILED: " << counter.load() << " tasks ran instead of " << taskCount*2u << "\n";
+			return 2;
+		}
+
+		constexpr uint32_t fibN = 30u;
+		uint64_t serialResult,parallelResult;
+		const double serialTime = timeIt([&]() {serialResult = fibSerial(fibN);});
+		const double parallelTime = timeIt([&]()
+		{
+			CTaskGroup root(scheduler);
+			parallelResult = fib(root,fibN);
+		});
+		std::cout << "\tfib(" << fibN << ") with a task per call: " << parallelTime << " ms, serial " << serialTime << " ms\n";
+		if (serialResult!=parallelResult)
+		{
+			std::cout << "\tFAILED: fib mismatch\n";
+			return 2;
+		}
+	}
+
+	//! Continuations
+	{
+		std::cout << "Continuations\n";
+		constexpr uint32_t chainLength = 1u<<14u;
+		std::atomic<uint32_t> links(0u);
+		CTaskGroup group(scheduler);
+		const double time = timeIt([&]()
+		{
+			for (uint32_t i=0u; i<chainLength; i++)
+			{
+				group.run([&links]() {links.fetch_add(1u,std::memory_order_relaxed);});
+				std::atomic<bool> continued(false);
+				group.then([&continued]() {continued.store(true,std::memory_order_release);});
+				while (!continued.load(std::memory_order_acquire))
+					scheduler->runPendingTask();
+			}
+		});
+		std::cout << "\t" << chainLength << " task+continuation round trips: " << (time*1000.0)/double(chainLength) << " us each\n";
+		if (links.load()!=chainLength)
+		{
+			std::cout << "\tFAILED: continuation ran before its group was done\n";
+			return 2;
+		}
+	}
+
+	//! parallel_for
+	{
+		std::cout << "parallel_for\n";
+		constexpr size_t side = 1024u;
+		core::vector<float> data(side*side);
+
+		const double serial1D = timeIt([&]()
+		{
+			for (size_t i=0u; i<data.size(); i++)
+				data[i] = burn(i,16u);
+		});
+		const double parallel1D = timeIt([&]()
+		{
+			scheduler->parallel_for(0u,data.size(),[&](const size_t i) {data[i] = burn(i,16u);});
+		});
+		std::cout << "\t1D " << data.size() << " items: " << parallel1D << " ms, serial " << serial1D << " ms\n";
+
+		const double parallel2D = timeIt([&]()
+		{
+			scheduler->parallel_for(SBlockedRange<2u>{{0u,0u},{side,side},{64u,64u}},[&](const SBlockedRange<2u>& r)
+			{
+				for (size_t y=r.begin[1]; y<r.end[1]; y++)
+				for (size_t x=r.begin[0]; x<r.end[0]; x++)
+					data[y*side+x] = burn(x^y,16u);
+			});
+		});
+		std::cout << "\t2D " << side << "x" << side << " in 64x64 tiles: " << parallel2D << " ms\n";
+
+		constexpr size_t depth = 16u;
+		constexpr size_t slice = side/depth;
+		const double parallel3D = timeIt([&]()
+		{
+			scheduler->parallel_for(SBlockedRange<3u>{{0u,0u,0u},{side,slice,depth},{64u,16u,4u}},[&](const SBlockedRange<3u>& r)
+			{
+				for (size_t z=r.begin[2]; z<r.end[2]; z++)
+				for (size_t y=r.begin[1]; y<r.end[1]; y++)
+				for (size_t x=r.begin[0]; x<r.end[0]; x++)
+					data[(z*slice+y)*side+x] = burn(x^y^z,16u);
+			});
+		});
+		std::cout << "\t3D " << side << "x" << slice << "x" << depth << " in 64x16x4 bricks: " << parallel3D << " ms\n";
+
+		std::atomic<size_t> visited(0u);
+		scheduler->parallel_for(SBlockedRange<3u>{{0u,0u,0u},{33u,17u,5u},{4u,3u,2u}},[&](const SBlockedRange<3u>& r) {visited.fetch_add(r.size(),std::memory_order_relaxed);});
+		if (visited.load()!=33u*17u*5u)
+		{
+			std::cout << "\tFAILED: subranges do not cover the range exactly\n";
+			return 2;
+		}
+	}
+
+	//! Load balance
+	{
+		std::cout << "Load balance\n";
+		constexpr size_t count = 1u<<12u;
+		core::vector<float> results(count);
+
+		const double staticTime = timeIt([&]()
+		{
+			core::vector<std::thread> threads;
+			const size_t chunk = (count+threadCount-1u)/threadCount;
+			for (uint32_t t=0u; t<threadCount; t++)
+				threads.emplace_back([&,t]()
+				{
+					const size_t end = core::min<size_t>((t+1u)*chunk,count);
+					for (size_t i=t*chunk; i<end; i++)
+						results[i] = burn(i,unevenCost(i,count));
+				});
+			for (auto& thread : threads)
+				thread.join();
+		});
+
+		core::vector<uint32_t> itemsPerWorker(threadCount,0u);
+		const double stealingTime = timeIt([&]()
+		{
+			scheduler->parallel_for(0u,count,[&](const size_t i)
+			{
+				results[i] = burn(i,unevenCost(i,count));
+				const uint32_t worker = scheduler->getCurrentWorkerIndex();
+				itemsPerWorker[worker!=CWorkStealingScheduler::AnyWorker ? worker:threadCount-1u]++;
+			},16u);
+		});
+
+		std::cout << "\tskewed work, static split over " << threadCount << " std::threads: " << staticTime << " ms\n";
+		std::cout << "\tskewed work, work stealing: " << stealingTime << " ms\n";
+		std::cout << "\titems per worker (last is the waiting thread):";
+		for (auto items : itemsPerWorker)
+			std::cout << " " << items;
+		std::cout << "\n";
+	}
+
+	//! Parallel sort
+	{
+		std::cout << "Parallel sort\n";
+		// few distinct keys, the second member shows whether ties kept their order
+		constexpr size_t count = 1u<<22u;
+		core::vector<std::pair<uint32_t,uint32_t>> input(count);
+		std::mt19937 mt(0x45u);
+		for (uint32_t i=0u; i<count; i++)
+			input[i] = {mt()&0xffffu,i};
+		auto byKey = [](const std::pair<uint32_t,uint32_t>& a, const std::pair<uint32_t,uint32_t>& b) {return a.first<b.first;};
+
+		auto serial = input;
+		const double serialTime = timeIt([&]() {std::stable_sort(serial.begin(),serial.end(),byKey);});
+		auto parallel = input;
+		const double parallelTime = timeIt([&]() {scheduler->parallel_sort(parallel.begin(),parallel.end(),byKey);});
+		std::cout << "\t" << count << " elements, std::stable_sort: " << serialTime << " ms, parallel_sort: " << parallelTime << " ms\n";
+		if (parallel!=serial)
+		{
+			std::cout << "\tFAILED: parallel_sort differs from std::stable_sort\n";
+			return 2;
+		}
+	}
+
+	//! Affinity hints
+	{
+		std::cout << "Affinity hints\n";
+		constexpr uint32_t tasksPerWorker = 256u;
+		const uint32_t workerCount = scheduler->getWorkerCount();
+		std::atomic<uint32_t> honoured(0u);
+		CTaskGroup group(scheduler);
+		for (uint32_t w=0u; w<workerCount; w++)
+		for (uint32_t i=0u; i<tasksPerWorker; i++)
+			group.run([&,w,i]()
+			{
+				burn(i,256u);
+				if (scheduler->getCurrentWorkerIndex()==w)
+					honoured.fetch_add(1u,std::memory_order_relaxed);
+			},w);
+		group.wait();
+		std::cout << "\t" << honoured.load() << " of " << workerCount*tasksPerWorker << " tasks ran on their preferred worker\n";
+	}
+
+	return 0;
+}
@@ -0,0 +1,907 @@
+// Copyright (C) 2018-2020 - DevSH Graphics Programming Sp. z O.O.
+// This file is part of the "Nabla Engine".
+// For conditions of distribution and use, see copyright notice in nabla.h
+
+#define _NBL_STATIC_LIB_
+#include <nabla.h>
+#include "../common/TestUtils.h"
+
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <memory>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <unordered_map>
+
+using namespace nbl;
+using namespace core;
+
+/*
+Headless benchmark replaying alloc/free traces against the address allocators and their concurrency adaptors.
+
+Usage: 52.AllocatorBenchmark [--ops N] [--seed N] [--threads N] [--buffer-scale F] [--samples N] [--filter NAME]
+                             [--trace FILE]... [--save-traces DIR] [--json FILE] [--csv FILE]
+
+Trace files are plain text, one operation per line:
+	a <id> <bytes> <alignment>	allocation, ids only need to be unique among live allocations
+	f <id>						free
+	r							end of frame, everything still alive gets freed (in reverse allocation order)
+	# comment
+
+Every trace is replayed three times per allocator:
+	- throughput, no clocks read inside the loop, with `--threads` threads sharing the allocator for the concurrency adaptors
+	- latency, every operation timed on its own (minus the measured clock overhead)
+	- layout, single threaded with every live allocation tracked, sampled `--samples` times for fragmentation and `safe_shrink_size`
+
+Fragmentation is measured against the requested sizes:
+	- external: 1 - largest free hole / total free space, holes between live allocations and the end of the buffer
+	- internal: 1 - requested live bytes / allocator's get_allocated_size()
+	- shrink effectiveness: how much of the space past the last live byte `safe_shrink_size` lets you give back, 1 is ideal
+
+Exits with 2 if any allocator handed out overlapping ranges or reported a `safe_shrink_size` cutting into live allocations.
+*/
+
+using size_type = uint32_t;
+
+struct STraceOp
+{
+	enum E_TYPE : uint8_t
+	{
+		ET_ALLOC,
+		ET_FREE,
+		//! frame boundary, only issued after all allocations of the frame have been freed
+		ET_RESET
+	};
+
+	E_TYPE type;
+	//! dense, so the replay can keep addresses in a flat array
+	uint32_t id;
+	size_type bytes;
+	size_type alignment;
+};
+
+struct STrace
+{
+	std::string name;
+	core::vector<STraceOp> ops;
+
+	uint32_t idCount = 0u;
+	size_type maxBytes = 0u;
+	size_type maxAlignment = 1u;
+	uint64_t peakLiveBytes = 0u;
+	uint32_t peakLiveCount = 0u;
+	//! every free is of the newest live allocation, stack allocators can replay it
+	bool lifo = true;
+	//! memory only ever gets reclaimed at frame ends, linear allocators can replay it
+	bool framesOnly = true;
+};
+
+//! Hands out dense ids and turns frame ends into explicit frees, used by both the generators and the trace file loader
+class CTraceBuilder
+{
+		_NBL_STATIC_INLINE_CONSTEXPR uint32_t Tombstone = ~0u;
+
+	public:
+		CTraceBuilder(std::string&& name)
+		{
+			trace.name = std::move(name);
+		}
+
+		inline uint32_t alloc(const size_type bytes, const size_type alignment)
+		{
+			uint32_t id;
+			if (freeIDs.size())
+			{
+				id = freeIDs.back();
+				freeIDs.pop_back();
+			}
+			else
+			{
+				id = trace.idCount++;
+				liveBytes.push_back(0u);
+				setIx.push_back(0u);
+				orderIx.push_back(0u);
+			}
+			liveBytes[id] = bytes;
+			setIx[id] = liveSet.size();
+			liveSet.push_back(id);
+			orderIx[id] = liveOrder.size();
+			liveOrder.push_back(id);
+
+			trace.ops.push_back({STraceOp::ET_ALLOC,id,bytes,alignment});
+			trace.maxBytes = core::max(trace.maxBytes,bytes);
+			trace.maxAlignment = core::max(trace.maxAlignment,alignment);
+			currentLiveBytes += bytes;
+			trace.peakLiveBytes = core::max(trace.peakLiveBytes,currentLiveBytes);
+			trace.peakLiveCount = core::max<uint32_t>(trace.peakLiveCount,liveSet.size());
+			return id;
+		}
+
+		inline void free(const uint32_t id)
+		{
+			trace.framesOnly = false;
+			release(id);
+		}
+
+		inline void endFrame()
+		{
+			while (liveSet.size())
+				release(liveOrder.back());
+			trace.ops.push_back({STraceOp::ET_RESET,0u,0u,0u});
+		}
+
+		inline size_t getLiveCount() const { return liveSet.size(); }
+		//! in no particular order
+		inline uint32_t getLive(const size_t ix) const { return liveSet[ix]; }
+		inline uint32_t getNewest() const { return liveOrder.back(); }
+
+		inline STrace finalize()
+		{
+			// whatever is left over gets freed so every replay ends with an empty allocator
+			if (liveSet.size())
+			{
+				const bool wasFramesOnly = trace.framesOnly;
+				endFrame();
+				trace.framesOnly = wasFramesOnly;
+			}
+			return std::move(trace);
+		}
+
+	private:
+		inline void release(const uint32_t id)
+		{
+			trace.ops.push_back({STraceOp::ET_FREE,id,liveBytes[id],0u});
+			currentLiveBytes -= liveBytes[id];
+			liveBytes[id] = 0u;
+			freeIDs.push_back(id);
+
+			const uint32_t moved = liveSet.back();
+			liveSet[setIx[id]] = moved;
+			setIx[moved] = setIx[id];
+			liveSet.pop_back();
+
+			// allocation order is only needed for frame ends and the LIFO check, so holes get left behind and compacted lazily
+			if (liveOrder.back()!=id)
+			{
+				trace.lifo = false;
+				liveOrder[orderIx[id]] = Tombstone;
+				if (++tombstones>liveOrder.size()/2u)
+				{
+					liveOrder.erase(std::remove(liveOrder.begin(),liveOrder.end(),Tombstone),liveOrder.end());
+					for (uint32_t i=0u; i<liveOrder.size(); i++)
+						orderIx[liveOrder[i]] = i;
+					tombstones = 0u;
+				}
+			}
+			else
+				liveOrder.pop_back();
+			while (liveOrder.size() && liveOrder.back()==Tombstone)
+			{
+				liveOrder.pop_back();
+				tombstones--;
+			}
+		}
+
+		STrace trace;
+		core::vector<size_type> liveBytes;
+		core::vector<uint32_t> liveSet;
+		core::vector<uint32_t> setIx;
+		core::vector<uint32_t> liveOrder;
+		core::vector<uint32_t> orderIx;
+		core::vector<uint32_t> freeIDs;
+		uint32_t tombstones = 0u;
+		uint64_t currentLiveBytes = 0u;
+};
+
+//! Synthetic traces, deterministic for a given seed
+namespace traces
+{
+	// random sizes and alignments around a steady working set, freed in random order
+	STrace uniform(std::mt19937& mt, const uint32_t opCount)
+	{
+		constexpr uint32_t workingSet = 4096u;
+		std::uniform_int_distribution<size_type> sizeDist(16u,4096u);
+		std::uniform_int_distribution<uint32_t> alignDist(0u,6u);
+
+		CTraceBuilder builder("uniform");
+		for (uint32_t i=0u; i<opCount; i++)
+		{
+			const size_t live = builder.getLiveCount();
+			if (live<workingSet/2u || (live<workingSet && (mt()&0x1u)))
+				builder.alloc(sizeDist(mt),0x1u<<alignDist(mt));
+			else
+				builder.free(builder.getLive(mt()%live));
+		}
+		return builder.finalize();
+	}
+
+	// log-uniform sizes, lots of tiny allocations and a few big ones, like loader scratch
+	STrace logUniform(std::mt19937& mt, const uint32_t opCount)
+	{
+		constexpr uint32_t workingSet = 4096u;
+		std::uniform_int_distribution<uint32_t> exponentDist(4u,16u);
+		std::uniform_int_distribution<uint32_t> alignDist(0u,4u);
+
+		CTraceBuilder builder("log_uniform");
+		for (uint32_t i=0u; i<opCount; i++)
+		{
+			const size_t live = builder.getLiveCount();
+			if (live<workingSet/2u || (live<workingSet && (mt()&0x1u)))
+			{
+				const uint32_t exponent = exponentDist(mt);
+				builder.alloc((0x1u<<exponent)+(mt()&((0x1u<<exponent)-1u)),0x1u<<alignDist(mt));
+			}
+			else
+				builder.free(builder.getLive(mt()%live));
+		}
+		return builder.finalize();
+	}
+
+	// big long lived allocations interleaved with many short lived small ones, the classical fragmentation inducer
+	STrace longShort(std::mt19937& mt, const uint32_t opCount)
+	{
+		constexpr uint32_t maxLongLived = 64u;
+		constexpr uint32_t maxShortLived = 1024u;
+		std::uniform_int_distribution<size_type> longSizeDist(16u<<10u,256u<<10u);
+		std::uniform_int_distribution<size_type> shortSizeDist(16u,1024u);
+
+		CTraceBuilder builder("long_short");
+		core::deque<uint32_t> shortLived;
+		core::vector<uint32_t> longLived;
+		for (uint32_t i=0u; i<opCount; i++)
+		{
+			const uint32_t dice = mt()%100u;
+			if (dice<2u)
+			{
+				if (longLived.size()==maxLongLived)
+				{
+					const uint32_t victim = mt()%maxLongLived;
+					builder.free(longLived[victim]);
+					longLived[victim] = builder.alloc(longSizeDist(mt),256u);
+				}
+				else
+					longLived.push_back(builder.alloc(longSizeDist(mt),256u));
+			}
+			else if (shortLived.size()==maxShortLived || (shortLived.size() && dice<50u))
+			{
+				// mostly FIFO, with some jitter
+				const size_t victim = core::min<size_t>(mt()%8u,shortLived.size()-1u);
+				builder.free(shortLived[victim]);
+				shortLived.erase(shortLived.begin()+victim);
+			}
+			else
+				shortLived.push_back(builder.alloc(shortSizeDist(mt),16u));
+		}
+		return builder.finalize();
+	}
+
+	// per-frame transient data that all dies at the end of the frame, like the streaming upload buffers
+	STrace frame(std::mt19937& mt, const uint32_t opCount)
+	{
+		std::uniform_int_distribution<uint32_t> frameAllocDist(64u,512u);
+		std::uniform_int_distribution<size_type> sizeDist(64u,16u<<10u);
+		std::uniform_int_distribution<uint32_t> alignDist(2u,8u);
+
+		CTraceBuilder builder("frame");
+		for (uint32_t i=0u; i<opCount;)
+		{
+			const uint32_t frameAllocs = frameAllocDist(mt);
+			for (uint32_t j=0u; j<frameAllocs; j++)
+				builder.alloc(sizeDist(mt),0x1u<<alignDist(mt));
+			builder.endFrame();
+			i += frameAllocs*2u+1u;
+		}
+		return builder.finalize();
+	}
+
+	// random walk of nested scopes
+	STrace lifo(std::mt19937& mt, const uint32_t opCount)
+	{
+		constexpr uint32_t maxDepth = 1024u;
+		std::uniform_int_distribution<size_type> sizeDist(16u,8192u);
+		std::uniform_int_distribution<uint32_t> alignDist(0u,6u);
+
+		CTraceBuilder builder("lifo");
+		for (uint32_t i=0u; i<opCount; i++)
+		{
+			const size_t depth = builder.getLiveCount();
+			if (depth==0u || (depth<maxDepth && (mt()%100u)<52u))
+				builder.alloc(sizeDist(mt),0x1u<<alignDist(mt));
+			else
+				builder.free(builder.getNewest());
+		}
+		return builder.finalize();
+	}
+}
+
+static bool loadTrace(const std::string& path, STrace& outTrace)
+{
+	std::ifstream file(path);
+	if (!file)
+	{
+		std::cerr << "Could not open trace " << path << "\n";
+		return false;
+	}
+
+	CTraceBuilder builder(std::string(path.substr(path.find_last_of("/\\")+1u)));
+	std::unordered_map<uint64_t,uint32_t> ids;
+	std::string line;
+	for (size_t lineNo=1u; std::getline(file,line); lineNo++)
+	{
+		std::istringstream tokens(line);
+		std::string type;
+		if (!(tokens >> type) || type[0]=='#')
+			continue;
+
+		uint64_t id;
+		if (type=="a")
+		{
+			uint64_t bytes,alignment = 1u;
+			if (!(tokens >> id >> bytes) || !bytes || bytes>~size_type(0u))
+			{
+				std::cerr << path << ":" << lineNo << ": malformed allocation\n";
+				return false;
+			}
+			tokens >> alignment;
+			if (ids.find(id)!=ids.end())
+			{
+				std::cerr << path << ":" << lineNo << ": id " << id << " is already live\n";
+				return false;
+			}
+			ids[id] = builder.alloc(static_cast<size_type>(bytes),core::roundUpToPoT(core::max<size_type>(alignment,1u)));
+		}
+		else if (type=="f")
+		{
+			auto found = (tokens >> id) ? ids.find(id):ids.end();
+			if (found==ids.end())
+			{
+				std::cerr << path << ":" << lineNo << ": free of an id which is not live\n";
+				return false;
+			}
+			builder.free(found->second);
+			ids.erase(found);
+		}
+		else if (type=="r")
+		{
+			builder.endFrame();
+			ids.clear();
+		}
+		else
+		{
+			std::cerr << path << ":" << lineNo << ": unknown operation " << type << "\n";
+			return false;
+		}
+	}
+	outTrace = builder.finalize();
+	return true;
+}
+
+static bool saveTrace(const std::string& path, const STrace& trace)
+{
+	std::ofstream file(path);
+	if (!file)
+		return false;
+	file << "# " << trace.name << ", " << trace.ops.size() << " operations\n";
+	for (const auto& op : trace.ops)
+	switch (op.type)
+	{
+		case STraceOp::ET_ALLOC:
+			file << "a " << op.id << " " << op.bytes << " " << op.alignment << "\n";
+			break;
+		case STraceOp::ET_FREE:
+			// when only frame ends free memory the frees are implied, writing them out would make the trace unusable for linear allocators
+			if (!trace.framesOnly)
+				file << "f " << op.id << "\n";
+			break;
+		case STraceOp::ET_RESET:
+			file << "r\n";
+			break;
+	}
+	return bool(file);
+}
+
+
+struct SBenchmarkConfig
+{
+	uint32_t threadCount = core::max(std::thread::hardware_concurrency(),1u);
+	double bufferScale = 2.0;
+	uint32_t sampleCount = 256u;
+	std::string filter;
+};
+
+struct SRunResult
+{
+	std::string allocator;
+	std::string trace;
+	uint32_t threadCount = 1u;
+	size_type bufferSize = 0u;
+	uint64_t ops = 0u;
+	uint64_t failedAllocs = 0u;
+	double opsPerSecond = 0.0;
+	//! nanoseconds
+	double allocP50 = 0.0, allocP99 = 0.0;
+	double freeP50 = 0.0, freeP99 = 0.0;
+
+	uint64_t peakLiveBytes = 0u;
+	uint64_t peakFootprint = 0u;
+	double peakExternalFragmentation = 0.0;
+	double meanExternalFragmentation = 0.0;
+	double peakInternalFragmentation = 0.0;
+	double meanShrinkEffectiveness = 1.0;
+	uint64_t overlaps = 0u;
+	uint64_t unsafeShrinks = 0u;
+};
+
+class IAllocatorBenchmark
+{
+	public:
+		virtual ~IAllocatorBenchmark() {}
+
+		virtual const char* getName() const = 0;
+		virtual bool canReplay(const STrace& trace) const = 0;
+		virtual SRunResult run(const STrace& trace, const SBenchmarkConfig& config) = 0;
+};
+
+// the adaptors only expose what is safe to call concurrently, so everything goes through the traits
+template<class AlctrType>
+inline void replayOp(AlctrType& alctr, const STraceOp& op, size_type* addresses, const bool resetAfterFrame, uint64_t& failedAllocs)
+{
+	using Traits = address_allocator_traits<AlctrType>;
+	switch (op.type)
+	{
+		case STraceOp::ET_ALLOC:
+			addresses[op.id] = AlctrType::invalid_address;
+			Traits::multi_alloc_addr(alctr,1u,addresses+op.id,&op.bytes,&op.alignment);
+			if (addresses[op.id]==AlctrType::invalid_address)
+				failedAllocs++;
+			break;
+		case STraceOp::ET_FREE:
+			if (addresses[op.id]!=AlctrType::invalid_address)
+				Traits::multi_free_addr(alctr,1u,addresses+op.id,&op.bytes);
+			break;
+		case STraceOp::ET_RESET:
+			if (resetAfterFrame)
+				alctr.reset();
+			break;
+	}
+}
+
+template<class AlctrType>
+inline auto drainCachesIfAny(AlctrType& alctr, int) -> decltype(alctr.drainCaches(),void())
+{
+	alctr.drainCaches();
+}
+template<class AlctrType>
+inline void drainCachesIfAny(AlctrType& alctr, long) {}
+
+static double measureClockOverhead()
+{
+	core::vector<double> samples(1024u);
+	for (auto& sample : samples)
+	{
+		const auto start = clock_type::now();
+		sample = std::chrono::duration<double,std::nano>(clock_type::now()-start).count();
+	}
+	std::nth_element(samples.begin(),samples.begin()+samples.size()/2u,samples.end());
+	return samples[samples.size()/2u];
+}
+
+static double percentile(core::vector<float>& samples, const double p)
+{
+	if (samples.empty())
+		return 0.0;
+	auto nth = samples.begin()+static_cast<size_t>(p*double(samples.size()-1u));
+	std::nth_element(samples.begin(),nth,samples.end());
+	return *nth;
+}
+
+enum E_ALLOCATOR_KIND
+{
+	EAK_LINEAR,
+	EAK_STACK,
+	EAK_POOL,
+	//! General purpose and TLSF, the extra constructor parameter is the minimum block size
+	EAK_GENERAL
+};
+
+/**
+@tparam AlctrType the allocator which gets timed
+@tparam LayoutAlctrType the allocator whose layout gets analyzed, the basic concurrency adaptor lays things out exactly like the allocator it wraps
+*/
+template<class AlctrType, class LayoutAlctrType, E_ALLOCATOR_KIND Kind, bool Concurrent>
+class CAllocatorBenchmark : public IAllocatorBenchmark
+{
+		_NBL_STATIC_INLINE_CONSTEXPR size_type StackMinAllocSize = 16u;
+		_NBL_STATIC_INLINE_CONSTEXPR size_type GeneralMinBlockSize = 32u;
+
+		//! Owns an allocator and its reserved memory
+		template<class T>
+		class CInstance
+		{
+			public:
+				CInstance(const STrace& trace, const size_type bufferSize)
+				{
+					const size_type extra = getExtraParam(trace);
+					const size_t reservedSize = core::max<size_t>(T::reserved_size(trace.maxAlignment,bufferSize,extra),1u);
+					reserved = _NBL_ALIGNED_MALLOC(reservedSize,_NBL_SIMD_ALIGNMENT);
+					// fault the pages in up front, otherwise allocators with per-granule metadata get first-touch costs in their latencies
+					memset(reserved,0,reservedSize);
+					if constexpr (Kind==EAK_LINEAR)
+						alctr.reset(new T(reserved,0u,0u,trace.maxAlignment,bufferSize));
+					else
+						alctr.reset(new T(reserved,0u,0u,trace.maxAlignment,bufferSize,extra));
+				}
+				~CInstance()
+				{
+					alctr = nullptr;
+					_NBL_ALIGNED_FREE(reserved);
+				}
+
+				void* reserved;
+				std::unique_ptr<T> alctr;
+		};
+
+	public:
+		CAllocatorBenchmark(const char* _name) : name(_name) {}
+
+		const char* getName() const override { return name; }
+
+		bool canReplay(const STrace& trace) const override
+		{
+			switch (Kind)
+			{
+				case EAK_LINEAR:
+					return trace.framesOnly;
+				case EAK_STACK:
+					return trace.lifo;
+				default:
+					return true;
+			}
+		}
+
+		SRunResult run(const STrace& trace, const SBenchmarkConfig& config) override
+		{
+			SRunResult result;
+			result.allocator = name;
+			result.trace = trace.name;
+			// threads replaying frames would reset each other's allocations
+			result.threadCount = Concurrent && Kind!=EAK_LINEAR ? config.threadCount:1u;
+			result.ops = trace.ops.size();
+
+			const size_type bufferSize = getBufferSize(trace,config.bufferScale);
+			const size_type sharedBufferSize = static_cast<size_type>(core::min<uint64_t>(uint64_t(bufferSize)*result.threadCount,0x80000000ull));
+			result.bufferSize = sharedBufferSize;
+
+			// throughput
+			{
+				CInstance<AlctrType> instance(trace,sharedBufferSize);
+				core::vector<uint64_t> failedAllocs(result.threadCount,0u);
+				std::atomic<bool> go(false);
+				core::vector<std::thread> threads;
+				for (uint32_t t=1u; t<result.threadCount; t++)
+					threads.emplace_back([&,t]()
+					{
+						while (!go.load(std::memory_order_acquire))
+							std::this_thread::yield();
+						replayAll(*instance.alctr,trace,failedAllocs[t]);
+					});
+				const auto start = clock_type::now();
+				go.store(true,std::memory_order_release);
+				replayAll(*instance.alctr,trace,failedAllocs[0]);
+				for (auto& thread : threads)
+					thread.join();
+				const double seconds = std::chrono::duration<double>(clock_type::now()-start).count();
+
+				result.opsPerSecond = double(result.ops*result.threadCount)/seconds;
+				for (auto failed : failedAllocs)
+					result.failedAllocs += failed;
+			}
+
+			// latency
+			{
+				CInstance<AlctrType> instance(trace,sharedBufferSize);
+				const double clockOverhead = measureClockOverhead();
+				core::vector<core::vector<float>> allocLatencies(result.threadCount),freeLatencies(result.threadCount);
+				core::vector<std::thread> threads;
+				auto timeAll = [&](const uint32_t t)
+				{
+					core::vector<size_type> addresses(trace.idCount,AlctrType::invalid_address);
+					uint64_t failedAllocs = 0u;
+					allocLatencies[t].reserve(trace.ops.size()/2u);
+					freeLatencies[t].reserve(trace.ops.size()/2u);
+					for (const auto& op : trace.ops)
+					{
+						const auto start = clock_type::now();
+						replayOp(*instance.alctr,op,addresses.data(),Kind==EAK_LINEAR,failedAllocs);
+						const double ns = core::max(std::chrono::duration<double,std::nano>(clock_type::now()-start).count()-clockOverhead,0.0);
+						if (op.type==STraceOp::ET_ALLOC)
+							allocLatencies[t].push_back(static_cast<float>(ns));
+						else if (op.type==STraceOp::ET_FREE)
+							freeLatencies[t].push_back(static_cast<float>(ns));
+					}
+				};
+				for (uint32_t t=1u; t<result.threadCount; t++)
+					threads.emplace_back(timeAll,t);
+				timeAll(0u);
+				for (auto& thread : threads)
+					thread.join();
+
+				for (uint32_t t=1u; t<result.threadCount; t++)
+				{
+					allocLatencies[0].insert(allocLatencies[0].end(),allocLatencies[t].begin(),allocLatencies[t].end());
+					freeLatencies[0].insert(freeLatencies[0].end(),freeLatencies[t].begin(),freeLatencies[t].end());
+				}
+				result.allocP50 = percentile(allocLatencies[0],0.5);
+				result.allocP99 = percentile(allocLatencies[0],0.99);
+				result.freeP50 = percentile(freeLatencies[0],0.5);
+				result.freeP99 = percentile(freeLatencies[0],0.99);
+			}
+
+			analyzeLayout(trace,bufferSize,config.sampleCount,result);
+			return result;
+		}
+
+	private:
+		static size_type getExtraParam(const STrace& trace)
+		{
+			switch (Kind)
+			{
+				case EAK_STACK:
+					return StackMinAllocSize;
+				case EAK_POOL:
+					// a pool has to fit the biggest allocation of the trace, the waste shows up as internal fragmentation
+					return core::roundUpToPoT(core::max(trace.maxBytes,trace.maxAlignment));
+				case EAK_GENERAL:
+					return GeneralMinBlockSize;
+				default:
+					return 0u;
+			}
+		}
+
+		static size_type getBufferSize(const STrace& trace, const double scale)
+		{
+			uint64_t needed = trace.peakLiveBytes;
+			if (Kind==EAK_POOL)
+				needed = uint64_t(trace.peakLiveCount)*getExtraParam(trace);
+			needed = static_cast<uint64_t>(double(needed)*scale)+trace.maxAlignment;
+			return static_cast<size_type>(core::min<uint64_t>(core::roundUp<uint64_t>(needed,trace.maxAlignment),0x80000000ull));
+		}
+
+		static void replayAll(AlctrType& alctr, const STrace& trace, uint64_t& failedAllocs)
+		{
+			core::vector<size_type> addresses(trace.idCount,AlctrType::invalid_address);
+			for (const auto& op : trace.ops)
+				replayOp(alctr,op,addresses.data(),Kind==EAK_LINEAR,failedAllocs);
+		}
+
+		static void analyzeLayout(const STrace& trace, const size_type bufferSize, const uint32_t sampleCount, SRunResult& result)
+		{
+			using Traits = address_allocator_traits<LayoutAlctrType>;
+			CInstance<LayoutAlctrType> instance(trace,bufferSize);
+			auto& alctr = *instance.alctr;
+
+			core::vector<size_type> addresses(trace.idCount,LayoutAlctrType::invalid_address);
+			core::map<size_type,size_type> live;
+			uint64_t liveBytes = 0u;
+			uint64_t failedAllocs = 0u;
+
+			uint32_t samples = 0u;
+			double externalSum = 0.0;
+			double shrinkSum = 0.0;
+			uint32_t shrinkSamples = 0u;
+			auto sample = [&]()
+			{
+				uint64_t totalFree = 0u, largestHole = 0u, end = 0u;
+				for (const auto& allocation : live)
+				{
+					const uint64_t hole = allocation.first-end;
+					totalFree += hole;
+					largestHole = core::max(largestHole,hole);
+					end = allocation.first+allocation.second;
+				}
+				const uint64_t highestLiveByte = end;
+				totalFree += bufferSize-end;
+				largestHole = core::max<uint64_t>(largestHole,bufferSize-end);
+
+				const double external = totalFree ? (1.0-double(largestHole)/double(totalFree)):0.0;
+				result.peakExternalFragmentation = core::max(result.peakExternalFragmentation,external);
+				externalSum += external;
+				samples++;
+
+				drainCachesIfAny(alctr,0);
+				const uint64_t allocated = Traits::get_allocated_size(alctr);
+				if (allocated)
+					result.peakInternalFragmentation = core::max(result.peakInternalFragmentation,1.0-double(liveBytes)/double(allocated));
+
+				const uint64_t safeSize = alctr.safe_shrink_size(0u,trace.maxAlignment);
+				if (safeSize<highestLiveByte)
+					result.unsafeShrinks++;
+				else if (highestLiveByte<bufferSize)
+				{
+					shrinkSum += double(bufferSize-core::min<uint64_t>(safeSize,bufferSize))/double(bufferSize-highestLiveByte);
+					shrinkSamples++;
+				}
+			};
+
+			const size_t sampleInterval = core::max<size_t>(trace.ops.size()/core::max(sampleCount,1u),1u);
+			for (size_t i=0u; i<trace.ops.size(); i++)
+			{
+				const auto& op = trace.ops[i];
+				replayOp(alctr,op,addresses.data(),Kind==EAK_LINEAR,failedAllocs);
+
+				const size_type addr = addresses[op.id];
+				if (op.type==STraceOp::ET_ALLOC && addr!=LayoutAlctrType::invalid_address)
+				{
+					// check the neighbours for overlap before recording
+					auto next = live.lower_bound(addr);
+					if (next!=live.end() && next->first<addr+op.bytes)
+						result.overlaps++;
+					if (next!=live.begin() && std::prev(next)->first+std::prev(next)->second>addr)
+						result.overlaps++;
+					live[addr] = op.bytes;
+					liveBytes += op.bytes;
+					result.peakLiveBytes = core::max(result.peakLiveBytes,liveBytes);
+					result.peakFootprint = core::max<uint64_t>(result.peakFootprint,addr+op.bytes);
+				}
+				else if (op.type==STraceOp::ET_FREE && addr!=LayoutAlctrType::invalid_address)
+				{
+					live.erase(addr);
+					liveBytes -= op.bytes;
+					addresses[op.id] = LayoutAlctrType::invalid_address;
+				}
+
+				if ((i+1u)%sampleInterval==0u)
+					sample();
+			}
+			result.meanExternalFragmentation = samples ? externalSum/double(samples):0.0;
+			result.meanShrinkEffectiveness = shrinkSamples ? shrinkSum/double(shrinkSamples):1.0;
+		}
+
+		const char* name;
+};
+
+
+static void writeJSON(std::ostream& out, const core::vector<SRunResult>& results, const SBenchmarkConfig& config, const uint32_t seed)
+{
+	out << "{\n\t\"schema\": 1,\n\t\"seed\": " << seed << ",\n\t\"threads\": " << config.threadCount << ",\n\t\"bufferScale\": " << config.bufferScale << ",\n\t\"results\": [\n";
+	for (size_t i=0u; i<results.size(); i++)
+	{
+		const auto& r = results[i];
+		out << "\t\t{\"allocator\": \"" << r.allocator << "\", \"trace\": \"" << r.trace << "\", \"threads\": " << r.threadCount
+			<< ", \"bufferSize\": " << r.bufferSize << ", \"ops\": " << r.ops << ", \"failedAllocs\": " << r.failedAllocs
+			<< ", \"opsPerSecond\": " << r.opsPerSecond
+			<< ", \"allocP50ns\": " << r.allocP50 << ", \"allocP99ns\": " << r.allocP99 << ", \"freeP50ns\": " << r.freeP50 << ", \"freeP99ns\": " << r.freeP99
+			<< ", \"peakLiveBytes\": " << r.peakLiveBytes << ", \"peakFootprint\": " << r.peakFootprint
+			<< ", \"peakExternalFragmentation\": " << r.peakExternalFragmentation << ", \"meanExternalFragmentation\": " << r.meanExternalFragmentation
+			<< ", \"peakInternalFragmentation\": " << r.peakInternalFragmentation << ", \"meanShrinkEffectiveness\": " << r.meanShrinkEffectiveness
+			<< ", \"overlaps\": " << r.overlaps << ", \"unsafeShrinks\": " << r.unsafeShrinks << "}" << (i+1u<results.size() ? ",\n":"\n");
+	}
+	out << "\t]\n}\n";
+}
+
+static void writeCSV(std::ostream& out, const core::vector<SRunResult>& results)
+{
+	out << "allocator,trace,threads,bufferSize,ops,failedAllocs,opsPerSecond,allocP50ns,allocP99ns,freeP50ns,freeP99ns,peakLiveBytes,peakFootprint,"
+		"peakExternalFragmentation,meanExternalFragmentation,peakInternalFragmentation,meanShrinkEffectiveness,overlaps,unsafeShrinks\n";
+	for (const auto& r : results)
+		out << r.allocator << "," << r.trace << "," << r.threadCount << "," << r.bufferSize << "," << r.ops << "," << r.failedAllocs << "," << r.opsPerSecond << ","
+			<< r.allocP50 << "," << r.allocP99 << "," << r.freeP50 << "," << r.freeP99 << "," << r.peakLiveBytes << "," << r.peakFootprint << ","
+			<< r.peakExternalFragmentation << "," << r.meanExternalFragmentation << "," << r.peakInternalFragmentation << "," << r.meanShrinkEffectiveness << ","
+			<< r.overlaps << "," << r.unsafeShrinks << "\n";
+}
+
+int main(int argc, char** argv)
+{
+	SBenchmarkConfig config;
+	uint32_t opCount = 1u<<20u;
+	uint32_t seed = 0x45u;
+	core::vector<std::string> tracePaths;
+	std::string saveDir, jsonPath, csvPath;
+	for (int i=1; i<argc; i++)
+	{
+		const std::string arg(argv[i]);
+		const bool hasValue = i+1<argc;
+		if (arg=="--ops" && hasValue)
+			opCount = std::stoul(argv[++i]);
+		else if (arg=="--seed" && hasValue)
+			seed = std::stoul(argv[++i]);
+		else if (arg=="--threads" && hasValue)
+			config.threadCount = core::max<uint32_t>(std::stoul(argv[++i]),1u);
+		else if (arg=="--buffer-scale" && hasValue)
+			config.bufferScale = core::max(std::stod(argv[++i]),1.0);
+		else if (arg=="--samples" && hasValue)
+			config.sampleCount = std::stoul(argv[++i]);
+		else if (arg=="--filter" && hasValue)
+			config.filter = argv[++i];
+		else if (arg=="--trace" && hasValue)
+			tracePaths.push_back(argv[++i]);
+		else if (arg=="--save-traces" && hasValue)
+			saveDir = argv[++i];
+		else if (arg=="--json" && hasValue)
+			jsonPath = argv[++i];
+		else if (arg=="--csv" && hasValue)
+			csvPath = argv[++i];
+		else
+		{
+			std::cerr << "Unknown or incomplete argument " << arg << ", see the top of main.cpp for usage\n";
+			return 1;
+		}
+	}
+
+	// recorded traces replace the synthetic ones
+	core::vector<STrace> traceList;
+	if (tracePaths.empty())
+	{
+		std::mt19937 mt(seed);
+		traceList.push_back(traces::uniform(mt,opCount));
+		traceList.push_back(traces::logUniform(mt,opCount));
+		traceList.push_back(traces::longShort(mt,opCount));
+		traceList.push_back(traces::frame(mt,opCount));
+		traceList.push_back(traces::lifo(mt,opCount));
+	}
+	for (const auto& path : tracePaths)
+	{
+		traceList.emplace_back();
+		if (!loadTrace(path,traceList.back()))
+			return 1;
+	}
+	if (saveDir.size())
+	for (const auto& trace : traceList)
+	{
+		const std::string path = saveDir+"/"+trace.name+".trace";
+		if (!saveTrace(path,trace))
+			std::cerr << "Could not write " << path << "\n";
+	}
+
+	core::vector<std::unique_ptr<IAllocatorBenchmark>> allocators;
+	allocators.emplace_back(new CAllocatorBenchmark<LinearAddressAllocatorST<size_type>,LinearAddressAllocatorST<size_type>,EAK_LINEAR,false>("Linear ST"));
+	allocators.emplace_back(new CAllocatorBenchmark<LinearAddressAllocatorMT<size_type,std::recursive_mutex>,LinearAddressAllocatorST<size_type>,EAK_LINEAR,true>("Linear MT"));
+	allocators.emplace_back(new CAllocatorBenchmark<StackAddressAllocatorST<size_type>,StackAddressAllocatorST<size_type>,EAK_STACK,false>("Stack ST"));
+	allocators.emplace_back(new CAllocatorBenchmark<PoolAddressAllocatorST<size_type>,PoolAddressAllocatorST<size_type>,EAK_POOL,false>("Pool ST"));
+	allocators.emplace_back(new CAllocatorBenchmark<PoolAddressAllocatorMT<size_type,std::recursive_mutex>,PoolAddressAllocatorST<size_type>,EAK_POOL,true>("Pool MT"));
+	allocators.emplace_back(new CAllocatorBenchmark<PoolAddressAllocatorTC<size_type,std::recursive_mutex>,PoolAddressAllocatorTC<size_type,std::recursive_mutex>,EAK_POOL,true>("Pool TC"));
+	allocators.emplace_back(new CAllocatorBenchmark<GeneralpurposeAddressAllocatorST<size_type>,GeneralpurposeAddressAllocatorST<size_type>,EAK_GENERAL,false>("General ST"));
+	allocators.emplace_back(new CAllocatorBenchmark<GeneralpurposeAddressAllocatorMT<size_type,std::recursive_mutex>,GeneralpurposeAddressAllocatorST<size_type>,EAK_GENERAL,true>("General MT"));
+	allocators.emplace_back(new CAllocatorBenchmark<GeneralpurposeAddressAllocatorTC<size_type,std::recursive_mutex>,GeneralpurposeAddressAllocatorTC<size_type,std::recursive_mutex>,EAK_GENERAL,true>("General TC"));
+	allocators.emplace_back(new CAllocatorBenchmark<TLSFAddressAllocatorST<size_type>,TLSFAddressAllocatorST<size_type>,EAK_GENERAL,false>("TLSF ST"));
+	allocators.emplace_back(new CAllocatorBenchmark<TLSFAddressAllocatorMT<size_type,std::recursive_mutex>,TLSFAddressAllocatorST<size_type>,EAK_GENERAL,true>("TLSF MT"));
+	allocators.emplace_back(new CAllocatorBenchmark<TLSFAddressAllocatorTC<size_type,std::recursive_mutex>,TLSFAddressAllocatorTC<size_type,std::recursive_mutex>,EAK_GENERAL,true>("TLSF TC"));
+
+	bool success = true;
+	core::vector<SRunResult> results;
+	for (const auto& trace : traceList)
+	{
+		printf("Trace %s: %zu ops, peak %llu live bytes in %u allocations%s%s\n",trace.name.c_str(),trace.ops.size(),
+			static_cast<unsigned long long>(trace.peakLiveBytes),trace.peakLiveCount,trace.lifo ? ", LIFO":"",trace.framesOnly ? ", frames only":"");
+		for (auto& allocator : allocators)
+		{
+			if (!allocator->canReplay(trace) || std::string(allocator->getName()).find(config.filter)==std::string::npos)
+				continue;
+
+			results.push_back(allocator->run(trace,config));
+			const auto& r = results.back();
+			printf("\t%-11s %2u threads: %8.2f Mops/s, alloc p50/p99 %6.0f/%6.0f ns, free p50/p99 %6.0f/%6.0f ns, ext. frag peak %.3f mean %.3f, int. frag %.3f, shrink %.3f, %llu failed%s%s\n",
+				r.allocator.c_str(),r.threadCount,r.opsPerSecond/1000000.0,r.allocP50,r.allocP99,r.freeP50,r.freeP99,
+				r.peakExternalFragmentation,r.meanExternalFragmentation,r.peakInternalFragmentation,r.meanShrinkEffectiveness,
+				static_cast<unsigned long long>(r.failedAllocs),r.overlaps ? ", OVERLAPPING ALLOCATIONS":"",r.unsafeShrinks ? ", UNSAFE SHRINK SIZE":"");
+			success = success && !r.overlaps && !r.unsafeShrinks;
+		}
+	}
+
+	if (jsonPath.size())
+	{
+		std::ofstream out(jsonPath);
+		writeJSON(out,results,config,seed);
+	}
+	if (csvPath.size())
+	{
+		std::ofstream out(csvPath);
+		writeCSV(out,results);
+	}
+
+	return success ? 0:2;
+}
@@ -0,0 +1,73 @@
+// Copyright (C) 2018-2020 - DevSH Graphics Programming Sp. z O.O.
+// This file is part of the "Nabla Engine".
+// For conditions of distribution and use, see copyright notice in nabla.h
+
+#define _NBL_STATIC_LIB_
+#include <nabla.h>
+#include "nbl/core/containers/ConcurrentLRUCache.h"
+#include "../common/TestUtils.h"
+
+#include <atomic>
+#include <cmath>
+#include <random>
+#include <string>
+#include <thread>
+
+using namespace nbl;
+using namespace core;
+
+// the functional checks are in 34.LRUCacheUnitTest
+int main()
+{
+	constexpr uint32_t keyCount = 1u<<16u;
+	constexpr uint32_t capacity = keyCount/4u;
+	constexpr uint32_t opsPerThread = 1u<<19u;
+
+	// resolved paths, like the texture and shader variant caches of the loaders get
+	core::vector<std::string> keys(keyCount);
+	for (uint32_t i=0u; i<keyCount; i++)
+		keys[i] = "../../media/textures/"+std::to_string(i)+".png";
+
+	const uint32_t hardwareThreads = core::max(std::thread::hardware_concurrency(),1u);
+	std::cout << "Hardware threads: " << hardwareThreads << "\n";
+	std::cout << "Cache capacity " << capacity << " over " << keyCount << " keys, " << opsPerThread << " ops per thread, get and insert on miss\n";
+
+	for (const uint32_t shardCount : {1u,16u,64u})
+	{
+		std::cout << shardCount << (shardCount>1u ? " shards\n":" shard (one global lock)\n");
+		for (uint32_t threadCount=1u; threadCount<=hardwareThreads*2u; threadCount*=2u)
+		{
+			ConcurrentLRUCache<std::string,uint32_t> cache(capacity,shardCount);
+			std::atomic<uint32_t> hits(0u);
+			const double time = timeIt([&]()
+			{
+				core::vector<std::thread> threads;
+				for (uint32_t t=0u; t<threadCount; t++)
+					threads.emplace_back([&,t]()
+					{
+						std::mt19937 mt(0x45u+t);
+						std::uniform_real_distribution<float> dist(0.f,1.f);
+						uint32_t localHits = 0u;
+						for (uint32_t i=0u; i<opsPerThread; i++)
+						{
+							// skewed towards low key indices, so there is a hot working set
+							const uint32_t k = core::min(static_cast<uint32_t>(std::pow(dist(mt),3.f)*float(keyCount)),keyCount-1u);
+							const std::string_view key = keys[k];
+							uint32_t value;
+							if (cache.get(key,value))
+								localHits++;
+							else
+								cache.insert(key,k);
+						}
+						hits.fetch_add(localHits,std::memory_order_relaxed);
+					});
+				for (auto& thread : threads)
+					thread.join();
+			});
+			const double totalOps = double(threadCount)*double(opsPerThread);
+			std::cout << "\t" << threadCount << " threads: " << totalOps/(time*1000.0) << " Mops/s, hit rate " << double(hits.load())/totalOps << "\n";
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,510 @@
+// Copyright (C) 2018-2020 - DevSH Graphics Programming Sp. z O.O.
+// This file is part of the "Nabla Engine".
+// For conditions of distribution and use, see copyright notice in nabla.h
+
+#define _NBL_STATIC_LIB_
+#include <nabla.h>
+#include "../common/TestUtils.h"
+
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+using namespace nbl;
+using namespace core;
+using namespace asset;
+
+static bool sameCode(const ICPUShader* a, const ICPUShader* b)
+{
+	const auto* bufA = a->getSPVorGLSL();
+	const auto* bufB = b->getSPVorGLSL();
+	return bufA->getSize()==bufB->getSize() && memcmp(bufA->getPointer(),bufB->getPointer(),bufA->getSize())==0;
+}
+
+// CSPIRVDiskCache, cold and warm compiles give the same SPIR-V, what goes into the key, sharing a directory and eviction
+static bool spirvDiskCacheTest(IGLSLCompiler* compiler)
+{
+	const ISPIRVOptimizer optimizer({ISPIRVOptimizer::EOP_MERGE_RETURN,ISPIRVOptimizer::EOP_INLINE,ISPIRVOptimizer::EOP_AGGRESSIVE_DCE});
+
+	// the permutations an uber-shader would produce
+	constexpr uint32_t permutationCount = 32u;
+	core::vector<smart_refctd_ptr<ICPUShader>> resolved;
+	for (uint32_t i=0u; i<permutationCount; i++)
+	{
+		std::string source = "#version 430 core\n#define PERMUTATION "+std::to_string(i)+"\n"+R"===(
+#include "nbl/builtin/glsl/math/constants.glsl"
+layout(local_size_x=64) in;
+layout(set=0, binding=0, std430) buffer Data { float data[]; };
+void main()
+{
+	float acc = float(PERMUTATION);
+	for (int j=0; j<PERMUTATION+4; j++)
+		acc = sin(acc*nbl_glsl_PI)+cos(float(j));
+	data[gl_GlobalInvocationID.x] = acc;
+}
+)===";
+		resolved.push_back(compiler->resolveIncludeDirectives(std::move(source),ISpecializedShader::ESS_COMPUTE,"permutation.comp"));
+		CHECK(resolved.back());
+	}
+	auto compileAll = [&](core::vector<smart_refctd_ptr<ICPUShader>>& out) -> void
+	{
+		out.clear();
+		for (const auto& shader : resolved)
+			out.push_back(compiler->createSPIRVFromGLSL(reinterpret_cast<const char*>(shader->getSPVorGLSL()->getPointer()),ISpecializedShader::ESS_COMPUTE,"main","permutation.comp",&optimizer));
+	};
+
+	core::vector<smart_refctd_ptr<ICPUShader>> reference, cold, warm;
+	const double uncachedTime = timeIt([&]() {compileAll(reference);});
+
+	auto cache = make_smart_refctd_ptr<CSPIRVDiskCache>("spirv_cache_test");
+	cache->clear();
+	CHECK(cache->getSize()==0ull);
+	compiler->setCache(smart_refctd_ptr(cache));
+	const double coldTime = timeIt([&]() {compileAll(cold);});
+	const uint64_t populatedSize = cache->getSize();
+	CHECK(populatedSize>0ull);
+	const double warmTime = timeIt([&]() {compileAll(warm);});
+	CHECK(cache->getSize()==populatedSize);
+	for (uint32_t i=0u; i<permutationCount; i++)
+		CHECK(reference[i] && sameCode(reference[i].get(),cold[i].get()) && sameCode(reference[i].get(),warm[i].get()));
+
+	// anything the output depends on is part of the key
+	{
+		const char* glsl = reinterpret_cast<const char*>(resolved[0]->getSPVorGLSL()->getPointer());
+		const auto key = CSPIRVDiskCache::computeKey(glsl,strlen(glsl),ISpecializedShader::ESS_COMPUTE,"main","permutation.comp",true,&optimizer);
+		CHECK(cache->find(key));
+		CHECK(!cache->find(CSPIRVDiskCache::computeKey(glsl,strlen(glsl),ISpecializedShader::ESS_COMPUTE,"main","permutation.comp",false,&optimizer)));
+		CHECK(!cache->find(CSPIRVDiskCache::computeKey(glsl,strlen(glsl),ISpecializedShader::ESS_COMPUTE,"main","permutation.comp",true,nullptr)));
+		// the compilation id ends up in the debug info, without debug info it doesn't matter
+		CHECK(!cache->find(CSPIRVDiskCache::computeKey(glsl,strlen(glsl),ISpecializedShader::ESS_COMPUTE,"main","other.comp",true,&optimizer)));
+		CHECK(CSPIRVDiskCache::computeKey(glsl,strlen(glsl),ISpecializedShader::ESS_COMPUTE,"main","permutation.comp",false,&optimizer)==CSPIRVDiskCache::computeKey(glsl,strlen(glsl),ISpecializedShader::ESS_COMPUTE,"main","other.comp",false,&optimizer));
+		// assembly was never requested, so it wasn't stored
+		std::string assembly;
+		CHECK(!cache->find(key,&assembly));
+		auto withAssembly = compiler->createSPIRVFromGLSL(glsl,ISpecializedShader::ESS_COMPUTE,"main","permutation.comp",&optimizer,true,&assembly);
+		CHECK(withAssembly && !assembly.empty());
+		std::string cachedAssembly;
+		CHECK(cache->find(key,&cachedAssembly) && cachedAssembly==assembly);
+	}
+
+	// a second cache over the same directory, as another process would have, sees the entries and can write the same ones concurrently
+	{
+		auto other = make_smart_refctd_ptr<CSPIRVDiskCache>("spirv_cache_test");
+		CHECK(other->getSize()==cache->getSize());
+		core::vector<std::thread> writers;
+		for (uint32_t t=0u; t<4u; t++)
+			writers.emplace_back([&,t]()
+			{
+				auto* target = (t&1u) ? other.get():cache.get();
+				for (uint32_t i=0u; i<permutationCount; i++)
+				{
+					const char* glsl = reinterpret_cast<const char*>(resolved[i]->getSPVorGLSL()->getPointer());
+					target->insert(CSPIRVDiskCache::computeKey(glsl,strlen(glsl),ISpecializedShader::ESS_COMPUTE,"main","permutation.comp",true,&optimizer),warm[i]->getSPVorGLSL());
+				}
+			});
+		for (auto& writer : writers)
+			writer.join();
+		core::vector<smart_refctd_ptr<ICPUShader>> shared;
+		compileAll(shared);
+		for (uint32_t i=0u; i<permutationCount; i++)
+			CHECK(sameCode(reference[i].get(),shared[i].get()));
+	}
+
+	// least recently used entries get evicted once over the cap
+	{
+		auto small = make_smart_refctd_ptr<CSPIRVDiskCache>("spirv_cache_test",populatedSize/4ull);
+		CHECK(small->getSize()<=populatedSize/4ull);
+		core::vector<smart_refctd_ptr<ICPUShader>> evicted;
+		compiler->setCache(smart_refctd_ptr(small));
+		compileAll(evicted);
+		CHECK(small->getSize()<=small->getMaxSize());
+		for (uint32_t i=0u; i<permutationCount; i++)
+			CHECK(sameCode(reference[i].get(),evicted[i].get()));
+		const char* last = reinterpret_cast<const char*>(resolved.back()->getSPVorGLSL()->getPointer());
+		CHECK(small->find(CSPIRVDiskCache::computeKey(last,strlen(last),ISpecializedShader::ESS_COMPUTE,"main","permutation.comp",true,&optimizer)));
+		small->clear();
+		CHECK(small->getSize()==0ull);
+	}
+	compiler->setCache(nullptr);
+
+	std::cout << permutationCount << " permutations, " << populatedSize/1024u << " KiB of cached SPIR-V\n";
+	std::cout << "\tno cache: " << uncachedTime << " ms\n";
+	std::cout << "\tcold cache: " << coldTime << " ms\n";
+	std::cout << "\twarm cache: " << warmTime << " ms\n";
+	return true;
+}
+
+// an uber-shader, permutations pick the material and the light count with defines
+static const char* uberShader = R"===(#version 430 core
+#include "nbl/builtin/glsl/math/constants.glsl"
+layout(local_size_x=64) in;
+layout(set=0, binding=0, std430) buffer Data { vec4 data[]; };
+void main()
+{
+	vec4 acc = data[gl_GlobalInvocationID.x];
+	for (int i=0; i<LIGHT_COUNT; i++)
+	{
+#if MATERIAL==0
+		acc = sin(acc*nbl_glsl_PI)+vec4(i);
+#elif MATERIAL==1
+		acc = cos(acc.wzyx)*exp2(float(i));
+#else
+		acc = normalize(acc+vec4(1.0))*inversesqrt(float(i+1));
+#endif
+	}
+	data[gl_GlobalInvocationID.x] = acc;
+}
+)===";
+
+// compileBatch gives what compiling one by one would, in job order, and keeps failures with their job
+static bool compileBatchTest(const IGLSLCompiler* compiler)
+{
+	const ISPIRVOptimizer optimizer({ISPIRVOptimizer::EOP_MERGE_RETURN,ISPIRVOptimizer::EOP_INLINE,ISPIRVOptimizer::EOP_AGGRESSIVE_DCE,ISPIRVOptimizer::EOP_SIMPLIFICATION});
+
+	constexpr uint32_t materialCount = 3u;
+	constexpr uint32_t maxLights = 16u;
+	core::vector<std::string> defineStorage;
+	defineStorage.reserve(materialCount*maxLights*2u);
+	core::vector<const char*> defines;
+	defines.reserve(materialCount*maxLights*2u);
+	core::vector<IGLSLCompiler::SCompilationJob> jobs;
+	for (uint32_t material=0u; material<materialCount; material++)
+	for (uint32_t lights=1u; lights<=maxLights; lights++)
+	{
+		defineStorage.push_back("MATERIAL "+std::to_string(material));
+		defineStorage.push_back("LIGHT_COUNT "+std::to_string(lights));
+		defines.push_back(defineStorage[defineStorage.size()-2u].c_str());
+		defines.push_back(defineStorage.back().c_str());
+
+		IGLSLCompiler::SCompilationJob job;
+		job.glsl = uberShader;
+		job.stage = ISpecializedShader::ESS_COMPUTE;
+		job.originFilepath = "uber.comp";
+		job.optimizer = &optimizer;
+		jobs.push_back(job);
+	}
+	for (size_t i=0u; i<jobs.size(); i++)
+		jobs[i].defines = {defines.data()+2u*i,defines.data()+2u*i+2u};
+
+	// what callers do now, one shader at a time
+	core::vector<smart_refctd_ptr<ICPUShader>> sequential;
+	const double sequentialTime = timeIt([&]()
+	{
+		for (const auto& job : jobs)
+		{
+			std::string glsl(job.glsl);
+			IShader::insertDefines(glsl,job.defines);
+			auto resolved = compiler->resolveIncludeDirectives(std::move(glsl),job.stage,job.originFilepath);
+			sequential.push_back(compiler->createSPIRVFromGLSL(reinterpret_cast<const char*>(resolved->getSPVorGLSL()->getPointer()),job.stage,"main",job.originFilepath,job.optimizer));
+		}
+	});
+
+	core::vector<IGLSLCompiler::SCompilationResult> batch;
+	const double batchTime = timeIt([&]() {batch = compiler->compileBatch({jobs.data(),jobs.data()+jobs.size()});});
+
+	// same results in the same order, no matter how the jobs got scheduled
+	CHECK(batch.size()==jobs.size());
+	for (size_t i=0u; i<jobs.size(); i++)
+		CHECK(sequential[i] && batch[i].shader && sameCode(sequential[i].get(),batch[i].shader.get()));
+	auto again = compiler->compileBatch({jobs.data(),jobs.data()+jobs.size()});
+	for (size_t i=0u; i<jobs.size(); i++)
+		CHECK(sameCode(again[i].shader.get(),batch[i].shader.get()) && again[i].diagnostics==batch[i].diagnostics);
+	// on the calling thread
+	auto inline_ = compiler->compileBatch({jobs.data(),jobs.data()+2u},nullptr);
+	CHECK(inline_.size()==2u && sameCode(inline_[1].shader.get(),batch[1].shader.get()));
+
+	// failures stay with their job
+	{
+		IGLSLCompiler::SCompilationJob broken[3] = {jobs[0],jobs[1],jobs[2]};
+		broken[0].defines = {nullptr,nullptr}; // LIGHT_COUNT undefined
+		const char* missingInclude = "#version 430 core\n#include \"does/not/exist.glsl\"\nvoid main() {}\n";
+		broken[2].glsl = missingInclude;
+		auto results = compiler->compileBatch({broken,broken+3});
+		CHECK(!results[0].shader && results[0].diagnostics.find("LIGHT_COUNT")!=std::string::npos);
+		CHECK(results[1].shader && sameCode(results[1].shader.get(),batch[1].shader.get()));
+		CHECK(!results[2].shader && !results[2].diagnostics.empty());
+	}
+
+	std::cout << jobs.size() << " permutations on " << CWorkStealingScheduler::getDefault()->getWorkerCount() << " workers (+ the waiting thread)\n";
+	std::cout << "\tone by one: " << sequentialTime << " ms\n";
+	std::cout << "\tcompileBatch: " << batchTime << " ms, speedup " << sequentialTime/batchTime << "x\n";
+	return true;
+}
+
+static void writeFile(const std::string& path, const std::string& contents)
+{
+	std::ofstream file(path,std::ios::binary|std::ios::trunc);
+	file << contents;
+}
+
+static std::string getGLSL(const ICPUShader* shader)
+{
+	return reinterpret_cast<const char*>(shader->getSPVorGLSL()->getPointer());
+}
+
+static bool endsWith(const std::string& str, const std::string& suffix)
+{
+	return str.size()>=suffix.size() && str.compare(str.size()-suffix.size(),suffix.size(),suffix)==0;
+}
+
+// resolved includes get reused, the include graph is right and edited files are never served stale
+static bool includeCacheTest(IGLSLCompiler* compiler)
+{
+	auto* cache = compiler->getIncludeCache();
+
+	// even shaders include a.glsl -> common.glsl -> the GGX builtins, odd ones b.glsl -> the GGX builtins
+	const std::string dir = "include_cache_test/";
+	std::filesystem::create_directories(dir);
+	writeFile(dir+"common.glsl","#ifndef _COMMON_INCLUDED_\n#define _COMMON_INCLUDED_\n#include <nbl/builtin/glsl/bxdf/brdf/specular/ggx.glsl>\nfloat common_f(float x) {return x*2.0;}\n#endif\n");
+	writeFile(dir+"a.glsl","#include \"common.glsl\"\nfloat a_f(float x) {return common_f(x)+1.0;}\n");
+	writeFile(dir+"b.glsl","#include <nbl/builtin/glsl/bxdf/brdf/specular/ggx.glsl>\nfloat b_f(float x) {return x-1.0;}\n");
+
+	constexpr uint32_t shaderCount = 64u;
+	core::vector<std::string> origins, sources;
+	for (uint32_t i=0u; i<shaderCount; i++)
+	{
+		origins.push_back(dir+"shader"+std::to_string(i)+".comp");
+		sources.push_back("#version 460 core\n#define PERMUTATION "+std::to_string(i)+"\n#include \""+((i&1u) ? "b.glsl":"a.glsl")+"\"\nlayout(local_size_x=64) in;\nvoid main() {}\n");
+	}
+	auto resolveAll = [&](const bool dropCache, core::vector<std::string>& out) -> void
+	{
+		out.clear();
+		for (uint32_t i=0u; i<shaderCount; i++)
+		{
+			if (dropCache)
+				cache->clear();
+			auto resolved = compiler->resolveIncludeDirectives(std::string(sources[i]),ISpecializedShader::ESS_COMPUTE,origins[i].c_str());
+			out.push_back(resolved ? getGLSL(resolved.get()):"");
+		}
+	};
+
+	// dropping the cache before every shader is what resolution used to cost
+	core::vector<std::string> uncached, cold, warm;
+	const double uncachedTime = timeIt([&]() {resolveAll(true,uncached);});
+	cache->clear();
+	const auto statsBefore = cache->getStatistics();
+	const double coldTime = timeIt([&]() {resolveAll(false,cold);});
+	const double warmTime = timeIt([&]() {resolveAll(false,warm);});
+	const auto statsAfter = cache->getStatistics();
+	for (uint32_t i=0u; i<shaderCount; i++)
+		CHECK(!uncached[i].empty() && uncached[i]==cold[i] && uncached[i]==warm[i]);
+	CHECK(statsAfter.hits>statsBefore.hits && statsAfter.entryCount>3u);
+
+	// the graph knows who includes what
+	std::string commonPath, bPath;
+	for (const auto& include : cache->getFilesystemIncludes())
+	{
+		if (endsWith(include.first,"common.glsl"))
+			commonPath = include.first;
+		else if (endsWith(include.first,"b.glsl"))
+			bPath = include.first;
+	}
+	CHECK(!commonPath.empty() && !bPath.empty());
+	{
+		const auto dependents = cache->getDependents(commonPath);
+		CHECK(dependents.size()==shaderCount/2u+1u);
+		for (uint32_t i=0u; i<shaderCount; i++)
+			CHECK(std::binary_search(dependents.begin(),dependents.end(),origins[i])==!(i&1u));
+		const auto dependencies = cache->getDependencies(origins[0]);
+		CHECK(std::binary_search(dependencies.begin(),dependencies.end(),commonPath));
+		CHECK(std::binary_search(dependencies.begin(),dependencies.end(),std::string("nbl/builtin/glsl/bxdf/brdf/specular/ggx.glsl")));
+	}
+
+	// hot reload, an edit only invalidates the shaders which depend on the file
+	CHECK(compiler->refreshIncludeCache().empty());
+	writeFile(dir+"b.glsl","#include <nbl/builtin/glsl/bxdf/brdf/specular/ggx.glsl>\nfloat b_f(float x) {return x-2.0;}\n");
+	{
+		const auto outdated = compiler->refreshIncludeCache();
+		CHECK(outdated.size()==shaderCount/2u+1u && std::binary_search(outdated.begin(),outdated.end(),bPath));
+		for (uint32_t i=0u; i<shaderCount; i++)
+			CHECK(std::binary_search(outdated.begin(),outdated.end(),origins[i])==bool(i&1u));
+	}
+	// even without a refresh an edited file is never served stale
+	writeFile(dir+"b.glsl","#include <nbl/builtin/glsl/bxdf/brdf/specular/ggx.glsl>\nfloat b_f(float x) {return x-3.0;}\n");
+	{
+		core::vector<std::string> edited;
+		resolveAll(false,edited);
+		for (uint32_t i=0u; i<shaderCount; i++)
+			CHECK((edited[i]==warm[i])==!(i&1u) && ((i&1u)==0u || edited[i].find("x-3.0")!=std::string::npos));
+	}
+	std::filesystem::remove_all(dir);
+
+	std::cout << shaderCount << " shaders resolving #includes\n";
+	std::cout << "\twithout the include cache: " << uncachedTime << " ms\n";
+	std::cout << "\tcold include cache: " << coldTime << " ms\n";
+	std::cout << "\twarm include cache: " << warmTime << " ms, " << statsAfter.entryCount << " includes cached\n";
+	return true;
+}
+
+static bool sameLayout(const ICPUPipelineLayout* a, const ICPUPipelineLayout* b)
+{
+	return a && b && a->isCompatibleForPushConstants(b) && a->isCompatibleUpToSet(ICPUPipelineLayout::DESCRIPTOR_SET_COUNT-1u,b)==ICPUPipelineLayout::DESCRIPTOR_SET_COUNT-1u;
+}
+
+// nested structs and a runtime sized array exercise the recursive member introspection
+static const char* introspectedSource = R"===(#version 430 core
+layout(local_size_x=64) in;
+struct Light { vec3 position; float radius; mat3 orientation; };
+struct Cluster { uvec2 range; Light lights[4]; };
+layout(set=0, binding=0, std430) restrict buffer Clusters { Cluster clusters[]; };
+layout(set=0, binding=1) uniform sampler2D tex[2];
+layout(set=1, binding=0, std140) uniform Camera { mat4 viewProj; vec4 params[PERMUTATION+1]; } camera;
+layout(set=2, binding=3, rgba16f) uniform writeonly image2D outImage;
+layout(push_constant) uniform PushConstants { uint frame; float exposure; } pc;
+void main()
+{
+	Cluster c = clusters[gl_GlobalInvocationID.x];
+	vec4 acc = camera.viewProj*vec4(c.lights[PERMUTATION%4].position,1.0)+camera.params[PERMUTATION];
+	acc += textureLod(tex[pc.frame&1u],acc.xy,0.0)*pc.exposure;
+	imageStore(outImage,ivec2(gl_GlobalInvocationID.xy),acc);
+}
+)===";
+
+// CIntrospectionCache, identical SPIR-V gets introspected once, from any thread, and survives a round trip to disk
+static bool introspectionCacheTest(const IGLSLCompiler* compiler)
+{
+	constexpr uint32_t permutationCount = 32u;
+	core::vector<std::string> defineStorage;
+	core::vector<IGLSLCompiler::SCompilationJob> jobs(permutationCount);
+	for (uint32_t i=0u; i<permutationCount; i++)
+		defineStorage.push_back("PERMUTATION "+std::to_string(i));
+	core::vector<const char*> defines;
+	for (const auto& define : defineStorage)
+		defines.push_back(define.c_str());
+	for (uint32_t i=0u; i<permutationCount; i++)
+	{
+		jobs[i].glsl = introspectedSource;
+		jobs[i].stage = ISpecializedShader::ESS_COMPUTE;
+		jobs[i].originFilepath = "introspected.comp";
+		jobs[i].defines = {defines.data()+i,defines.data()+i+1u};
+	}
+	const auto compiled = compiler->compileBatch({jobs.data(),jobs.data()+jobs.size()});
+
+	// every SPIR-V gets loaded twice, as separate assets with the same contents
+	core::vector<smart_refctd_ptr<ICPUSpecializedShader>> shaders;
+	for (uint32_t copy=0u; copy<2u; copy++)
+	for (uint32_t i=0u; i<permutationCount; i++)
+	{
+		CHECK(compiled[i].shader);
+		const auto* spirv = compiled[i].shader->getSPVorGLSL();
+		auto buffer = make_smart_refctd_ptr<ICPUBuffer>(spirv->getSize());
+		memcpy(buffer->getPointer(),spirv->getPointer(),spirv->getSize());
+		auto unspecialized = make_smart_refctd_ptr<ICPUShader>(std::move(buffer));
+		shaders.push_back(make_smart_refctd_ptr<ICPUSpecializedShader>(std::move(unspecialized),ISpecializedShader::SInfo(nullptr,nullptr,"main",ISpecializedShader::ESS_COMPUTE)));
+	}
+	auto createLayouts = [&](CShaderIntrospector& introspector, core::vector<smart_refctd_ptr<ICPUPipelineLayout>>& out, CWorkStealingScheduler* scheduler) -> void
+	{
+		out.resize(shaders.size());
+		auto body = [&](const size_t i) -> void
+		{
+			ICPUSpecializedShader* shader = shaders[i].get();
+			out[i] = introspector.createApproximatePipelineLayoutFromIntrospection(&shader,&shader+1,nullptr,nullptr);
+		};
+		if (scheduler)
+			scheduler->parallel_for(0u,shaders.size(),body);
+		else for (size_t i=0u; i<shaders.size(); i++)
+			body(i);
+	};
+
+	// the same contents only go through spirv_cross once
+	CShaderIntrospector cold(compiler);
+	core::vector<smart_refctd_ptr<ICPUPipelineLayout>> coldLayouts;
+	const double coldTime = timeIt([&]() {createLayouts(cold,coldLayouts,nullptr);});
+	{
+		const auto stats = cold.getCache()->getStatistics();
+		CHECK(stats.entryCount==permutationCount && stats.misses==permutationCount && stats.hits==permutationCount);
+	}
+	for (uint32_t i=0u; i<permutationCount; i++)
+		CHECK(coldLayouts[i] && sameLayout(coldLayouts[i].get(),coldLayouts[i+permutationCount].get()));
+
+	// many introspectors, one cache, from all workers at once
+	auto shared = make_smart_refctd_ptr<CIntrospectionCache>();
+	core::vector<smart_refctd_ptr<ICPUPipelineLayout>> parallelLayouts;
+	const double parallelTime = timeIt([&]()
+	{
+		CShaderIntrospector introspector(compiler,smart_refctd_ptr(shared));
+		createLayouts(introspector,parallelLayouts,CWorkStealingScheduler::getDefault());
+	});
+	CHECK(shared->getStatistics().entryCount==permutationCount);
+	for (size_t i=0u; i<shaders.size(); i++)
+		CHECK(sameLayout(coldLayouts[i].get(),parallelLayouts[i].get()));
+
+	// warm start from disk, nothing left to introspect
+	const std::string cachePath = "introspection_cache_test.bin";
+	CHECK(cold.getCache()->serialize(cachePath));
+	auto loaded = make_smart_refctd_ptr<CIntrospectionCache>();
+	core::vector<smart_refctd_ptr<ICPUPipelineLayout>> warmLayouts;
+	double loadTime = timeIt([&]() {loaded->deserialize(cachePath);});
+	CHECK(loaded->getStatistics().entryCount==permutationCount);
+	CShaderIntrospector warm(compiler,smart_refctd_ptr(loaded));
+	const double warmTime = timeIt([&]() {createLayouts(warm,warmLayouts,nullptr);});
+	CHECK(loaded->getStatistics().misses==0u);
+	for (size_t i=0u; i<shaders.size(); i++)
+		CHECK(sameLayout(coldLayouts[i].get(),warmLayouts[i].get()));
+	{
+		// members survive the round trip all the way down
+		CShaderIntrospector::SIntrospectionParams introParams = {ISpecializedShader::ESS_COMPUTE,"main",nullptr,""};
+		const auto* introspected = cold.introspect(shaders[0]->getUnspecialized(),introParams);
+		const auto* deserialized = warm.introspect(shaders[0]->getUnspecialized(),introParams);
+		CHECK(introspected && deserialized && introspected!=deserialized);
+		const auto& a = introspected->descriptorSetBindings[0].front().get<ESRT_STORAGE_BUFFER>();
+		const auto& b = deserialized->descriptorSetBindings[0].front().get<ESRT_STORAGE_BUFFER>();
+		CHECK(a.name==b.name && a.size==b.size && a.rtSizedArrayOneElementSize==b.rtSizedArrayOneElementSize && a.restrict_==b.restrict_);
+		const auto& lightsA = a.members.array[0].members.array[1];
+		const auto& lightsB = b.members.array[0].members.array[1];
+		CHECK(lightsA.name==lightsB.name && lightsA.count==lightsB.count && lightsA.arrayStride==lightsB.arrayStride && lightsA.members.count==lightsB.members.count);
+		CHECK(lightsA.members.array[2].mtxStride==lightsB.members.array[2].mtxStride && lightsA.members.array[2].offset==lightsB.members.array[2].offset);
+		CHECK(introspected->pushConstant.present && deserialized->pushConstant.present && introspected->pushConstant.info.name==deserialized->pushConstant.info.name);
+	}
+
+	// GLSL gets keyed on what it includes, editing an included file is a miss and not a stale introspection
+	{
+		const std::string dir = "introspection_include_test/";
+		std::filesystem::create_directories(dir);
+		writeFile(dir+"bindings.glsl","layout(set=0, binding=0, std430) buffer Data { vec4 data[]; };\n");
+		auto includer = make_smart_refctd_ptr<ICPUShader>("#version 430 core\nlayout(local_size_x=64) in;\n#include \"bindings.glsl\"\nvoid main() { data[gl_GlobalInvocationID.x] = vec4(1.0); }\n");
+		CShaderIntrospector::SIntrospectionParams glslParams = {ISpecializedShader::ESS_COMPUTE,"main",nullptr,dir+"includer.comp"};
+		CShaderIntrospector introspector(compiler);
+		const auto* before = introspector.introspect(includer.get(),glslParams);
+		CHECK(before && introspector.introspect(includer.get(),glslParams)==before);
+		writeFile(dir+"bindings.glsl","layout(set=0, binding=5, std430) buffer Data { vec4 data[]; };\n");
+		const auto* after = introspector.introspect(includer.get(),glslParams);
+		CHECK(after && after!=before && introspector.getCache()->getStatistics().misses==2u);
+		CHECK(before->descriptorSetBindings[0].front().binding==0u && after->descriptorSetBindings[0].front().binding==5u);
+		std::filesystem::remove_all(dir);
+	}
+
+	// a damaged file is refused as a whole
+	{
+		std::filesystem::resize_file(cachePath,std::filesystem::file_size(cachePath)-1u);
+		auto truncated = make_smart_refctd_ptr<CIntrospectionCache>();
+		CHECK(!truncated->deserialize(cachePath) && truncated->getStatistics().entryCount==0u);
+	}
+	std::filesystem::remove(cachePath);
+
+	std::cout << shaders.size() << " shaders, " << permutationCount << " unique\n";
+	std::cout << "\tcold introspection: " << coldTime << " ms\n";
+	std::cout << "\tshared cache on " << CWorkStealingScheduler::getDefault()->getWorkerCount() << " workers: " << parallelTime << " ms\n";
+	std::cout << "\twarm start: " << loadTime << " ms loading, " << warmTime << " ms introspecting\n";
+	return true;
+}
+
+int main()
+{
+	nbl::SIrrlichtCreationParameters params;
+	params.DriverType = video::EDT_NULL;
+	auto device = createDeviceEx(params);
+	if (!device)
+		return 1;
+
+	auto* compiler = device->getAssetManager()->getGLSLCompiler();
+	if (!spirvDiskCacheTest(compiler))
+		return 1;
+	if (!compileBatchTest(compiler))
+		return 1;
+	if (!includeCacheTest(compiler))
+		return 1;
+	if (!introspectionCacheTest(compiler))
+		return 1;
+	return 0;
+}
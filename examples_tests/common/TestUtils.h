@@ -0,0 +1,27 @@
+// Copyright (C) 2018-2020 - DevSH Graphics Programming Sp. z O.O.
+// This file is part of the "Nabla Engine".
+// For conditions of distribution and use, see copyright notice in nabla.h
+
+#ifndef __NBL_TEST_UTILS_H_INCLUDED__
+#define __NBL_TEST_UTILS_H_INCLUDED__
+
+#include <chrono>
+#include <iostream>
+
+//! Timing and checks shared by the headless unit tests and benchmarks
+
+using clock_type = std::chrono::high_resolution_clock;
+
+//! Wall clock time of one call of `f`, in milliseconds
+template<typename F>
+inline double timeIt(F&& f)
+{
+	const auto start = clock_type::now();
+	f();
+	return std::chrono::duration<double,std::milli>(clock_type::now()-start).count();
+}
+
+//! For test functions returning `bool`, reports the condition which didn't hold and returns false
+#define CHECK(X) do { if (!(X)) {std::cout << "FAILED: " #X " at " __FILE__ ":" << __LINE__ << "\n"; return false;} } while (false)
+
+#endif
@@ -44,6 +44,11 @@ namespace io
 		//! Get name of file.
 		/** \return File name as zero terminated character string. */
 		virtual const io::path& getFileName() const = 0;
+
+		//! Get the whole file as memory, if it's already there or can be mapped.
+		/** Lets loaders read it without copying and from many threads at once, the position in the file is not affected.
+		\return Pointer to getSize() bytes valid for as long as the file is, or nullptr if it can only be read with read(). */
+		virtual const void* getMappedContents() const { return nullptr; }
 	};
 
 } // end namespace io
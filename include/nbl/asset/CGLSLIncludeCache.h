@@ -0,0 +1,109 @@
+// Copyright (C) 2018-2020 - DevSH Graphics Programming Sp. z O.O.
+// This file is part of the "Nabla Engine".
+// For conditions of distribution and use, see copyright notice in nabla.h
+
+#ifndef __NBL_ASSET_C_GLSL_INCLUDE_CACHE_H_INCLUDED__
+#define __NBL_ASSET_C_GLSL_INCLUDE_CACHE_H_INCLUDED__
+
+#include "nbl/core/core.h"
+
+#include <array>
+#include <atomic>
+#include <shared_mutex>
+#include <string>
+
+namespace nbl
+{
+namespace asset
+{
+
+//! Shared by all #include resolutions of an `IGLSLCompiler`, keeps every included file in the form ready to be handed to the preprocessor and records who includes what
+/**
+Builtin includes (under `IIncludeHandler::BUILTIN_PREFIX`) can't change while the process runs, so they're looked up by path alone and never fetched again.
+Filesystem includes are keyed by their path and an `XXHash_256` of their contents, they still get read every time but an edited file is never served stale.
+Call `clear()` after adding builtin include loaders.
+
+The dependency graph has an edge from every file (or `_originFilepath` of a shader) to everything it #includes directly.
+Edges are only ever added, except when the contents of an include change, then its outgoing edges are dropped until it's resolved again.
+`IGLSLCompiler::refreshIncludeCache` uses it to tell which shaders need to be rebuilt after a file changed.
+Thread-safe.
+*/
+class CGLSLIncludeCache final : public core::IReferenceCounted
+{
+	public:
+		using hash_t = std::array<uint64_t,4>;
+
+		//! How an include was found, so it can be looked for again
+		struct SSource
+		{
+			std::string requested;
+			std::string workingDirectory;
+			bool relative;
+			bool builtin;
+		};
+
+		struct SStatistics
+		{
+			uint64_t hits;
+			uint64_t misses;
+			uint32_t entryCount;
+		};
+
+		CGLSLIncludeCache() : m_hits(0u), m_misses(0u) {}
+
+		static hash_t hashContents(const std::string& _contents);
+
+		//! `_contentHash` nullptr only matches builtins, otherwise the contents need to be the same as when it got inserted
+		bool find(const std::string& _name, const hash_t* _contentHash, std::string& _outPreprocessed) const;
+
+		//! Replaces the entry and drops its outgoing edges if the contents changed
+		void insert(const std::string& _name, SSource&& _source, const hash_t& _contentHash, const std::string& _preprocessed);
+
+		//! Records that `_includer` #includes `_included`
+		void addDependency(const std::string& _includer, const std::string& _included);
+
+		//! Everything `_name` includes, directly or not, sorted
+		core::vector<std::string> getDependencies(const std::string& _name) const;
+		//! Everything which includes `_name`, directly or not, sorted, shaders show up by their `_originFilepath`
+		core::vector<std::string> getDependents(const std::string& _name) const;
+
+		//! Filesystem includes with how they were found, for checking if they changed
+		core::vector<std::pair<std::string,SSource>> getFilesystemIncludes() const;
+		//! Compares the hash of `_contents` with the one of the entry, true if they differ or the entry is gone
+		bool hasChanged(const std::string& _name, const std::string& _contents) const;
+
+		//! Drops the entry and its outgoing edges, keeps edges pointing to it so `getDependents` still works
+		void invalidate(const std::string& _name);
+
+		//! Drops all entries and the whole graph
+		void clear();
+
+		SStatistics getStatistics() const;
+
+	protected:
+		virtual ~CGLSLIncludeCache() = default;
+
+		struct SEntry
+		{
+			SSource source;
+			hash_t contentHash;
+			std::string preprocessed;
+		};
+
+		//! Needs the exclusive lock held
+		void invalidate_impl(const std::string& _name);
+		static core::vector<std::string> traverse(const core::unordered_map<std::string,core::unordered_set<std::string>>& _graph, const std::string& _from);
+
+		mutable std::shared_mutex m_lock;
+		core::unordered_map<std::string,SEntry> m_entries;
+		core::unordered_map<std::string,core::unordered_set<std::string>> m_includes;
+		core::unordered_map<std::string,core::unordered_set<std::string>> m_includedBy;
+
+		mutable std::atomic<uint64_t> m_hits;
+		mutable std::atomic<uint64_t> m_misses;
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,94 @@
+// Copyright (C) 2018-2020 - DevSH Graphics Programming Sp. z O.O.
+// This file is part of the "Nabla Engine".
+// For conditions of distribution and use, see copyright notice in nabla.h
+
+#ifndef __NBL_ASSET_C_SPIRV_DISK_CACHE_H_INCLUDED__
+#define __NBL_ASSET_C_SPIRV_DISK_CACHE_H_INCLUDED__
+
+#include "nbl/core/core.h"
+
+#include "nbl/asset/ICPUBuffer.h"
+#include "nbl/asset/ISpecializedShader.h"
+#include "nbl/asset/ISPIRVOptimizer.h"
+
+#include <array>
+#include <mutex>
+#include <string>
+
+namespace nbl
+{
+namespace asset
+{
+
+//! Persistent content-addressed cache of compiled (and optimized) SPIR-V, so permutations compiled by a previous run don't go through shaderc and spirv-opt again
+/**
+Every entry is a file in the cache directory named after an `XXHash_256` of the #include-resolved GLSL source, shader stage, entry point, debug info flag,
+optimizer pass list and `getCompilerVersion()`, so any of these changing makes a different entry (stale ones just age out).
+Entries are written to a temporary file and renamed over, so many processes can share a directory and nobody ever reads a half-written entry.
+The total size is capped, when an insert pushes it over the least recently used entries (by file modification time, which hits refresh) get deleted.
+Thread-safe.
+*/
+class CSPIRVDiskCache final : public core::IReferenceCounted
+{
+	public:
+		struct SKey
+		{
+			std::array<uint64_t,4> hash;
+
+			inline bool operator==(const SKey& other) const { return hash==other.hash; }
+			inline bool operator!=(const SKey& other) const { return hash!=other.hash; }
+
+			//! file name of the entry
+			std::string toString() const;
+		};
+
+		//! Bump whenever the compiler setup changes in a way the key does not capture
+		_NBL_STATIC_INLINE_CONSTEXPR uint32_t FormatVersion = 1u;
+
+		//! Creates the directory if it doesn't exist, `_maxSize` is in bytes
+		CSPIRVDiskCache(std::string&& _directory, const uint64_t _maxSize=256ull<<20ull);
+
+		const std::string& getDirectory() const { return m_directory; }
+
+		uint64_t getMaxSize() const { return m_maxSize; }
+
+		//! Approximate, other processes may be adding or removing entries
+		uint64_t getSize() const
+		{
+			std::unique_lock<std::mutex> lock(m_lock);
+			return m_size;
+		}
+
+		//! Nabla version, SPIR-V target, shaderc's SPIR-V version and SPIRV-Tools' version, goes into every key
+		static const std::string& getCompilerVersion();
+
+		//! `_compilationId` only goes into the key with `_genDebugInfo`, the debug info is the only place it ends up in
+		static SKey computeKey(const char* _resolvedGLSL, const size_t _length, ISpecializedShader::E_SHADER_STAGE _stage, const char* _entryPoint, const char* _compilationId, const bool _genDebugInfo, const ISPIRVOptimizer* _opt);
+
+		//! Returns nullptr on a miss, `_outAssembly` makes entries stored without assembly count as a miss
+		core::smart_refctd_ptr<ICPUBuffer> find(const SKey& _key, std::string* _outAssembly=nullptr) const;
+
+		//! Replaces an existing entry, then deletes the least recently used entries if the cache got too big
+		bool insert(const SKey& _key, const ICPUBuffer* _spirv, const std::string* _assembly=nullptr);
+
+		//! Deletes least recently used entries until the cache takes up at most `_targetSize` bytes
+		void trim(const uint64_t _targetSize);
+
+		//! Deletes all entries
+		void clear() { trim(0ull); }
+
+	protected:
+		virtual ~CSPIRVDiskCache() = default;
+
+		std::string getEntryPath(const SKey& _key) const;
+
+		const std::string m_directory;
+		const uint64_t m_maxSize;
+		mutable std::mutex m_lock;
+		uint64_t m_size;
+};
+
+}
+}
+
+#endif
@@ -5,8 +5,11 @@
 #ifndef __NBL_ASSET_C_SHADER_INTROSPECTOR_H_INCLUDED__
 #define __NBL_ASSET_C_SHADER_INTROSPECTOR_H_INCLUDED__
 
+#include <array>
+#include <atomic>
 #include <cstdint>
 #include <memory>
+#include <shared_mutex>
 #include "nbl/core/Types.h"
 #include "nbl/asset/ShaderRes.h"
 #include "nbl/asset/ICPUSpecializedShader.h"
@@ -71,6 +74,57 @@ class CIntrospectionData : public core::IReferenceCounted
 		}
 };
 
+//! Introspections keyed by `CShaderIntrospector::computeKey`, so the same shader loaded twice only goes through spirv_cross once
+/**
+Can be shared between any number of `CShaderIntrospector`s and threads, and saved to a file so a warm start doesn't need to introspect at all.
+Entries are only ever added, pointers handed out stay valid until `clear()` or the cache's destruction.
+Thread-safe.
+*/
+class CIntrospectionCache final : public core::IReferenceCounted
+{
+	public:
+		using hash_t = std::array<uint64_t,4>;
+
+		_NBL_STATIC_INLINE_CONSTEXPR uint32_t FormatVersion = 2u;
+
+		struct SStatistics
+		{
+			uint64_t hits;
+			uint64_t misses;
+			uint32_t entryCount;
+		};
+
+		CIntrospectionCache() : m_hits(0u), m_misses(0u) {}
+
+		const CIntrospectionData* find(const hash_t& _key) const;
+		//! If another thread got there first, its introspection is kept and returned
+		const CIntrospectionData* insert(const hash_t& _key, core::smart_refctd_ptr<CIntrospectionData>&& _introspection);
+
+		//! Writes all entries to `_path`, goes through a temporary file so a concurrent `deserialize` never sees half of it
+		bool serialize(const std::string& _path) const;
+		//! Adds the entries from `_path` which aren't in the cache yet, fails on files written by a different build or format version
+		bool deserialize(const std::string& _path);
+
+		//! Not to be called while anyone still uses the introspections
+		void clear();
+
+		SStatistics getStatistics() const;
+
+	protected:
+		virtual ~CIntrospectionCache() = default;
+
+		struct SKeyHash
+		{
+			inline size_t operator()(const hash_t& _key) const { return static_cast<size_t>(_key[0]); }
+		};
+
+		mutable std::shared_mutex m_lock;
+		core::unordered_map<hash_t,core::smart_refctd_ptr<CIntrospectionData>,SKeyHash> m_entries;
+
+		mutable std::atomic<uint64_t> m_hits;
+		mutable std::atomic<uint64_t> m_misses;
+};
+
 class CShaderIntrospector : public core::Uncopyable
 {
 		using mapId2SpecConst_t = core::unordered_map<uint32_t, const CIntrospectionData::SSpecConstant*>;
@@ -113,9 +167,19 @@ class CShaderIntrospector : public core::Uncopyable
 		};
 
 		//In the future there's also going list of enabled extensions
-		CShaderIntrospector(const IGLSLCompiler* _glslcomp) : m_glslCompiler(_glslcomp) {}
+		//! Without a `_cache` every introspector gets its own, pass the same one to share introspections between them
+		CShaderIntrospector(const IGLSLCompiler* _glslcomp, core::smart_refctd_ptr<CIntrospectionCache>&& _cache=nullptr) :
+			m_glslCompiler(_glslcomp), m_cache(_cache ? std::move(_cache):core::make_smart_refctd_ptr<CIntrospectionCache>()) {}
 
-		//
+		CIntrospectionCache* getCache() { return m_cache.get(); }
+		const CIntrospectionCache* getCache() const { return m_cache.get(); }
+
+		//! An `XXHash_256` of the shader's code and of the params which can change the outcome
+		/** GLSL has to be passed with the extension defines inserted and the #includes resolved, as `introspect` does,
+		then the contents of included files are part of the key and the extensions and the file path hint needn't be. */
+		static CIntrospectionCache::hash_t computeKey(const ICPUShader* _shader, const SIntrospectionParams& _params);
+
+		//! Thread-safe, the returned introspection lives as long as the cache
 		const CIntrospectionData* introspect(const ICPUShader* _shader, const SIntrospectionParams& _params);
 
 		//
@@ -176,29 +240,9 @@ class CShaderIntrospector : public core::Uncopyable
 		void shaderMemBlockIntrospection(spirv_cross::Compiler& _comp, impl::SShaderMemoryBlock& _res, uint32_t _blockBaseTypeID, uint32_t _varID, const mapId2SpecConst_t& _sortedId2sconst) const;
 		size_t calcBytesizeforType(spirv_cross::Compiler& _comp, const spirv_cross::SPIRType& _type) const;
 
-        core::smart_refctd_ptr<CIntrospectionData> findIntrospection(const ICPUShader* _shader, const SIntrospectionParams& _params) const
-        {
-            auto introspectionMap = m_introspectionCache.find(_params);
-            if (introspectionMap == m_introspectionCache.end())
-                return nullptr;
-
-            auto introspection = introspectionMap->second.find(core::smart_refctd_ptr<const ICPUShader>(_shader));
-            if (introspection == introspectionMap->second.end())
-                return nullptr;
-
-            return introspection->second;
-        }
-        CIntrospectionData* cacheIntrospection(core::smart_refctd_ptr<CIntrospectionData>&& _introspection, const ICPUShader* _shader, const SIntrospectionParams& _params)
-        {
-            return m_introspectionCache[_params].insert({core::smart_refctd_ptr<const ICPUShader>(_shader), std::move(_introspection)}).first->second.get();
-        }
-
 	private:
 		const IGLSLCompiler* m_glslCompiler;
-
-        using Shader2IntrospectionMap = core::unordered_map<core::smart_refctd_ptr<const ICPUShader>, core::smart_refctd_ptr<CIntrospectionData>>;
-        using Params2ShaderMap = core::map<SIntrospectionParams, Shader2IntrospectionMap>;
-        Params2ShaderMap m_introspectionCache;
+		core::smart_refctd_ptr<CIntrospectionCache> m_cache;
 };
 
 }//asset
@@ -0,0 +1,47 @@
+// Copyright (C) 2018-2020 - DevSH Graphics Programming Sp. z O.O.
+// This file is part of the "Nabla Engine".
+// For conditions of distribution and use, see copyright notice in nabla.h
+
+#ifndef __NBL_ASSET_C_TIPSIFY_VERTEX_CACHE_OPTIMIZER_H_INCLUDED__
+#define __NBL_ASSET_C_TIPSIFY_VERTEX_CACHE_OPTIMIZER_H_INCLUDED__
+
+#include <cstdint>
+#include "nbl/core/Types.h"
+
+namespace nbl { namespace asset
+{
+
+//! Linear-time vertex cache optimization for a FIFO post-transform cache of configurable size
+/**
+Implements "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw" by Sander, Nehab and Barczak (SIGGRAPH 2007).
+Triangles get emitted as fans around a vertex, the next fanning vertex is picked from the 1-ring of the last fan
+by how long it will stay in the cache. Whenever no neighbour is usable the algorithm skips to a new part of the mesh,
+those points are reported as cluster boundaries which the overdraw optimizer can sort without hurting the cache.
+*/
+class CTipsifyVertexCacheOptimizer
+{
+	public:
+		//! Same size as the cache assumed by `COverdrawMeshOptimizer` by default
+		_NBL_STATIC_INLINE_CONSTEXPR uint32_t DefaultFIFOSize = 16u;
+
+		CTipsifyVertexCacheOptimizer(const uint32_t _fifoSize=DefaultFIFOSize) : m_fifoSize(_fifoSize) {}
+
+		inline uint32_t getFIFOSize() const { return m_fifoSize; }
+
+		/**
+		@param _numVerts Number of vertices indexed by the '_indices'
+		@param _numIndices Number of elements in both '_indices' and '_outIndices', must be a multiple of 3
+		@param _indices Input triangle list index buffer
+		@param _outIndices Output index buffer, cannot alias `_indices`
+		@param _outClusters Optional, receives the index of the first triangle of every cluster (the first is always 0), a cluster ends where the next fan starts from a vertex out of the cache
+		*/
+		template<typename IdxT> // IdxT is uint16_t or uint32_t
+		void optimizeTriangleOrdering(const size_t _numVerts, const size_t _numIndices, const IdxT* _indices, IdxT* _outIndices, core::vector<uint32_t>* _outClusters=nullptr) const;
+
+	private:
+		uint32_t m_fifoSize;
+};
+
+}}
+
+#endif
@@ -234,17 +234,20 @@ class IAssetManager : public core::IReferenceCounted, public core::QuitSignallin
             if (!file)
                 return {};//return empty bundle
 
-            auto capableLoadersRng = m_loaders.perFileExt.findRange(getFileExt(filename.c_str()));
-            // loaders associated with the file's extension tryout
-            for (auto& loader : capableLoadersRng)
             {
-                if (loader.second->isALoadableFileFormat(file) && !(asset = loader.second->loadAsset(file, params, _override, _hierarchyLevel)).isEmpty())
-                    break;
-            }
-            for (auto loaderItr = std::begin(m_loaders.vector); asset.isEmpty() && loaderItr != std::end(m_loaders.vector); ++loaderItr) // all loaders tryout
-            {
-                if ((*loaderItr)->isALoadableFileFormat(file) && !(asset = (*loaderItr)->loadAsset(file, params, _override, _hierarchyLevel)).isEmpty())
-                    break;
+                core::CMemoryStatistics::CSubsystemScope memoryScope(core::EMS_ASSET_LOADERS);
+                auto capableLoadersRng = m_loaders.perFileExt.findRange(getFileExt(filename.c_str()));
+                // loaders associated with the file's extension tryout
+                for (auto& loader : capableLoadersRng)
+                {
+                    if (loader.second->isALoadableFileFormat(file) && !(asset = loader.second->loadAsset(file, params, _override, _hierarchyLevel)).isEmpty())
+                        break;
+                }
+                for (auto loaderItr = std::begin(m_loaders.vector); asset.isEmpty() && loaderItr != std::end(m_loaders.vector); ++loaderItr) // all loaders tryout
+                {
+                    if ((*loaderItr)->isALoadableFileFormat(file) && !(asset = (*loaderItr)->loadAsset(file, params, _override, _hierarchyLevel)).isEmpty())
+                        break;
+                }
             }
 
             if (!asset.isEmpty() && 
@@ -422,8 +425,9 @@ class IAssetManager : public core::IReferenceCounted, public core::QuitSignallin
         //TODO change name
         bool insertAssetIntoCache(SAssetBundle& _asset, IAsset::E_MUTABILITY _mutability = IAsset::EM_CPU_PERSISTENT)
         {
+            core::CMemoryStatistics::CSubsystemScope memoryScope(core::EMS_ASSET_MANAGER);
             const uint32_t ix = IAsset::typeFlagToIndex(_asset.getAssetType());
-            for (auto ass : _asset.getContents())
+            for (const auto& ass : _asset.getContents())
                 setAssetMutability(ass.get(), _mutability);
             return m_assetCache[ix]->insert(_asset.getCacheKey(), _asset);
         }
@@ -500,7 +504,7 @@ class IAssetManager : public core::IReferenceCounted, public core::QuitSignallin
 			for (auto it=assets->begin(); it!=assets->end(); it++)
 			{
 				const auto& contents = it->getContents();
-                for (auto ass : contents)
+                for (const auto& ass : contents)
 				{
 					size_t storageSz = 1u;
 					m_cpuGpuCache[ix]->findAndStoreRange(ass.get(), storageSz, outIt++);
@@ -563,6 +567,7 @@ class IAssetManager : public core::IReferenceCounted, public core::QuitSignallin
             if (!_override)
                 _override = &defOverride;
 
+            core::CMemoryStatistics::CSubsystemScope memoryScope(core::EMS_ASSET_WRITERS);
             auto capableWritersRng = m_writers.perTypeAndFileExt.findRange({_params.rootAsset->getAssetType(), getFileExt(_file->getFileName())});
 
             for (auto& writer : capableWritersRng)
@@ -675,7 +680,7 @@ class IAssetManager : public core::IReferenceCounted, public core::QuitSignallin
         void restoreDummyAsset(SAssetBundle& _bundle, uint32_t _levelsBelow = 0u)
         {
             bool anyIsDummy = false;
-            for (auto ass : _bundle.getContents())
+            for (const auto& ass : _bundle.getContents())
                 anyIsDummy = anyIsDummy || ass->isADummyObjectForCache();
             if (!anyIsDummy)
                 return;
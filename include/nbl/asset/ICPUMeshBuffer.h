@@ -83,6 +83,7 @@ protected:
         cp->baseInstance = baseInstance;
         memcpy(cp->m_pushConstantsData, m_pushConstantsData, sizeof(m_pushConstantsData));
         cp->posAttrId = posAttrId;
+        cp->normalAttrId = normalAttrId;
 
         cp->m_indexBufferBinding.offset = m_indexBufferBinding.offset;
         cp->m_indexBufferBinding.buffer = (_depth > 0u && m_indexBufferBinding.buffer) ? 
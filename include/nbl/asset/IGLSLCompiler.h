@@ -15,6 +15,8 @@
 #include "nbl/asset/IIncludeHandler.h"
 
 #include "nbl/asset/ISPIRVOptimizer.h"
+#include "nbl/asset/CSPIRVDiskCache.h"
+#include "nbl/asset/CGLSLIncludeCache.h"
 
 namespace nbl
 {
@@ -32,17 +34,62 @@ class IGLSLCompiler final : public core::IReferenceCounted
 {
 		core::smart_refctd_ptr<IIncludeHandler> m_inclHandler;
 		const io::IFileSystem* m_fs;
+		core::smart_refctd_ptr<CSPIRVDiskCache> m_cache;
+		core::smart_refctd_ptr<CGLSLIncludeCache> m_includeCache;
 
 	protected:
 		friend class video::COpenGLDriver;
-		core::smart_refctd_ptr<ICPUBuffer> compileSPIRVFromGLSL(const char* _glslCode, ISpecializedShader::E_SHADER_STAGE _stage, const char* _entryPoint, const char* _compilationId, bool _genDebugInfo = true, std::string* _outAssembly = nullptr) const;
+		//! `_outDiagnostics` gets errors and warnings instead of the log when not nullptr
+		core::smart_refctd_ptr<ICPUBuffer> compileSPIRVFromGLSL(const char* _glslCode, ISpecializedShader::E_SHADER_STAGE _stage, const char* _entryPoint, const char* _compilationId, bool _genDebugInfo = true, std::string* _outAssembly = nullptr, std::string* _outDiagnostics = nullptr) const;
+
+		core::smart_refctd_ptr<ICPUShader> createSPIRVFromGLSL_impl(const char* _glslCode, ISpecializedShader::E_SHADER_STAGE _stage, const char* _entryPoint, const char* _compilationId, const ISPIRVOptimizer* _opt, bool _genDebugInfo, std::string* _outAssembly, std::string* _outDiagnostics) const;
+		bool resolveIncludeDirectives_impl(std::string& _glslCode, ISpecializedShader::E_SHADER_STAGE _stage, const char* _originFilepath, uint32_t _maxSelfInclusionCnt, std::string* _outDiagnostics) const;
 
 	public:
+		//! One shader for `compileBatch`
+		struct SCompilationJob
+		{
+			//! GLSL source with #include directives not yet resolved, has to stay alive until `compileBatch` returns
+			const char* glsl = nullptr;
+			ISpecializedShader::E_SHADER_STAGE stage = ISpecializedShader::ESS_UNKNOWN;
+			//! Base for relative #include resolution and the name diagnostics refer to, see `resolveIncludeDirectives`
+			const char* originFilepath = "";
+			//! Inserted right after #version, every define is what follows `#define`, i.e. "NAME" or "NAME VALUE"
+			core::SRange<const char* const> defines = {nullptr,nullptr};
+			//! Optional
+			const ISPIRVOptimizer* optimizer = nullptr;
+			bool genDebugInfo = true;
+			uint32_t maxSelfInclusionCnt = 4u;
+		};
+		struct SCompilationResult
+		{
+			//! SPIR-V, nullptr if any step failed
+			core::smart_refctd_ptr<ICPUShader> shader;
+			//! Errors and warnings of include resolution, compilation and optimization, in that order
+			std::string diagnostics;
+		};
+
 		IGLSLCompiler(io::IFileSystem* _fs);
 
 		IIncludeHandler* getIncludeHandler() { return m_inclHandler.get(); }
 		const IIncludeHandler* getIncludeHandler() const { return m_inclHandler.get(); }
 
+		//! When set, `createSPIRVFromGLSL` looks the (optimized) SPIR-V up in the cache before compiling and stores it there after, set it before compiling anything
+		void setCache(core::smart_refctd_ptr<CSPIRVDiskCache>&& _cache) { m_cache = std::move(_cache); }
+		CSPIRVDiskCache* getCache() { return m_cache.get(); }
+		const CSPIRVDiskCache* getCache() const { return m_cache.get(); }
+
+		//! Preprocessed #include'd files and the graph of who includes what, shared by all `resolveIncludeDirectives` calls
+		CGLSLIncludeCache* getIncludeCache() { return m_includeCache.get(); }
+		const CGLSLIncludeCache* getIncludeCache() const { return m_includeCache.get(); }
+
+		/**
+		For hot reload, checks every #include'd file for changes and drops the changed ones from the include cache.
+
+		@returns Changed files and everything that #includes them directly or not, the shaders among them by their `_originFilepath`. Sorted.
+		*/
+		core::vector<std::string> refreshIncludeCache();
+
 		/**
 		If _stage is ESS_UNKNOWN, then compiler will try to deduce shader stage from #pragma annotation, i.e.:
 		#pragma shader_stage(vertex),       or
@@ -60,7 +107,7 @@ class IGLSLCompiler final : public core::IReferenceCounted
 		@param _compilationId String that will be printed along with possible errors as source identifier.
 		@param _genDebugInfo Requests compiler to generate debug info (most importantly objects' names).
 			The engine, while running on OpenGL, won't be able to set push constants for shaders loaded as SPIR-V without debug info.
-		@param _outAssembly Optional parameter; if not nullptr, SPIR-V assembly is saved in there.
+		@param _outAssembly Optional parameter; if not nullptr, SPIR-V assembly (from before optimization) is saved in there.
 
 		@returns Shader containing SPIR-V bytecode.
 		*/
@@ -85,6 +132,15 @@ class IGLSLCompiler final : public core::IReferenceCounted
 		core::smart_refctd_ptr<ICPUShader> resolveIncludeDirectives(std::string&& glslCode, ISpecializedShader::E_SHADER_STAGE _stage, const char* _originFilepath, uint32_t _maxSelfInclusionCnt = 4u) const;
 
 		core::smart_refctd_ptr<ICPUShader> resolveIncludeDirectives(io::IReadFile* _sourcefile, ISpecializedShader::E_SHADER_STAGE _stage, const char* _originFilepath, uint32_t _maxSelfInclusionCnt = 4u) const;
+
+		/**
+		Inserts defines, resolves #include directives, compiles and optimizes every job, jobs run in parallel on `_scheduler` (or the calling thread if it's nullptr).
+
+		Results come in the order of the jobs and are the same as if every job went through `resolveIncludeDirectives` and `createSPIRVFromGLSL` one by one
+		(including cache lookups if a cache is set), only the diagnostics go into the results instead of the log so they don't interleave.
+		Don't add include loaders, search directories or file archives while a batch is running.
+		*/
+		core::vector<SCompilationResult> compileBatch(const core::SRange<const SCompilationJob>& _jobs, core::CWorkStealingScheduler* _scheduler = core::CWorkStealingScheduler::getDefault()) const;
 };
 
 }
@@ -160,16 +160,92 @@ namespace asset
 				});
 
 		//! Creates a copy of a mesh with vertices welded
-		/** \param mesh Input mesh
+		/** Positions are quantized onto a grid of the position attribute's epsilon and sorted in parallel, so only vertices in neighbouring cells get compared.
+		Every vertex gets welded onto the lowest indexed vertex it matches (which has not been welded itself), vertex buffers are left untouched.
+		\param mesh Input mesh
         \param errMetrics Array of size EVAI_COUNT. Describes error metric for each vertex attribute (used if attribute is of floating point or normalized type).
-		\param tolerance The threshold for vertex comparisons.
+		\param optimIndexType Whether to use 16bit indices if the welded vertices allow for it.
+		\param makeNewMesh Whether to modify the input meshbuffer or a shallow copy of it.
 		\return Mesh without redundant vertices. */
 		static core::smart_refctd_ptr<ICPUMeshBuffer> createMeshBufferWelded(ICPUMeshBuffer *inbuffer, const SErrorMetric* errMetrics, const bool& optimIndexType = true, const bool& makeNewMesh = false);
 
-		//! Throws meshbuffer into full optimizing pipeline consisting of: vertices welding, z-buffer optimization, vertex cache optimization (Forsyth's algorithm), fetch optimization and attributes requantization. A new meshbuffer is created unless given meshbuffer doesn't own (getMeshDataAndFormat()==NULL) a data format descriptor.
+		//! Throws meshbuffer into full optimizing pipeline consisting of: vertices welding, vertex cache and z-buffer optimization (see createMeshBufferCacheOptimized), fetch optimization and attributes requantization. A new meshbuffer is created unless given meshbuffer doesn't own (getMeshDataAndFormat()==NULL) a data format descriptor.
 		/**@return A new meshbuffer or NULL if an error occured. */
 		static core::smart_refctd_ptr<ICPUMeshBuffer> createOptimizedMeshBuffer(const ICPUMeshBuffer* inbuffer, const SErrorMetric* _errMetric);
 
+		//! Efficiency of a triangle list's order with respect to the post-transform vertex cache and vertex fetch.
+		struct SVertexCacheStatistics
+		{
+			//! Average Cache Miss Ratio, vertex shader invocations per triangle (0.5 is the best achievable on a regular grid, 3 is the worst)
+			float acmr = 0.f;
+			//! Average Transformed Vertex Ratio, vertex shader invocations per referenced vertex (1 is optimal)
+			float atvr = 0.f;
+			//! Bytes of vertex buffer cache lines fetched per byte of referenced vertex data (1 is optimal)
+			float overfetch = 0.f;
+		};
+		//! Simulates a FIFO post-transform cache of `_fifoSize` entries and a direct mapped vertex fetch cache with `_cacheLineSize` byte lines over a triangle list meshbuffer.
+		static SVertexCacheStatistics calculateVertexCacheStatistics(const ICPUMeshBuffer* _meshbuffer, const uint32_t _fifoSize=16u, const uint32_t _cacheLineSize=64u);
+
+		//! Reorders triangles and vertices of a triangle list for vertex cache hits, low overdraw and vertex fetch locality.
+		/** Linear time Tipsify vertex cache optimization for a FIFO of `_fifoSize` entries, followed by sorting of its clusters for overdraw and reordering of vertices in order of first use.
+		Non-indexed meshbuffers get an index buffer, the attributes get interleaved into a single vertex buffer.
+		@param _inbuffer Input meshbuffer, must be a triangle list.
+		@param _fifoSize Number of entries in the modelled post-transform cache, 16 is a safe choice for all current GPUs.
+		@param _overdrawThreshold How much the overdraw sort can degrade the ACMR (1.05 = up to 5%), values below 1 skip the overdraw sort.
+		@param _outStatistics Optional, receives the statistics of the output.
+		@return A new meshbuffer or nullptr if the input was not a triangle list.
+		*/
+		static core::smart_refctd_ptr<ICPUMeshBuffer> createMeshBufferCacheOptimized(const ICPUMeshBuffer* _inbuffer, const uint32_t _fifoSize=16u, const float _overdrawThreshold=1.05f, SVertexCacheStatistics* _outStatistics=nullptr);
+
+		//! Vertex buffer layouts createMeshBufferWithLayout can produce, per-instance attributes are left where they were in all of them.
+		enum E_VERTEX_LAYOUT
+		{
+			//! All per-vertex attributes in a single binding.
+			EVL_INTERLEAVED,
+			//! Positions alone in one binding and the other attributes interleaved in another, so depth-only passes only fetch the positions.
+			EVL_POSITION_SPLIT,
+			//! Every per-vertex attribute in its own binding.
+			EVL_PLANAR
+		};
+		//! Rewrites the per-vertex attributes of a meshbuffer into the given layout, attribute formats and vertex order are kept.
+		/** All the streams share one new vertex buffer, each stream starting on a cache line. Index buffer and per-instance bindings are shared with the input.
+		Attributes which are enabled but have no buffer bound get disabled.
+		@return New meshbuffer with its own pipeline (shallow copy with new vertex input params) or nullptr if the layout needs more bindings than available.
+		*/
+		static core::smart_refctd_ptr<ICPUMeshBuffer> createMeshBufferWithLayout(const ICPUMeshBuffer* _inbuffer, const E_VERTEX_LAYOUT _layout);
+
+		//! Stopping criteria for createMeshBufferSimplified, whichever gets hit first
+		struct SSimplificationParams
+		{
+			//! Simplification stops once there are this many or fewer triangles
+			uint32_t targetTriangleCount = 0u;
+			//! Largest allowed quadric error (approximately the distance from the original surface) relative to the largest extent of the mesh
+			float targetError = 0.01f;
+			//! Open borders never move, needed when meshbuffers of a mesh have to keep lining up with each other
+			bool lockBorders = false;
+		};
+		//! Decimates a triangle list by quadric error metric edge collapses onto existing vertices
+		/** Vertices whose position is shared by vertices with different attributes (UV seams, hard edges, etc.) are never removed, so the meshbuffer should be welded first (see createMeshBufferWelded).
+		Only a new index buffer gets created, the vertex buffers and pipeline are shared with the input.
+		@param _inbuffer Triangle list meshbuffer with a position attribute.
+		@param _params Target triangle count and error.
+		@param _outError Optional, receives the largest relative error introduced.
+		@return Simplified meshbuffer or nullptr if the input was not a triangle list.
+		*/
+		static core::smart_refctd_ptr<ICPUMeshBuffer> createMeshBufferSimplified(const ICPUMeshBuffer* _inbuffer, const SSimplificationParams& _params, float* _outError=nullptr);
+
+		//! Creates levels of detail of a meshbuffer, all sharing the input's vertex buffers
+		/** First element is a shallow copy of the input, every next one is simplified from the previous level to `_triangleRatio` times its triangles.
+		The chain ends early if a level cannot be simplified further without exceeding `_maxError` (relative error introduced per level).
+		*/
+		static core::vector<core::smart_refctd_ptr<ICPUMeshBuffer>> createMeshBufferLODChain(const ICPUMeshBuffer* _inbuffer, const uint32_t _lodCount, const float _triangleRatio=0.5f, const float _maxError=0.05f);
+
+		//! Creates `_lodCount` levels of detail of a mesh, the meshbuffers get simplified in parallel
+		/** Every level is a shallow copy of the input mesh with the index buffers of createMeshBufferLODChain swapped in, so vertex data is shared across all levels.
+		Meshbuffer borders stay locked so that neighbouring meshbuffers keep lining up, meshbuffers which run out of levels repeat their last one.
+		*/
+		static core::vector<core::smart_refctd_ptr<ICPUMesh>> createMeshLODChain(const ICPUMesh* _mesh, const uint32_t _lodCount, const float _triangleRatio=0.5f, const float _maxError=0.05f);
+
 		//! Requantizes vertex attributes to the smallest possible types taking into account values of the attribute under consideration. A brand new vertex buffer is created and attributes are going to be interleaved in single buffer.
 		/**
 			The function tests type's range and precision loss after eventual requantization. The latter is performed in one of several possible methods specified
@@ -38,13 +38,18 @@ public:
         EOP_COUNT
     };
 
-    ISPIRVOptimizer(std::initializer_list<E_OPTIMIZER_PASS> _passes) : m_passes(std::move(_passes)) {}
+    ISPIRVOptimizer(std::initializer_list<E_OPTIMIZER_PASS> _passes) : m_passes(_passes) {}
 
-    core::smart_refctd_ptr<ICPUBuffer> optimize(const uint32_t* _spirv, uint32_t _dwordCount) const;
-    core::smart_refctd_ptr<ICPUBuffer> optimize(const ICPUBuffer* _spirv) const;
+    //! `_outDiagnostics` gets the optimizer's messages instead of the log when not nullptr
+    core::smart_refctd_ptr<ICPUBuffer> optimize(const uint32_t* _spirv, uint32_t _dwordCount, std::string* _outDiagnostics = nullptr) const;
+    core::smart_refctd_ptr<ICPUBuffer> optimize(const ICPUBuffer* _spirv, std::string* _outDiagnostics = nullptr) const;
+
+    //! In the order they run
+    const core::vector<E_OPTIMIZER_PASS>& getPasses() const { return m_passes; }
 
 protected:
-    const std::initializer_list<E_OPTIMIZER_PASS> m_passes;
+    // an `std::initializer_list` member would dangle as soon as the constructor returns
+    const core::vector<E_OPTIMIZER_PASS> m_passes;
 };
 
 }
@@ -47,6 +47,19 @@ class IShader : public virtual core::IReferenceCounted
 			insertAfterVersionAndPragmaShaderStage(_glsl, insertion);
 		}
 
+		//! Every define is what follows `#define`, i.e. "NAME" or "NAME VALUE"
+		static inline void insertDefines(std::string& _glsl, const core::SRange<const char* const>& _defines)
+		{
+			if (_defines.empty())
+				return;
+
+			std::string insertion = "\n";
+			for (const char* define : _defines)
+				insertion.append("#define ").append(define).append("\n");
+
+			insertAfterVersionAndPragmaShaderStage(_glsl, insertion);
+		}
+
 protected:
 	static inline std::string genGLSLExtensionDefines(const core::refctd_dynamic_array<std::string>* _exts)
 	{
@@ -244,6 +244,8 @@ class CBlitImageFilter : public CImageFilter<CBlitImageFilter<Normalize,Clamp,Sw
 			if (!validate(state))
 				return false;
 
+			core::CMemoryStatistics::CSubsystemScope memoryScope(core::EMS_IMAGE_FILTERS);
+
 			// load all the state
 			const auto* const inImg = state->inImage;
 			auto* const outImg = state->outImage;
@@ -57,6 +57,8 @@ class CFlattenRegionsImageFilter : public CImageFilter<CFlattenRegionsImageFilte
 			if (!validate(state))
 				return false;
 
+			core::CMemoryStatistics::CSubsystemScope memoryScope(core::EMS_IMAGE_FILTERS);
+
 			auto* const inImg = state->inImage;
 			const auto& inParams = inImg->getCreationParameters();
 			auto respecifyRegions = [&state,&inImg,&inParams]() -> void
@@ -88,6 +88,8 @@ class CMipMapGenerationImageFilter : public CImageFilter<CMipMapGenerationImageF
 			if (!validate(state))
 				return false;
 
+			core::CMemoryStatistics::CSubsystemScope memoryScope(core::EMS_IMAGE_FILTERS);
+
 			for (auto inMipLevel=state->startMipLevel; inMipLevel!=state->endMipLevel; inMipLevel++)
 			{
 				auto blit = buildBlitState(state, inMipLevel);
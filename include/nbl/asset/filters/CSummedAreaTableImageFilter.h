@@ -110,6 +110,8 @@ class CSummedAreaTableImageFilter : public CMatchedSizeInOutImageFilterCommon, p
 			if (!validate(state))
 				return false;
 
+			core::CMemoryStatistics::CSubsystemScope memoryScope(core::EMS_IMAGE_FILTERS);
+
 			auto checkFormat = state->inImage->getCreationParameters().format;
 			if (isIntegerFormat(checkFormat))
 				return executeInterprated(state, reinterpret_cast<uint64_t*>(state->scratchMemory));
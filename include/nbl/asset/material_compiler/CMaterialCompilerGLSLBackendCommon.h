@@ -334,7 +334,8 @@ public:
 			{
 				_NBL_STATIC_INLINE_CONSTEXPR size_t MAX_TEXTURES = INSTR_MAX_PARAMETER_COUNT;
 
-				SBSDFUnion() : bumpmap{} {}
+				//! whatever a BSDF doesn't use stays zero, so compiling the same IR always gives the same bytes
+				SBSDFUnion() : bumpmap{} { memset(reinterpret_cast<uint8_t*>(this)+sizeof(bumpmap),0,sizeof(SBSDFUnion)-sizeof(bumpmap)); }
 
 				SAllDiffuse diffuse;
 				SDiffuseTransmitter difftrans;
@@ -415,7 +416,7 @@ public:
 		{
 			_NBL_STATIC_INLINE_CONSTEXPR size_t MAX_TEXTURES = INSTR_MAX_PARAMETER_COUNT;
 
-			SBSDFUnion() : bumpmap{} {}
+			SBSDFUnion() { memset(this,0,sizeof(SBSDFUnion)); }
 
 			SAllDiffuse diffuse;
 			SDiffuseTransmitter difftrans;
@@ -555,6 +556,8 @@ public:
 	{
 		template <typename stack_el_t>
 		friend class ITraversalGenerator;
+		friend struct SRootContext;
+		friend class CBSDFDataWriter;
 
 		friend class CMaterialCompilerGLSLBackendCommon;
 
@@ -681,7 +684,8 @@ public:
 
 	void debugPrint(std::ostream& _out, const result_t::instr_streams_t& _streams, const result_t& _res, const SContext* _ctx) const;
 
-	result_t compile(SContext* _ctx, IR* _ir, bool _computeGenChoiceStream = true);
+	//! Roots get compiled in parallel on `_scheduler` (or the calling thread if it's nullptr), the result is the same either way
+	result_t compile(SContext* _ctx, IR* _ir, bool _computeGenChoiceStream = true, core::CWorkStealingScheduler* _scheduler = core::CWorkStealingScheduler::getDefault());
 };
 
 }}}
@@ -19,7 +19,7 @@ class CMaterialCompilerGLSLRasterBackend : public CMaterialCompilerGLSLBackendCo
     using base_t = CMaterialCompilerGLSLBackendCommon;
 
 public:
-    result_t compile(SContext* _ctx, IR* _ir);
+    result_t compile(SContext* _ctx, IR* _ir, core::CWorkStealingScheduler* _scheduler = core::CWorkStealingScheduler::getDefault());
 };
 
 }}}
@@ -9,103 +9,48 @@
 #include <nbl/core/containers/refctd_dynamic_array.h>
 #include <nbl/asset/ICPUImageView.h>
 #include <nbl/asset/ICPUSampler.h>
-#include <nbl/core/alloc/LinearAddressAllocator.h>
+#include <nbl/core/alloc/MonotonicArena.h>
+
+#include <mutex>
 
 namespace nbl {
 namespace asset {
 namespace material_compiler
 {
 
+//! Nodes live in a `core::MonotonicArena` which grows by whole blocks and never moves them, so there's no size limit and node pointers stay valid for the lifetime of the IR
+/**
+Trees get hash-consed when added with `addRootNode`, every subtree structurally identical to one already in the IR (same node types, parameters, texture sources and children)
+is replaced by the one in the IR, so identical BSDFs of different materials are stored once and identical roots are compiled once.
+A subtree is never shared twice within the same root though, as backends tell nodes of a traversal apart by their address.
+*/
 class IR : public core::IReferenceCounted
 {
-    class SBackingMemManager
-    {
-        _NBL_STATIC_INLINE_CONSTEXPR size_t INITIAL_MEM_SIZE = 1ull<<20;
-        _NBL_STATIC_INLINE_CONSTEXPR size_t MAX_MEM_SIZE = 1ull<<20;
-        _NBL_STATIC_INLINE_CONSTEXPR size_t ALIGNMENT = _NBL_SIMD_ALIGNMENT;
-
-        uint8_t* mem;
-        size_t currSz;
-        using addr_alctr_t = core::LinearAddressAllocator<uint32_t>;
-        addr_alctr_t addrAlctr;
-
-    public:
-        SBackingMemManager() : mem(nullptr), currSz(INITIAL_MEM_SIZE), addrAlctr(nullptr, 0u, 0u, ALIGNMENT, MAX_MEM_SIZE) {
-            mem = reinterpret_cast<uint8_t*>(_NBL_ALIGNED_MALLOC(currSz, ALIGNMENT));
-        }
-        ~SBackingMemManager() {
-            _NBL_ALIGNED_FREE(mem);
-        }
-
-        uint8_t* alloc(size_t bytes)
-        {
-            auto addr = addrAlctr.alloc_addr(bytes, ALIGNMENT);
-            assert(addr != addr_alctr_t::invalid_address);
-            //TODO reallocation will invalidate all pointers to nodes, so...
-            //1) never reallocate (just have reasonably big buffer for nodes)
-            //2) make some node_handle class that will work as pointer but is based on offset instead of actual address
-            if (addr+bytes > currSz) {
-                size_t newSz = currSz<<1;
-                if (newSz > MAX_MEM_SIZE) {
-                    addrAlctr.free_addr(addr, bytes);
-                    return nullptr;
-                }
-
-                void* newMem = _NBL_ALIGNED_MALLOC(newSz, ALIGNMENT);
-                memcpy(newMem, mem, currSz);
-                _NBL_ALIGNED_FREE(mem);
-                mem = reinterpret_cast<uint8_t*>(newMem);
-                currSz = newSz;
-            }
-
-            return mem+addr;
-        }
-
-        uint32_t getAllocatedSize() const
-        {
-            return addrAlctr.get_allocated_size();
-        }
-
-        void freeLastAllocatedBytes(uint32_t _bytes)
-        {
-            assert(addrAlctr.get_allocated_size() >= _bytes);
-            const uint32_t newCursor = addrAlctr.get_allocated_size() - _bytes;
-            addrAlctr.reset(newCursor);
-        }
-    };
-
 protected:
+    using arena_t = core::MonotonicArena<>;
+
     ~IR()
     {
+        deinitTmpNodes();
         //call destructors on all nodes
-        for (auto* root : roots)
+        for (auto& alloc : nodes)
         {
-            core::stack<decltype(root)> s;
-            s.push(root);
-            while (!s.empty())
-            {
-                auto* n = s.top();
-                s.pop();
-                for (auto* c : n->children)
-                    s.push(c);
-
-                if (!n->deinited) {
-                    n->~INode();
-                    n->deinited = true;
-                }
+            if (!alloc.node->deinited) {
+                alloc.node->~INode();
+                alloc.node->deinited = true;
             }
         }
     }
 
     template <typename NodeType, typename ...Args>
-    NodeType* allocNode_impl(Args&& ...args)
+    static NodeType* allocNode_impl(arena_t& _arena, Args&& ...args)
     {
-        uint8_t* ptr = memMgr.alloc(sizeof(NodeType));
+        void* ptr = _arena.allocate(sizeof(NodeType), alignof(NodeType));
         return new (ptr) NodeType(std::forward<Args>(args)...);
     }
 
 public:
-    IR() : memMgr() {}
+    IR() : memMgr(), tmpMemMgr() {}
 
     struct INode;
 
@@ -114,38 +59,43 @@ public:
         for (INode* n : tmp)
             n->~INode();
         tmp.clear();
-        memMgr.freeLastAllocatedBytes(tmpSize);
-        tmpSize = 0u;
+        tmpMemMgr.reset();
     }
 
-    void addRootNode(INode* node)
+    //! Hash-conses the tree under `node` and adds it as a root, unless an identical one is there already
+    /** Use the returned node from then on, the nodes of the passed in tree which got replaced are destroyed,
+    so they must not be referenced by any tree which is yet to be added. */
+    INode* addRootNode(INode* node)
     {
-        roots.push_back(node);
+        if (!node)
+            return nullptr;
+
+        node = hashCons(node);
+        if (rootSet.insert(node).second)
+            roots.push_back(node);
+        return node;
     }
 
     template <typename NodeType, typename ...Args>
     NodeType* allocNode(Args&& ...args)
     {
-        tmpSize = 0u;
-        return allocNode_impl<NodeType>(std::forward<Args>(args)...);
-    }
-    template <typename NodeType, typename ...Args>
-    NodeType* allocRootNode(Args&& ...args)
-    {
-        auto* root = allocNode<NodeType>(std::forward<Args>(args)...);
-        addRootNode(root);
-        return root;
+        auto* node = allocNode_impl<NodeType>(memMgr, std::forward<Args>(args)...);
+        nodes.push_back({node,sizeof(NodeType)});
+        return node;
     }
+    //! Thread-safe, backends translate roots in parallel
     template <typename NodeType, typename ...Args>
     NodeType* allocTmpNode(Args&& ...args)
     {
-        const uint32_t cursor = memMgr.getAllocatedSize();
-        auto* node = allocNode_impl<NodeType>(std::forward<Args>(args)...);
+        std::lock_guard<std::mutex> lock(tmpMutex);
+        auto* node = allocNode_impl<NodeType>(tmpMemMgr, std::forward<Args>(args)...);
         tmp.push_back(node);
-        tmpSize += (memMgr.getAllocatedSize() - cursor);
         return node;
     }
 
+    //! Count of nodes reachable from the roots
+    size_t getUniqueNodeCount() const { return uniqueNodeCount; }
+
     struct INode
     {
         enum E_SYMBOL
@@ -612,11 +562,212 @@ public:
         bool thin = false;
     };
 
-    SBackingMemManager memMgr;
+protected:
+    struct SNodeAllocation
+    {
+        INode* node;
+        size_t size;
+    };
+
+    //! Everything the node depends on, children by their address so they need to be hash-consed first
+    static void getStructuralKey(const INode* _node, std::string& _outKey)
+    {
+        auto append = [&_outKey](const void* data, const size_t size) -> void
+        {
+            _outKey.append(reinterpret_cast<const char*>(data), size);
+        };
+        auto appendUint = [&append](const uint32_t val) -> void { append(&val, sizeof(val)); };
+        auto appendColor = [&append](const INode::color_t& c) -> void { append(c.pointer, 3u*sizeof(float)); };
+        auto appendTexture = [&append](const INode::STextureSource& t) -> void
+        {
+            const void* ptrs[2] = {t.image.get(), t.sampler.get()};
+            append(ptrs, sizeof(ptrs));
+            append(&t.scale, sizeof(t.scale));
+        };
+        auto appendFloatParam = [&](const INode::SParameter<float>& p) -> void
+        {
+            appendUint(p.source);
+            if (p.source == INode::EPS_TEXTURE)
+                appendTexture(p.value.texture);
+            else
+                append(&p.value.constant, sizeof(float));
+        };
+        auto appendColorParam = [&](const INode::SParameter<INode::color_t>& p) -> void
+        {
+            appendUint(p.source);
+            if (p.source == INode::EPS_TEXTURE)
+                appendTexture(p.value.texture);
+            else
+                appendColor(p.value.constant);
+        };
+
+        _outKey.clear();
+        appendUint(_node->symbol);
+        appendUint(static_cast<uint32_t>(_node->children.count));
+        append(_node->children.array, _node->children.count*sizeof(INode*));
+        switch (_node->symbol)
+        {
+        case INode::ES_GEOM_MODIFIER:
+        {
+            auto* node = static_cast<const CGeomModifierNode*>(_node);
+            appendUint(node->type);
+            appendTexture(node->texture);
+        }
+            break;
+        case INode::ES_EMISSION:
+            appendColor(static_cast<const CEmissionNode*>(_node)->intensity);
+            break;
+        case INode::ES_OPACITY:
+            appendColorParam(static_cast<const COpacityNode*>(_node)->opacity);
+            break;
+        case INode::ES_BSDF:
+        {
+            auto* bsdf = static_cast<const CBSDFNode*>(_node);
+            appendUint(bsdf->type);
+            appendColor(bsdf->eta);
+            appendColor(bsdf->etaK);
+            switch (bsdf->type)
+            {
+            case CBSDFNode::ET_MICROFACET_DIFFTRANS:
+            case CBSDFNode::ET_MICROFACET_DIFFUSE:
+            {
+                auto* node = static_cast<const CMicrofacetDiffuseBxDFBase*>(bsdf);
+                appendFloatParam(node->alpha_u);
+                appendFloatParam(node->alpha_v);
+                if (bsdf->type == CBSDFNode::ET_MICROFACET_DIFFUSE)
+                    appendColorParam(static_cast<const CMicrofacetDiffuseBSDFNode*>(bsdf)->reflectance);
+                else
+                    appendColorParam(static_cast<const CMicrofacetDifftransBSDFNode*>(bsdf)->transmittance);
+            }
+                break;
+            case CBSDFNode::ET_MICROFACET_SPECULAR:
+            case CBSDFNode::ET_MICROFACET_COATING:
+            case CBSDFNode::ET_MICROFACET_DIELECTRIC:
+            {
+                auto* node = static_cast<const CMicrofacetSpecularBSDFNode*>(bsdf);
+                appendUint(node->ndf);
+                appendUint(node->shadowing);
+                appendFloatParam(node->alpha_u);
+                appendFloatParam(node->alpha_v);
+                if (bsdf->type == CBSDFNode::ET_MICROFACET_COATING)
+                    appendColorParam(static_cast<const CMicrofacetCoatingBSDFNode*>(bsdf)->thicknessSigmaA);
+                else if (bsdf->type == CBSDFNode::ET_MICROFACET_DIELECTRIC)
+                    appendUint(static_cast<const CMicrofacetDielectricBSDFNode*>(bsdf)->thin);
+            }
+                break;
+            default:
+                break;
+            }
+        }
+            break;
+        case INode::ES_BSDF_COMBINER:
+        {
+            auto* combiner = static_cast<const CBSDFCombinerNode*>(_node);
+            appendUint(combiner->type);
+            if (combiner->type == CBSDFCombinerNode::ET_WEIGHT_BLEND)
+                appendColorParam(static_cast<const CBSDFBlendNode*>(combiner)->weight);
+            else if (combiner->type == CBSDFCombinerNode::ET_MIX)
+                append(static_cast<const CBSDFMixNode*>(combiner)->weights, combiner->children.count*sizeof(float));
+        }
+            break;
+        }
+    }
+
+    INode* hashCons(INode* _root)
+    {
+        // what each node of the tree got replaced with
+        core::unordered_map<INode*, INode*> canonical;
+        core::unordered_set<const INode*> usedInThisRoot;
+        core::unordered_set<INode*> replaced;
+        std::string key;
+
+        // post-order, so children are always hash-consed before their parents
+        core::stack<std::pair<INode*,bool>> stack;
+        stack.push({_root,false});
+        while (!stack.empty())
+        {
+            auto [node, childrenDone] = stack.top();
+            stack.pop();
+            if (canonical.find(node) != canonical.end())
+                continue;
+            if (!childrenDone)
+            {
+                stack.push({node,true});
+                for (INode* child : node->children)
+                if (child)
+                    stack.push({child,false});
+                continue;
+            }
+
+            for (INode*& child : node->children)
+            if (child)
+                child = canonical[child];
+
+            // identical subtrees occurring a few times within a root are kept apart, so each one of them can be shared
+            getStructuralKey(node, key);
+            auto& candidates = uniqueNodes[key];
+            // a node which is canonical already (shared with an earlier root) stays, other roots point to it
+            INode* replacement = std::find(candidates.begin(), candidates.end(), node) != candidates.end() ? node : nullptr;
+            if (!replacement)
+            for (INode* candidate : candidates)
+            if (usedInThisRoot.find(candidate) == usedInThisRoot.end())
+            {
+                replacement = candidate;
+                break;
+            }
+            if (!replacement)
+            {
+                replacement = node;
+                candidates.push_back(node);
+                uniqueNodeCount++;
+            }
+            else if (replacement != node)
+                replaced.insert(node);
+            usedInThisRoot.insert(replacement);
+            canonical[node] = replacement;
+        }
+
+        for (INode* node : replaced)
+        {
+            node->~INode();
+            node->deinited = true;
+        }
+        if (!replaced.empty())
+        {
+            auto isReplaced = [&replaced](const SNodeAllocation& a) { return replaced.find(a.node) != replaced.end(); };
+            // the tree usually is what got allocated last, so the replaced nodes at the top go back to the arena
+            size_t remaining = replaced.size();
+            while (!nodes.empty() && isReplaced(nodes.back()))
+            {
+                memMgr.deallocate(nodes.back().node, nodes.back().size);
+                nodes.pop_back();
+                remaining--;
+            }
+            // only look back as far as the earliest replaced node, not through the whole IR every time
+            auto first = nodes.end();
+            while (remaining && first != nodes.begin())
+            if (isReplaced(*(--first)))
+                remaining--;
+            nodes.erase(std::remove_if(first, nodes.end(), isReplaced), nodes.end());
+        }
+
+        return canonical[_root];
+    }
+
+    arena_t memMgr;
+    core::vector<SNodeAllocation> nodes;
+    core::unordered_map<std::string, core::vector<INode*>> uniqueNodes;
+    size_t uniqueNodeCount = 0u;
+
+public:
     core::vector<INode*> roots;
 
+protected:
+    core::unordered_set<const INode*> rootSet;
+
+    std::mutex tmpMutex;
+    arena_t tmpMemMgr;
     core::vector<INode*> tmp;
-    uint32_t tmpSize = 0u;
 };
 
 }}}
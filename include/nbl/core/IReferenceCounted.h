@@ -78,7 +78,13 @@ namespace core
 		You will not have to drop the pointer to the loaded texture,
 		because the name of the method does not start with 'create'.
 		The texture is stored somewhere by the driver. */
-		inline void grab() const { ReferenceCounter++; }
+		inline void grab() const
+		{
+			if (ThreadConfined)
+				ReferenceCounter.store(ReferenceCounter.load(std::memory_order_relaxed)+1u,std::memory_order_relaxed);
+			else // a new reference can only be made from an existing one, so there is nothing to synchronize with
+				ReferenceCounter.fetch_add(1u,std::memory_order_relaxed);
+		}
 
 		//! Drops the object. Decrements the reference counter by one.
 		/** The IReferenceCounted class provides a basic reference
@@ -110,11 +116,21 @@ namespace core
 		\return True, if the object was deleted. */
 		inline bool drop() const
 		{
-			auto ctrVal = ReferenceCounter--;
+			uint32_t ctrVal;
+			if (ThreadConfined)
+			{
+				ctrVal = ReferenceCounter.load(std::memory_order_relaxed);
+				ReferenceCounter.store(ctrVal-1u,std::memory_order_relaxed);
+			}
+			else // release so that our writes to the object happen-before its deletion by whichever thread drops last
+				ctrVal = ReferenceCounter.fetch_sub(1u,std::memory_order_release);
 			// someone is doing bad reference counting.
 			_NBL_DEBUG_BREAK_IF(ctrVal == 0)
 			if (ctrVal==1)
 			{
+				// pairs with the release of every other drop, only paid for by the last one
+				// an acquire load instead of an acquire fence, same guarantee and visible to thread sanitizers
+				ReferenceCounter.load(std::memory_order_acquire);
 			    // https://eli.thegreenplace.net/2015/c-deleting-destructors-and-virtual-operator-delete/
 				delete this; // aligned overrides of delete should do the job :D due to C++ standard trickery
 				return true;
@@ -127,7 +143,13 @@ namespace core
 		/** \return Recent value of the reference counter. */
 		inline int32_t getReferenceCount() const
 		{
-			return ReferenceCounter.load();
+			return ReferenceCounter.load(std::memory_order_relaxed);
+		}
+
+		//! Whether `grab` and `drop` skip the atomic read-modify-writes, see IThreadBoundReferenceCounted
+		inline bool isThreadConfined() const
+		{
+			return ThreadConfined;
 		}
 
 		//! Returns the debug name of the object.
@@ -142,7 +164,7 @@ namespace core
 	protected:
 		//! Constructor.
 		IReferenceCounted()
-			: DebugName(0), ReferenceCounter(1)
+			: DebugName(0), ReferenceCounter(1), ThreadConfined(false)
 		{
 			_NBL_DEBUG_BREAK_IF(!ReferenceCounter.is_lock_free()) //incompatibile platform
 			static_assert(decltype(ReferenceCounter)::is_always_lock_free,"Unsupported Platform, Lock-less Atomic Reference Couting is Impossible!");
@@ -162,6 +184,13 @@ namespace core
 			DebugName = newName;
 		}
 
+		//! Makes reference counting use plain loads and stores, only for objects which never get grabbed or dropped by another thread than the one which created them.
+		/** Must be called from a constructor, before any reference other than the initial one exists. */
+		inline void makeThreadConfined()
+		{
+			ThreadConfined = true;
+		}
+
 	private:
 		//! The debug name.
 		const char* DebugName;
@@ -172,6 +201,9 @@ namespace core
 		mutable std::atomic<uint32_t> ReferenceCounter;
 		static_assert(alignof(std::atomic<uint32_t>) <= _NBL_SIMD_ALIGNMENT/2u, "This compiler has a problem with its atomic int decl!");
 		static_assert(sizeof(std::atomic<uint32_t>) <= _NBL_SIMD_ALIGNMENT/2u, "This compiler has a problem with its atomic int decl!");
+
+		//! Sits in the padding after the counter, so it doesn't make the objects any bigger
+		bool ThreadConfined;
 	};
 	static_assert(alignof(IReferenceCounted) == _NBL_SIMD_ALIGNMENT, "This compiler has a problem respecting alignment!");
 
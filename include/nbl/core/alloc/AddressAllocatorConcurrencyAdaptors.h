@@ -5,6 +5,12 @@
 #ifndef __NBL_CORE_ADDRESS_ALLOCATOR_CONCURRENCY_ADAPTORS_H_INCLUDED__
 #define __NBL_CORE_ADDRESS_ALLOCATOR_CONCURRENCY_ADAPTORS_H_INCLUDED__
 
+#include <mutex>
+#include <memory>
+
+#include "nbl/core/Types.h"
+#include "nbl/core/math/intutil.h"
+#include "nbl/core/alloc/AlignedBase.h"
 #include "nbl/core/alloc/address_allocator_traits.h"
 
 namespace nbl
@@ -87,6 +93,15 @@ class AddressAllocatorBasicConcurrencyAdaptor : private AddressAllocator
             return retval;
         }
 
+        //! the non-const overload lets allocators which defragment their free lists (General purpose, Pool) give a tighter bound
+        template<typename... Args>
+        inline size_type    safe_shrink_size(const Args&... args) noexcept
+        {
+            lock.lock();
+            auto retval = AddressAllocator::safe_shrink_size(args...);
+            lock.unlock();
+            return retval;
+        }
         template<typename... Args>
         inline size_type    safe_shrink_size(const Args&... args) const noexcept
         {
@@ -111,6 +126,344 @@ class AddressAllocatorBasicConcurrencyAdaptor : private AddressAllocator
         }
 };
 
+
+namespace impl
+{
+    //! Small index unique among the live threads, handed back when a thread exits so that per-thread tables can be plain arrays
+    class ThreadCacheSlot
+    {
+        public:
+            static inline uint32_t get() noexcept
+            {
+                thread_local ThreadCacheSlot slot;
+                return slot.ix;
+            }
+
+        private:
+            ThreadCacheSlot()
+            {
+                std::lock_guard<std::mutex> guard(getLock());
+                auto& freeSlots = getFreeSlots();
+                if (freeSlots.empty())
+                    ix = getSlotCount()++;
+                else
+                {
+                    ix = freeSlots.back();
+                    freeSlots.pop_back();
+                }
+            }
+            ~ThreadCacheSlot()
+            {
+                std::lock_guard<std::mutex> guard(getLock());
+                getFreeSlots().push_back(ix);
+            }
+
+            static inline std::mutex& getLock() {static std::mutex lock; return lock;}
+            static inline core::vector<uint32_t>& getFreeSlots() {static core::vector<uint32_t> freeSlots; return freeSlots;}
+            static inline uint32_t& getSlotCount() {static uint32_t slotCount = 0u; return slotCount;}
+
+            uint32_t ix;
+    };
+}
+
+//! Thread caching front-end for address allocators which support arbitrary order frees (PoolAddressAllocator, GeneralpurposeAddressAllocator)
+/** Every thread keeps a magazine of free addresses per power-of-two size class (just one for `allocatesFixedSize` allocators),
+allocations and frees served by the magazine touch neither the lock nor any atomic. An empty magazine gets refilled and a full one
+half-flushed with a single `multi_alloc_addr`/`multi_free_addr` of `MagazineSize/2` addresses under the lock.
+
+Sizes above `0x1<<MaxCachedSizeLog2`, alignments above the size class' own and threads beyond the first `MaxThreads` go straight to the locked allocator.
+Cached sizes get rounded up to their class, so `free_addr` needs the same `bytes` that went into `alloc_addr` (as with any other allocator).
+
+Addresses sitting in magazines are allocated as far as the underlying allocator is concerned, so an allocation can fail while other threads hoard free space,
+call `drainCaches()` before `safe_shrink_size`, resizing or querying free space if that matters.
+`drainCaches()`, `reset()` and destruction must not race with other threads using the allocator.
+*/
+template<class AddressAllocator, class RecursiveLockable, uint32_t MagazineSize=64u, uint32_t MaxCachedSizeLog2=16u, uint32_t MaxThreads=64u>
+class AddressAllocatorThreadCachingAdaptor : private AddressAllocator
+{
+        static_assert(std::is_standard_layout<RecursiveLockable>::value,"Lock class is not standard layout");
+        static_assert(MagazineSize>=2u && (MagazineSize&0x1u)==0u,"Magazines get refilled and flushed by halves");
+
+        _NBL_STATIC_INLINE_CONSTEXPR uint32_t SizeClassCount = MaxCachedSizeLog2+1u;
+        _NBL_STATIC_INLINE_CONSTEXPR uint32_t BatchSize = MagazineSize/2u;
+
+        AddressAllocator& getBaseRef() {return reinterpret_cast<AddressAllocator&>(*this);}
+    public:
+        _NBL_DECLARE_ADDRESS_ALLOCATOR_TYPEDEFS(typename AddressAllocator::size_type);
+
+        typedef address_allocator_traits<AddressAllocator>              traits;
+        static_assert(address_allocator_traits<AddressAllocator>::supportsArbitraryOrderFrees,"AddressAllocator does not support arbitrary order frees!");
+
+        static constexpr bool supportsNullBuffer = traits::supportsNullBuffer;
+        static constexpr bool allocatesFixedSize = traits::allocatesFixedSize;
+
+
+        AddressAllocatorThreadCachingAdaptor() = default;
+
+        template<typename... Args>
+        AddressAllocatorThreadCachingAdaptor(Args&&... args) noexcept : AddressAllocator(std::forward<Args>(args)...) {}
+
+        //! Resize, the addresses cached by `other` go back to it before its state gets moved
+        template<typename... Args>
+        AddressAllocatorThreadCachingAdaptor(size_type newBuffSz, AddressAllocatorThreadCachingAdaptor&& other, Args&&... args) noexcept :
+                    AddressAllocator(newBuffSz,std::move(other.drainedBaseRef()),std::forward<Args>(args)...) {}
+
+        virtual ~AddressAllocatorThreadCachingAdaptor() {}
+
+        AddressAllocatorThreadCachingAdaptor& operator=(AddressAllocatorThreadCachingAdaptor&& other)
+        {
+            drainCaches();
+            AddressAllocator::operator=(std::move(other.drainedBaseRef()));
+            return *this;
+        }
+
+
+        inline size_type    alloc_addr(size_type bytes, size_type alignment, size_type hint=0ull) noexcept
+        {
+            const uint32_t sizeClass = findSizeClass(bytes);
+            if (sizeClass<SizeClassCount)
+            {
+                SThreadCache* cache;
+                if (alignment && getClassAlignment(sizeClass)%alignment==0u && (cache=getThreadCache()))
+                {
+                    SMagazine& magazine = cache->magazines[sizeClass];
+                    if (!magazine.count)
+                        refill(magazine,sizeClass);
+                    return magazine.count ? magazine.addresses[--magazine.count]:invalid_address;
+                }
+                // still needs to be the size of the class, because `free_addr` only gets to see the size
+                bytes = getClassSize(sizeClass);
+            }
+
+            std::lock_guard<RecursiveLockable> guard(lock);
+            return AddressAllocator::alloc_addr(bytes,alignment,hint);
+        }
+
+        inline void         free_addr(size_type addr, size_type bytes) noexcept
+        {
+            const uint32_t sizeClass = findSizeClass(bytes);
+            if (sizeClass<SizeClassCount)
+            {
+                if (SThreadCache* cache=getThreadCache())
+                {
+                    SMagazine& magazine = cache->magazines[sizeClass];
+                    if (magazine.count==MagazineSize)
+                        flush(magazine,sizeClass,BatchSize);
+                    magazine.addresses[magazine.count++] = addr;
+                    return;
+                }
+                bytes = getClassSize(sizeClass);
+            }
+
+            std::lock_guard<RecursiveLockable> guard(lock);
+            AddressAllocator::free_addr(addr,bytes);
+        }
+
+        inline void         multi_alloc_addr(uint32_t count, size_type* outAddresses, const size_type* bytes, const size_type* alignment, const size_type* hint=nullptr) noexcept
+        {
+            for (uint32_t i=0; i<count; i++)
+            {
+                if (outAddresses[i]!=invalid_address)
+                    continue;
+
+                outAddresses[i] = alloc_addr(bytes[i],alignment[i],hint ? hint[i]:0ull);
+            }
+        }
+
+        inline void         multi_free_addr(uint32_t count, const size_type* addr, const size_type* bytes) noexcept
+        {
+            for (uint32_t i=0; i<count; i++)
+            {
+                if (addr[i]==invalid_address)
+                    continue;
+
+                free_addr(addr[i],bytes[i]);
+            }
+        }
+
+        //! Gives all the addresses sitting in magazines of all threads back to the underlying allocator
+        inline void         drainCaches() noexcept
+        {
+            std::lock_guard<RecursiveLockable> guard(lock);
+            for (auto& cache : m_caches)
+            if (cache)
+            for (uint32_t i=0u; i<SizeClassCount; i++)
+                flush(cache->magazines[i],i,cache->magazines[i].count);
+        }
+
+        inline void         reset() noexcept
+        {
+            std::lock_guard<RecursiveLockable> guard(lock);
+            for (auto& cache : m_caches)
+            if (cache)
+            for (auto& magazine : cache->magazines)
+                magazine.count = 0u;
+            AddressAllocator::reset();
+        }
+
+        //! Conservative estimate, max_size() gives largest size we are sure to be able to allocate
+        inline size_type    max_size() const noexcept
+        {
+            std::lock_guard<RecursiveLockable> guard(lock);
+            return AddressAllocator::max_size();
+        }
+
+        //! Most address allocators do not support e.g. 1-byte allocations
+        inline size_type    min_size() const noexcept
+        {
+            return AddressAllocator::min_size();
+        }
+
+        inline size_type    max_alignment() const noexcept
+        {
+            return AddressAllocator::max_alignment();
+        }
+
+        inline size_type    get_align_offset() const noexcept
+        {
+            return AddressAllocator::get_align_offset();
+        }
+
+        inline size_type    get_combined_offset() const noexcept
+        {
+            return AddressAllocator::get_combined_offset();
+        }
+
+        //! Cached addresses count as allocated
+        inline size_type    get_free_size() const noexcept
+        {
+            std::lock_guard<RecursiveLockable> guard(lock);
+            return AddressAllocator::get_free_size();
+        }
+
+        inline size_type    get_allocated_size() const noexcept
+        {
+            std::lock_guard<RecursiveLockable> guard(lock);
+            return AddressAllocator::get_allocated_size();
+        }
+
+        inline size_type    get_total_size() const noexcept
+        {
+            return AddressAllocator::get_total_size();
+        }
+
+        template<typename... Args>
+        inline size_type    safe_shrink_size(const Args&... args) noexcept
+        {
+            std::lock_guard<RecursiveLockable> guard(lock);
+            return AddressAllocator::safe_shrink_size(args...);
+        }
+        template<typename... Args>
+        inline size_type    safe_shrink_size(const Args&... args) const noexcept
+        {
+            std::lock_guard<RecursiveLockable> guard(lock);
+            return AddressAllocator::safe_shrink_size(args...);
+        }
+
+        template<typename... Args>
+        static inline size_type reserved_size(const Args&... args) noexcept
+        {
+            return AddressAllocator::reserved_size(args...);
+        }
+
+
+        //! Extra == USE WITH EXTREME CAUTION, only guards the underlying allocator not the magazines
+        inline RecursiveLockable&   get_lock() noexcept
+        {
+            return lock;
+        }
+
+    private:
+        struct SMagazine
+        {
+            uint32_t    count = 0u;
+            size_type   addresses[MagazineSize];
+        };
+        //! Only ever touched by its thread (apart from `drainCaches` and `reset`), cache line aligned so threads do not false share
+        struct SThreadCache : public AllocationOverrideBase<64u>
+        {
+            SMagazine   magazines[SizeClassCount];
+        };
+
+        //! SizeClassCount if the size does not get cached
+        inline uint32_t     findSizeClass(size_type bytes) const noexcept
+        {
+            if (!bytes)
+                return SizeClassCount;
+            if constexpr (allocatesFixedSize)
+                return bytes<=AddressAllocator::min_size() ? 0u:SizeClassCount;
+
+            const size_type classSize = core::roundUpToPoT<size_type>(core::max<size_type>(bytes,AddressAllocator::min_size()));
+            const uint32_t sizeClass = core::findMSB<size_type>(classSize);
+            return core::min(sizeClass,SizeClassCount);
+        }
+        inline size_type    getClassSize(uint32_t sizeClass) const noexcept
+        {
+            if constexpr (allocatesFixedSize)
+                return AddressAllocator::min_size();
+            return size_type(0x1u)<<size_type(sizeClass);
+        }
+        //! Every cached address is aligned to this, so requests for any divisor of it can be served from the magazine
+        inline size_type    getClassAlignment(uint32_t sizeClass) const noexcept
+        {
+            if constexpr (allocatesFixedSize)
+                return AddressAllocator::min_size();
+            return core::min(getClassSize(sizeClass),AddressAllocator::max_alignment());
+        }
+
+        inline SThreadCache* getThreadCache()
+        {
+            const uint32_t slot = impl::ThreadCacheSlot::get();
+            if (slot>=MaxThreads)
+                return nullptr;
+
+            auto& cache = m_caches[slot];
+            if (!cache)
+                cache.reset(new SThreadCache());
+            return cache.get();
+        }
+
+        inline void         refill(SMagazine& magazine, uint32_t sizeClass)
+        {
+            size_type bytes[BatchSize];
+            size_type alignments[BatchSize];
+            std::fill_n(bytes,BatchSize,getClassSize(sizeClass));
+            std::fill_n(alignments,BatchSize,getClassAlignment(sizeClass));
+            std::fill_n(magazine.addresses,BatchSize,invalid_address);
+            {
+                std::lock_guard<RecursiveLockable> guard(lock);
+                traits::multi_alloc_addr(getBaseRef(),BatchSize,magazine.addresses,bytes,alignments);
+            }
+            // close the gaps left by the allocations which failed
+            magazine.count = static_cast<uint32_t>(std::remove(magazine.addresses,magazine.addresses+BatchSize,invalid_address)-magazine.addresses);
+        }
+
+        //! Frees the `count` oldest addresses, the ones most likely to have gone cold
+        inline void         flush(SMagazine& magazine, uint32_t sizeClass, uint32_t count)
+        {
+            if (!count)
+                return;
+
+            size_type bytes[MagazineSize];
+            std::fill_n(bytes,count,getClassSize(sizeClass));
+            {
+                std::lock_guard<RecursiveLockable> guard(lock);
+                traits::multi_free_addr(getBaseRef(),count,magazine.addresses,bytes);
+            }
+            std::copy(magazine.addresses+count,magazine.addresses+magazine.count,magazine.addresses);
+            magazine.count -= count;
+        }
+
+        inline AddressAllocator& drainedBaseRef()
+        {
+            drainCaches();
+            return getBaseRef();
+        }
+
+        mutable RecursiveLockable lock;
+        std::unique_ptr<SThreadCache> m_caches[MaxThreads];
+};
+
 }
 }
 
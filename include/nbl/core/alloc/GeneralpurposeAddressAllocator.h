@@ -275,39 +275,25 @@ class GeneralpurposeAddressAllocatorBase
         void copyState(const GeneralpurposeAddressAllocatorBase& other, void* newReservedSpc)
         {
             swapFreeLists(newReservedSpc);
-            // first, insert new block or trim existing
-            if (bufferSize<other.bufferSize) // trim
-            {
-                bool notFoundTheSlab = true;
-                for (auto i=freeListCount; notFoundTheSlab&&i<other.freeListCount; i++)
-                for (size_type j=0u; j<other.freeListStackCtr[i]; j++)
-                {
-                    const auto& block = other.freeListStack[i][j];
-                    if (block.startOffset>bufferSize)
-                        continue;
-                    #ifdef _NBL_DEBUG
-                    assert(block.endOffset>=bufferSize);
-                    #endif // _NBL_DEBUG
-                    insertFreeBlock({block.startOffset,bufferSize});
-                    #ifndef _NBL_DEBUG
-                    notFoundTheSlab = false;
-                    #endif // _NBL_DEBUG
-                }
-            }
-            else if (bufferSize>other.bufferSize) // insert new
+            // first, insert new block when growing
+            if (bufferSize>other.bufferSize)
                 insertFreeBlock({other.bufferSize,bufferSize});
-            // then copy the existing free-blocks across
-            for (decltype(freeListCount) i=0u; i<freeListCount; i++)
+            // then copy the existing free-blocks across, trimming the ones past the new end
+            for (decltype(freeListCount) i=0u; i<other.freeListCount; i++)
+            for (size_type j=0u; j<other.freeListStackCtr[i]; j++)
             {
-                if (i<other.freeListCount)
+                Block block = other.freeListStack[i][j];
+                // after `safe_shrink_size` only the trailing free slab can cross the new end, and it can be on any level
+                if (block.endOffset>bufferSize)
                 {
-                    for (size_type j=0u; j<other.freeListStackCtr[i]; j++)
-                    {
-                        const auto& block = other.freeListStack[i][j];
-                        freeListStack[i][freeListStackCtr[i]++]= block;
-                        freeSize += block.getLength();
-                    }
+                    if (block.startOffset>=bufferSize)
+                        continue;
+                    block.endOffset = bufferSize;
+                    // a sliver smaller than a block cannot be tracked, it becomes part of the unusable tail
+                    if (block.getLength()<minBlockSize)
+                        continue;
                 }
+                insertFreeBlock(block);
             }
         }
 };
@@ -614,6 +600,11 @@ class GeneralpurposeAddressAllocator : public AddressAllocatorBase<Generalpurpos
         {
             return reserved_size(other.maxRequestableAlignment,bufSz,other.minBlockSize);
         }
+        //! argument order `ResizableHeterogenousMemoryAllocator` and the other allocators use
+        static inline size_type reserved_size(const GeneralpurposeAddressAllocator<_size_type>& other, size_type bufSz) noexcept
+        {
+            return reserved_size(bufSz,other);
+        }
 
         inline size_type        get_free_size() const noexcept
         {
@@ -704,6 +695,9 @@ using GeneralpurposeAddressAllocatorST = GeneralpurposeAddressAllocator<size_typ
 template<typename size_type, class RecursiveLockable>
 using GeneralpurposeAddressAllocatorMT = AddressAllocatorBasicConcurrencyAdaptor<GeneralpurposeAddressAllocator<size_type>,RecursiveLockable>;
 
+template<typename size_type, class RecursiveLockable>
+using GeneralpurposeAddressAllocatorTC = AddressAllocatorThreadCachingAdaptor<GeneralpurposeAddressAllocator<size_type>,RecursiveLockable>;
+
 }
 }
 
@@ -0,0 +1,223 @@
+// Copyright (C) 2018-2020 - DevSH Graphics Programming Sp. z O.O.
+// This file is part of the "Nabla Engine".
+// For conditions of distribution and use, see copyright notice in nabla.h
+
+#ifndef __NBL_CORE_MONOTONIC_ARENA_H_INCLUDED__
+#define __NBL_CORE_MONOTONIC_ARENA_H_INCLUDED__
+
+#include "nbl/core/alloc/LinearAddressAllocator.h"
+#include "nbl/core/alloc/SimpleBlockBasedAllocator.h"
+#include "nbl/core/alloc/AllocatorTrivialBases.h"
+
+namespace nbl
+{
+namespace core
+{
+
+//! Bump allocator for temporaries which all die at once, i.e. everything a loader needs during a single `loadAsset`
+/** Allocations are carved out of blocks managed by `LinearAddressAllocator`s, so `deallocate` is a no-op
+unless it frees the most recent allocation in the current block, which gets rolled back (so a `vector` growing at the top of the arena reuses its space).
+Anything larger than a quarter of a block, or aligned to more than `meta_alignment`, gets a dedicated allocation which `deallocate` returns right away,
+so big growing buffers don't pile up their old storage until the arena dies.
+`reset` rewinds all the blocks for reuse, `release` and the destructor free all memory. Not thread-safe, use one arena per load and thread. */
+template<template<class> class DataAllocator=aligned_allocator>
+class MonotonicArena : protected SimpleBlockBasedAllocator<LinearAddressAllocator<uint32_t>,DataAllocator>
+{
+		using base_t = SimpleBlockBasedAllocator<LinearAddressAllocator<uint32_t>,DataAllocator>;
+		_NBL_STATIC_INLINE_CONSTEXPR auto invalid_address = LinearAddressAllocator<uint32_t>::invalid_address;
+
+		// lives right in front of the memory handed out
+		struct SDedicatedHeader
+		{
+			size_t offset; // from the start of the underlying allocation
+			size_t size; // of the underlying allocation
+		};
+
+	public:
+		using base_t::meta_alignment;
+		_NBL_STATIC_INLINE_CONSTEXPR size_t default_block_size = 256u*1024u;
+		_NBL_STATIC_INLINE_CONSTEXPR size_t default_max_block_count = 4096u;
+
+		MonotonicArena(const size_t blockSize=default_block_size, const size_t maxBlockCount=default_max_block_count) :
+			base_t(blockSize,maxBlockCount), m_currentBlock(0u)
+		{
+		}
+		MonotonicArena(const MonotonicArena&) = delete;
+		MonotonicArena& operator=(const MonotonicArena&) = delete;
+
+		~MonotonicArena()
+		{
+			releaseDedicated();
+		}
+
+		//
+		inline void*	allocate(const size_t bytes, const size_t alignment) noexcept
+		{
+			if (bytes==0u)
+				return nullptr;
+			if (isDedicated(bytes) || alignment>meta_alignment)
+				return allocateDedicated(bytes,alignment);
+
+			for (; m_currentBlock<base_t::maxBlockCount; m_currentBlock++)
+			{
+				auto& block = base_t::blocks[m_currentBlock];
+				if (!block)
+					block = base_t::createBlock();
+				const auto addr = block->alloc(bytes,alignment);
+				if (addr!=invalid_address)
+					return block->data()+addr;
+			}
+			// out of blocks, keep working but without the benefits
+			m_currentBlock = base_t::maxBlockCount-1u;
+			return allocateDedicated(bytes,alignment);
+		}
+
+		//! `bytes` needs to be the same as passed to `allocate`
+		inline void		deallocate(void* p, const size_t bytes) noexcept
+		{
+			if (!p)
+				return;
+
+			// small allocations can be dedicated too (over-aligned or out of blocks), so the size alone can't tell
+			auto* block = base_t::blocks[m_currentBlock];
+			if (block && p>=block->data() && p<block->data()+base_t::blockSize)
+			{
+				auto& addrAlloc = block->getAllocator();
+				const size_t addr = reinterpret_cast<uint8_t*>(p)-block->data();
+				if (addr+bytes==addrAlloc.get_allocated_size())
+					addrAlloc.reset(addr);
+				return;
+			}
+			// not in the current block, so either in an older one where it stays, or dedicated
+			if (m_dedicated.empty())
+				return;
+			auto found = m_dedicated.find(p);
+			if (found==m_dedicated.end())
+				return;
+			m_dedicated.erase(found);
+			freeDedicated(p);
+		}
+
+		//! Invalidates all allocations, but keeps the blocks around for the next use
+		inline void		reset()
+		{
+			releaseDedicated();
+			for (size_t i=0u; i<=m_currentBlock; i++)
+			if (base_t::blocks[i])
+				base_t::blocks[i]->getAllocator().reset();
+			m_currentBlock = 0u;
+		}
+
+		//! Invalidates all allocations and frees all memory
+		inline void		release()
+		{
+			releaseDedicated();
+			base_t::reset();
+			m_currentBlock = 0u;
+		}
+
+		inline size_t	getBlockSize() const { return base_t::blockSize; }
+
+		//! Bytes held by the arena, blocks and dedicated allocations
+		inline size_t	getReservedSize() const
+		{
+			size_t retval = 0u;
+			for (size_t i=0u; i<base_t::maxBlockCount; i++)
+			if (base_t::blocks[i])
+				retval += base_t::effectiveBlockSize;
+			for (auto* p : m_dedicated)
+				retval += (reinterpret_cast<const SDedicatedHeader*>(p)-1)->size;
+			return retval;
+		}
+
+	private:
+		inline bool		isDedicated(const size_t bytes) const
+		{
+			return bytes>(base_t::blockSize>>2u);
+		}
+
+		inline void*	allocateDedicated(const size_t bytes, const size_t alignment) noexcept
+		{
+			const size_t underlyingAlignment = core::max<size_t>(alignment,alignof(SDedicatedHeader));
+			const size_t offset = core::alignUp(sizeof(SDedicatedHeader),underlyingAlignment);
+			const size_t size = offset+bytes;
+			uint8_t* const base = base_t::blockAlloc.allocate(size,underlyingAlignment);
+			if (!base)
+				return nullptr;
+
+			uint8_t* const retval = base+offset;
+			*(reinterpret_cast<SDedicatedHeader*>(retval)-1) = {offset,size};
+			m_dedicated.insert(retval);
+			return retval;
+		}
+		//! doesn't remove `p` from `m_dedicated`
+		inline void		freeDedicated(void* p) noexcept
+		{
+			const auto* header = reinterpret_cast<const SDedicatedHeader*>(p)-1;
+			base_t::blockAlloc.deallocate(reinterpret_cast<uint8_t*>(p)-header->offset,header->size);
+		}
+		inline void		releaseDedicated() noexcept
+		{
+			for (auto* p : m_dedicated)
+				freeDedicated(p);
+			m_dedicated.clear();
+		}
+
+		size_t m_currentBlock;
+		//! hashed so `deallocate` can tell a dedicated allocation from one in an older block in O(1)
+		core::unordered_set<void*> m_dedicated;
+};
+
+
+//! Lets `core::vector`, `core::map` and friends allocate from a `MonotonicArena`, the arena has to outlive the containers
+/** Unlike `aligned_allocator` there's no `deallocate(p)` without a size and types only get their natural alignment. */
+template<typename T, class Arena=MonotonicArena<>>
+class NBL_FORCE_EBO monotonic_arena_allocator : public AllocatorTrivialBase<T>
+{
+	public:
+		typedef size_t	size_type;
+		typedef T*		pointer;
+
+		template<class U> struct rebind { typedef monotonic_arena_allocator<U,Arena> other; };
+
+
+		monotonic_arena_allocator(Arena& _arena) : arena(&_arena) {}
+		template<typename U>
+		monotonic_arena_allocator(const monotonic_arena_allocator<U,Arena>& other) : arena(other.getArena()) {}
+
+
+		inline pointer	allocate(size_type n, size_type alignment, const void* hint=nullptr) noexcept
+		{
+			return reinterpret_cast<pointer>(arena->allocate(n*sizeof(T),alignment));
+		}
+		inline pointer	allocate(size_type n, const void* hint=nullptr) noexcept
+		{
+			return allocate(n,alignof(T),hint);
+		}
+
+		inline void		deallocate(pointer p, size_type n) noexcept
+		{
+			arena->deallocate(const_cast<typename std::remove_const<T>::type*>(p),n*sizeof(T));
+		}
+
+		inline Arena*	getArena() const { return arena; }
+
+		template<typename U>
+		inline bool		operator!=(const monotonic_arena_allocator<U,Arena>& other) const noexcept
+		{
+			return arena!=other.getArena();
+		}
+		template<typename U>
+		inline bool		operator==(const monotonic_arena_allocator<U,Arena>& other) const noexcept
+		{
+			return arena==other.getArena();
+		}
+
+	private:
+		Arena* arena;
+};
+
+}
+}
+
+#endif
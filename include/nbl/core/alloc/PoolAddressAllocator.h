@@ -46,6 +46,7 @@ class PoolAddressAllocator : public AddressAllocatorBase<PoolAddressAllocator<_s
         _NBL_DECLARE_ADDRESS_ALLOCATOR_TYPEDEFS(_size_type);
 
         static constexpr bool supportsNullBuffer = true;
+        static constexpr bool allocatesFixedSize = true;
 
         #define DUMMY_DEFAULT_CONSTRUCTOR PoolAddressAllocator() : blockSize(1u), blockCount(0u) {}
         GCC_CONSTRUCTOR_INHERITANCE_BUG_WORKAROUND(DUMMY_DEFAULT_CONSTRUCTOR)
@@ -228,6 +229,9 @@ using PoolAddressAllocatorST = PoolAddressAllocator<size_type>;
 template<typename size_type, class RecursiveLockable>
 using PoolAddressAllocatorMT = AddressAllocatorBasicConcurrencyAdaptor<PoolAddressAllocator<size_type>,RecursiveLockable>;
 
+template<typename size_type, class RecursiveLockable>
+using PoolAddressAllocatorTC = AddressAllocatorThreadCachingAdaptor<PoolAddressAllocator<size_type>,RecursiveLockable>;
+
 }
 }
 
@@ -6,6 +6,9 @@
 #define __NBL_CORE_RESIZABLE_HETEROGENOUS_MEMORY_ALLOCATOR_H___
 
 
+#include <algorithm>
+#include <cstring>
+
 #include "nbl/core/alloc/HeterogenousMemoryAddressAllocatorAdaptor.h"
 
 #include "nbl/core/alloc/PoolAddressAllocator.h"
@@ -132,10 +135,148 @@ class ResizableHeterogenousMemoryAllocator : public impl::ResizableHeterogenousM
         template<typename... Args>
         inline void                             multi_free_addr(Args&&... args)
         {
-            AddressAllocator& mAddrAlloc = Base::getBaseAddrAllocRef();
-
             Base::multi_free_addr(std::forward<Args>(args)...);
 
+            shrinkIfPolicyAllows();
+        }
+
+
+        //! Live allocation which a compaction is allowed to move, address allocators do not keep track of their allocations so the owner has to list them
+        struct SCompactionCandidate
+        {
+            size_type address;
+            size_type bytes;
+            size_type alignment;
+        };
+        //! A move performed by `compact`, owners of the allocation need to patch their references from `oldAddress` to `newAddress`
+        struct SRelocation
+        {
+            size_type oldAddress;
+            size_type newAddress;
+            size_type bytes;
+        };
+
+        //! Order in which a relocating compaction visits the live allocations, highest addresses first because they are what prevents a shrink
+        class CCompactionPlan
+        {
+            public:
+                CCompactionPlan() : next(0u), remainingBytes(0u), packedSize(0u) {}
+
+                inline bool         done() const {return next>=candidates.size();}
+
+                //! Bytes of allocations the plan has not visited yet, an upper bound on what is left to copy
+                inline size_type    getRemainingBytes() const {return remainingBytes;}
+
+                //! Size the live allocations would take if packed perfectly from address 0, the compaction stops once it reaches allocations below it
+                inline size_type    getPackedSize() const {return packedSize;}
+
+                //! Must be called when the owner frees an allocation of the plan before the compaction is done, otherwise it would get moved and freed again
+                inline void         forget(size_type address)
+                {
+                    auto found = std::lower_bound(candidates.begin()+next,candidates.end(),address,[](const SCompactionCandidate& candidate, size_type addr) {return candidate.address>addr;});
+                    if (found==candidates.end() || found->address!=address)
+                        return;
+                    remainingBytes -= found->bytes;
+                    found->bytes = 0u;
+                }
+
+            private:
+                friend class ResizableHeterogenousMemoryAllocator<HeterogenousMemoryAllocator>;
+
+                core::vector<SCompactionCandidate>  candidates;
+                size_t                              next;
+                size_type                           remainingBytes;
+                size_type                           packedSize;
+        };
+
+        //! Opt-in defragmentation for long running allocators, where merging adjacent free blocks is not enough to keep the buffer shrinkable
+        /** The plan stays valid while other allocations and frees happen between incremental `compact` calls, as long as freed candidates get `forget`-ed. */
+        inline CCompactionPlan                  planCompaction(const SCompactionCandidate* begin, const SCompactionCandidate* end) const
+        {
+            CCompactionPlan plan;
+            plan.candidates.assign(begin,end);
+            std::sort(plan.candidates.begin(),plan.candidates.end(),[](const SCompactionCandidate& lhs, const SCompactionCandidate& rhs) {return lhs.address>rhs.address;});
+
+            const auto& mAddrAlloc = Base::getAddressAllocator();
+            for (const auto& candidate : plan.candidates)
+            {
+                plan.remainingBytes += candidate.bytes;
+                plan.packedSize = core::roundUp(plan.packedSize,candidate.alignment)+std::max(candidate.bytes,alloc_traits::min_size(mAddrAlloc));
+            }
+            return plan;
+        }
+
+        //! Relocates allocations of the plan to lower addresses until `byteBudget` bytes got copied or the plan is done, then shrinks the buffer if the shrink policy wants to
+        /** Every move allocates the new place from the address allocator before freeing the old one, so any allocator supporting arbitrary order frees works
+        and the source and destination ranges of `copy(oldAddress,newAddress,bytes)` never overlap.
+        The relocations performed get appended to `outRelocations`, which owners (property pool indices, sub-allocated buffer users) use to patch their references.
+        @returns number of relocations appended. */
+        template<typename CopyFunc>
+        inline uint32_t                         compact(CCompactionPlan& plan, CopyFunc&& copy, size_type byteBudget, core::vector<SRelocation>& outRelocations)
+        {
+            static_assert(alloc_traits::supportsArbitraryOrderFrees, "Relocating compaction needs to free the old places in any order");
+            // The allocator decides where a new allocation goes, when it picks a place outside the packed range the block is held on to and another one requested.
+            // Moving just below the old place would not free up the end of the buffer, and as the candidates come in descending address order a block rejected once
+            // is useless for the rest of the call too.
+            core::vector<std::pair<size_type,size_type>> rejected;
+
+            uint32_t relocated = 0u;
+            while (!plan.done() && byteBudget)
+            {
+                const SCompactionCandidate candidate = plan.candidates[plan.next];
+                if (candidate.address+candidate.bytes<=plan.packedSize)
+                {
+                    // everything below is already where perfect packing would put it
+                    plan.next = plan.candidates.size();
+                    plan.remainingBytes = 0u;
+                    break;
+                }
+                plan.next++;
+                plan.remainingBytes -= candidate.bytes;
+                if (!candidate.bytes)
+                    continue;
+
+                size_type newAddress;
+                while (true)
+                {
+                    newAddress = AddressAllocator::invalid_address;
+                    Base::multi_alloc_addr(1u,&newAddress,&candidate.bytes,&candidate.alignment);
+                    if (newAddress==AddressAllocator::invalid_address || newAddress<std::min(candidate.address,plan.packedSize))
+                        break;
+                    rejected.emplace_back(newAddress,candidate.bytes);
+                }
+                if (newAddress==AddressAllocator::invalid_address)
+                    continue;
+
+                copy(candidate.address,newAddress,candidate.bytes);
+                Base::multi_free_addr(1u,&candidate.address,&candidate.bytes);
+                outRelocations.push_back({candidate.address,newAddress,candidate.bytes});
+                relocated++;
+                byteBudget -= std::min(byteBudget,candidate.bytes);
+            }
+            for (const auto& block : rejected)
+                Base::multi_free_addr(1u,&block.first,&block.second);
+
+            shrinkIfPolicyAllows();
+            return relocated;
+        }
+
+        //! For buffers in host memory, addresses are byte offsets into the current buffer allocation
+        template<typename T=typename Base::allocation_type>
+        inline typename std::enable_if<std::is_pointer<T>::value,uint32_t>::type compact(CCompactionPlan& plan, size_type byteBudget, core::vector<SRelocation>& outRelocations)
+        {
+            return compact(plan,[this](size_type oldAddress, size_type newAddress, size_type bytes)
+            {
+                uint8_t* data = reinterpret_cast<uint8_t*>(Base::mAllocation);
+                memcpy(data+newAddress,data+oldAddress,bytes);
+            },byteBudget,outRelocations);
+        }
+
+    protected:
+        inline void                             shrinkIfPolicyAllows()
+        {
+            AddressAllocator& mAddrAlloc = Base::getBaseAddrAllocRef();
+
             size_type allAllocatorSpace = alloc_traits::get_total_size(mAddrAlloc)-alloc_traits::get_align_offset(mAddrAlloc);
             size_type newSize = shrinkPolicy(this);
             if (newSize>=allAllocatorSpace)
@@ -163,7 +304,6 @@ class ResizableHeterogenousMemoryAllocator : public impl::ResizableHeterogenousM
                 Base::mReservedAlloc.deallocate(reinterpret_cast<uint8_t*>(const_cast<void*>(oldReserved)),oldReservedSize);
         }
 
-    protected:
         constexpr static size_type defaultGrowStep = 32u*4096u; //128k at a time
         constexpr static size_type defaultGrowStepMinus1 = defaultGrowStep-1u;
         static inline size_type                 defaultGrowPolicy(ThisType* _this, size_type totalRequestedNewMem)
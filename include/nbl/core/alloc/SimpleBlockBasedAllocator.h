@@ -25,7 +25,7 @@ class SimpleBlockBasedAllocator
 		using size_type = typename address_allocator_traits<AddressAllocator>::size_type;
 		_NBL_STATIC_INLINE_CONSTEXPR size_type meta_alignment = 64u;
 
-	private:
+	protected:
 		class Block
 		{
 				AddressAllocator addrAlloc;
@@ -49,6 +49,7 @@ class SimpleBlockBasedAllocator
 					return const_cast<Block*>(this)->data();
 				}
 				
+				AddressAllocator& getAllocator() { return addrAlloc; }
 				const AddressAllocator& getAllocator() const { return addrAlloc; }
 
 				size_type alloc(size_type bytes, size_type alignment)
@@ -134,7 +135,7 @@ class SimpleBlockBasedAllocator
 				if (!block)
 					continue;
                     
-				size_type addr = p-block->data();
+				const size_t addr = reinterpret_cast<uint8_t*>(p)-block->data();
 				if (addr<blockSize)
 				{
 					block->free(addr,bytes);
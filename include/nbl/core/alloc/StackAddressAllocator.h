@@ -109,6 +109,16 @@ class StackAddressAllocator  : protected LinearAddressAllocator<_size_type>
         {
             return reserved_size(other.maxRequestableAlignment,bufSz,other.minimumAllocSize);
         }
+        //! argument order `ResizableHeterogenousMemoryAllocator` and the other allocators use
+        static inline size_type reserved_size(const StackAddressAllocator<_size_type>& other, size_type bufSz) noexcept
+        {
+            return reserved_size(bufSz,other);
+        }
+
+        inline size_type        safe_shrink_size(size_type sizeBound, size_type newBuffAlignmentWeCanGuarantee=1u) const noexcept
+        {
+            return Base::safe_shrink_size(sizeBound,newBuffAlignmentWeCanGuarantee);
+        }
 
 
         inline size_type        get_free_size() const noexcept
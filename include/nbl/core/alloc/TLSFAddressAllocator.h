@@ -0,0 +1,478 @@
+// Copyright (C) 2018-2020 - DevSH Graphics Programming Sp. z O.O.
+// This file is part of the "Nabla Engine".
+// For conditions of distribution and use, see copyright notice in nabla.h
+
+#ifndef __NBL_CORE_TLSF_ADDRESS_ALLOCATOR_H_INCLUDED__
+#define __NBL_CORE_TLSF_ADDRESS_ALLOCATOR_H_INCLUDED__
+
+#include "BuildConfigOptions.h"
+
+#include <numeric>
+
+#include "nbl/core/math/intutil.h"
+#include "nbl/core/math/glslFunctions.h"
+
+#include "nbl/core/alloc/AddressAllocatorBase.h"
+
+namespace nbl
+{
+namespace core
+{
+
+
+//! Two-Level Segregated Fit allocator (Masmano et al.), constant time allocation and free with immediate coalescing
+/** Free blocks are binned by the MSB of their length (first level) and then linearly by the next `SecondLevelLog2` bits (second level),
+a bitmap per level makes finding a non-empty bin which is guaranteed to fit a single find-LSB each. Unlike GeneralpurposeAddressAllocator
+there is never any defragmentation pass, neighbouring free blocks get merged as soon as one is freed.
+
+Like all other address allocators this never touches the memory it hands out, all block metadata lives in the reserved space,
+indexed by granule. Granule is `minBlockSz` rounded up to a power of two, every allocation is rounded up to whole granules.
+*/
+template<typename _size_type>
+class TLSFAddressAllocator : public AddressAllocatorBase<TLSFAddressAllocator<_size_type>,_size_type>
+{
+    private:
+        typedef AddressAllocatorBase<TLSFAddressAllocator<_size_type>,_size_type> Base;
+    public:
+        _NBL_DECLARE_ADDRESS_ALLOCATOR_TYPEDEFS(_size_type);
+
+        static constexpr bool supportsNullBuffer = true;
+
+        #define DUMMY_DEFAULT_CONSTRUCTOR TLSFAddressAllocator() noexcept : granuleLog2(0u), granuleCount(0u), firstLevelCount(0u), freeSize(0u) {}
+        GCC_CONSTRUCTOR_INHERITANCE_BUG_WORKAROUND(DUMMY_DEFAULT_CONSTRUCTOR)
+        #undef DUMMY_DEFAULT_CONSTRUCTOR
+
+        virtual ~TLSFAddressAllocator() {}
+
+        TLSFAddressAllocator(void* reservedSpc, size_type addressOffsetToApply, size_type alignOffsetNeeded, size_type maxAllocatableAlignment, size_type bufSz, size_type minBlockSz) noexcept :
+                    Base(reservedSpc,addressOffsetToApply,alignOffsetNeeded,maxAllocatableAlignment),
+                    granuleLog2(calcGranuleLog2(minBlockSz)), granuleCount((bufSz-Base::alignOffset)>>granuleLog2), firstLevelCount(calcFirstLevelCount(granuleCount)), freeSize(0u)
+        {
+            // buffer has to be large enough for at least one block of minimum size
+            assert(bufSz>=Base::alignOffset+(size_type(0x1u)<<granuleLog2));
+
+            setupPointers();
+            reset();
+        }
+
+        //! When resizing we require that the copying of data buffer has already been handled by the user of the address allocator even if `supportsNullBuffer==true`
+        template<typename... Args>
+        TLSFAddressAllocator(size_type newBuffSz, TLSFAddressAllocator&& other, void* newReservedSpc, Args&&... args) noexcept :
+                    Base(std::move(other),newReservedSpc,std::forward<Args>(args)...),
+                    granuleLog2(other.granuleLog2), granuleCount((newBuffSz-Base::alignOffset)>>granuleLog2), firstLevelCount(calcFirstLevelCount(granuleCount)), freeSize(0u)
+        {
+            setupPointers();
+            copyState(other);
+            other.invalidate();
+        }
+
+        template<typename... Args>
+        TLSFAddressAllocator(size_type newBuffSz, const TLSFAddressAllocator& other, void* newReservedSpc, Args&&... args) noexcept :
+                    Base(other,newReservedSpc,std::forward<Args>(args)...),
+                    granuleLog2(other.granuleLog2), granuleCount((newBuffSz-Base::alignOffset)>>granuleLog2), firstLevelCount(calcFirstLevelCount(granuleCount)), freeSize(0u)
+        {
+            setupPointers();
+            copyState(other);
+        }
+
+        TLSFAddressAllocator& operator=(TLSFAddressAllocator&& other)
+        {
+            Base::operator=(std::move(other));
+            std::swap(granuleLog2,other.granuleLog2);
+            std::swap(granuleCount,other.granuleCount);
+            std::swap(firstLevelCount,other.firstLevelCount);
+            std::swap(freeSize,other.freeSize);
+            std::swap(firstLevelBitmap,other.firstLevelBitmap);
+            std::swap(secondLevelBitmaps,other.secondLevelBitmaps);
+            std::swap(freeListHeads,other.freeListHeads);
+            std::swap(blockLengths,other.blockLengths);
+            std::swap(prevPhysical,other.prevPhysical);
+            std::swap(nextFree,other.nextFree);
+            std::swap(prevFree,other.prevFree);
+            return *this;
+        }
+
+
+        //! non-PoT alignments get rounded up to a common multiple with the granule
+        inline size_type        alloc_addr(size_type bytes, size_type alignment, size_type hint=0ull) noexcept
+        {
+            if (alignment>Base::maxRequestableAlignment || bytes==0u || alignment==0u)
+                return invalid_address;
+
+            const size_type length = toGranules(bytes);
+            const size_type alignmentInGranules = alignment/std::gcd(alignment,granuleSize());
+            // worst case the start needs to be moved forward by `alignmentInGranules-1` to get aligned
+            const size_type searchLength = length+alignmentInGranules-1u;
+            if (searchLength>granuleCount || length>(freeSize>>granuleLog2))
+                return invalid_address;
+
+            // rounding the request up to the next bin means anything in the found bin is large enough
+            uint32_t fl,sl;
+            mapping(roundUpToSecondLevel(searchLength),fl,sl);
+            size_type block = findSuitableBlock(fl,sl);
+            if (block==invalid_address)
+            {
+                // blocks in the bin of the request itself might still fit, especially once alignment is accounted for
+                mapping(searchLength,fl,sl);
+                block = firstFittingBlockInBin(fl,sl,length,alignmentInGranules);
+                if (block==invalid_address)
+                    return invalid_address;
+            }
+            removeFreeBlock(block);
+
+            const size_type blockEnd = block+getLength(block);
+            const size_type start = core::roundUp(block,alignmentInGranules);
+            const size_type end = start+length;
+            if (start!=block)
+            {
+                setBlock(block,start-block,true);
+                insertFreeBlock(block);
+            }
+            setBlock(start,length,false);
+            setPrevPhysical(start,block!=start ? block:prevPhysical[block]);
+            if (end!=blockEnd)
+            {
+                setBlock(end,blockEnd-end,true);
+                setPrevPhysical(end,start);
+                setPrevPhysical(blockEnd,end);
+                insertFreeBlock(end);
+            }
+            else
+                setPrevPhysical(end,start);
+
+            freeSize -= length<<granuleLog2;
+            return (start<<granuleLog2)+Base::combinedOffset;
+        }
+
+        inline void             free_addr(size_type addr, size_type bytes) noexcept
+        {
+            size_type block = (addr-Base::combinedOffset)>>granuleLog2;
+#ifdef _NBL_DEBUG
+            // address must have had combinedOffset already applied to it, and allocation must not be outside the buffer
+            assert(addr>=Base::combinedOffset && block<granuleCount);
+            // double free or a free of something that was never allocated
+            assert(!isFree(block) && getLength(block)==toGranules(bytes));
+#endif // _NBL_DEBUG
+            size_type length = getLength(block);
+            freeSize += length<<granuleLog2;
+
+            // merge with the physically next block
+            const size_type next = block+length;
+            if (next<granuleCount && isFree(next))
+            {
+                removeFreeBlock(next);
+                length += getLength(next);
+            }
+            // merge with the physically previous block
+            const size_type prev = prevPhysical[block];
+            if (prev!=invalid_address && isFree(prev))
+            {
+                removeFreeBlock(prev);
+                length += block-prev;
+                block = prev;
+            }
+
+            setBlock(block,length,true);
+            setPrevPhysical(block+length,block);
+            insertFreeBlock(block);
+        }
+
+        inline void             reset()
+        {
+            firstLevelBitmap = 0ull;
+            std::fill_n(secondLevelBitmaps,MaxFirstLevels,0u);
+            std::fill_n(freeListHeads,firstLevelCount<<SecondLevelLog2,invalid_address);
+            freeSize = 0u;
+            if (!granuleCount)
+                return;
+
+            setBlock(0u,granuleCount,true);
+            prevPhysical[0u] = invalid_address;
+            setPrevPhysical(granuleCount,0u);
+            insertFreeBlock(0u);
+            freeSize = granuleCount<<granuleLog2;
+        }
+
+        //! Conservative estimate, max_size() gives largest size we are sure to be able to allocate
+        inline size_type        max_size() const noexcept
+        {
+            if (!firstLevelBitmap)
+                return 0u;
+
+            const uint32_t fl = core::findMSB(firstLevelBitmap);
+            const uint32_t sl = core::findMSB(secondLevelBitmaps[fl]);
+            // not accurate since there might be bigger blocks further in the bin, but the bins are narrow
+            const size_type block = freeListHeads[(fl<<SecondLevelLog2)+sl];
+            const size_type alignedStart = core::roundUp(block<<granuleLog2,Base::maxRequestableAlignment);
+            const size_type end = (block+getLength(block))<<granuleLog2;
+            return alignedStart<end ? (end-alignedStart):0u;
+        }
+
+        //! Most allocators do not support e.g. 1-byte allocations
+        inline size_type        min_size() const noexcept
+        {
+            return granuleSize();
+        }
+
+        inline size_type        safe_shrink_size(size_type sizeBound, size_type newBuffAlignmentWeCanGuarantee=1u) const noexcept
+        {
+            // unlike the other allocators this includes the alignment offset, so the result can go straight into the resizing constructor
+            size_type retval = get_total_size();
+            if (sizeBound>=retval)
+                return Base::safe_shrink_size(sizeBound,newBuffAlignmentWeCanGuarantee);
+
+            // only a free block at the very end can be cut off, and there is at most one thanks to the immediate coalescing
+            const size_type lastBlock = granuleCount ? prevPhysical[granuleCount]:invalid_address;
+            if (lastBlock!=invalid_address && isFree(lastBlock))
+                retval = (lastBlock<<granuleLog2)+Base::alignOffset;
+
+            return Base::safe_shrink_size(std::max(retval,sizeBound),newBuffAlignmentWeCanGuarantee);
+        }
+
+
+        static inline size_type reserved_size(size_type maxAlignment, size_type bufSz, size_type minBlockSz) noexcept
+        {
+            const size_type maxGranuleCount = bufSz>>calcGranuleLog2(minBlockSz);
+            // free list heads, block lengths, free list links and the previous physical block (with a sentinel past the end)
+            return ((size_type(calcFirstLevelCount(maxGranuleCount))<<SecondLevelLog2)+maxGranuleCount*size_type(4u)+1u)*sizeof(size_type);
+        }
+        static inline size_type reserved_size(const TLSFAddressAllocator<_size_type>& other, size_type bufSz) noexcept
+        {
+            return reserved_size(other.maxRequestableAlignment,bufSz,other.granuleSize());
+        }
+
+        inline size_type        get_free_size() const noexcept
+        {
+            return freeSize;
+        }
+        inline size_type        get_allocated_size() const noexcept
+        {
+            return (granuleCount<<granuleLog2)-freeSize;
+        }
+        inline size_type        get_total_size() const noexcept
+        {
+            return (granuleCount<<granuleLog2)+Base::alignOffset;
+        }
+
+    protected:
+        _NBL_STATIC_INLINE_CONSTEXPR uint32_t SecondLevelLog2 = 5u;
+        _NBL_STATIC_INLINE_CONSTEXPR uint32_t SecondLevelCount = 0x1u<<SecondLevelLog2;
+        _NBL_STATIC_INLINE_CONSTEXPR uint32_t MaxFirstLevels = sizeof(size_type)*8u;
+        // lowest bit of a block length says whether the block is free
+        _NBL_STATIC_INLINE_CONSTEXPR size_type FreeFlag = 0x1u;
+
+        static inline uint32_t  calcGranuleLog2(size_type minBlockSz) noexcept
+        {
+            return core::findMSB(core::roundUpToPoT(std::max(minBlockSz,size_type(1u))));
+        }
+        //! bin 0 holds the lengths below SecondLevelCount, every other bin a power of two range
+        static inline uint32_t  calcFirstLevelCount(size_type maxLength) noexcept
+        {
+            if (maxLength<SecondLevelCount)
+                return 1u;
+            return core::findMSB(maxLength)-SecondLevelLog2+2u;
+        }
+        static inline void      mapping(size_type length, uint32_t& fl, uint32_t& sl) noexcept
+        {
+            if (length<SecondLevelCount)
+            {
+                fl = 0u;
+                sl = length;
+                return;
+            }
+            const uint32_t msb = core::findMSB(length);
+            fl = msb-SecondLevelLog2+1u;
+            sl = (length>>(msb-SecondLevelLog2))^SecondLevelCount;
+        }
+        static inline size_type roundUpToSecondLevel(size_type length) noexcept
+        {
+            if (length<SecondLevelCount)
+                return length;
+            return length+(size_type(0x1u)<<(core::findMSB(length)-SecondLevelLog2))-1u;
+        }
+
+        inline size_type        granuleSize() const noexcept {return size_type(0x1u)<<granuleLog2;}
+        inline size_type        toGranules(size_type bytes) const noexcept {return (bytes+granuleSize()-1u)>>granuleLog2;}
+
+        inline size_type        getLength(size_type block) const noexcept {return blockLengths[block]>>1u;}
+        inline bool             isFree(size_type block) const noexcept {return blockLengths[block]&FreeFlag;}
+        inline void             setBlock(size_type block, size_type length, bool free) noexcept
+        {
+            blockLengths[block] = (length<<1u)|(free ? FreeFlag:size_type(0u));
+        }
+        //! `block` may be one past the last block, that slot keeps track of which block is the last one
+        inline void             setPrevPhysical(size_type block, size_type prev) noexcept
+        {
+            prevPhysical[block] = prev;
+        }
+
+        inline size_type        findSuitableBlock(uint32_t fl, uint32_t sl) const noexcept
+        {
+            if (fl>=firstLevelCount)
+                return invalid_address;
+
+            uint32_t secondLevelMap = secondLevelBitmaps[fl]&(~0u<<sl);
+            if (!secondLevelMap)
+            {
+                const uint64_t firstLevelMap = fl+1u<64u ? (firstLevelBitmap&(~0ull<<(fl+1u))):0ull;
+                if (!firstLevelMap)
+                    return invalid_address;
+                fl = core::findLSB(firstLevelMap);
+                secondLevelMap = secondLevelBitmaps[fl];
+            }
+            sl = core::findLSB(secondLevelMap);
+            return freeListHeads[(fl<<SecondLevelLog2)+sl];
+        }
+        inline size_type        firstFittingBlockInBin(uint32_t fl, uint32_t sl, size_type length, size_type alignmentInGranules) const noexcept
+        {
+            if (fl>=firstLevelCount)
+                return invalid_address;
+
+            for (size_type block=freeListHeads[(fl<<SecondLevelLog2)+sl]; block!=invalid_address; block=nextFree[block])
+            if (core::roundUp(block,alignmentInGranules)+length<=block+getLength(block))
+                return block;
+            return invalid_address;
+        }
+
+        inline void             insertFreeBlock(size_type block) noexcept
+        {
+            uint32_t fl,sl;
+            mapping(getLength(block),fl,sl);
+            auto& head = freeListHeads[(fl<<SecondLevelLog2)+sl];
+            prevFree[block] = invalid_address;
+            nextFree[block] = head;
+            if (head!=invalid_address)
+                prevFree[head] = block;
+            head = block;
+            firstLevelBitmap |= 0x1ull<<fl;
+            secondLevelBitmaps[fl] |= 0x1u<<sl;
+        }
+        inline void             removeFreeBlock(size_type block) noexcept
+        {
+            const size_type prev = prevFree[block];
+            const size_type next = nextFree[block];
+            if (next!=invalid_address)
+                prevFree[next] = prev;
+            if (prev!=invalid_address)
+            {
+                nextFree[prev] = next;
+                return;
+            }
+
+            uint32_t fl,sl;
+            mapping(getLength(block),fl,sl);
+            freeListHeads[(fl<<SecondLevelLog2)+sl] = next;
+            if (next==invalid_address)
+            {
+                secondLevelBitmaps[fl] &= ~(0x1u<<sl);
+                if (!secondLevelBitmaps[fl])
+                    firstLevelBitmap &= ~(0x1ull<<fl);
+            }
+        }
+
+        inline void             setupPointers() noexcept
+        {
+            freeListHeads = reinterpret_cast<size_type*>(Base::reservedSpace);
+            blockLengths = freeListHeads+(size_type(firstLevelCount)<<SecondLevelLog2);
+            nextFree = blockLengths+granuleCount;
+            prevFree = nextFree+granuleCount;
+            prevPhysical = prevFree+granuleCount;
+        }
+
+        //! Walks the blocks of `other` in address order, the ones past the new end must be free (guaranteed by `safe_shrink_size`)
+        inline void             copyState(const TLSFAddressAllocator& other) noexcept
+        {
+            firstLevelBitmap = 0ull;
+            std::fill_n(secondLevelBitmaps,MaxFirstLevels,0u);
+            std::fill_n(freeListHeads,firstLevelCount<<SecondLevelLog2,invalid_address);
+
+            size_type block = 0u;
+            size_type prev = invalid_address;
+            for (; block<other.granuleCount && block<granuleCount; block+=getLength(block))
+            {
+                const bool free = other.isFree(block);
+                size_type length = other.getLength(block);
+                if (block+length>granuleCount)
+                {
+                    #ifdef _NBL_DEBUG
+                        assert(free);
+                    #endif // _NBL_DEBUG
+                    length = granuleCount-block;
+                }
+                setBlock(block,length,free);
+                prevPhysical[block] = prev;
+                prev = block;
+            }
+            // grown, extend the last block if free or append a new one
+            if (block<granuleCount)
+            {
+                if (prev!=invalid_address && isFree(prev))
+                    setBlock(prev,granuleCount-prev,true);
+                else
+                {
+                    setBlock(block,granuleCount-block,true);
+                    prevPhysical[block] = prev;
+                    prev = block;
+                }
+            }
+            if (granuleCount)
+                setPrevPhysical(granuleCount,prev);
+
+            freeSize = 0u;
+            for (block=0u; block<granuleCount; block+=getLength(block))
+            if (isFree(block))
+            {
+                insertFreeBlock(block);
+                freeSize += getLength(block)<<granuleLog2;
+            }
+        }
+
+        inline void             invalidate() noexcept
+        {
+            granuleCount = 0u;
+            firstLevelCount = 0u;
+            freeSize = 0u;
+            firstLevelBitmap = 0ull;
+        }
+
+        uint32_t    granuleLog2;
+        size_type   granuleCount;
+        uint32_t    firstLevelCount;
+        size_type   freeSize;
+
+        uint64_t    firstLevelBitmap = 0ull;
+        uint32_t    secondLevelBitmaps[MaxFirstLevels] = {};
+
+        // all in the reserved space
+        size_type*  freeListHeads = nullptr;
+        size_type*  blockLengths = nullptr;
+        size_type*  nextFree = nullptr;
+        size_type*  prevFree = nullptr;
+        size_type*  prevPhysical = nullptr;
+};
+
+
+}
+}
+
+#include "nbl/core/alloc/AddressAllocatorConcurrencyAdaptors.h"
+
+namespace nbl
+{
+namespace core
+{
+
+// aliases
+template<typename size_type>
+using TLSFAddressAllocatorST = TLSFAddressAllocator<size_type>;
+
+template<typename size_type, class RecursiveLockable>
+using TLSFAddressAllocatorMT = AddressAllocatorBasicConcurrencyAdaptor<TLSFAddressAllocator<size_type>,RecursiveLockable>;
+
+template<typename size_type, class RecursiveLockable>
+using TLSFAddressAllocatorTC = AddressAllocatorThreadCachingAdaptor<TLSFAddressAllocator<size_type>,RecursiveLockable>;
+
+}
+}
+
+#endif
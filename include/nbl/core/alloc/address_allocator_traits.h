@@ -127,6 +127,7 @@ namespace core
             template<class U> using cstexpr_supportsArbitraryOrderFrees = decltype(std::declval<U&>().supportsArbitraryOrderFrees);
             template<class U> using cstexpr_maxMultiOps                 = decltype(std::declval<U&>().maxMultiOps);
             template<class U> using cstexpr_supportsNullBuffer          = decltype(std::declval<U&>().supportsNullBuffer);
+            template<class U> using cstexpr_allocatesFixedSize          = decltype(std::declval<U&>().allocatesFixedSize);
 
             template<class U> using func_multi_alloc_addr               = decltype(std::declval<U&>().multi_alloc_addr(0u,nullptr,nullptr,nullptr,nullptr));
             template<class U> using func_multi_free_addr                = decltype(std::declval<U&>().multi_free_addr(0u,nullptr,nullptr));
@@ -137,6 +138,7 @@ namespace core
             template<class,class=void> struct resolve_supportsArbitraryOrderFrees  : std::true_type {};
             template<class,class=void> struct resolve_maxMultiOps                           : std::integral_constant<uint32_t,256u> {};
             template<class,class=void> struct resolve_supportsNullBuffer                  : std::true_type {};
+            template<class,class=void> struct resolve_allocatesFixedSize                  : std::false_type {};
 
             template<class,class=void> struct has_func_multi_alloc_addr                : std::false_type {};
             template<class,class=void> struct has_func_multi_free_addr                 : std::false_type {};
@@ -150,6 +152,8 @@ namespace core
                                                                             : std::conditional<std::true_type/*std::is_integral<cstexpr_maxMultiOps<U> >*/::value,std::integral_constant<uint32_t,U::maxMultiOps>, resolve_maxMultiOps<void, void> >::type {};
             template<class U> struct resolve_supportsNullBuffer<U,std::void_t<cstexpr_supportsNullBuffer<U> > >
                                                                             : std::conditional<std::true_type/*std::is_same<cstexpr_supportsNullBuffer<U>,bool>*/::value,nbl::bool_constant<U::supportsNullBuffer>,resolve_supportsNullBuffer<void,void> >::type {};
+            template<class U> struct resolve_allocatesFixedSize<U,std::void_t<cstexpr_allocatesFixedSize<U> > >
+                                                                            : nbl::bool_constant<U::allocatesFixedSize> {};
 
             template<class U> struct has_func_multi_alloc_addr<U,std::void_t<func_multi_alloc_addr<U> > >
                                                                             : std::is_same<func_multi_alloc_addr<U>,void> {};
@@ -161,6 +165,8 @@ namespace core
             _NBL_STATIC_INLINE_CONSTEXPR bool         supportsArbitraryOrderFrees = resolve_supportsArbitraryOrderFrees<AddressAlloc>::value;
             _NBL_STATIC_INLINE_CONSTEXPR uint32_t     maxMultiOps                 = resolve_maxMultiOps<AddressAlloc>::value;
             _NBL_STATIC_INLINE_CONSTEXPR bool         supportsNullBuffer          = resolve_supportsNullBuffer<AddressAlloc>::value;
+            //! Every allocation takes `min_size()` bytes no matter what was asked for (like a pool)
+            _NBL_STATIC_INLINE_CONSTEXPR bool         allocatesFixedSize          = resolve_allocatesFixedSize<AddressAlloc>::value;
 
             static inline void          printDebugInfo()
             {
@@ -171,6 +177,7 @@ namespace core
                 printf("supportsArbitraryOrderFrees == %d\n", supportsArbitraryOrderFrees);
                 printf("maxMultiOps == %d\n",                           maxMultiOps);
                 printf("supportsNullBuffer == %d\n",                 supportsNullBuffer);
+                printf("allocatesFixedSize == %d\n",                 allocatesFixedSize);
             }
 
 
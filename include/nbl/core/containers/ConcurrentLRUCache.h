@@ -0,0 +1,268 @@
+// Copyright (C) 2018-2020 - DevSH Graphics Programming Sp. z O.O.
+// This file is part of the "Nabla Engine".
+// For conditions of distribution and use, see copyright notice in nabla.h
+
+#ifndef __NBL_CORE_CONCURRENT_LRU_CACHE_H_INCLUDED__
+#define __NBL_CORE_CONCURRENT_LRU_CACHE_H_INCLUDED__
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+#include "nbl/core/containers/FixedCapacityDoublyLinkedList.h"
+
+namespace nbl
+{
+namespace core
+{
+
+namespace impl
+{
+	// `std::hash<std::string_view>` gives the same values as `std::hash<std::string>`, so string keys can be looked up without constructing a string
+	template<typename Key>
+	struct ConcurrentLRUCacheHash : std::hash<Key> {};
+	template<>
+	struct ConcurrentLRUCacheHash<std::string> : std::hash<std::string_view> {};
+}
+
+// Key-Value Least Recently Used cache which many threads can use at once
+// Keys are spread over shards by their hash, each shard is a small LRU cache with its own lock and an equal share of the capacity,
+// so the eviction order is only approximately least recently used across the whole cache.
+// Lookups do not go through a mutable member like `LRUCache` does and take any key type `MapHash` and `MapEquals` accept,
+// e.g. `std::string_view` or `const char*` for `std::string` keys.
+// Values are returned by copy because another thread may evict the entry the moment the shard lock is released, cache `smart_refctd_ptr`s for anything big.
+template<typename Key, typename Value, typename MapHash=impl::ConcurrentLRUCacheHash<Key>, typename MapEquals=std::equal_to<>, class Lockable=std::mutex>
+class ConcurrentLRUCache
+{
+	public:
+		// Called outside of any lock with the entry evicted to make space for an insert. Entries removed by `erase`, `clear` or overwritten by `insert` don't trigger it
+		using eviction_callback_t = std::function<void(Key&&,Value&&)>;
+
+	private:
+		struct SEntry
+		{
+			Key key;
+			Value value;
+			std::size_t hash; // so rehashing the shortcut map does not need to hash the keys again
+		};
+		using list_t = FixedCapacityDoublyLinkedList<SEntry>;
+		_NBL_STATIC_INLINE_CONSTEXPR uint32_t invalid_iterator = list_t::invalid_iterator;
+
+		// wraps the searched key, so it can't be confused with the node addresses stored in the shortcut map
+		template<typename K>
+		struct SLookup
+		{
+			const K& key;
+			std::size_t hash;
+		};
+
+		// wrappers
+		struct WrapHash
+		{
+			using is_transparent = void;
+
+			const list_t* list;
+
+			inline std::size_t operator()(const uint32_t nodeAddr) const
+			{
+				return list->get(nodeAddr)->data.hash;
+			}
+			template<typename K>
+			inline std::size_t operator()(const SLookup<K>& lookup) const
+			{
+				return lookup.hash;
+			}
+		};
+		struct WrapEquals
+		{
+			using is_transparent = void;
+
+			const list_t* list;
+			const MapEquals* equals;
+
+			// keys in the cache are unique, so are their nodes
+			inline bool operator()(const uint32_t lhs, const uint32_t rhs) const
+			{
+				return lhs==rhs;
+			}
+			template<typename K>
+			inline bool operator()(const uint32_t nodeAddr, const SLookup<K>& lookup) const
+			{
+				return (*equals)(list->get(nodeAddr)->data.key,lookup.key);
+			}
+			template<typename K>
+			inline bool operator()(const SLookup<K>& lookup, const uint32_t nodeAddr) const
+			{
+				return operator()(nodeAddr,lookup);
+			}
+		};
+		using shortcut_map_t = unordered_set<uint32_t,WrapHash,WrapEquals>;
+
+		// separate cache lines, so threads working on neighbouring shards don't contend on the locks
+		struct alignas(64) SShard
+		{
+			SShard(const uint32_t capacity, const MapEquals* equals) :
+				list(capacity), map(capacity>>2,WrapHash{&list},WrapEquals{&list,equals}) // 4x less buckets than capacity seems reasonable
+			{
+				map.reserve(capacity);
+			}
+
+			mutable Lockable lock;
+			list_t list;
+			shortcut_map_t map;
+		};
+
+		// members
+		MapHash m_hash;
+		MapEquals m_equals;
+		eviction_callback_t m_evictionCallback;
+		vector<std::unique_ptr<SShard>> m_shards;
+		uint32_t m_shardMask;
+		uint32_t m_capacity;
+
+		inline SShard& getShard(const std::size_t hash) const
+		{
+			// the shortcut maps use the low bits of the same hash, take the shard from well mixed high bits
+			return *m_shards[static_cast<uint32_t>((static_cast<uint64_t>(hash)*0x9E3779B97F4A7C15ull)>>32ull)&m_shardMask];
+		}
+
+		template<typename K>
+		inline typename shortcut_map_t::const_iterator common_find(const SShard& shard, const K& key, const std::size_t hash) const
+		{
+			return shard.map.find(SLookup<K>{key,hash});
+		}
+
+	public:
+		//Constructor, `shardCount` gets rounded up to a power of two and every shard gets `capacity/shardCount` (rounded up) entries
+		inline ConcurrentLRUCache(const uint32_t capacity, const uint32_t shardCount=16u, eviction_callback_t&& _evictionCallback=eviction_callback_t(), MapHash&& _hash=MapHash(), MapEquals&& _equals=MapEquals()) :
+			m_hash(std::move(_hash)), m_equals(std::move(_equals)), m_evictionCallback(std::move(_evictionCallback)),
+			m_shardMask(core::roundUpToPoT(core::max(shardCount,1u))-1u), m_capacity(0u)
+		{
+			const uint32_t shardCapacity = (capacity+m_shardMask)/(m_shardMask+1u);
+			assert(shardCapacity>1u);
+			m_shards.reserve(m_shardMask+1u);
+			for (uint32_t i=0u; i<=m_shardMask; i++)
+				m_shards.emplace_back(new SShard(shardCapacity,&m_equals));
+			m_capacity = shardCapacity*(m_shardMask+1u);
+		}
+
+		inline uint32_t getCapacity() const { return m_capacity; }
+
+		inline uint32_t getShardCount() const { return m_shardMask+1u; }
+
+		// number of entries at the time each shard got visited, only exact if no other thread modifies the cache
+		inline uint32_t getSize() const
+		{
+			uint32_t size = 0u;
+			for (const auto& shard : m_shards)
+			{
+				std::unique_lock<Lockable> lock(shard->lock);
+				size += shard->map.size();
+			}
+			return size;
+		}
+
+		//insert an element into the cache, or update an existing one with the same key, `K` needs to be convertible to `Key`
+		template<typename K, typename V>
+		inline void insert(K&& k, V&& v)
+		{
+			const std::size_t hash = m_hash(k);
+			SShard& shard = getShard(hash);
+			std::unique_lock<Lockable> lock(shard.lock);
+
+			auto found = common_find(shard,k,hash);
+			if (found!=shard.map.end())
+			{
+				const auto nodeAddr = *found;
+				shard.list.get(nodeAddr)->data.value = std::forward<V>(v);
+				shard.list.moveToFront(nodeAddr);
+				return;
+			}
+
+			const bool overflow = shard.map.size()>=shard.list.getCapacity();
+			if (!overflow)
+			{
+				shard.list.pushFront(SEntry{Key(std::forward<K>(k)),Value(std::forward<V>(v)),hash});
+				shard.map.insert(shard.list.getFirstAddress());
+				return;
+			}
+
+			const auto evictedAddr = shard.list.getLastAddress();
+			shard.map.erase(evictedAddr);
+			SEntry evicted(std::move(shard.list.get(evictedAddr)->data));
+			shard.list.popBack();
+			shard.list.pushFront(SEntry{Key(std::forward<K>(k)),Value(std::forward<V>(v)),hash});
+			shard.map.insert(shard.list.getFirstAddress());
+			lock.unlock();
+
+			if (m_evictionCallback)
+				m_evictionCallback(std::move(evicted.key),std::move(evicted.value));
+		}
+
+		//copy the value associated with the key to `outValue`, returns false if key is not contained within cache. Marks the value as most recently used
+		template<typename K>
+		inline bool get(const K& key, Value& outValue)
+		{
+			const std::size_t hash = m_hash(key);
+			SShard& shard = getShard(hash);
+			std::unique_lock<Lockable> lock(shard.lock);
+
+			auto found = common_find(shard,key,hash);
+			if (found==shard.map.end())
+				return false;
+			shard.list.moveToFront(*found);
+			outValue = shard.list.get(*found)->data.value;
+			return true;
+		}
+
+		//copy the value associated with the key to `outValue`, returns false if key is not contained within cache. Does not alter the value use order
+		template<typename K>
+		inline bool peek(const K& key, Value& outValue) const
+		{
+			const std::size_t hash = m_hash(key);
+			const SShard& shard = getShard(hash);
+			std::unique_lock<Lockable> lock(shard.lock);
+
+			auto found = common_find(shard,key,hash);
+			if (found==shard.map.end())
+				return false;
+			outValue = shard.list.get(*found)->data.value;
+			return true;
+		}
+
+		//remove element at key if present, returns whether it was
+		template<typename K>
+		inline bool erase(const K& key)
+		{
+			const std::size_t hash = m_hash(key);
+			SShard& shard = getShard(hash);
+			std::unique_lock<Lockable> lock(shard.lock);
+
+			auto found = common_find(shard,key,hash);
+			if (found==shard.map.end())
+				return false;
+			const auto nodeAddr = *found;
+			shard.map.erase(found);
+			shard.list.erase(nodeAddr);
+			return true;
+		}
+
+		//remove all elements, shard by shard
+		inline void clear()
+		{
+			for (auto& shard : m_shards)
+			{
+				std::unique_lock<Lockable> lock(shard->lock);
+				shard->map.clear();
+				while (shard->list.getLastAddress()!=invalid_iterator)
+					shard->list.popBack();
+			}
+		}
+};
+
+
+}	//namespace core
+}		//namespace nbl
+#endif
@@ -14,6 +14,9 @@ namespace nbl
 namespace core
 {
 
+template<typename Value>
+class FixedCapacityDoublyLinkedList;
+
 //Struct for use in a doubly linked list. Stores data and pointers to next and previous elements the list, or invalid iterator if it is first/last
 template<typename Value>
 struct alignas(void*) SDoublyLinkedNode
@@ -102,11 +105,8 @@ class FixedCapacityDoublyLinkedList : private impl::FixedCapacityDoublyLinkedLis
 			if (m_back == invalid_iterator)
 				return;
 
-			auto backNode = getBack();
-			if (backNode->prev != invalid_iterator)
-				get(backNode->prev)->next = invalid_iterator;
 			uint32_t temp = m_back;
-			m_back = backNode->prev;
+			common_detach(getBack());
 			common_delete(temp);
 		}
 
@@ -206,12 +206,17 @@ class FixedCapacityDoublyLinkedList : private impl::FixedCapacityDoublyLinkedLis
 			alloc.free_addr(address, 1u);
 		}
 
+		//unlink a node from its neighbours, or from the ends of the list if it was the first/last
 		inline void common_detach(node_t* node)
 		{
 			if (node->next != invalid_iterator)
 				get(node->next)->prev = node->prev;
+			else
+				m_back = node->prev;
 			if (node->prev != invalid_iterator)
 				get(node->prev)->next = node->next;
+			else
+				m_begin = node->next;
 		}
 };
 
@@ -5,6 +5,8 @@
 #ifndef __NBL_CORE_LRU_CACHE_H_INCLUDED__
 #define __NBL_CORE_LRU_CACHE_H_INCLUDED__
 
+#include <functional>
+
 #include "nbl/core/containers/FixedCapacityDoublyLinkedList.h"
 
 namespace nbl
@@ -57,9 +59,28 @@ template<typename Key, typename Value, typename MapHash=std::hash<Key>, typename
 class LRUCache : private impl::LRUCacheBase<Key,Value,MapHash,MapEquals>
 {
 		// typedefs
-		typedef LRUCacheBase<Key,Value,MapHash,MapEquals> base_t;
+		typedef impl::LRUCacheBase<Key,Value,MapHash,MapEquals> base_t;
 		typedef LRUCache<Key,Value,MapHash,MapEquals> this_t;
 
+		using base_t::m_list;
+		using base_t::searchedKey;
+		using base_t::invalid_iterator;
+
+	public:
+		// Called with the entry evicted to make space (count or cost-wise), so its value can be recycled. Entries removed by `erase` or overwritten by `insert` don't trigger it
+		using eviction_callback_t = std::function<void(Key&&,Value&&)>;
+		_NBL_STATIC_INLINE_CONSTEXPR size_t no_cost_budget = ~size_t(0u);
+
+		// for tuning the capacity and budget
+		struct SStatistics
+		{
+			uint64_t hits = 0u;
+			uint64_t misses = 0u;
+			uint64_t evictions = 0u;
+		};
+
+	private:
+
 		// wrappers
 		struct WrapHash
 		{
@@ -82,6 +103,12 @@ class LRUCache : private impl::LRUCacheBase<Key,Value,MapHash,MapEquals>
 
 		// members
 		unordered_set<uint32_t,WrapHash,WrapEquals> m_shortcut_map;
+		eviction_callback_t m_evictionCallback;
+		core::vector<size_t> m_costs; // indexed by node address, empty when there is no cost budget
+		size_t m_costBudget;
+		size_t m_totalCost;
+		mutable SStatistics m_statistics;
+
 		using shortcut_iterator_t = typename unordered_set<uint32_t,WrapHash,WrapEquals>::const_iterator;
 		inline shortcut_iterator_t common_find(const Key& key) const
 		{
@@ -100,41 +127,95 @@ class LRUCache : private impl::LRUCacheBase<Key,Value,MapHash,MapEquals>
 		{
 			bool success;
 			shortcut_iterator_t iterator = common_find(key,success);
-			return success ? (*iterator):invalid_iterator;
+			if (!success)
+			{
+				m_statistics.misses++;
+				return invalid_iterator;
+			}
+			m_statistics.hits++;
+			return *iterator;
+		}
+
+		inline void common_set_cost(const uint32_t nodeAddr, const size_t cost)
+		{
+			if (m_costs.empty())
+				return;
+			m_totalCost += cost-m_costs[nodeAddr];
+			m_costs[nodeAddr] = cost;
+		}
+
+		inline void common_evict_back()
+		{
+			const auto nodeAddr = m_list.getLastAddress();
+			common_set_cost(nodeAddr,0u);
+			m_shortcut_map.erase(nodeAddr);
+			if (m_evictionCallback)
+			{
+				auto& data = m_list.get(nodeAddr)->data;
+				m_evictionCallback(std::move(data.first),std::move(data.second));
+			}
+			m_list.popBack();
+			m_statistics.evictions++;
 		}
 
 		template<typename K,typename V>
-		inline void common_insert(K&& k, V&& v)
+		inline void common_insert(K&& k, V&& v, const size_t cost)
 		{
 			bool success;
 			shortcut_iterator_t iterator = common_find(k,success);
+			// an entry which can never fit must not flush the whole cache, the callback gets it straight back and the stale entry under the same key goes away
+			if (!m_costs.empty() && cost>m_costBudget)
+			{
+				if (success)
+				{
+					const auto nodeAddr = *iterator;
+					common_set_cost(nodeAddr,0u);
+					m_shortcut_map.erase(iterator);
+					m_list.erase(nodeAddr);
+				}
+				if (m_evictionCallback)
+					m_evictionCallback(Key(std::forward<K>(k)),Value(std::forward<V>(v)));
+				m_statistics.evictions++;
+				return;
+			}
+
 			if (success)
 			{
 				const auto nodeAddr = *iterator;
 				m_list.get(nodeAddr)->data.second = std::forward<V>(v);
 				m_list.moveToFront(nodeAddr);
+				common_set_cost(nodeAddr,cost);
 			}
 			else
 			{
 				const bool overflow = m_shortcut_map.size()>=m_list.getCapacity();
 				if (overflow)
-				{
-					m_shortcut_map.erase(m_list.getLastAddress());
-					m_list.popBack();
-				}
+					common_evict_back();
 				m_list.pushFront(std::make_pair(std::forward<K>(k),std::forward<V>(v)));
 				m_shortcut_map.insert(m_list.getFirstAddress());
+				common_set_cost(m_list.getFirstAddress(),cost);
 			}
+			while (m_totalCost>m_costBudget)
+				common_evict_back();
 		}
 
 	public:
 		//Constructor
 		inline LRUCache(const uint32_t capacity, MapHash&& _hash=MapHash(), MapEquals&& _equals=MapEquals()) :
+			LRUCache(capacity,no_cost_budget,eviction_callback_t(),std::move(_hash),std::move(_equals))
+		{
+		}
+		//Constructor for the cost-aware mode, every `insert` says how much of `costBudget` (i.e. bytes) the value takes up and least recently used entries get evicted until the total fits,
+		//`capacity` still bounds the entry count. Pass `no_cost_budget` to only get the eviction callback
+		inline LRUCache(const uint32_t capacity, const size_t costBudget, eviction_callback_t&& _evictionCallback, MapHash&& _hash=MapHash(), MapEquals&& _equals=MapEquals()) :
 			base_t(capacity,std::move(_hash),std::move(_equals)),
-			m_shortcut_map(capacity>>2,WrapHash{this},WrapEquals{this}) // 4x less buckets than capacity seems reasonable
+			m_shortcut_map(capacity>>2,WrapHash{this},WrapEquals{this}), // 4x less buckets than capacity seems reasonable
+			m_evictionCallback(std::move(_evictionCallback)), m_costBudget(costBudget), m_totalCost(0u)
 		{
 			assert(capacity > 1);
 			m_shortcut_map.reserve(capacity);
+			if (m_costBudget!=no_cost_budget)
+				m_costs.resize(capacity,0u);
 		}
 
 	#ifdef _NBL_DEBUG
@@ -151,11 +232,11 @@ class LRUCache : private impl::LRUCacheBase<Key,Value,MapHash,MapEquals>
 		}
 	#endif // _NBL_DEBUG
 
-		//insert an element into the cache, or update an existing one with the same key
-		inline void insert(Key&& k, Value&& v) { common_insert(std::move(k), std::move(v)); }
-		inline void insert(Key&& k, const Value& v) { common_insert(std::move(k), v); }
-		inline void insert(const Key& k, Value&& v) { common_insert(k, std::move(v)); }
-		inline void insert(const Key& k, const Value& v) { common_insert(k, v); }
+		//insert an element into the cache, or update an existing one with the same key. `cost` only matters if the cache was constructed with a cost budget
+		inline void insert(Key&& k, Value&& v, const size_t cost=1u) { common_insert(std::move(k), std::move(v), cost); }
+		inline void insert(Key&& k, const Value& v, const size_t cost=1u) { common_insert(std::move(k), v, cost); }
+		inline void insert(const Key& k, Value&& v, const size_t cost=1u) { common_insert(k, std::move(v), cost); }
+		inline void insert(const Key& k, const Value& v, const size_t cost=1u) { common_insert(k, v, cost); }
 
 		//get the value from cache at an associated Key, or nullptr if Key is not contained within cache. Marks the returned value as most recently used
 		inline Value* get(const Key& key)
@@ -195,10 +276,21 @@ class LRUCache : private impl::LRUCacheBase<Key,Value,MapHash,MapEquals>
 			shortcut_iterator_t iterator = common_find(key,success);
 			if (success)
 			{
-				m_list.erase(*iterator);
+				const auto nodeAddr = *iterator;
+				common_set_cost(nodeAddr,0u);
 				m_shortcut_map.erase(iterator);
+				m_list.erase(nodeAddr);
 			}
 		}
+
+		inline size_t getCostBudget() const { return m_costBudget; }
+
+		//sum of the costs of all entries, always 0 without a cost budget
+		inline size_t getTotalCost() const { return m_totalCost; }
+
+		//lookups through `get` and `peek` count as hits or misses
+		inline const SStatistics& getStatistics() const { return m_statistics; }
+		inline void resetStatistics() { m_statistics = SStatistics(); }
 };
 
 
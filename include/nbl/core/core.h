@@ -28,12 +28,15 @@
 #include "nbl/core/alloc/PoolAddressAllocator.h"
 #include "nbl/core/alloc/ResizableHeterogenousMemoryAllocator.h"
 #include "nbl/core/alloc/StackAddressAllocator.h"
+#include "nbl/core/alloc/TLSFAddressAllocator.h"
 #include "nbl/core/alloc/SimpleBlockBasedAllocator.h"
+#include "nbl/core/alloc/MonotonicArena.h"
 // containers
 #include "nbl/core/containers/dynamic_array.h"
 #include "nbl/core/containers/refctd_dynamic_array.h"
 #include "nbl/core/containers/FixedCapacityDoublyLinkedList.h"
 #include "nbl/core/containers/LRUCache.h"
+#include "nbl/core/containers/ConcurrentLRUCache.h"
 // math
 #include "nbl/core/math/intutil.h"
 #include "nbl/core/math/floatutil.tcc"
@@ -43,6 +46,7 @@
 #include "nbl/core/math/plane3dSIMD.h"
 // memory
 #include "nbl/core/memory/memory.h"
+#include "nbl/core/memory/CMemoryStatistics.h"
 #include "nbl/core/memory/new_delete.h"
 #include "nbl/core/memory/CLeakDebugger.h"
 // samplers
@@ -50,6 +54,8 @@
 #include "nbl/core/sampling/SobolSampler.h"
 #include "nbl/core/sampling/OwenSampler.h"
 // parallel
+#include "nbl/core/parallel/CWorkStealingDeque.h"
+#include "nbl/core/parallel/CWorkStealingScheduler.h"
 #include "nbl/core/parallel/IThreadBound.h"
 #include "nbl/core/parallel/unlock_guard.h"
 // string
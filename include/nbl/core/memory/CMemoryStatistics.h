@@ -0,0 +1,339 @@
+// Copyright (C) 2018-2020 - DevSH Graphics Programming Sp. z O.O.
+// This file is part of the "Nabla Engine".
+// For conditions of distribution and use, see copyright notice in nabla.h
+
+#ifndef __NBL_CORE_C_MEMORY_STATISTICS_H_INCLUDED__
+#define __NBL_CORE_C_MEMORY_STATISTICS_H_INCLUDED__
+
+#include "nbl/core/memory/memory.h"
+
+#include <array>
+#include <cstdint>
+
+#ifdef _NBL_MEMORY_STATISTICS_
+#include <atomic>
+#include <mutex>
+#include <utility>
+#include <vector>
+#endif
+
+namespace nbl
+{
+namespace core
+{
+
+//! What the allocations made through `_NBL_ALIGNED_MALLOC`, `core::allocator` and `core::aligned_allocator` get attributed to
+enum E_MEMORY_SUBSYSTEM : uint8_t
+{
+    EMS_UNTAGGED = 0u,
+    EMS_ASSET_MANAGER,
+    EMS_ASSET_LOADERS,
+    EMS_ASSET_WRITERS,
+    EMS_IMAGE_FILTERS,
+    EMS_SHADER_COMPILER,
+    EMS_PROPERTY_POOLS,
+    EMS_APPLICATION,
+    EMS_COUNT
+};
+
+//! Live bytes, live allocations and high-water marks per subsystem, compiled in with the `NBL_MEMORY_STATISTICS` CMake option.
+/** Unlike CLeakDebugger this is cheap enough to leave on in release builds and feed a metrics system.
+Every thread counts into its own block of relaxed atomics which only it writes to, the blocks get summed up when a snapshot is taken.
+Every allocation carries a 16 byte header (or `alignment` bytes if that's larger) with its size and subsystem,
+so a free on another thread or under another subsystem's scope takes back exactly what the allocation added.
+Memory is attributed to the innermost `CSubsystemScope` alive on the allocating thread, a loader's buffers stay with `EMS_ASSET_LOADERS` after they get cached.
+With the option off the scopes are empty, nothing gets a header and `getSnapshot` returns zeros. */
+class CMemoryStatistics
+{
+    public:
+        struct SSnapshot
+        {
+            struct SSubsystem
+            {
+                int64_t liveBytes = 0;
+                int64_t liveAllocations = 0;
+                //! allocations made over the lifetime of the process
+                uint64_t allocations = 0u;
+                //! high-water mark of `liveBytes`, see `PeakGranularity`
+                int64_t peakBytes = 0;
+            };
+            std::array<SSubsystem,EMS_COUNT> subsystems = {};
+            int64_t liveBytes = 0;
+            int64_t peakBytes = 0;
+        };
+
+        //! Threads only publish their live byte counts for the high-water marks every time they change by this much, so the marks can be under by `PeakGranularity` times the thread count
+        _NBL_STATIC_INLINE_CONSTEXPR int64_t PeakGranularity = 64ll<<10ll;
+
+        //! Attributes the allocations the current thread makes to a subsystem until it goes out of scope, scopes nest
+        class CSubsystemScope
+        {
+            public:
+#ifdef _NBL_MEMORY_STATISTICS_
+                inline CSubsystemScope(const E_MEMORY_SUBSYSTEM subsystem) : m_previous(t_subsystem)
+                {
+                    t_subsystem = subsystem;
+                }
+                inline ~CSubsystemScope()
+                {
+                    t_subsystem = m_previous;
+                }
+#else
+                inline CSubsystemScope(const E_MEMORY_SUBSYSTEM subsystem) {}
+#endif
+                CSubsystemScope(const CSubsystemScope&) = delete;
+                CSubsystemScope& operator=(const CSubsystemScope&) = delete;
+
+#ifdef _NBL_MEMORY_STATISTICS_
+            private:
+                uint8_t m_previous;
+#endif
+        };
+
+        static inline constexpr bool isEnabled()
+        {
+#ifdef _NBL_MEMORY_STATISTICS_
+            return true;
+#else
+            return false;
+#endif
+        }
+
+        static inline const char* getSubsystemName(const E_MEMORY_SUBSYSTEM subsystem)
+        {
+            constexpr const char* names[EMS_COUNT] = {"untagged","asset manager","asset loaders","asset writers","image filters","shader compiler","property pools","application"};
+            return subsystem<EMS_COUNT ? names[subsystem]:"invalid";
+        }
+
+#ifdef _NBL_MEMORY_STATISTICS_
+        //! What `_NBL_ALIGNED_MALLOC` and `_NBL_ALIGNED_FREE` expand to
+        static inline void* trackedMalloc(const size_t size, const size_t alignment) noexcept
+        {
+            if (size==0ull)
+                return nullptr;
+
+            const size_t underlyingAlignment = alignment>alignof(SAllocationHeader) ? alignment:alignof(SAllocationHeader);
+            const size_t offset = core::alignUp(sizeof(SAllocationHeader),underlyingAlignment);
+            uint8_t* const base = reinterpret_cast<uint8_t*>(_NBL_UNTRACKED_ALIGNED_MALLOC(size+offset,underlyingAlignment));
+            if (!base)
+                return nullptr;
+
+            const auto subsystem = t_subsystem;
+            uint8_t* const retval = base+offset;
+            reinterpret_cast<SAllocationHeader*>(retval)[-1] = {size,static_cast<uint32_t>(offset),subsystem};
+            count(subsystem,static_cast<int64_t>(size),1);
+            return retval;
+        }
+        static inline void trackedFree(void* addr) noexcept
+        {
+            if (!addr)
+                return;
+
+            const SAllocationHeader header = reinterpret_cast<const SAllocationHeader*>(addr)[-1];
+            count(header.subsystem,-static_cast<int64_t>(header.size),-1);
+            _NBL_UNTRACKED_ALIGNED_FREE(reinterpret_cast<uint8_t*>(addr)-header.offset);
+        }
+
+        //! Sums up the counters of all threads, each is read atomically but the threads keep going, so the sums are only exact when nobody allocates at the same time
+        static inline SSnapshot getSnapshot()
+        {
+            SSnapshot retval;
+
+            auto& state = getGlobalState();
+            std::unique_lock<std::mutex> lock(state.lock);
+            auto accumulate = [&retval](const SThreadCounters& counters) -> void
+            {
+                for (uint32_t i=0u; i<EMS_COUNT; i++)
+                {
+                    const auto& in = counters.perSubsystem[i];
+                    auto& out = retval.subsystems[i];
+                    out.liveBytes += in.liveBytes.load(std::memory_order_relaxed);
+                    out.liveAllocations += in.liveAllocations.load(std::memory_order_relaxed);
+                    out.allocations += in.allocations.load(std::memory_order_relaxed);
+                }
+            };
+            accumulate(state.retired);
+            for (const auto* counters : state.threads)
+                accumulate(*counters);
+
+            for (uint32_t i=0u; i<EMS_COUNT; i++)
+            {
+                auto& subsystem = retval.subsystems[i];
+                const int64_t peak = state.peakBytes[i].load(std::memory_order_relaxed);
+                subsystem.peakBytes = peak>subsystem.liveBytes ? peak:subsystem.liveBytes;
+                retval.liveBytes += subsystem.liveBytes;
+            }
+            const int64_t peak = state.peakBytes[EMS_COUNT].load(std::memory_order_relaxed);
+            retval.peakBytes = peak>retval.liveBytes ? peak:retval.liveBytes;
+            return retval;
+        }
+
+        //! Starts the high-water marks over from the current live byte counts, i.e. to get the peak of a single frame or level load
+        static inline void resetPeaks()
+        {
+            auto& state = getGlobalState();
+            for (uint32_t i=0u; i<=EMS_COUNT; i++)
+                state.peakBytes[i].store(state.publishedBytes[i].load(std::memory_order_relaxed),std::memory_order_relaxed);
+        }
+
+    private:
+        struct SAllocationHeader
+        {
+            uint64_t size;
+            uint32_t offset; // from the start of the underlying allocation
+            uint8_t subsystem;
+        };
+        static_assert(sizeof(SAllocationHeader)==16u && alignof(SAllocationHeader)==8u, "Allocation header must be 16 bytes");
+
+        struct SCounters
+        {
+            std::atomic<int64_t> liveBytes{0};
+            std::atomic<int64_t> liveAllocations{0};
+            std::atomic<uint64_t> allocations{0u};
+            // change of `liveBytes` not yet added to `SGlobalState::publishedBytes`, only ever touched by the owning thread
+            int64_t unpublishedBytes = 0;
+        };
+        // own cache lines, so threads don't false-share their counters
+        struct alignas(64) SThreadCounters
+        {
+            SCounters perSubsystem[EMS_COUNT];
+        };
+
+        struct SGlobalState
+        {
+            std::mutex lock;
+            // `std::vector` with `std::allocator`, so registering a thread does not allocate through `trackedMalloc`
+            std::vector<SThreadCounters*> threads;
+            // counts of the threads which exited
+            SThreadCounters retired;
+            // the last element is the total over all subsystems
+            std::atomic<int64_t> publishedBytes[EMS_COUNT+1u] = {};
+            std::atomic<int64_t> peakBytes[EMS_COUNT+1u] = {};
+        };
+
+        // destroys the thread's counters when it exits
+        struct SThreadExitHook
+        {
+            ~SThreadExitHook()
+            {
+                auto* counters = t_counters;
+                t_counters = nullptr;
+                t_exited = true;
+
+                auto& state = getGlobalState();
+                std::unique_lock<std::mutex> lock(state.lock);
+                for (uint32_t i=0u; i<EMS_COUNT; i++)
+                {
+                    auto& in = counters->perSubsystem[i];
+                    auto& out = state.retired.perSubsystem[i];
+                    increment(out.liveBytes,in.liveBytes.load(std::memory_order_relaxed));
+                    increment(out.liveAllocations,in.liveAllocations.load(std::memory_order_relaxed));
+                    increment(out.allocations,in.allocations.load(std::memory_order_relaxed));
+                    publish(static_cast<E_MEMORY_SUBSYSTEM>(i),in);
+                }
+                for (auto it=state.threads.begin(); it!=state.threads.end(); it++)
+                if (*it==counters)
+                {
+                    state.threads.erase(it);
+                    break;
+                }
+                delete counters;
+            }
+        };
+
+        // never destroyed, static objects get destroyed in an unspecified order and may still free memory
+        static inline SGlobalState& getGlobalState()
+        {
+            static SGlobalState* state = new SGlobalState();
+            return *state;
+        }
+
+        // constant initialized, so accessing these does not go through a TLS init function
+        static inline thread_local SThreadCounters* t_counters = nullptr;
+        static inline thread_local uint8_t t_subsystem = EMS_UNTAGGED;
+        static inline thread_local bool t_exited = false;
+
+        // only the owning thread writes its counters, no need for a locked RMW instruction
+        template<typename T>
+        static inline void increment(std::atomic<T>& counter, const T delta)
+        {
+            counter.store(counter.load(std::memory_order_relaxed)+delta,std::memory_order_relaxed);
+        }
+
+        static inline void raiseTo(std::atomic<int64_t>& peak, const int64_t value)
+        {
+            int64_t expected = peak.load(std::memory_order_relaxed);
+            while (expected<value && !peak.compare_exchange_weak(expected,value,std::memory_order_relaxed)) {}
+        }
+
+        static inline void publish(const E_MEMORY_SUBSYSTEM subsystem, SCounters& counters)
+        {
+            const int64_t delta = std::exchange(counters.unpublishedBytes,0ll);
+            auto& state = getGlobalState();
+            const int64_t live = state.publishedBytes[subsystem].fetch_add(delta,std::memory_order_relaxed)+delta;
+            const int64_t total = state.publishedBytes[EMS_COUNT].fetch_add(delta,std::memory_order_relaxed)+delta;
+            if (delta>0ll)
+            {
+                raiseTo(state.peakBytes[subsystem],live);
+                raiseTo(state.peakBytes[EMS_COUNT],total);
+            }
+        }
+
+        static inline void count(const uint8_t subsystem, const int64_t bytes, const int64_t allocations)
+        {
+            auto* counters = t_counters;
+            if (!counters)
+            {
+                // a thread's first allocation, or one made by another thread_local's destructor after the hook ran
+                if (t_exited)
+                {
+                    countAfterExit(subsystem,bytes,allocations);
+                    return;
+                }
+                counters = registerThread();
+            }
+
+            auto& c = counters->perSubsystem[subsystem];
+            increment(c.liveBytes,bytes);
+            increment(c.liveAllocations,allocations);
+            if (allocations>0)
+                increment<uint64_t>(c.allocations,1u);
+            c.unpublishedBytes += bytes;
+            if (c.unpublishedBytes>=PeakGranularity || c.unpublishedBytes<=-PeakGranularity)
+                publish(static_cast<E_MEMORY_SUBSYSTEM>(subsystem),c);
+        }
+
+        static inline SThreadCounters* registerThread()
+        {
+            static thread_local SThreadExitHook exitHook;
+            t_counters = new SThreadCounters();
+
+            auto& state = getGlobalState();
+            std::unique_lock<std::mutex> lock(state.lock);
+            state.threads.push_back(t_counters);
+            return t_counters;
+        }
+
+        static inline void countAfterExit(const uint8_t subsystem, const int64_t bytes, const int64_t allocations)
+        {
+            auto& state = getGlobalState();
+            std::unique_lock<std::mutex> lock(state.lock);
+            auto& c = state.retired.perSubsystem[subsystem];
+            increment(c.liveBytes,bytes);
+            increment(c.liveAllocations,allocations);
+            if (allocations>0)
+                increment<uint64_t>(c.allocations,1u);
+            c.unpublishedBytes = bytes;
+            publish(static_cast<E_MEMORY_SUBSYSTEM>(subsystem),c);
+        }
+#else
+        static inline SSnapshot getSnapshot() { return {}; }
+
+        static inline void resetPeaks() {}
+#endif
+};
+
+}
+}
+
+#endif
@@ -35,8 +35,8 @@
 
 //! You can swap these out for whatever you like, jemalloc, tcmalloc etc. but make them noexcept
 #ifdef _NBL_PLATFORM_WINDOWS_
-    #define _NBL_ALIGNED_MALLOC(size,alignment)     ::_aligned_malloc(size,alignment)
-    #define _NBL_ALIGNED_FREE(addr)                 ::_aligned_free(addr)
+    #define _NBL_UNTRACKED_ALIGNED_MALLOC(size,alignment)   ::_aligned_malloc(size,alignment)
+    #define _NBL_UNTRACKED_ALIGNED_FREE(addr)               ::_aligned_free(addr)
 #else
 
 namespace nbl
@@ -52,8 +52,17 @@ namespace impl
     }
 }
 }
-    #define _NBL_ALIGNED_MALLOC(size,alignment)     nbl::impl::aligned_malloc(size,alignment)
-    #define _NBL_ALIGNED_FREE(addr)                 ::free(addr)
+    #define _NBL_UNTRACKED_ALIGNED_MALLOC(size,alignment)   nbl::impl::aligned_malloc(size,alignment)
+    #define _NBL_UNTRACKED_ALIGNED_FREE(addr)               ::free(addr)
+#endif
+
+//! With `NBL_MEMORY_STATISTICS` every allocation gets counted by CMemoryStatistics, memory from `_NBL_ALIGNED_MALLOC` must only ever be freed with `_NBL_ALIGNED_FREE`
+#ifdef _NBL_MEMORY_STATISTICS_
+    #define _NBL_ALIGNED_MALLOC(size,alignment)     nbl::core::CMemoryStatistics::trackedMalloc(size,alignment)
+    #define _NBL_ALIGNED_FREE(addr)                 nbl::core::CMemoryStatistics::trackedFree(addr)
+#else
+    #define _NBL_ALIGNED_MALLOC(size,alignment)     _NBL_UNTRACKED_ALIGNED_MALLOC(size,alignment)
+    #define _NBL_ALIGNED_FREE(addr)                 _NBL_UNTRACKED_ALIGNED_FREE(addr)
 #endif
 
 
@@ -93,5 +102,9 @@ constexpr inline bool is_aligned_to(const void* value, size_t alignment)
 }
 }
 
+// needs the untracked allocation macros and `alignUp`
+#ifdef _NBL_MEMORY_STATISTICS_
+#include "nbl/core/memory/CMemoryStatistics.h"
+#endif
 
 #endif
@@ -0,0 +1,133 @@
+// Copyright (C) 2018-2020 - DevSH Graphics Programming Sp. z O.O.
+// This file is part of the "Nabla Engine".
+// For conditions of distribution and use, see copyright notice in nabla.h
+
+#ifndef __NBL_CORE_C_WORK_STEALING_DEQUE_H_INCLUDED__
+#define __NBL_CORE_C_WORK_STEALING_DEQUE_H_INCLUDED__
+
+#include <atomic>
+#include <memory>
+
+#include "nbl/core/Types.h"
+#include "nbl/core/BaseClasses.h"
+
+namespace nbl
+{
+namespace core
+{
+
+//! Lock-free single producer, multiple consumer deque of pointers
+/**
+Chase & Lev "Dynamic Circular Work-Stealing Deque" with the memory orders from Le et al. "Correct and Efficient Work-Stealing for Weak Memory Models".
+Only the owning thread may `push` and `pop` (LIFO end), any thread may `steal` (FIFO end).
+Arrays outgrown by `push` are kept alive until the deque dies, because a concurrent `steal` might still be reading them.
+*/
+template<typename T>
+class CWorkStealingDeque : public Uncopyable
+{
+		static_assert(std::is_pointer<T>::value, "CWorkStealingDeque only stores pointers, nullptr signals an empty deque");
+
+		class CArray
+		{
+				const int64_t m_mask;
+				std::unique_ptr<std::atomic<T>[]> m_data;
+			public:
+				CArray(const int64_t _capacity) : m_mask(_capacity-1), m_data(new std::atomic<T>[_capacity]) {}
+
+				inline int64_t capacity() const { return m_mask+1; }
+				inline T get(const int64_t _ix) const { return m_data[_ix&m_mask].load(std::memory_order_relaxed); }
+				inline void put(const int64_t _ix, T _value) { m_data[_ix&m_mask].store(_value,std::memory_order_relaxed); }
+
+				inline CArray* grow(const int64_t _bottom, const int64_t _top) const
+				{
+					CArray* retval = new CArray(capacity()*2);
+					for (int64_t i=_top; i<_bottom; i++)
+						retval->put(i,get(i));
+					return retval;
+				}
+		};
+
+	public:
+		//! `_initialCapacity` must be a power of two
+		CWorkStealingDeque(const int64_t _initialCapacity=256) : m_top(0), m_bottom(0), m_array(new CArray(_initialCapacity))
+		{
+			m_retired.emplace_back(m_array.load(std::memory_order_relaxed));
+		}
+
+		//! Owner only
+		inline void push(T _value)
+		{
+			const int64_t b = m_bottom.load(std::memory_order_relaxed);
+			const int64_t t = m_top.load(std::memory_order_acquire);
+			CArray* a = m_array.load(std::memory_order_relaxed);
+			if (b-t>a->capacity()-1)
+			{
+				a = a->grow(b,t);
+				m_retired.emplace_back(a);
+				m_array.store(a,std::memory_order_release);
+			}
+			a->put(b,_value);
+			// a release store instead of the paper's release fence, same guarantee and visible to thread sanitizers
+			m_bottom.store(b+1,std::memory_order_release);
+		}
+
+		//! Owner only, returns nullptr if empty
+		inline T pop()
+		{
+			const int64_t b = m_bottom.load(std::memory_order_relaxed)-1;
+			CArray* a = m_array.load(std::memory_order_relaxed);
+			m_bottom.store(b,std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			int64_t t = m_top.load(std::memory_order_relaxed);
+
+			T retval = nullptr;
+			if (t<=b)
+			{
+				retval = a->get(b);
+				if (t==b)
+				{
+					// last element, race the thieves for it
+					if (!m_top.compare_exchange_strong(t,t+1,std::memory_order_seq_cst,std::memory_order_relaxed))
+						retval = nullptr;
+					m_bottom.store(b+1,std::memory_order_relaxed);
+				}
+			}
+			else
+				m_bottom.store(b+1,std::memory_order_relaxed);
+			return retval;
+		}
+
+		//! Any thread, returns nullptr if empty or if it lost a race with another thief or the owner
+		inline T steal()
+		{
+			int64_t t = m_top.load(std::memory_order_acquire);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			const int64_t b = m_bottom.load(std::memory_order_acquire);
+
+			if (t>=b)
+				return nullptr;
+
+			CArray* a = m_array.load(std::memory_order_acquire);
+			T retval = a->get(t);
+			if (!m_top.compare_exchange_strong(t,t+1,std::memory_order_seq_cst,std::memory_order_relaxed))
+				return nullptr;
+			return retval;
+		}
+
+		//! Only a hint when called by anyone but the owner
+		inline bool empty() const
+		{
+			return m_bottom.load(std::memory_order_relaxed)<=m_top.load(std::memory_order_relaxed);
+		}
+
+	private:
+		alignas(64) std::atomic<int64_t> m_top;
+		alignas(64) std::atomic<int64_t> m_bottom;
+		std::atomic<CArray*> m_array;
+		core::vector<std::unique_ptr<CArray>> m_retired;
+};
+
+}
+}
+
+#endif
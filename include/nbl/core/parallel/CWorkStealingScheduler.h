@@ -0,0 +1,283 @@
+// Copyright (C) 2018-2020 - DevSH Graphics Programming Sp. z O.O.
+// This file is part of the "Nabla Engine".
+// For conditions of distribution and use, see copyright notice in nabla.h
+
+#ifndef __NBL_CORE_C_WORK_STEALING_SCHEDULER_H_INCLUDED__
+#define __NBL_CORE_C_WORK_STEALING_SCHEDULER_H_INCLUDED__
+
+#include <array>
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <iterator>
+#include <functional>
+#include <condition_variable>
+
+#include "nbl/core/Types.h"
+#include "nbl/core/BaseClasses.h"
+#include "nbl/core/IReferenceCounted.h"
+#include "nbl/core/memory/new_delete.h"
+#include "nbl/core/parallel/CWorkStealingDeque.h"
+
+namespace nbl
+{
+namespace core
+{
+
+//! Half-open N dimensional range of indices which splits itself in halves along its longest dimension until every dimension is within its grain size
+template<uint32_t N>
+struct SBlockedRange
+{
+	static_assert(N>=1u && N<=3u, "Only 1D, 2D and 3D ranges are supported");
+
+	std::array<size_t,N> begin;
+	std::array<size_t,N> end;
+	//! Largest extent which is not worth splitting further, must not be 0
+	std::array<size_t,N> grain;
+
+	inline size_t size() const
+	{
+		size_t retval = 1u;
+		for (uint32_t i=0u; i<N; i++)
+			retval *= end[i]-begin[i];
+		return retval;
+	}
+
+	inline bool isDivisible() const
+	{
+		for (uint32_t i=0u; i<N; i++)
+		if (end[i]-begin[i]>grain[i])
+			return true;
+		return false;
+	}
+
+	//! Keeps the lower half and returns the upper half
+	inline SBlockedRange split()
+	{
+		uint32_t dim = 0u;
+		for (uint32_t i=1u; i<N; i++)
+		if ((end[i]-begin[i])*grain[dim]>(end[dim]-begin[dim])*grain[i])
+			dim = i;
+
+		SBlockedRange retval = *this;
+		const size_t middle = begin[dim]+(end[dim]-begin[dim])/2u;
+		end[dim] = middle;
+		retval.begin[dim] = middle;
+		return retval;
+	}
+};
+
+class CTaskGroup;
+
+//! Thread pool where every worker owns a deque of tasks it spawned, idle workers steal the oldest tasks of others
+/**
+Tasks spawned by a worker go to the bottom of its own deque and get executed depth-first by it, which keeps recursive splitting cache friendly,
+while thieves take from the top where the biggest chunks of work are. Tasks spawned from outside the pool go into a shared injection queue.
+
+A thread waiting on a CTaskGroup executes pending tasks instead of blocking, so nested parallelism cannot deadlock the pool.
+Use getDefault() to share one pool between subsystems instead of oversubscribing the machine.
+*/
+class CWorkStealingScheduler : public IReferenceCounted
+{
+	public:
+		_NBL_STATIC_INLINE_CONSTEXPR uint32_t AnyWorker = ~0u;
+
+		struct SCreationParams
+		{
+			//! 0 means one worker for every hardware thread but one, because the thread waiting on the results helps out
+			uint32_t workerCount = 0u;
+			//! Optional, one mask of logical processors (bit N is processor N) per worker to pin them with.
+			/** On NUMA machines give the workers which will be handed the same data (see `preferredWorker`) the processors of one node. */
+			core::vector<uint64_t> workerAffinityMasks;
+		};
+
+		CWorkStealingScheduler();
+		CWorkStealingScheduler(SCreationParams&& _params);
+
+		//! Process wide pool with the default creation parameters, created on first use
+		static CWorkStealingScheduler* getDefault();
+
+		inline uint32_t getWorkerCount() const { return static_cast<uint32_t>(m_workers.size()); }
+
+		//! Index of the worker calling this, or AnyWorker if the calling thread is not a worker of this pool
+		uint32_t getCurrentWorkerIndex() const;
+
+		//! Fire and forget, use CTaskGroup to find out when the task is done
+		/** @param _preferredWorker Affinity hint, the task goes to that worker's mailbox which it checks before stealing from others (they can still steal it). */
+		template<typename F>
+		inline void spawn(F&& _func, const uint32_t _preferredWorker=AnyWorker)
+		{
+			push(new STask(std::forward<F>(_func),nullptr),_preferredWorker);
+		}
+
+		//! Calls `_body(subrange)` on subranges no bigger than the grain size, returns when all are done
+		template<uint32_t N, typename F>
+		inline void parallel_for(const SBlockedRange<N>& _range, const F& _body);
+
+		//! Calls `_body(i)` for every index in [_begin,_end), `_grain==0` picks a grain giving every worker a few chunks to balance
+		template<typename F>
+		inline void parallel_for(const size_t _begin, const size_t _end, const F& _body, size_t _grain=0u)
+		{
+			if (_begin>=_end)
+				return;
+			if (!_grain)
+				_grain = std::max<size_t>((_end-_begin)/(size_t(getWorkerCount()+1u)*8u),1u);
+			parallel_for(SBlockedRange<1u>{{_begin},{_end},{_grain}},[&_body](const SBlockedRange<1u>& _subrange)
+			{
+				for (size_t i=_subrange.begin[0]; i<_subrange.end[0]; i++)
+					_body(i);
+			});
+		}
+
+		//! Stable sort, chunks get sorted in parallel and then merged pairwise in parallel, the result doesn't depend on the worker count
+		template<typename RandomIt, typename Compare=std::less<>>
+		inline void parallel_sort(RandomIt _begin, RandomIt _end, Compare _comp=Compare());
+
+		//! Executes one pending task on the calling thread
+		/** @returns false if there was nothing to run. */
+		bool runPendingTask();
+
+	protected:
+		virtual ~CWorkStealingScheduler();
+
+	private:
+		friend class CTaskGroup;
+
+		struct STask
+		{
+			template<typename F>
+			STask(F&& _func, CTaskGroup* _group) : func(std::forward<F>(_func)), group(_group) {}
+
+			std::function<void()> func;
+			CTaskGroup* group;
+		};
+
+		//! Cache line aligned so the deque ends of different workers do not false share
+		struct SWorker : public AllocationOverrideBase<64u>
+		{
+			CWorkStealingDeque<STask*> deque;
+			//! Tasks other threads want this worker to run (affinity hints)
+			std::mutex mailboxLock;
+			core::deque<STask*> mailbox;
+			std::thread thread;
+		};
+
+		template<uint32_t N, typename F>
+		void forkRange(CTaskGroup& _group, SBlockedRange<N> _range, const F& _body);
+
+		void push(STask* _task, const uint32_t _preferredWorker);
+		STask* findTask(const uint32_t _self);
+		void execute(STask* _task);
+		void workerMain(const uint32_t _ix, const uint64_t _affinityMask);
+
+		core::vector<std::unique_ptr<SWorker>> m_workers;
+
+		std::mutex m_injectionLock;
+		core::deque<STask*> m_injectionQueue;
+
+		//! Tasks sitting in any of the queues, idle workers only go to sleep when this is 0
+		alignas(64) std::atomic<uint32_t> m_pendingTasks;
+		std::atomic<uint32_t> m_sleepingWorkers;
+		std::atomic<bool> m_stop;
+		std::mutex m_sleepLock;
+		std::condition_variable m_wakeUp;
+};
+
+//! Set of tasks which can be waited on together, must outlive its tasks (the destructor waits)
+class CTaskGroup : public Uncopyable
+{
+	public:
+		CTaskGroup(CWorkStealingScheduler* _scheduler=CWorkStealingScheduler::getDefault()) : m_scheduler(_scheduler), m_pending(0u), m_finishing(0u), m_continuation(nullptr) {}
+		~CTaskGroup() { wait(); }
+
+		template<typename F>
+		inline void run(F&& _func, const uint32_t _preferredWorker=CWorkStealingScheduler::AnyWorker)
+		{
+			m_pending.fetch_add(1u,std::memory_order_relaxed);
+			m_scheduler->push(new CWorkStealingScheduler::STask(std::forward<F>(_func),this),_preferredWorker);
+		}
+
+		//! Spawns `_func` once all tasks run so far are done, immediately if they already are. Waiting on the group does not wait for it.
+		/** Only one continuation can be pending at a time. */
+		template<typename F>
+		inline void then(F&& _func)
+		{
+			// hold the group open while the continuation gets published
+			m_pending.fetch_add(1u,std::memory_order_relaxed);
+			auto* continuation = new CWorkStealingScheduler::STask(std::forward<F>(_func),nullptr);
+			continuation = m_continuation.exchange(continuation,std::memory_order_release);
+			_NBL_DEBUG_BREAK_IF(continuation);
+			delete continuation;
+			taskFinished();
+		}
+
+		inline bool done() const
+		{
+			return m_pending.load(std::memory_order_acquire)==0u && m_finishing.load(std::memory_order_acquire)==0u;
+		}
+
+		//! Runs pending tasks (of any group) on the calling thread until all tasks of this group are done
+		void wait();
+
+		inline CWorkStealingScheduler* getScheduler() const { return m_scheduler; }
+
+	private:
+		friend class CWorkStealingScheduler;
+
+		void taskFinished();
+
+		CWorkStealingScheduler* m_scheduler;
+		std::atomic<uint32_t> m_pending;
+		//! Threads still inside taskFinished, the group must not die before they leave
+		std::atomic<uint32_t> m_finishing;
+		std::atomic<CWorkStealingScheduler::STask*> m_continuation;
+};
+
+
+template<uint32_t N, typename F>
+inline void CWorkStealingScheduler::parallel_for(const SBlockedRange<N>& _range, const F& _body)
+{
+	if (!_range.size())
+		return;
+	CTaskGroup group(this);
+	forkRange(group,_range,_body);
+	group.wait();
+}
+
+template<typename RandomIt, typename Compare>
+inline void CWorkStealingScheduler::parallel_sort(RandomIt _begin, RandomIt _end, Compare _comp)
+{
+	// below this forking and merging costs more than it saves
+	constexpr size_t MinChunkSize = 0x1u<<12u;
+	const size_t count = std::distance(_begin,_end);
+	size_t chunks = 1u;
+	while (chunks<=getWorkerCount() && count/(chunks*2u)>=MinChunkSize)
+		chunks *= 2u;
+	auto chunkBegin = [&](const size_t i) {return _begin+count*i/chunks;};
+
+	parallel_for(0u,chunks,[&](const size_t i) {std::stable_sort(chunkBegin(i),chunkBegin(i+1u),_comp);},1u);
+	for (size_t width=1u; width<chunks; width*=2u)
+	parallel_for(0u,chunks/(width*2u),[&](const size_t i)
+	{
+		const size_t first = i*width*2u;
+		std::inplace_merge(chunkBegin(first),chunkBegin(first+width),chunkBegin(first+width*2u),_comp);
+	},1u);
+}
+
+template<uint32_t N, typename F>
+void CWorkStealingScheduler::forkRange(CTaskGroup& _group, SBlockedRange<N> _range, const F& _body)
+{
+	// keep the lower half, hand out the upper one, thieves get the biggest pieces
+	while (_range.isDivisible())
+	{
+		const SBlockedRange<N> upper = _range.split();
+		_group.run([this,&_group,upper,&_body]() {forkRange(_group,upper,_body);});
+	}
+	_body(_range);
+}
+
+}
+}
+
+#endif
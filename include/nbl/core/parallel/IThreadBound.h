@@ -7,6 +7,8 @@
 
 #include <thread>
 
+#include "nbl/core/IReferenceCounted.h"
+
 namespace nbl
 {
 namespace core
@@ -50,9 +52,22 @@ class NBL_FORCE_EBO IThreadBound
 		*/
         std::thread::id getCreationThreadID() const
         {
-            return std::this_thread::get_id();
+            return tid;
+        }
+};
+
+//! Base class for reference counted things that cannot be shared between threads, grabbing and dropping them skips the atomic read-modify-writes
+/** The object and every `smart_refctd_ptr` to it must stay on the creating thread for its whole life, copying such a pointer on another thread is a data race. */
+class NBL_FORCE_EBO IThreadBoundReferenceCounted : public virtual IReferenceCounted, public IThreadBound
+{
+    protected:
+        IThreadBoundReferenceCounted()
+        {
+            makeThreadConfined();
         }
+        virtual ~IThreadBoundReferenceCounted() = 0;
 };
+inline IThreadBoundReferenceCounted::~IThreadBoundReferenceCounted() {}
 
 } // end namespace core
 } // end namespace nbl
@@ -6,6 +6,7 @@
 #define __NBL_CORE_STRINGUTIL_H_INCLUDED__
 
 #include <string>
+#include <string_view>
 #include <sstream>
 #include <cwchar>
 #include <cctype>
@@ -177,10 +178,10 @@ namespace core
 		return 0;
 	}
 
-	//! DOCUMENTATION TODO
+	//! Hashes strings so that ones differing only in letter case collide, takes views so it works on strings the container doesn't own
 	struct CaseInsensitiveHash
 	{
-		inline std::size_t operator()(const std::string& val) const
+		inline std::size_t operator()(const std::string_view& val) const
 		{
 			std::size_t seed = 0;
 			for (auto it = val.begin(); it != val.end(); it++)
@@ -192,7 +193,7 @@ namespace core
 	};
 	struct CaseInsensitiveEquals
 	{
-		inline bool operator()(const std::string& A, const std::string& B) const
+		inline bool operator()(const std::string_view& A, const std::string_view& B) const
 		{
 			return core::strcmpi(A, B)==0;
 		}
@@ -62,18 +62,23 @@ class IMeshMetadata : public IMitsubaMetadata
 {
 	public:
 		IMeshMetadata(core::smart_refctd_ptr<CGlobalMitsubaMetadata>&& _gmeta, std::string&& _id, CElementShape* shape) :
-			IMitsubaMetadata(std::move(_gmeta),std::move(_id)), type(shape->type)
+			IMitsubaMetadata(std::move(_gmeta),std::move(_id)), type(shape->type), geometryHash{}
 		{}
 
+		//! of the first shape which had this geometry, `id` is of that shape too
 		inline auto getShapeType() const {return type;}
 
 		using Instance = SContext::SInstanceData;
 
+		//! every shape with identical geometry is an instance of the same mesh, with its own transform, BSDF and emitter
 		inline const auto& getInstances() const { return instances; }
+		//! what the shapes got deduplicated by, all zero if the mesh didn't take part
+		inline const auto& getGeometryHash() const { return geometryHash; }
 
 	protected:
 		CElementShape::Type type;
 		core::vector<Instance> instances;
+		SContext::geometry_hash_t geometryHash;
 
 		friend class CMitsubaLoader;
 };
@@ -40,16 +40,48 @@ class CMitsubaLoader : public asset::IAssetLoader
 	protected:
 		asset::IAssetManager* m_manager;
 		io::IFileSystem* m_filesystem;
+		//! not registered with the asset manager, only used to decode the meshes the scene references
+		core::smart_refctd_ptr<CSerializedLoader> m_serializedLoader;
 
 		//! Destructor
 		virtual ~CMitsubaLoader() = default;
 
 		static core::smart_refctd_ptr<asset::ICPUPipelineLayout> createPipelineLayout(asset::IAssetManager* _manager, asset::ICPUVirtualTexture* _vt);
 
+		//! what's left to do to the mesh of a shape after `loadShapeSource`
+		struct SShapeProcessing
+		{
+			bool flipNormals = false;
+			bool faceNormals = false;
+			float maxSmoothAngle = NAN;
+			bool flipTexCoords = false;
+			//! deep copy before anything else
+			bool clone = false;
+			//! convert vertex colors to linear
+			bool srgb = false;
+
+			inline bool operator==(const SShapeProcessing& other) const
+			{
+				const bool sameSmoothing = maxSmoothAngle==other.maxSmoothAngle || (std::isnan(maxSmoothAngle) && std::isnan(other.maxSmoothAngle));
+				return flipNormals==other.flipNormals && faceNormals==other.faceNormals && sameSmoothing && flipTexCoords==other.flipTexCoords && clone==other.clone && srgb==other.srgb;
+			}
+		};
+
+		//! decodes every mesh of `.serialized` files any of the shapes (or the shapes in their groups) references, and no others
+		void									cacheSerializedMeshes(SContext& ctx, uint32_t hierarchyLevel, const core::vector<std::pair<CElementShape*,std::string>>& shapes);
+		//! loads every model and bitmap the shapes reference, decoding the bitmaps concurrently on `_scheduler` (or the calling thread if it's nullptr), then builds the geometry of all the shapes concurrently
+		/** Fills `SContext::prefetchedAssets` and `SContext::shapeCache`, the asset cache and the asset loader override only get used from the calling thread. */
+		void									prefetchShapes(SContext& ctx, uint32_t hierarchyLevel, const core::vector<std::pair<CElementShape*,std::string>>& shapes, core::CWorkStealingScheduler* _scheduler);
+		//! the prefetched asset if there is one, otherwise loads it
+		asset::SAssetBundle						getFileAsset(SContext& ctx, const std::string& filename, const asset::IAssetLoader::SAssetLoadParams& params, uint32_t hierarchyLevel);
 		//
 		core::vector<SContext::shape_ass_type>	getMesh(SContext& ctx, uint32_t hierarchyLevel, CElementShape* shape);
 		core::vector<SContext::shape_ass_type>	loadShapeGroup(SContext& ctx, uint32_t hierarchyLevel, const CElementShape::ShapeGroup* shapegroup, const core::matrix3x4SIMD& relTform);
 		SContext::shape_ass_type				loadBasicShape(SContext& ctx, uint32_t hierarchyLevel, CElementShape* shape, const core::matrix3x4SIMD& relTform);
+		//! gets (or generates) the mesh of a shape, only needs to be followed by `processShape`
+		SContext::shape_ass_type				loadShapeSource(SContext& ctx, uint32_t hierarchyLevel, CElementShape* shape, SShapeProcessing& processing);
+		//! doesn't touch the context, copies the meshbuffers and buffers of `mesh` before changing them as they may be shared with other shapes
+		SContext::shape_ass_type				processShape(const SContext& ctx, SContext::shape_ass_type&& mesh, const SShapeProcessing& processing) const;
 		
 		SContext::tex_ass_type					cacheTexture(SContext& ctx, uint32_t hierarchyLevel, const CElementTexture* texture);
 
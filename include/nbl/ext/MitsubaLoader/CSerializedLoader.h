@@ -62,6 +62,11 @@ class CSerializedLoader final : public asset::IAssetLoader
 		//! creates/loads an animated mesh from the file.
 		asset::SAssetBundle loadAsset(io::IReadFile* _file, const asset::IAssetLoader::SAssetLoadParams& _params, asset::IAssetLoader::IAssetLoaderOverride* _override = nullptr, uint32_t _hierarchyLevel = 0u) override;
 
+		//! Only decodes the meshes with the given ids (`shapeIndex` in a Mitsuba scene), in parallel on `_scheduler` (or the calling thread if it's nullptr)
+		/** Meshes are independent blocks of the file, if it can be mapped they're inflated straight from the mapping.
+		@returns A mesh for every id in the same order, nullptr if the id is out of range or the mesh failed to decode. */
+		core::vector<core::smart_refctd_ptr<asset::ICPUMesh>> loadMeshes(io::IReadFile* _file, const core::SRange<const uint32_t>& _ids, core::CWorkStealingScheduler* _scheduler = core::CWorkStealingScheduler::getDefault());
+
 	private:
 
 		struct FileHeader
@@ -80,8 +85,12 @@ class CSerializedLoader final : public asset::IAssetLoader
 		{
 			io::IReadFile* file = nullptr;
 			uint32_t meshCount;
+			//! offsets of the compressed meshes followed by their sizes
 			core::smart_refctd_dynamic_array<uint64_t> meshOffsets;
 		};
+		//! reads the header and the offset table
+		bool readMeshOffsets(SContext& _ctx) const;
+		core::vector<core::smart_refctd_ptr<asset::ICPUMesh>> loadMeshes_impl(SContext& _ctx, const core::SRange<const uint32_t>& _ids, core::CWorkStealingScheduler* _scheduler);
 };
 
 
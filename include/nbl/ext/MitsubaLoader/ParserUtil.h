@@ -16,6 +16,8 @@
 #include "expat/lib/expat.h"
 
 #include <stack>
+#include <string_view>
+#include <tuple>
 
 
 namespace nbl
@@ -38,18 +40,78 @@ public:
 };
 
 
-template<typename... types>
-class ElementPool // : public std::tuple<core::vector<types>...>
+//! Elements of one type in chunks which never move (the parser hands out pointers to them), all destroyed together with the arena
+template<typename T>
+class ElementArena
 {
-		core::SimpleBlockBasedAllocator<core::LinearAddressAllocator<uint32_t>,core::aligned_allocator> poolAllocator;
+		_NBL_STATIC_INLINE_CONSTEXPR size_t ChunkSize = std::max<size_t>((64u*1024u)/sizeof(T),1u);
+		_NBL_STATIC_INLINE_CONSTEXPR size_t Alignment = std::max<size_t>(alignof(T),_NBL_SIMD_ALIGNMENT);
+
+		core::vector<T*> chunks;
+		size_t lastChunkSize;
 	public:
-		ElementPool() : poolAllocator(4096u*1024u, 256u) {}
+		ElementArena() : lastChunkSize(ChunkSize) {}
+		ElementArena(const ElementArena&) = delete;
+		ElementArena& operator=(const ElementArena&) = delete;
+		~ElementArena()
+		{
+			for (size_t i=0u; i<chunks.size(); i++)
+			{
+				const size_t count = i+1u<chunks.size() ? ChunkSize:lastChunkSize;
+				for (size_t j=0u; j<count; j++)
+					chunks[i][j].~T();
+				_NBL_ALIGNED_FREE(chunks[i]);
+			}
+		}
+
+		template<typename... Args>
+		inline T* construct(Args&& ... args)
+		{
+			if (lastChunkSize==ChunkSize)
+			{
+				chunks.push_back(reinterpret_cast<T*>(_NBL_ALIGNED_MALLOC(sizeof(T)*ChunkSize,Alignment)));
+				lastChunkSize = 0u;
+			}
+			return new (chunks.back()+(lastChunkSize++)) T(std::forward<Args>(args)...);
+		}
+};
 
+//! One `ElementArena` per element type, so elements of a type sit next to each other and get their destructors called
+template<typename... types>
+class ElementPool
+{
+		std::tuple<ElementArena<types>...> arenas;
+	public:
 		template<typename T, typename... Args>
 		inline T* construct(Args&& ... args)
 		{
-			T* ptr = reinterpret_cast<T*>(poolAllocator.allocate(sizeof(T), alignof(T)));
-			return new (ptr) T(std::forward<Args>(args)...);
+			return std::get<ElementArena<T>>(arenas).construct(std::forward<Args>(args)...);
+		}
+};
+
+//! Keeps one copy of every id, case insensitive like Mitsuba's ids, so the same id always gets the same pointer
+class CStringPool
+{
+		core::MonotonicArena<> storage;
+		core::unordered_set<std::string_view,core::CaseInsensitiveHash,core::CaseInsensitiveEquals> strings;
+	public:
+		//! Adds the string if it's not there yet, the returned pointer is null-terminated and lives as long as the pool
+		inline const char* intern(const char* str)
+		{
+			const std::string_view view(str);
+			auto found = strings.find(view);
+			if (found!=strings.end())
+				return found->data();
+
+			char* copy = reinterpret_cast<char*>(storage.allocate(view.size()+1u,1u));
+			memcpy(copy,str,view.size()+1u);
+			return strings.insert(std::string_view(copy,view.size())).first->data();
+		}
+		//! nullptr if the string was never interned
+		inline const char* find(const char* str) const
+		{
+			auto found = strings.find(std::string_view(str));
+			return found!=strings.end() ? found->data():nullptr;
 		}
 };
 
@@ -111,12 +173,15 @@ class ParserManager
 			CElementRFilter,
 			CElementSampler,
 			CElementShape,
+			CElementTransform,
 			CElementBSDF,
 			CElementTexture,
 			CElementEmitter
 					> objects;
-		// aliases and names
-		core::unordered_map<std::string,IElement*,core::CaseInsensitiveHash,core::CaseInsensitiveEquals> handles;
+		// ids, aliases included
+		CStringPool ids;
+		// keyed by the pointers `ids` hands out, equal ids always get the same one
+		core::unordered_map<const char*,IElement*> handles;
 
 		/*stack of currently processed elements
 		each element of index N is parent of the element of index N+1
@@ -46,6 +46,17 @@ namespace MitsubaLoader
 		//
 		using shape_ass_type = core::smart_refctd_ptr<asset::ICPUMesh>;
 		core::map<const CElementShape*, shape_ass_type> shapeCache;
+		//filename -> shapeIndex -> mesh, filled by CMitsubaLoader::cacheSerializedMeshes
+		core::unordered_map<std::string, core::unordered_map<uint32_t, shape_ass_type>> serializedMeshes;
+		//filename -> models and bitmaps, filled by CMitsubaLoader::prefetchShapes
+		core::unordered_map<std::string, asset::SAssetBundle> prefetchedAssets;
+		//XXHash_256 of the geometry, shapes with the same one share a mesh
+		using geometry_hash_t = std::array<uint64_t, 4>;
+		struct geometry_hash_hasher
+		{
+			inline size_t operator()(const geometry_hash_t& h) const { return h[0]; }
+		};
+		core::unordered_map<const shape_ass_type::pointee*, geometry_hash_t> geometryHashes;
 		//image, sampler
 		using tex_ass_type = std::tuple<core::smart_refctd_ptr<asset::ICPUImageView>, core::smart_refctd_ptr<asset::ICPUSampler>>;
 
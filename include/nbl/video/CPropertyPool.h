@@ -33,6 +33,7 @@ class CPropertyPool final : public IPropertyPool
 	public:
 		static inline core::smart_refctd_ptr<this_t> create(asset::SBufferRange<IGPUBuffer>&& _memoryBlock, allocator<uint8_t>&& alloc = allocator<uint8_t>())
 		{
+			core::CMemoryStatistics::CSubsystemScope memoryScope(core::EMS_PROPERTY_POOLS);
 			const auto reservedSize = getReservedSize(calcApproximateCapacity(_memoryBlock.size));
 			auto reserved = std::allocator_traits<allocator<uint8_t>>::allocate(alloc,reservedSize);
 			if (!reserved)
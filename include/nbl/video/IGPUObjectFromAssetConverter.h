@@ -965,7 +965,7 @@ inline created_gpu_object_array<asset::ICPUDescriptorSet> IGPUObjectFromAssetCon
 				{
 					if (isBufferDesc(type))
 					{
-						core::smart_refctd_ptr<video::IGPUOffsetBufferPair> buffer = bufRedirs[bi]>=gpuBuffers->size() ? nullptr : gpuBuffers->operator[](bufRedirs[bi]);
+						const video::IGPUOffsetBufferPair* buffer = bufRedirs[bi]>=gpuBuffers->size() ? nullptr : gpuBuffers->operator[](bufRedirs[bi]).get();
                         if (buffer)
                         {
                             info->desc = core::smart_refctd_ptr<video::IGPUBuffer>(buffer->getBuffer());
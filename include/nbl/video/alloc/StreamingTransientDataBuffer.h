@@ -8,6 +8,7 @@
 #include <cstring>
 
 #include "nbl/core/IReferenceCounted.h"
+#include "nbl/core/alloc/TLSFAddressAllocator.h"
 #include "nbl/video/alloc/SubAllocatedDataBuffer.h"
 #include "nbl/video/alloc/StreamingGPUBufferAllocator.h"
 #include "IDriverFence.h"
@@ -19,12 +20,13 @@ namespace video
 {
 
 
-template< typename _size_type=uint32_t, class CPUAllocator=core::allocator<uint8_t>, class CustomDeferredFreeFunctor=void >
-class StreamingTransientDataBufferST : protected SubAllocatedDataBuffer<core::HeterogenousMemoryAddressAllocatorAdaptor<core::GeneralpurposeAddressAllocator<_size_type>,StreamingGPUBufferAllocator,CPUAllocator>,CustomDeferredFreeFunctor>,
+//! `BasicAddressAllocator` can be swapped for core::TLSFAddressAllocator to get constant time allocation when the buffer sees lots of small transient allocations
+template< typename _size_type=uint32_t, class CPUAllocator=core::allocator<uint8_t>, class CustomDeferredFreeFunctor=void, class BasicAddressAllocator=core::GeneralpurposeAddressAllocator<_size_type> >
+class StreamingTransientDataBufferST : protected SubAllocatedDataBuffer<core::HeterogenousMemoryAddressAllocatorAdaptor<BasicAddressAllocator,StreamingGPUBufferAllocator,CPUAllocator>,CustomDeferredFreeFunctor>,
                                                                 public virtual core::IReferenceCounted
 {
-        typedef core::HeterogenousMemoryAddressAllocatorAdaptor<core::GeneralpurposeAddressAllocator<_size_type>,StreamingGPUBufferAllocator,CPUAllocator> HeterogenousMemoryAddressAllocator;
-        typedef StreamingTransientDataBufferST<_size_type,CPUAllocator> ThisType;
+        typedef core::HeterogenousMemoryAddressAllocatorAdaptor<BasicAddressAllocator,StreamingGPUBufferAllocator,CPUAllocator> HeterogenousMemoryAddressAllocator;
+        typedef StreamingTransientDataBufferST<_size_type,CPUAllocator,CustomDeferredFreeFunctor,BasicAddressAllocator> ThisType;
         typedef SubAllocatedDataBuffer<HeterogenousMemoryAddressAllocator,CustomDeferredFreeFunctor> Base;
     protected:
         virtual ~StreamingTransientDataBufferST() {}
@@ -96,10 +98,10 @@ class StreamingTransientDataBufferST : protected SubAllocatedDataBuffer<core::He
 };
 
 
-template< typename _size_type=uint32_t, class CPUAllocator=core::allocator<uint8_t>, class CustomDeferredFreeFunctor=void, class RecursiveLockable=std::recursive_mutex>
-class StreamingTransientDataBufferMT : protected StreamingTransientDataBufferST<_size_type,CPUAllocator,CustomDeferredFreeFunctor>, public virtual core::IReferenceCounted
+template< typename _size_type=uint32_t, class CPUAllocator=core::allocator<uint8_t>, class CustomDeferredFreeFunctor=void, class RecursiveLockable=std::recursive_mutex, class BasicAddressAllocator=core::GeneralpurposeAddressAllocator<_size_type> >
+class StreamingTransientDataBufferMT : protected StreamingTransientDataBufferST<_size_type,CPUAllocator,CustomDeferredFreeFunctor,BasicAddressAllocator>, public virtual core::IReferenceCounted
 {
-        typedef StreamingTransientDataBufferST<_size_type,CPUAllocator,CustomDeferredFreeFunctor> Base;
+        typedef StreamingTransientDataBufferST<_size_type,CPUAllocator,CustomDeferredFreeFunctor,BasicAddressAllocator> Base;
     protected:
         RecursiveLockable lock;
 
@@ -119,6 +119,16 @@ const io::path& CLimitReadFile::getFileName() const
 }
 
 
+const void* CLimitReadFile::getMappedContents() const
+{
+	if (!File)
+		return nullptr;
+
+	const auto* contents = reinterpret_cast<const uint8_t*>(File->getMappedContents());
+	return contents ? (contents+AreaStart):nullptr;
+}
+
+
 } // end namespace io
 } // end namespace nbl
 
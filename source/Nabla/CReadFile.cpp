@@ -5,6 +5,14 @@
 
 #include "CReadFile.h"
 
+#if defined(_NBL_WINDOWS_API_)
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h>
+	#include <io.h>
+#elif defined(_NBL_POSIX_API_)
+	#include <sys/mman.h>
+#endif
+
 namespace nbl
 {
 namespace io
@@ -12,7 +20,10 @@ namespace io
 
 
 CReadFile::CReadFile(const io::path& fileName)
-: File(0), FileSize(0), Filename(fileName)
+: File(0), FileSize(0), Filename(fileName), MappedContents(nullptr)
+#ifdef _NBL_WINDOWS_API_
+, MappingHandle(nullptr)
+#endif
 {
 	#ifdef _NBL_DEBUG
 	setDebugName("CReadFile");
@@ -24,6 +35,15 @@ CReadFile::CReadFile(const io::path& fileName)
 
 CReadFile::~CReadFile()
 {
+	if (MappedContents)
+	{
+#if defined(_NBL_WINDOWS_API_)
+		UnmapViewOfFile(MappedContents);
+		CloseHandle(MappingHandle);
+#elif defined(_NBL_POSIX_API_)
+		munmap(MappedContents, FileSize);
+#endif
+	}
 	if (File)
 		fclose(File);
 }
@@ -98,6 +118,36 @@ const io::path& CReadFile::getFileName() const
 }
 
 
+const void* CReadFile::getMappedContents() const
+{
+	std::call_once(MappingOnce,[this]() {mapContents();});
+	return MappedContents;
+}
+
+
+void CReadFile::mapContents() const
+{
+	if (!isOpen() || FileSize==0u)
+		return;
+#if defined(_NBL_WINDOWS_API_)
+	MappingHandle = CreateFileMappingA(reinterpret_cast<HANDLE>(_get_osfhandle(_fileno(File))), nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (MappingHandle)
+	{
+		MappedContents = MapViewOfFile(MappingHandle, FILE_MAP_READ, 0, 0, 0);
+		if (!MappedContents)
+		{
+			CloseHandle(MappingHandle);
+			MappingHandle = nullptr;
+		}
+	}
+#elif defined(_NBL_POSIX_API_)
+	void* mapping = mmap(nullptr, FileSize, PROT_READ, MAP_PRIVATE, fileno(File), 0);
+	if (mapping!=MAP_FAILED)
+		MappedContents = mapping;
+#endif
+}
+
+
 } // end namespace io
 } // end namespace nbl
 
@@ -7,6 +7,7 @@
 #define __NBL_C_READ_FILE_H_INCLUDED__
 
 #include <stdio.h>
+#include <mutex>
 #include "IReadFile.h"
 
 #include "nbl/core/core.h"
@@ -49,14 +50,27 @@ namespace io
             //! returns name of file
             virtual const io::path& getFileName() const;
 
+            //! maps the file on first use, nullptr on platforms without memory mapped files or if it failed
+            /** Thread-safe, concurrent first calls map the file once and all get the same pointer. */
+            virtual const void* getMappedContents() const;
+
         private:
 
             //! opens the file
             void openFile();
 
+            //! called once, by the first getMappedContents()
+            void mapContents() const;
+
             FILE* File;
             size_t FileSize;
             io::path Filename;
+
+            mutable void* MappedContents;
+            mutable std::once_flag MappingOnce;
+#ifdef _NBL_WINDOWS_API_
+            mutable void* MappingHandle;
+#endif
 	};
 
 } // end namespace io
@@ -0,0 +1,158 @@
+// Copyright (C) 2018-2020 - DevSH Graphics Programming Sp. z O.O.
+// This file is part of the "Nabla Engine".
+// For conditions of distribution and use, see copyright notice in nabla.h
+
+#include <algorithm>
+
+#include "nbl/asset/CGLSLIncludeCache.h"
+#include "nbl/core/xxHash256.h"
+
+namespace nbl
+{
+namespace asset
+{
+
+CGLSLIncludeCache::hash_t CGLSLIncludeCache::hashContents(const std::string& _contents)
+{
+	hash_t retval;
+	core::XXHash_256(_contents.data(),_contents.size(),retval.data());
+	return retval;
+}
+
+bool CGLSLIncludeCache::find(const std::string& _name, const hash_t* _contentHash, std::string& _outPreprocessed) const
+{
+	{
+		std::shared_lock<std::shared_mutex> lock(m_lock);
+		auto found = m_entries.find(_name);
+		if (found!=m_entries.end() && (_contentHash ? (found->second.contentHash==*_contentHash):found->second.source.builtin))
+		{
+			_outPreprocessed = found->second.preprocessed;
+			m_hits.fetch_add(1u,std::memory_order_relaxed);
+			return true;
+		}
+	}
+	m_misses.fetch_add(1u,std::memory_order_relaxed);
+	return false;
+}
+
+void CGLSLIncludeCache::insert(const std::string& _name, SSource&& _source, const hash_t& _contentHash, const std::string& _preprocessed)
+{
+	std::unique_lock<std::shared_mutex> lock(m_lock);
+	auto found = m_entries.find(_name);
+	if (found!=m_entries.end())
+	{
+		// two threads missed at once, or the file changed and what it includes might have too
+		if (found->second.contentHash==_contentHash)
+			return;
+		invalidate_impl(_name);
+	}
+	m_entries[_name] = {std::move(_source),_contentHash,_preprocessed};
+}
+
+void CGLSLIncludeCache::addDependency(const std::string& _includer, const std::string& _included)
+{
+	{
+		// every shader adds the same edges over and over, don't serialize them on the exclusive lock
+		std::shared_lock<std::shared_mutex> lock(m_lock);
+		auto found = m_includes.find(_includer);
+		if (found!=m_includes.end() && found->second.find(_included)!=found->second.end())
+			return;
+	}
+	std::unique_lock<std::shared_mutex> lock(m_lock);
+	m_includes[_includer].insert(_included);
+	m_includedBy[_included].insert(_includer);
+}
+
+core::vector<std::string> CGLSLIncludeCache::traverse(const core::unordered_map<std::string,core::unordered_set<std::string>>& _graph, const std::string& _from)
+{
+	core::unordered_set<std::string> visited;
+	core::vector<const std::string*> stack = {&_from};
+	while (!stack.empty())
+	{
+		const std::string* node = stack.back();
+		stack.pop_back();
+		auto found = _graph.find(*node);
+		if (found==_graph.end())
+			continue;
+		for (const auto& next : found->second)
+		if (next!=_from && visited.insert(next).second)
+			stack.push_back(&next);
+	}
+
+	core::vector<std::string> retval(visited.begin(),visited.end());
+	std::sort(retval.begin(),retval.end());
+	return retval;
+}
+
+core::vector<std::string> CGLSLIncludeCache::getDependencies(const std::string& _name) const
+{
+	std::shared_lock<std::shared_mutex> lock(m_lock);
+	return traverse(m_includes,_name);
+}
+
+core::vector<std::string> CGLSLIncludeCache::getDependents(const std::string& _name) const
+{
+	std::shared_lock<std::shared_mutex> lock(m_lock);
+	return traverse(m_includedBy,_name);
+}
+
+core::vector<std::pair<std::string,CGLSLIncludeCache::SSource>> CGLSLIncludeCache::getFilesystemIncludes() const
+{
+	core::vector<std::pair<std::string,SSource>> retval;
+	std::shared_lock<std::shared_mutex> lock(m_lock);
+	for (const auto& entry : m_entries)
+	if (!entry.second.source.builtin)
+		retval.emplace_back(entry.first,entry.second.source);
+	std::sort(retval.begin(),retval.end(),[](const auto& lhs, const auto& rhs) {return lhs.first<rhs.first;});
+	return retval;
+}
+
+bool CGLSLIncludeCache::hasChanged(const std::string& _name, const std::string& _contents) const
+{
+	const auto contentHash = hashContents(_contents);
+	std::shared_lock<std::shared_mutex> lock(m_lock);
+	auto found = m_entries.find(_name);
+	return found==m_entries.end() || found->second.contentHash!=contentHash;
+}
+
+void CGLSLIncludeCache::invalidate(const std::string& _name)
+{
+	std::unique_lock<std::shared_mutex> lock(m_lock);
+	invalidate_impl(_name);
+}
+
+void CGLSLIncludeCache::invalidate_impl(const std::string& _name)
+{
+	m_entries.erase(_name);
+	auto found = m_includes.find(_name);
+	if (found==m_includes.end())
+		return;
+	for (const auto& included : found->second)
+	{
+		auto reverse = m_includedBy.find(included);
+		if (reverse!=m_includedBy.end())
+			reverse->second.erase(_name);
+	}
+	m_includes.erase(found);
+}
+
+void CGLSLIncludeCache::clear()
+{
+	std::unique_lock<std::shared_mutex> lock(m_lock);
+	m_entries.clear();
+	m_includes.clear();
+	m_includedBy.clear();
+}
+
+CGLSLIncludeCache::SStatistics CGLSLIncludeCache::getStatistics() const
+{
+	SStatistics retval;
+	retval.hits = m_hits.load(std::memory_order_relaxed);
+	retval.misses = m_misses.load(std::memory_order_relaxed);
+	std::shared_lock<std::shared_mutex> lock(m_lock);
+	retval.entryCount = static_cast<uint32_t>(m_entries.size());
+	return retval;
+}
+
+}
+}
@@ -3,6 +3,7 @@
 // For conditions of distribution and use, see copyright notice in nabla.h
 
 #include <vector>
+#include <atomic>
 #include <numeric>
 #include <functional>
 #include <algorithm>
@@ -13,8 +14,9 @@
 #include "nbl/asset/asset.h"
 #include "nbl/asset/CMeshManipulator.h"
 #include "nbl/asset/CSmoothNormalGenerator.h"
-#include "nbl/asset/CForsythVertexCacheOptimizer.h"
+#include "nbl/asset/CTipsifyVertexCacheOptimizer.h"
 #include "nbl/asset/COverdrawMeshOptimizer.h"
+#include "nbl/asset/CQuadricMeshSimplifier.h"
 
 namespace nbl
 {
@@ -149,6 +151,8 @@ core::smart_refctd_ptr<ICPUMeshBuffer> CMeshManipulator::createMeshBufferFetchOp
 	size_t offsets[MAX_ATTRIBS];
 	memset(offsets, -1, sizeof(offsets));
 	E_FORMAT types[MAX_ATTRIBS];
+	for (size_t i = 0; i < MAX_ATTRIBS; ++i)
+		types[i] = outbuffer->isAttributeEnabled(i) ? outbuffer->getAttribFormat(i) : EF_UNKNOWN;
 	if (buffers.size() != 1)
 	{
 		size_t lastOffset = 0u;
@@ -157,14 +161,13 @@ core::smart_refctd_ptr<ICPUMeshBuffer> CMeshManipulator::createMeshBufferFetchOp
 		{
 			if (outbuffer->isAttributeEnabled(i))
 			{
-				types[i] = outbuffer->getAttribFormat(i);
-
                 const uint32_t typeSz = getTexelOrBlockBytesize(types[i]);
                 const size_t alignment = (typeSz/getFormatChannelCount(types[i]) == 8u) ? 8ull : 4ull; // if format 64bit per channel, then align to 8
 
 				offsets[i] = lastOffset + lastSize;
 				const size_t mod = offsets[i] % alignment;
-				offsets[i] += mod;
+				if (mod)
+					offsets[i] += alignment - mod;
 
 				lastOffset = offsets[i];
                 lastSize = typeSz;
@@ -468,17 +471,10 @@ core::smart_refctd_ptr<ICPUMeshBuffer> IMeshManipulator::createMeshBufferWelded(
         return cmpVertices(inbuffer, _va, _vb, vertexSize, _errMetrics);
     };
 
-    size_t vertexCount = inbuffer->calcVertexCount();
-    E_INDEX_TYPE oldIndexType = inbuffer->getIndexType();
-
+    const size_t vertexCount = inbuffer->calcVertexCount();
     if (!vertexCount)
         return nullptr;
 
-    // reset redirect list
-    uint32_t* redirects = new uint32_t[vertexCount];
-
-    uint32_t maxRedirect = 0;
-
     uint8_t* epicData = (uint8_t*)_NBL_ALIGNED_MALLOC(vertexSize*vertexCount,_NBL_SIMD_ALIGNMENT);
     for (size_t i=0; i < vertexCount; i++)
     {
@@ -495,90 +491,141 @@ core::smart_refctd_ptr<ICPUMeshBuffer> IMeshManipulator::createMeshBufferWelded(
         }
     }
 
-    for (size_t i=0; i<vertexCount; i++)
+    // Quantize positions onto a grid with cells as large as the position epsilon, two vertices which could weld are then at most one cell apart.
+    // If the positions cannot be put on a grid (no position attribute, integer positions or an angular metric) all vertices land in one cell.
+    const uint32_t posAttrId = inbuffer->getPositionAttributeIx();
+    uint32_t gridDims = 0u;
+    double invCellSize[3] = { 0.0,0.0,0.0 };
+    if (posAttrId<MAX_ATTRIBS && bufferPresent[posAttrId] && _errMetrics[posAttrId].method==EEM_POSITIONS)
     {
-        uint32_t redir = i;
-        for (size_t j = 0u; j < vertexCount; ++j)
+        const E_FORMAT posFormat = inbuffer->getAttribFormat(posAttrId);
+        if (!isIntegerFormat(posFormat))
         {
-            if (i == j)
-                continue;
-            if (cmpfunc(epicData+vertexSize*i, epicData+vertexSize*j))
+            gridDims = core::min(getFormatChannelCount(posFormat),3u);
+            for (uint32_t c=0u; c<gridDims; c++)
             {
-                redir = j;
-                break;
+                const float eps = _errMetrics[posAttrId].epsilon.pointer[c];
+                if (!(eps>0.f)) // exact comparison or NaN, cells would be infinitely small
+                    gridDims = 0u;
+                else
+                    invCellSize[c] = 1.0/double(eps);
             }
         }
-
-        redirects[i] = redir;
-        if (redir>maxRedirect)
-            maxRedirect = redir;
     }
-    _NBL_ALIGNED_FREE(epicData);
 
-    void* oldIndices = inbuffer->getIndices();
-    core::smart_refctd_ptr<ICPUMeshBuffer> clone;
-    if (makeNewMesh)
-        clone = core::smart_refctd_ptr_static_cast<ICPUMeshBuffer>(inbuffer->clone(0u));
-    else
+    struct SCellKey
     {
-        if (!oldIndices)
+        uint64_t hash;
+        uint32_t vertex;
+
+        inline bool operator<(const SCellKey& other) const
         {
-            inbuffer->setIndexBufferBinding({ 0u, core::make_smart_refctd_ptr<ICPUBuffer>((maxRedirect >= 0x10000u ? sizeof(uint32_t) : sizeof(uint16_t)) * inbuffer->getIndexCount()) });
-            inbuffer->setIndexType(maxRedirect>=0x10000u ? EIT_32BIT:EIT_16BIT);
+            return hash<other.hash || (hash==other.hash && vertex<other.vertex);
         }
-    }
-
-
-    if (oldIndexType==EIT_16BIT)
+    };
+    using cell_t = std::array<int64_t,3u>;
+    auto hashCell = [](const cell_t& cell) -> uint64_t
     {
-        uint16_t* indicesIn = reinterpret_cast<uint16_t*>(oldIndices);
-        if ((makeNewMesh ? clone.get():inbuffer)->getIndexType()==EIT_32BIT)
+        uint64_t h = 0xcbf29ce484222325ull;
+        for (auto c : cell)
         {
-            uint32_t* indicesOut = reinterpret_cast<uint32_t*>((makeNewMesh ? clone.get():inbuffer)->getIndices());
-            for (size_t i=0; i<inbuffer->getIndexCount(); i++)
-                indicesOut[i] = redirects[indicesIn[i]];
+            h ^= static_cast<uint64_t>(c);
+            h *= 0x100000001b3ull;
+            h ^= h>>29u;
         }
-        else if ((makeNewMesh ? clone.get():inbuffer)->getIndexType()==EIT_16BIT)
+        return h;
+    };
+
+    core::vector<cell_t> cells(vertexCount);
+    core::vector<SCellKey> keys(vertexCount);
+    for (uint32_t i=0u; i<vertexCount; i++)
+    {
+        cell_t& cell = cells[i];
+        cell = { 0ll,0ll,0ll };
+        if (gridDims)
         {
-            uint16_t* indicesOut = reinterpret_cast<uint16_t*>((makeNewMesh ? clone.get():inbuffer)->getIndices());
-            for (size_t i=0; i<inbuffer->getIndexCount(); i++)
-                indicesOut[i] = redirects[indicesIn[i]];
+            core::vectorSIMDf pos;
+            inbuffer->getAttribute(pos,posAttrId,i);
+            for (uint32_t c=0u; c<gridDims; c++)
+            {
+                constexpr double maxCell = double(1ll<<62);
+                cell[c] = static_cast<int64_t>(core::clamp(std::floor(double(pos.pointer[c])*invCellSize[c]),-maxCell,maxCell));
+            }
         }
+        keys[i] = { hashCell(cell),i };
     }
-    else if (oldIndexType==EIT_32BIT)
+    auto* scheduler = core::CWorkStealingScheduler::getDefault();
+    scheduler->parallel_sort(keys.begin(),keys.end());
+
+    // Finds the smallest vertex index lower than `_vx` which welds with it and satisfies the predicate, only neighbouring grid cells are searched.
+    auto findWeldCandidate = [&](const uint32_t _vx, auto _pred) -> uint32_t
     {
-        uint32_t* indicesIn = reinterpret_cast<uint32_t*>(oldIndices);
-        if ((makeNewMesh ? clone.get():inbuffer)->getIndexType()==EIT_32BIT)
-        {
-            uint32_t* indicesOut = reinterpret_cast<uint32_t*>((makeNewMesh ? clone.get():inbuffer)->getIndices());
-            for (size_t i=0; i<inbuffer->getIndexCount(); i++)
-                indicesOut[i] = redirects[indicesIn[i]];
-        }
-        else if ((makeNewMesh ? clone.get():inbuffer)->getIndexType()==EIT_16BIT)
+        uint32_t retval = _vx;
+        const int64_t extent[3] = { gridDims>0u ? 1ll:0ll,gridDims>1u ? 1ll:0ll,gridDims>2u ? 1ll:0ll };
+        const cell_t& cell = cells[_vx];
+        for (int64_t z=-extent[2]; z<=extent[2]; z++)
+        for (int64_t y=-extent[1]; y<=extent[1]; y++)
+        for (int64_t x=-extent[0]; x<=extent[0]; x++)
         {
-            uint16_t* indicesOut = reinterpret_cast<uint16_t*>((makeNewMesh ? clone.get():inbuffer)->getIndices());
-            for (size_t i=0; i<inbuffer->getIndexCount(); i++)
-                indicesOut[i] = redirects[indicesIn[i]];
+            const uint64_t hash = hashCell({ cell[0]+x,cell[1]+y,cell[2]+z });
+            // entries within a cell are sorted by vertex index, so we can stop at the first one not below the current best
+            for (auto it=std::lower_bound(keys.begin(),keys.end(),SCellKey{hash,0u}); it!=keys.end() && it->hash==hash && it->vertex<retval; it++)
+            if (_pred(it->vertex) && cmpfunc(epicData+vertexSize*_vx,epicData+vertexSize*it->vertex))
+            {
+                retval = it->vertex;
+                break;
+            }
         }
-    }
-    else if ((makeNewMesh ? clone.get():inbuffer)->getIndexType()==EIT_32BIT)
+        return retval;
+    };
+
+    // every vertex finds its first match independently
+    core::vector<uint32_t> redirects(vertexCount);
+    scheduler->parallel_for(0u,vertexCount,[&](const size_t i) -> void
     {
-        uint32_t* indicesOut = reinterpret_cast<uint32_t*>((makeNewMesh ? clone.get():inbuffer)->getIndices());
-        for (size_t i=0; i<inbuffer->getIndexCount(); i++)
-            indicesOut[i] = redirects[i];
-    }
-    else if ((makeNewMesh ? clone.get():inbuffer)->getIndexType()==EIT_16BIT)
+        const uint32_t vertex = keys[i].vertex;
+        redirects[vertex] = findWeldCandidate(vertex,[](uint32_t) {return true;});
+    });
+    // then in order of vertex index we make sure that vertices only weld onto vertices which were not welded themselves
+    uint32_t maxRedirect = 0u;
+    for (uint32_t i=0u; i<vertexCount; i++)
     {
-        uint16_t* indicesOut = reinterpret_cast<uint16_t*>((makeNewMesh ? clone.get():inbuffer)->getIndices());
-        for (size_t i=0; i<inbuffer->getIndexCount(); i++)
-            indicesOut[i] = redirects[i];
+        uint32_t& redir = redirects[i];
+        if (redir!=i && redirects[redir]!=redir)
+            redir = findWeldCandidate(i,[&redirects](uint32_t j) {return redirects[j]==j;});
+        maxRedirect = core::max(redir,maxRedirect);
     }
-    delete [] redirects;
+    _NBL_ALIGNED_FREE(epicData);
 
+    core::smart_refctd_ptr<ICPUMeshBuffer> retval;
     if (makeNewMesh)
-        return clone;
+        retval = core::smart_refctd_ptr_static_cast<ICPUMeshBuffer>(inbuffer->clone(0u));
+    else
+        retval = core::smart_refctd_ptr<ICPUMeshBuffer>(inbuffer);
+
+    // write out a fresh index buffer (the old one could be shared), only referencing the welded vertices
+    const E_INDEX_TYPE oldIndexType = inbuffer->getIndices() ? inbuffer->getIndexType():EIT_UNKNOWN;
+    E_INDEX_TYPE newIndexType = oldIndexType;
+    if (optimIndexType || oldIndexType==EIT_UNKNOWN)
+        newIndexType = maxRedirect>=0x10000u ? EIT_32BIT:EIT_16BIT;
+    const uint32_t indexCount = inbuffer->getIndexCount();
+    auto newIndexBuffer = core::make_smart_refctd_ptr<ICPUBuffer>((newIndexType==EIT_32BIT ? sizeof(uint32_t):sizeof(uint16_t))*indexCount);
+    if (newIndexType==EIT_32BIT)
+    {
+        uint32_t* indicesOut = reinterpret_cast<uint32_t*>(newIndexBuffer->getPointer());
+        for (uint32_t i=0u; i<indexCount; i++)
+            indicesOut[i] = redirects[inbuffer->getIndexValue(i)];
+    }
     else
-        return core::smart_refctd_ptr<ICPUMeshBuffer>(inbuffer);
+    {
+        uint16_t* indicesOut = reinterpret_cast<uint16_t*>(newIndexBuffer->getPointer());
+        for (uint32_t i=0u; i<indexCount; i++)
+            indicesOut[i] = redirects[inbuffer->getIndexValue(i)];
+    }
+    retval->setIndexBufferBinding({ 0u,std::move(newIndexBuffer) });
+    retval->setIndexType(newIndexType);
+
+    return retval;
 }
 
 core::smart_refctd_ptr<ICPUMeshBuffer> IMeshManipulator::createOptimizedMeshBuffer(const ICPUMeshBuffer* _inbuffer, const SErrorMetric* _errMetric)
@@ -640,18 +687,8 @@ core::smart_refctd_ptr<ICPUMeshBuffer> IMeshManipulator::createOptimizedMeshBuff
     // STEP: filter invalid triangles
     filterInvalidTriangles(outbuffer.get());
 
-	// STEP: overdraw optimization
-	COverdrawMeshOptimizer::createOptimized(outbuffer.get(), false);
-
-	// STEP: Forsyth
-	{
-		uint32_t* indices = reinterpret_cast<uint32_t*>(outbuffer->getIndices());
-		CForsythVertexCacheOptimizer forsyth;
-		forsyth.optimizeTriangleOrdering(vertexCount, outbuffer->getIndexCount(), indices, indices);
-	}
-
-	// STEP: prefetch optimization
-	outbuffer = CMeshManipulator::createMeshBufferFetchOptimized(outbuffer.get()); // here we also get interleaved attributes (single vertex buffer)
+	// STEP: vertex cache, overdraw and prefetch optimization
+	outbuffer = createMeshBufferCacheOptimized(outbuffer.get()); // here we also get interleaved attributes (single vertex buffer)
 	
 	// STEP: requantization
 	requantizeMeshBuffer(outbuffer.get(), _errMetric);
@@ -757,45 +794,469 @@ core::smart_refctd_ptr<ICPUMeshBuffer> IMeshManipulator::createOptimizedMeshBuff
 	return outbuffer;
 }
 
-void IMeshManipulator::requantizeMeshBuffer(ICPUMeshBuffer* _meshbuffer, const SErrorMetric* _errMetric)
+IMeshManipulator::SVertexCacheStatistics IMeshManipulator::calculateVertexCacheStatistics(const ICPUMeshBuffer* _meshbuffer, const uint32_t _fifoSize, const uint32_t _cacheLineSize)
 {
-    constexpr uint32_t MAX_ATTRIBS = ICPUMeshBuffer::MAX_VERTEX_ATTRIB_COUNT;
+	SVertexCacheStatistics retval;
+	if (!_meshbuffer || !_meshbuffer->getPipeline() || !_cacheLineSize)
+		return retval;
 
-	CMeshManipulator::SAttrib newAttribs[MAX_ATTRIBS];
-	for (size_t i = 0u; i < MAX_ATTRIBS; ++i)
-		newAttribs[i].vaid = i;
+	const uint32_t indexCount = _meshbuffer->getIndexCount()/3u*3u;
+	const size_t vertexCount = _meshbuffer->calcVertexCount();
+	if (!indexCount || !vertexCount)
+		return retval;
+
+	// byte range of every per-vertex binding which gets read for a single vertex
+	struct SFetchRange
+	{
+		const uint8_t* base;
+		size_t stride;
+		uint32_t begin;
+		uint32_t end;
+	};
+	core::vector<SFetchRange> fetchRanges;
+	size_t vertexBytes = 0u;
+	{
+		const auto& vtxParams = _meshbuffer->getPipeline()->getVertexInputParams();
+		for (uint32_t b=0u; b<SVertexInputParams::MAX_ATTR_BUF_BINDING_COUNT; b++)
+		{
+			const auto& binding = _meshbuffer->getVertexBufferBindings()[b];
+			if (!(vtxParams.enabledBindingFlags&(1u<<b)) || vtxParams.bindings[b].inputRate!=EVIR_PER_VERTEX || !binding.buffer)
+				continue;
 
-    CQuantNormalCache quantizationCache;
+			SFetchRange range = {reinterpret_cast<const uint8_t*>(binding.buffer->getPointer())+binding.offset,vtxParams.bindings[b].stride,~0u,0u};
+			for (uint32_t a=0u; a<SVertexInputParams::MAX_VERTEX_ATTRIB_COUNT; a++)
+			if ((vtxParams.enabledAttribFlags&(1u<<a)) && vtxParams.attributes[a].binding==b)
+			{
+				const uint32_t relOffset = vtxParams.attributes[a].relativeOffset;
+				range.begin = core::min(range.begin,relOffset);
+				range.end = core::max(range.end,relOffset+getTexelOrBlockBytesize(static_cast<E_FORMAT>(vtxParams.attributes[a].format)));
+			}
+			if (range.begin>=range.end)
+				continue;
+			vertexBytes += range.end-range.begin;
+			fetchRanges.push_back(range);
+		}
+	}
 
-	core::unordered_map<uint32_t, core::vector<CMeshManipulator::SIntegerAttr>> attribsI;
-	core::unordered_map<uint32_t, core::vector<core::vectorSIMDf>> attribsF;
-	for (size_t vaid = 0u; vaid < MAX_ATTRIBS; ++vaid)
+	// direct mapped cache of 128 KiB (for 64 byte lines), roughly what sits between the vertex fetch and memory
+	constexpr size_t FetchCacheLines = 2048u;
+	core::vector<uintptr_t> fetchCache(FetchCacheLines,0u);
+	core::vector<size_t> cacheTimestamps(vertexCount,0u);
+	core::vector<bool> referenced(vertexCount,false);
+	size_t timestamp = _fifoSize+1u;
+	size_t transformed = 0u;
+	size_t uniqueVertices = 0u;
+	size_t fetchedLines = 0u;
+	for (uint32_t i=0u; i<indexCount; i++)
 	{
-        const E_FORMAT type = _meshbuffer->getAttribFormat(vaid);
+		const uint32_t index = _meshbuffer->getIndexValue(i);
+		if (index>=vertexCount)
+			continue;
+		if (!referenced[index])
+		{
+			referenced[index] = true;
+			uniqueVertices++;
+		}
+		if (timestamp-cacheTimestamps[index]<=_fifoSize)
+			continue;
+		cacheTimestamps[index] = timestamp++;
+		transformed++;
 
-        auto* vbuf = _meshbuffer->getAttribBoundBuffer(vaid);
-		if (_meshbuffer->isAttributeEnabled(vaid) && vbuf->buffer)
+		const int64_t vertex = int64_t(_meshbuffer->getBaseVertex())+index;
+		for (const auto& range : fetchRanges)
 		{
-			if (!isNormalizedFormat(type) && isIntegerFormat(type))
-				attribsI[vaid] = CMeshManipulator::findBetterFormatI(&newAttribs[vaid].type, &newAttribs[vaid].size, &newAttribs[vaid].prevType, _meshbuffer, vaid, _errMetric[vaid]);
+			const uintptr_t first = reinterpret_cast<uintptr_t>(range.base+vertex*range.stride+range.begin)/_cacheLineSize;
+			const uintptr_t last = reinterpret_cast<uintptr_t>(range.base+vertex*range.stride+range.end-1u)/_cacheLineSize;
+			for (uintptr_t line=first; line<=last; line++)
+			{
+				uintptr_t& slot = fetchCache[line%FetchCacheLines];
+				if (slot!=line+1u)
+				{
+					slot = line+1u;
+					fetchedLines++;
+				}
+			}
+		}
+	}
+
+	retval.acmr = float(transformed)/float(indexCount/3u);
+	retval.atvr = uniqueVertices ? float(transformed)/float(uniqueVertices):0.f;
+	retval.overfetch = (uniqueVertices&&vertexBytes) ? float(fetchedLines*_cacheLineSize)/float(uniqueVertices*vertexBytes):0.f;
+	return retval;
+}
+
+core::smart_refctd_ptr<ICPUMeshBuffer> IMeshManipulator::createMeshBufferCacheOptimized(const ICPUMeshBuffer* _inbuffer, const uint32_t _fifoSize, const float _overdrawThreshold, SVertexCacheStatistics* _outStatistics)
+{
+	if (!_inbuffer || !_inbuffer->getPipeline())
+		return nullptr;
+	if (_inbuffer->getPipeline()->getPrimitiveAssemblyParams().primitiveType!=EPT_TRIANGLE_LIST)
+		return nullptr;
+
+	const uint32_t indexCount = _inbuffer->getIndexCount()/3u*3u;
+	const size_t vertexCount = _inbuffer->calcVertexCount();
+
+	// widen to 32bit (or make up an index buffer if there was none)
+	core::vector<uint32_t> indices(indexCount);
+	for (uint32_t i=0u; i<indexCount; i++)
+		indices[i] = _inbuffer->getIndexValue(i);
+
+	// STEP: vertex cache optimization
+	auto newIndexBuffer = core::make_smart_refctd_ptr<ICPUBuffer>(sizeof(uint32_t)*indexCount);
+	core::vector<uint32_t> clusters;
+	CTipsifyVertexCacheOptimizer tipsify(_fifoSize);
+	tipsify.optimizeTriangleOrdering(vertexCount,indexCount,indices.data(),reinterpret_cast<uint32_t*>(newIndexBuffer->getPointer()),&clusters);
+
+	// fetch optimization makes a deep copy anyway, so no need for one here
+	auto outbuffer = core::smart_refctd_ptr_static_cast<ICPUMeshBuffer>(_inbuffer->clone(0u));
+	outbuffer->setIndexBufferBinding({0u,std::move(newIndexBuffer)});
+	outbuffer->setIndexType(EIT_32BIT);
+	outbuffer->setIndexCount(indexCount);
+
+	// STEP: overdraw optimization, only moves whole Tipsify clusters around
+	if (_overdrawThreshold>=1.f && outbuffer->isAttributeEnabled(outbuffer->getPositionAttributeIx()))
+		COverdrawMeshOptimizer::createOptimized(outbuffer.get(),false,_overdrawThreshold,_fifoSize,&clusters);
+
+	// STEP: prefetch optimization
+	outbuffer = CMeshManipulator::createMeshBufferFetchOptimized(outbuffer.get());
+
+	if (outbuffer && _outStatistics)
+		*_outStatistics = calculateVertexCacheStatistics(outbuffer.get(),_fifoSize);
+	return outbuffer;
+}
+
+namespace
+{
+	// fixed size copies become plain moves, 16 byte multiples go through unaligned SSE loads and stores
+	template<size_t Size>
+	inline void copyStrided(uint8_t* _dst, size_t _dstStride, const uint8_t* _src, size_t _srcStride, size_t _count)
+	{
+		for (size_t i=0u; i<_count; i++,_dst+=_dstStride,_src+=_srcStride)
+		{
+#ifdef __NBL_COMPILE_WITH_X86_SIMD_
+			if constexpr ((Size%16u)==0u)
+			{
+				for (size_t j=0u; j<Size; j+=16u)
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(_dst+j),_mm_loadu_si128(reinterpret_cast<const __m128i*>(_src+j)));
+			}
 			else
-				attribsF[vaid] = CMeshManipulator::findBetterFormatF(&newAttribs[vaid].type, &newAttribs[vaid].size, &newAttribs[vaid].prevType, _meshbuffer, vaid, _errMetric[vaid], quantizationCache);
+#endif
+				memcpy(_dst,_src,Size);
 		}
 	}
+}
 
-	const size_t activeAttributeCount = attribsI.size() + attribsF.size();
+void CMeshManipulator::copyAttribute(uint8_t* _dst, size_t _dstStride, const SAttribSource& _src, size_t _attribSize, const SVertexRange& _range)
+{
+	uint8_t* dst = _dst+_range.first*_dstStride;
+	const uint8_t* src = reinterpret_cast<const uint8_t*>(_src.getVertex(_range.first));
+	const size_t count = _range.second-_range.first;
+	// planar to planar
+	if (_dstStride==_attribSize && _src.stride==_attribSize)
+	{
+		memcpy(dst,src,count*_attribSize);
+		return;
+	}
+	switch (_attribSize)
+	{
+		case 1u: copyStrided<1u>(dst,_dstStride,src,_src.stride,count); break;
+		case 2u: copyStrided<2u>(dst,_dstStride,src,_src.stride,count); break;
+		case 3u: copyStrided<3u>(dst,_dstStride,src,_src.stride,count); break;
+		case 4u: copyStrided<4u>(dst,_dstStride,src,_src.stride,count); break;
+		case 6u: copyStrided<6u>(dst,_dstStride,src,_src.stride,count); break;
+		case 8u: copyStrided<8u>(dst,_dstStride,src,_src.stride,count); break;
+		case 12u: copyStrided<12u>(dst,_dstStride,src,_src.stride,count); break;
+		case 16u: copyStrided<16u>(dst,_dstStride,src,_src.stride,count); break;
+		case 24u: copyStrided<24u>(dst,_dstStride,src,_src.stride,count); break;
+		case 32u: copyStrided<32u>(dst,_dstStride,src,_src.stride,count); break;
+		default:
+			for (size_t i=0u; i<count; i++)
+				memcpy(dst+i*_dstStride,src+i*_src.stride,_attribSize);
+			break;
+	}
+}
+
+core::smart_refctd_ptr<ICPUMeshBuffer> IMeshManipulator::createMeshBufferWithLayout(const ICPUMeshBuffer* _inbuffer, const E_VERTEX_LAYOUT _layout)
+{
+	if (!_inbuffer || !_inbuffer->getPipeline())
+		return nullptr;
+
+	constexpr uint32_t MAX_ATTRIBS = ICPUMeshBuffer::MAX_VERTEX_ATTRIB_COUNT;
+	constexpr uint32_t MAX_BINDINGS = ICPUMeshBuffer::MAX_ATTR_BUF_BINDING_COUNT;
+	constexpr size_t StreamAlignment = 64u;
+	const auto& oldParams = _inbuffer->getPipeline()->getVertexInputParams();
 
-#ifdef _NBL_DEBUG
+	// sort attributes into streams
+	uint32_t instanceBindings = 0u;
+	uint32_t unboundAttribs = 0u;
+	core::vector<uint32_t> positionStream, otherStream;
+	for (uint32_t attr=0u; attr<MAX_ATTRIBS; attr++)
+	{
+		if (!_inbuffer->isAttributeEnabled(attr))
+			continue;
+		if (!_inbuffer->getAttribPointer(attr))
+		{
+			unboundAttribs |= 0x1u<<attr;
+			continue;
+		}
+		const uint32_t binding = oldParams.attributes[attr].binding;
+		if (oldParams.bindings[binding].inputRate!=EVIR_PER_VERTEX)
+			instanceBindings |= 0x1u<<binding;
+		else if (_layout==EVL_POSITION_SPLIT && attr==_inbuffer->getPositionAttributeIx())
+			positionStream.push_back(attr);
+		else
+			otherStream.push_back(attr);
+	}
+	core::vector<core::vector<uint32_t>> streamAttribs;
+	if (!positionStream.empty())
+		streamAttribs.push_back(std::move(positionStream));
+	if (_layout==EVL_PLANAR)
 	{
-		core::unordered_set<size_t> sizesSet;
-		for (core::unordered_map<uint32_t, core::vector<CMeshManipulator::SIntegerAttr>>::iterator it = attribsI.begin(); it != attribsI.end(); ++it)
-			sizesSet.insert(it->second.size());
-		for (core::unordered_map<uint32_t, core::vector<core::vectorSIMDf>>::iterator it = attribsF.begin(); it != attribsF.end(); ++it)
-			sizesSet.insert(it->second.size());
-		_NBL_DEBUG_BREAK_IF(sizesSet.size() != 1);
+		for (const uint32_t attr : otherStream)
+			streamAttribs.push_back({attr});
 	}
-#endif
-	const size_t vertexCnt = (!attribsI.empty() ? attribsI.begin()->second.size() : (!attribsF.empty() ? attribsF.begin()->second.size() : 0));
+	else if (!otherStream.empty())
+		streamAttribs.push_back(std::move(otherStream));
+
+	// lay out the streams, attribute alignment follows createMeshBufferFetchOptimized
+	struct SStream
+	{
+		uint32_t binding;
+		size_t offset;
+		size_t stride;
+	};
+	core::vector<SStream> streams(streamAttribs.size());
+	auto newPipeline = core::smart_refctd_ptr_static_cast<ICPURenderpassIndependentPipeline>(_inbuffer->getPipeline()->clone(0u));
+	auto& newParams = newPipeline->getVertexInputParams();
+	newParams.enabledBindingFlags &= instanceBindings;
+	// their binding would point at whichever stream got its number, so they can't stay enabled
+	newParams.enabledAttribFlags &= ~unboundAttribs;
+	const size_t vertexCount = _inbuffer->calcVertexCount();
+	size_t bufferSize = 0u;
+	{
+		uint32_t nextBinding = 0u;
+		for (size_t s=0u; s<streams.size(); s++)
+		{
+			while (nextBinding<MAX_BINDINGS && (instanceBindings&(0x1u<<nextBinding)))
+				nextBinding++;
+			if (nextBinding>=MAX_BINDINGS)
+				return nullptr;
+			auto& stream = streams[s];
+			stream.binding = nextBinding++;
+
+			size_t vertexSize = 0u;
+			size_t maxAlignment = 1u;
+			for (const uint32_t attr : streamAttribs[s])
+			{
+				const E_FORMAT format = _inbuffer->getAttribFormat(attr);
+				const uint32_t size = getTexelOrBlockBytesize(format);
+				const size_t alignment = (size/getFormatChannelCount(format)==8u) ? 8ull:4ull; // if format 64bit per channel, then align to 8
+				vertexSize = core::roundUp<size_t>(vertexSize,alignment);
+				maxAlignment = core::max(maxAlignment,alignment);
+
+				newParams.attributes[attr].binding = stream.binding;
+				newParams.attributes[attr].relativeOffset = vertexSize;
+				vertexSize += size;
+			}
+			stream.stride = core::roundUp<size_t>(vertexSize,maxAlignment);
+			stream.offset = bufferSize;
+			bufferSize = core::roundUp<size_t>(bufferSize+stream.stride*vertexCount,StreamAlignment);
+
+			newParams.enabledBindingFlags |= 0x1u<<stream.binding;
+			newParams.bindings[stream.binding].stride = stream.stride;
+			newParams.bindings[stream.binding].inputRate = EVIR_PER_VERTEX;
+		}
+	}
+
+	// copy, every task moves one range of one attribute
+	auto newVertexBuffer = core::make_smart_refctd_ptr<ICPUBuffer>(core::max<size_t>(bufferSize,1u));
+	uint8_t* const newData = reinterpret_cast<uint8_t*>(newVertexBuffer->getPointer());
+	{
+		struct SCopyJob
+		{
+			uint32_t attr;
+			uint8_t* dst;
+			size_t dstStride;
+			CMeshManipulator::SVertexRange range;
+		};
+		core::vector<SCopyJob> jobs;
+		const auto ranges = CMeshManipulator::makeVertexRanges(vertexCount);
+		for (size_t s=0u; s<streams.size(); s++)
+		for (const uint32_t attr : streamAttribs[s])
+		for (const auto& range : ranges)
+			jobs.push_back({attr,newData+streams[s].offset+newParams.attributes[attr].relativeOffset,streams[s].stride,range});
+
+		core::CWorkStealingScheduler::getDefault()->parallel_for(0u,jobs.size(),[_inbuffer,&jobs](const size_t j) -> void
+		{
+			const SCopyJob& job = jobs[j];
+			CMeshManipulator::SAttribSource src;
+			src.ptr = _inbuffer->getAttribPointer(job.attr);
+			src.stride = _inbuffer->getAttribStride(job.attr);
+			src.format = _inbuffer->getAttribFormat(job.attr);
+			CMeshManipulator::copyAttribute(job.dst,job.dstStride,src,getTexelOrBlockBytesize(src.format),job.range);
+		},1u);
+	}
+
+	auto outbuffer = core::smart_refctd_ptr_static_cast<ICPUMeshBuffer>(_inbuffer->clone(0u));
+	outbuffer->setPipeline(std::move(newPipeline));
+	for (uint32_t binding=0u; binding<MAX_BINDINGS; binding++)
+	if (!(instanceBindings&(0x1u<<binding)))
+		outbuffer->setVertexBufferBinding({0u,nullptr},binding);
+	for (const auto& stream : streams)
+		outbuffer->setVertexBufferBinding({stream.offset,core::smart_refctd_ptr(newVertexBuffer)},stream.binding);
+	outbuffer->setBaseVertex(0);
+	return outbuffer;
+}
+
+// Used by the simplification functions only
+static void setSimplifiedIndices(ICPUMeshBuffer* _meshbuffer, const core::vector<uint32_t>& _indices, const size_t _vertexCount)
+{
+	core::smart_refctd_ptr<ICPUBuffer> indexBuffer;
+	if (_vertexCount<=0x10000u)
+	{
+		indexBuffer = core::make_smart_refctd_ptr<ICPUBuffer>(sizeof(uint16_t)*_indices.size());
+		std::copy(_indices.begin(),_indices.end(),reinterpret_cast<uint16_t*>(indexBuffer->getPointer()));
+		_meshbuffer->setIndexType(EIT_16BIT);
+	}
+	else
+	{
+		indexBuffer = core::make_smart_refctd_ptr<ICPUBuffer>(sizeof(uint32_t)*_indices.size());
+		std::copy(_indices.begin(),_indices.end(),reinterpret_cast<uint32_t*>(indexBuffer->getPointer()));
+		_meshbuffer->setIndexType(EIT_32BIT);
+	}
+	_meshbuffer->setIndexBufferBinding({0u,std::move(indexBuffer)});
+	_meshbuffer->setIndexCount(_indices.size());
+}
+
+static bool canBeSimplified(const ICPUMeshBuffer* _meshbuffer)
+{
+	if (!_meshbuffer || !_meshbuffer->getPipeline())
+		return false;
+	return _meshbuffer->getPipeline()->getPrimitiveAssemblyParams().primitiveType==EPT_TRIANGLE_LIST && _meshbuffer->isAttributeEnabled(_meshbuffer->getPositionAttributeIx());
+}
+
+static core::vector<core::smart_refctd_ptr<ICPUMeshBuffer>> createLODChain(const ICPUMeshBuffer* _inbuffer, const uint32_t _lodCount, const float _triangleRatio, const float _maxError, const bool _lockBorders)
+{
+	core::vector<core::smart_refctd_ptr<ICPUMeshBuffer>> lods;
+	if (!_lodCount || !canBeSimplified(_inbuffer))
+		return lods;
+	lods.push_back(core::smart_refctd_ptr_static_cast<ICPUMeshBuffer>(_inbuffer->clone(0u)));
+
+	const CQuadricMeshSimplifier::SVertexData vertices(_inbuffer);
+	core::vector<uint32_t> indices(_inbuffer->getIndexCount()/3u*3u);
+	for (uint32_t i=0u; i<indices.size(); i++)
+		indices[i] = _inbuffer->getIndexValue(i);
+	while (lods.size()<_lodCount)
+	{
+		const uint32_t prevTriangleCount = indices.size()/3u;
+		CQuadricMeshSimplifier::simplify(vertices,indices,static_cast<uint32_t>(prevTriangleCount*_triangleRatio),_maxError,_lockBorders);
+		if (indices.size()/3u>=prevTriangleCount)
+			break;
+
+		auto lod = core::smart_refctd_ptr_static_cast<ICPUMeshBuffer>(_inbuffer->clone(0u));
+		setSimplifiedIndices(lod.get(),indices,vertices.positions.size());
+		lods.push_back(std::move(lod));
+	}
+	return lods;
+}
+
+core::smart_refctd_ptr<ICPUMeshBuffer> IMeshManipulator::createMeshBufferSimplified(const ICPUMeshBuffer* _inbuffer, const SSimplificationParams& _params, float* _outError)
+{
+	if (!canBeSimplified(_inbuffer))
+		return nullptr;
+
+	const CQuadricMeshSimplifier::SVertexData vertices(_inbuffer);
+	core::vector<uint32_t> indices(_inbuffer->getIndexCount()/3u*3u);
+	for (uint32_t i=0u; i<indices.size(); i++)
+		indices[i] = _inbuffer->getIndexValue(i);
+	const float error = CQuadricMeshSimplifier::simplify(vertices,indices,_params.targetTriangleCount,_params.targetError,_params.lockBorders);
+	if (_outError)
+		*_outError = error;
+
+	auto outbuffer = core::smart_refctd_ptr_static_cast<ICPUMeshBuffer>(_inbuffer->clone(0u));
+	setSimplifiedIndices(outbuffer.get(),indices,vertices.positions.size());
+	return outbuffer;
+}
+
+core::vector<core::smart_refctd_ptr<ICPUMeshBuffer>> IMeshManipulator::createMeshBufferLODChain(const ICPUMeshBuffer* _inbuffer, const uint32_t _lodCount, const float _triangleRatio, const float _maxError)
+{
+	return createLODChain(_inbuffer,_lodCount,_triangleRatio,_maxError,false);
+}
+
+core::vector<core::smart_refctd_ptr<ICPUMesh>> IMeshManipulator::createMeshLODChain(const ICPUMesh* _mesh, const uint32_t _lodCount, const float _triangleRatio, const float _maxError)
+{
+	core::vector<core::smart_refctd_ptr<ICPUMesh>> lods;
+	if (!_mesh || !_lodCount)
+		return lods;
+
+	// shallow copies of the meshbuffers, only their index buffers get replaced
+	for (uint32_t lod=0u; lod<_lodCount; lod++)
+		lods.push_back(core::smart_refctd_ptr_static_cast<ICPUMesh>(_mesh->clone(1u)));
+
+	core::CWorkStealingScheduler::getDefault()->parallel_for(0u,_mesh->getMeshBufferCount(),[&](const size_t _mbIx) -> void
+	{
+		const auto chain = createLODChain(_mesh->getMeshBuffer(_mbIx),_lodCount,_triangleRatio,_maxError,true);
+		if (chain.empty())
+			return;
+		// every task only touches its own meshbuffer of each level, meshbuffers which ran out of levels repeat their last one
+		for (uint32_t lod=1u; lod<_lodCount; lod++)
+		{
+			const ICPUMeshBuffer* src = chain[core::min<size_t>(lod,chain.size()-1u)].get();
+			const auto* binding = src->getIndexBufferBinding();
+			ICPUMeshBuffer* dst = lods[lod]->getMeshBuffer(_mbIx);
+			dst->setIndexBufferBinding({binding->offset,core::smart_refctd_ptr(binding->buffer)});
+			dst->setIndexType(src->getIndexType());
+			dst->setIndexCount(src->getIndexCount());
+		}
+	},1u);
+	return lods;
+}
+
+void IMeshManipulator::requantizeMeshBuffer(ICPUMeshBuffer* _meshbuffer, const SErrorMetric* _errMetric)
+{
+    constexpr uint32_t MAX_ATTRIBS = ICPUMeshBuffer::MAX_VERTEX_ATTRIB_COUNT;
+
+	const size_t vertexCnt = _meshbuffer->calcVertexCount();
+	if (!vertexCnt)
+		return;
+
+	CMeshManipulator::SAttrib newAttribs[MAX_ATTRIBS];
+	CMeshManipulator::SAttribSource sources[MAX_ATTRIBS];
+	core::vector<uint32_t> activeAttribs;
+	for (uint32_t vaid = 0u; vaid < MAX_ATTRIBS; ++vaid)
+	{
+		newAttribs[vaid].vaid = vaid;
+
+        auto* vbuf = _meshbuffer->getAttribBoundBuffer(vaid);
+		if (_meshbuffer->isAttributeEnabled(vaid) && vbuf->buffer && _meshbuffer->getAttribPointer(vaid))
+		{
+			auto& src = sources[vaid];
+			src.buffer = vbuf->buffer;
+			src.ptr = _meshbuffer->getAttribPointer(vaid);
+			src.stride = _meshbuffer->getAttribStride(vaid);
+			src.format = _meshbuffer->getAttribFormat(vaid);
+			activeAttribs.push_back(vaid);
+		}
+	}
+	if (activeAttribs.empty())
+		return;
+
+	const auto ranges = CMeshManipulator::makeVertexRanges(vertexCnt);
+	auto isNativeInteger = [](E_FORMAT _fmt) { return !isNormalizedFormat(_fmt) && isIntegerFormat(_fmt); };
+
+	// attributes are independent of each other, and the candidate formats of each get checked over vertex ranges in parallel
+	auto* scheduler = core::CWorkStealingScheduler::getDefault();
+	scheduler->parallel_for(0u,activeAttribs.size(),[&](const size_t i) -> void
+	{
+		const uint32_t vaid = activeAttribs[i];
+		auto& attrib = newAttribs[vaid];
+		attrib.prevType = sources[vaid].format;
+		if (isNativeInteger(attrib.prevType))
+			attrib.type = CMeshManipulator::findBetterFormatI(&attrib.size, sources[vaid], ranges, _errMetric[vaid]);
+		else
+			attrib.type = CMeshManipulator::findBetterFormatF(&attrib.size, sources[vaid], ranges, _errMetric[vaid]);
+	},1u);
+
+	const size_t activeAttributeCount = activeAttribs.size();
 
 	std::sort(newAttribs, newAttribs + MAX_ATTRIBS, std::greater<CMeshManipulator::SAttrib>()); // sort decreasing by size
 
@@ -813,14 +1274,52 @@ void IMeshManipulator::requantizeMeshBuffer(ICPUMeshBuffer* _meshbuffer, const S
 
 	auto newVertexBuffer = core::make_smart_refctd_ptr<ICPUBuffer>(vertexCnt * vertexSize);
 
-    constexpr uint32_t VTX_BUF_BINDING = 0u;
-    assert(_meshbuffer->getVertexBufferBindings()[0].buffer);
-    assert(_meshbuffer->isVertexAttribBufferBindingEnabled(VTX_BUF_BINDING));
-    _meshbuffer->setVertexBufferBinding({ 0u, core::smart_refctd_ptr(newVertexBuffer) }, VTX_BUF_BINDING);
+	// the old buffers are kept alive by `sources`, every attribute gets streamed straight from them into the new interleaved buffer
+	{
+		uint8_t* const dstBase = reinterpret_cast<uint8_t*>(newVertexBuffer->getPointer());
+		scheduler->parallel_for(0u,ranges.size(),[&](const size_t r) -> void
+		{
+			const auto& range = ranges[r];
+			for (size_t i = 0u; i < activeAttributeCount; ++i)
+			{
+				const auto& attrib = newAttribs[i];
+				const auto& src = sources[attrib.vaid];
+				uint8_t* dst = dstBase + range.first*vertexSize + attrib.offset;
+				if (isNativeInteger(src.format))
+				{
+					for (size_t ix = range.first; ix < range.second; ++ix, dst += vertexSize)
+					{
+						uint32_t value[4];
+						ICPUMeshBuffer::getAttribute(value, src.getVertex(ix), src.format);
+						const bool check = ICPUMeshBuffer::setAttribute(value, dst, attrib.type);
+						_NBL_DEBUG_BREAK_IF(!check)
+					}
+				}
+				else
+				{
+					for (size_t ix = range.first; ix < range.second; ++ix, dst += vertexSize)
+					{
+						core::vectorSIMDf value;
+						ICPUMeshBuffer::getAttribute(value, src.getVertex(ix), src.format);
+						const bool check = ICPUMeshBuffer::setAttribute(value, dst, attrib.type);
+						_NBL_DEBUG_BREAK_IF(!check)
+					}
+				}
+			}
+		},1u);
+	}
 
+    constexpr uint32_t VTX_BUF_BINDING = 0u;
     auto* pipeline = _meshbuffer->getPipeline();
     auto& vtxParams = pipeline->getVertexInputParams();
 
+	// all attributes live in a single binding now, so the other buffers can be let go
+	for (uint32_t i = 0u; i < ICPUMeshBuffer::MAX_ATTR_BUF_BINDING_COUNT; ++i)
+		_meshbuffer->setVertexBufferBinding({}, i);
+    _meshbuffer->setVertexBufferBinding({ 0u, std::move(newVertexBuffer) }, VTX_BUF_BINDING);
+    _meshbuffer->setBaseVertex(0);
+
+    vtxParams.enabledBindingFlags = 1u << VTX_BUF_BINDING;
     vtxParams.bindings[VTX_BUF_BINDING].stride = vertexSize;
     vtxParams.bindings[VTX_BUF_BINDING].inputRate = EVIR_PER_VERTEX;
 	for (size_t i = 0u; i < activeAttributeCount; ++i)
@@ -829,29 +1328,6 @@ void IMeshManipulator::requantizeMeshBuffer(ICPUMeshBuffer* _meshbuffer, const S
         vtxParams.attributes[vaid].binding = VTX_BUF_BINDING;
         vtxParams.attributes[vaid].format = newAttribs[i].type;
         vtxParams.attributes[vaid].relativeOffset = newAttribs[i].offset;
-
-		core::unordered_map<uint32_t, core::vector<CMeshManipulator::SIntegerAttr>>::iterator iti = attribsI.find(newAttribs[i].vaid);
-		if (iti != attribsI.end())
-		{
-			const core::vector<CMeshManipulator::SIntegerAttr>& attrVec = iti->second;
-			for (size_t ai = 0u; ai < attrVec.size(); ++ai)
-			{
-				const bool check = _meshbuffer->setAttribute(attrVec[ai].pointer, newAttribs[i].vaid, ai);
-				_NBL_DEBUG_BREAK_IF(!check)
-			}
-			continue;
-		}
-
-		core::unordered_map<uint32_t, core::vector<core::vectorSIMDf>>::iterator itf = attribsF.find(newAttribs[i].vaid);
-		if (itf != attribsF.end())
-		{
-			const core::vector<core::vectorSIMDf>& attrVec = itf->second;
-			for (size_t ai = 0u; ai < attrVec.size(); ++ai)
-			{
-				const bool check = _meshbuffer->setAttribute(attrVec[ai], newAttribs[i].vaid, ai);
-				_NBL_DEBUG_BREAK_IF(!check)
-			}
-		}
 	}
 }
 
@@ -1003,136 +1479,146 @@ void CMeshManipulator::_filterInvalidTriangles(ICPUMeshBuffer* _input)
 template void CMeshManipulator::_filterInvalidTriangles<uint16_t>(ICPUMeshBuffer* _input);
 template void CMeshManipulator::_filterInvalidTriangles<uint32_t>(ICPUMeshBuffer* _input);
 
-core::vector<core::vectorSIMDf> CMeshManipulator::findBetterFormatF(E_FORMAT* _outType, size_t* _outSize, E_FORMAT* _outPrevType, const ICPUMeshBuffer* _meshbuffer, uint32_t _attrId, const SErrorMetric& _errMetric, CQuantNormalCache& _cache)
+E_FORMAT CMeshManipulator::findBetterFormatF(size_t* _outSize, const SAttribSource& _src, const core::vector<SVertexRange>& _ranges, const SErrorMetric& _errMetric)
 {
-	if (!_meshbuffer->getPipeline())
-        return {};
-
-	const E_FORMAT thisType = _meshbuffer->getAttribFormat(_attrId);
+	const E_FORMAT thisType = _src.format;
+	*_outSize = getTexelOrBlockBytesize(thisType);
 
     if (!isFloatingPointFormat(thisType) && !isNormalizedFormat(thisType) && !isScaledFormat(thisType))
-        return {};
-
-	core::vector<core::vectorSIMDf> attribs;
-
+        return thisType;
 
     const uint32_t cpa = getFormatChannelCount(thisType);
 
-	float min[4]{ FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX };
-	float max[4]{ -FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX };
-
-	core::vectorSIMDf attr;
-    const size_t cnt = _meshbuffer->calcVertexCount();
-    for (size_t idx = 0u; idx < cnt; ++idx)
+	struct SMinMax
+	{
+		float min[4]{ FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX };
+		float max[4]{ -FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	};
+	// streaming min/max pass, the values are decoded again when testing candidates instead of being kept around
+	core::vector<SMinMax> partials(_ranges.size(),SMinMax{});
+	core::CWorkStealingScheduler::getDefault()->parallel_for(0u,_ranges.size(),[&](const size_t r) -> void
 	{
-        _meshbuffer->getAttribute(attr, _attrId, idx);
-		attribs.push_back(attr);
-		for (uint32_t i = 0; i < cpa ; ++i)
+		const SVertexRange& vertices = _ranges[r];
+		SMinMax& retval = partials[r];
+		core::vectorSIMDf attr;
+		for (size_t idx = vertices.first; idx < vertices.second; ++idx)
 		{
-			if (attr.pointer[i] < min[i])
-				min[i] = attr.pointer[i];
-			if (attr.pointer[i] > max[i])
-				max[i] = attr.pointer[i];
+			ICPUMeshBuffer::getAttribute(attr, _src.getVertex(idx), thisType);
+			for (uint32_t i = 0; i < cpa; ++i)
+			{
+				if (attr.pointer[i] < retval.min[i])
+					retval.min[i] = attr.pointer[i];
+				if (attr.pointer[i] > retval.max[i])
+					retval.max[i] = attr.pointer[i];
+			}
 		}
-	}
+	},1u);
+	const SMinMax range = std::accumulate(partials.begin(),partials.end(),SMinMax{},
+		[](const SMinMax& a, const SMinMax& b) -> SMinMax
+		{
+			SMinMax retval;
+			for (uint32_t i = 0; i < 4u; ++i)
+			{
+				retval.min[i] = core::min(a.min[i], b.min[i]);
+				retval.max[i] = core::max(a.max[i], b.max[i]);
+			}
+			return retval;
+		}
+	);
 
-	core::vector<SAttribTypeChoice> possibleTypes = findTypesOfProperRangeF(thisType, getTexelOrBlockBytesize(thisType), min, max, _errMetric);
+	core::vector<SAttribTypeChoice> possibleTypes = findTypesOfProperRangeF(thisType, getTexelOrBlockBytesize(thisType), range.min, range.max, _errMetric);
 	std::sort(possibleTypes.begin(), possibleTypes.end(), [](const SAttribTypeChoice& t1, const SAttribTypeChoice& t2) { return getTexelOrBlockBytesize(t1.type) < getTexelOrBlockBytesize(t2.type); });
 
-	*_outPrevType = thisType;
-    *_outType = thisType;
-    *_outSize = getTexelOrBlockBytesize(*_outType);
-
+	// candidates go from smallest to largest, so the first one within error bounds is the answer
 	for (const SAttribTypeChoice& t : possibleTypes)
 	{
-		if (calcMaxQuantizationError({ thisType }, t, attribs, _errMetric, _cache))
+		if (calcMaxQuantizationError({ thisType }, t, _src, _ranges, _errMetric))
 		{
             if (getTexelOrBlockBytesize(t.type) < getTexelOrBlockBytesize(thisType))
             {
-                *_outType = t.type;
-                *_outSize = getTexelOrBlockBytesize(*_outType);
+                *_outSize = getTexelOrBlockBytesize(t.type);
+                return t.type;
             }
-
-			return attribs;
+			break;
 		}
 	}
 
-	return attribs;
+	return thisType;
 }
 
-core::vector<CMeshManipulator::SIntegerAttr> CMeshManipulator::findBetterFormatI(E_FORMAT* _outType, size_t* _outSize, E_FORMAT* _outPrevType, const ICPUMeshBuffer* _meshbuffer, uint32_t _attrId, const SErrorMetric& _errMetric)
+E_FORMAT CMeshManipulator::findBetterFormatI(size_t* _outSize, const SAttribSource& _src, const core::vector<SVertexRange>& _ranges, const SErrorMetric& _errMetric)
 {
-	if (!_meshbuffer->getPipeline())
-        return {};
-
-    const E_FORMAT thisType = _meshbuffer->getAttribFormat(_attrId);
+    const E_FORMAT thisType = _src.format;
+	*_outSize = getTexelOrBlockBytesize(thisType);
 
     if (!isIntegerFormat(thisType))
-        return {};
+        return thisType;
 
     if (isBGRALayoutFormat(thisType))
-        return {}; // BGRA is supported only by a few normalized types (this is function for integer types)
-
-	core::vector<SIntegerAttr> attribs;
+        return thisType; // BGRA is supported only by a few normalized types (this is function for integer types)
 
+	if (_errMetric.method == EEM_ANGLES) // native integers normals does not change
+		return thisType;
 
     const uint32_t cpa = getFormatChannelCount(thisType);
+	const bool isSigned = isSignedFormat(thisType);
 
-	uint32_t min[4];
-	uint32_t max[4];
-	if (!isSignedFormat(thisType))
-		for (size_t i = 0; i < 4; ++i)
-			min[i] = UINT_MAX;
-	else
-		for (size_t i = 0; i < 4; ++i)
-			min[i] = INT_MAX;
-	if (!isSignedFormat(thisType))
-		for (size_t i = 0; i < 4; ++i)
-			max[i] = 0;
-	else
-		for (size_t i = 0; i < 4; ++i)
-			max[i] = INT_MIN;
-
+	struct SMinMax
+	{
+		uint32_t min[4];
+		uint32_t max[4];
+	};
+	SMinMax identity;
+	for (size_t i = 0; i < 4; ++i)
+	{
+		identity.min[i] = isSigned ? INT_MAX : UINT_MAX;
+		identity.max[i] = isSigned ? INT_MIN : 0u;
+	}
+	auto less = [isSigned](uint32_t a, uint32_t b) -> bool
+	{
+		if (isSigned)
+			return reinterpret_cast<const int32_t&>(a) < reinterpret_cast<const int32_t&>(b);
+		return a < b;
+	};
 
-	SIntegerAttr attr;
-    const size_t cnt = _meshbuffer->calcVertexCount();
-    for (size_t idx = 0u; idx < cnt; ++idx)
+	core::vector<SMinMax> partials(_ranges.size(),identity);
+	core::CWorkStealingScheduler::getDefault()->parallel_for(0u,_ranges.size(),[&](const size_t r) -> void
 	{
-        _meshbuffer->getAttribute(attr.pointer, _attrId, idx);
-		attribs.push_back(attr);
-		for (size_t i = 0; i < cpa; ++i)
+		const SVertexRange& vertices = _ranges[r];
+		SMinMax& retval = partials[r];
+		uint32_t attr[4];
+		for (size_t idx = vertices.first; idx < vertices.second; ++idx)
 		{
-			if (!isSignedFormat(thisType))
+			ICPUMeshBuffer::getAttribute(attr, _src.getVertex(idx), thisType);
+			for (uint32_t i = 0; i < cpa; ++i)
 			{
-				if (attr.pointer[i] < min[i])
-					min[i] = attr.pointer[i];
-				if (attr.pointer[i] > max[i])
-					max[i] = attr.pointer[i];
+				if (less(attr[i], retval.min[i]))
+					retval.min[i] = attr[i];
+				if (less(retval.max[i], attr[i]))
+					retval.max[i] = attr[i];
 			}
-			else
+		}
+	},1u);
+	const SMinMax range = std::accumulate(partials.begin(),partials.end(),identity,
+		[&](const SMinMax& a, const SMinMax& b) -> SMinMax
+		{
+			SMinMax retval;
+			for (uint32_t i = 0; i < 4u; ++i)
 			{
-				if (((int32_t*)attr.pointer + i)[0] < ((int32_t*)min + i)[0])
-					min[i] = attr.pointer[i];
-				if (((int32_t*)attr.pointer + i)[0] > ((int32_t*)max + i)[0])
-					max[i] = attr.pointer[i];
+				retval.min[i] = less(b.min[i], a.min[i]) ? b.min[i] : a.min[i];
+				retval.max[i] = less(a.max[i], b.max[i]) ? b.max[i] : a.max[i];
 			}
+			return retval;
 		}
-	}
-
-	*_outPrevType = *_outType = thisType;
-	*_outSize = getTexelOrBlockBytesize(thisType);
-	*_outPrevType = thisType;
-
-	if (_errMetric.method == EEM_ANGLES) // native integers normals does not change
-		return attribs;
+	);
 
-	*_outType = getBestTypeI(thisType, _outSize, min, max);
-    if (getTexelOrBlockBytesize(*_outType) >= getTexelOrBlockBytesize(thisType))
+	E_FORMAT bestType = getBestTypeI(thisType, _outSize, range.min, range.max);
+    if (getTexelOrBlockBytesize(bestType) >= getTexelOrBlockBytesize(thisType))
     {
-        *_outType = thisType;
         *_outSize = getTexelOrBlockBytesize(thisType);
+        return thisType;
     }
-	return attribs;
+	return bestType;
 }
 
 E_FORMAT CMeshManipulator::getBestTypeI(E_FORMAT _originalType, size_t* _outSize, const uint32_t* _min, const uint32_t* _max)
@@ -1455,7 +1941,7 @@ core::vector<CMeshManipulator::SAttribTypeChoice> CMeshManipulator::findTypesOfP
 	return possibleTypes;
 }
 
-bool CMeshManipulator::calcMaxQuantizationError(const SAttribTypeChoice& _srcType, const SAttribTypeChoice& _dstType, const core::vector<core::vectorSIMDf>& _srcData, const SErrorMetric& _errMetric, CQuantNormalCache& _cache)
+bool CMeshManipulator::calcMaxQuantizationError(const SAttribTypeChoice& _srcType, const SAttribTypeChoice& _dstType, const SAttribSource& _src, const core::vector<SVertexRange>& _ranges, const SErrorMetric& _errMetric)
 {
     using namespace video;
 
@@ -1527,14 +2013,26 @@ bool CMeshManipulator::calcMaxQuantizationError(const SAttribTypeChoice& _srcTyp
 	if (!quantFunc)
 		return false;
 
-	for (const core::vectorSIMDf& d : _srcData)
+	// ranges which start after one of them failed don't bother checking
+	std::atomic<bool> acceptable(true);
+	core::CWorkStealingScheduler::getDefault()->parallel_for(0u,_ranges.size(),[&](const size_t r) -> void
 	{
-		const core::vectorSIMDf quantized = quantFunc(d, _srcType.type, _dstType.type, _cache);
-        if (!compareFloatingPointAttribute(d, quantized, getFormatChannelCount(_srcType.type), _errMetric))
-            return false;
-	}
-
-	return true;
+		if (!acceptable.load(std::memory_order_relaxed))
+			return;
+		CQuantNormalCache cache;
+		core::vectorSIMDf d;
+		for (size_t idx = _ranges[r].first; idx < _ranges[r].second; ++idx)
+		{
+			ICPUMeshBuffer::getAttribute(d, _src.getVertex(idx), _srcType.type);
+			const core::vectorSIMDf quantized = quantFunc(d, _srcType.type, _dstType.type, cache);
+			if (!compareFloatingPointAttribute(d, quantized, getFormatChannelCount(_srcType.type), _errMetric))
+			{
+				acceptable.store(false,std::memory_order_relaxed);
+				return;
+			}
+		}
+	},1u);
+	return acceptable.load(std::memory_order_relaxed);
 }
 
 core::smart_refctd_ptr<ICPUBuffer> IMeshManipulator::idxBufferFromLineStripsToLines(const void* _input, size_t& _idxCount, E_INDEX_TYPE _inIndexType, E_INDEX_TYPE _outIndexType)
@@ -36,6 +36,28 @@ class CMeshManipulator : public IMeshManipulator
 		{
 			E_FORMAT type;
 		};
+		//! Where to read an attribute from, holds onto the buffer so it stays valid after the meshbuffer's bindings get replaced.
+		struct SAttribSource
+		{
+			core::smart_refctd_ptr<ICPUBuffer> buffer;
+			const uint8_t* ptr = nullptr;
+			size_t stride = 0u;
+			E_FORMAT format = EF_UNKNOWN;
+
+			inline const void* getVertex(size_t _ix) const { return ptr+_ix*stride; }
+		};
+		//! Half-open range of vertices processed by a single task of the parallel requantization passes.
+		using SVertexRange = std::pair<size_t,size_t>;
+		static inline core::vector<SVertexRange> makeVertexRanges(size_t _vertexCount)
+		{
+			constexpr size_t VerticesPerRange = 0x1u<<14u;
+
+			core::vector<SVertexRange> ranges;
+			ranges.reserve((_vertexCount+VerticesPerRange-1u)/VerticesPerRange);
+			for (size_t i=0u; i<_vertexCount; i+=VerticesPerRange)
+				ranges.emplace_back(i,core::min(i+VerticesPerRange,_vertexCount));
+			return ranges;
+		}
 
 	public:
 		static core::smart_refctd_ptr<ICPUMeshBuffer> createMeshBufferFetchOptimized(const ICPUMeshBuffer* _inbuffer);
@@ -68,21 +90,21 @@ class CMeshManipulator : public IMeshManipulator
 			return out;
 		}
 
-		static core::vector<core::vectorSIMDf> findBetterFormatF(E_FORMAT* _outType, size_t* _outSize, E_FORMAT* _outPrevType, const ICPUMeshBuffer* _meshbuffer, uint32_t _attrId, const SErrorMetric& _errMetric, CQuantNormalCache& _cache);
-
-		struct SIntegerAttr
-		{
-			uint32_t pointer[4];
-		};
-		static core::vector<SIntegerAttr> findBetterFormatI(E_FORMAT* _outType, size_t* _outSize, E_FORMAT* _outPrevType, const ICPUMeshBuffer* _meshbuffer, uint32_t _attrId, const SErrorMetric& _errMetric);
+		//! Both functions stream over the attribute's values in parallel instead of gathering them, `_outSize` receives the byte size of the returned format.
+		static E_FORMAT findBetterFormatF(size_t* _outSize, const SAttribSource& _src, const core::vector<SVertexRange>& _ranges, const SErrorMetric& _errMetric);
+		static E_FORMAT findBetterFormatI(size_t* _outSize, const SAttribSource& _src, const core::vector<SVertexRange>& _ranges, const SErrorMetric& _errMetric);
 
 		//E_COMPONENT_TYPE getBestTypeF(bool _normalized, E_COMPONENTS_PER_ATTRIBUTE _cpa, size_t* _outSize, E_COMPONENTS_PER_ATTRIBUTE* _outCpa, const float* _min, const float* _max) const;
 		static E_FORMAT getBestTypeI(E_FORMAT _originalType, size_t* _outSize, const uint32_t* _min, const uint32_t* _max);
 		static core::vector<SAttribTypeChoice> findTypesOfProperRangeF(E_FORMAT _type, size_t _sizeThreshold, const float* _min, const float* _max, const SErrorMetric& _errMetric);
 
+		//! Copies `_attribSize` bytes of every vertex in `_range` from `_src` to the stream at `_dst` (which is indexed from 0, not from the range start).
+		static void copyAttribute(uint8_t* _dst, size_t _dstStride, const SAttribSource& _src, size_t _attribSize, const SVertexRange& _range);
+
 		//! Calculates quantization errors and compares them with given epsilon.
-		/** @returns false when first of calculated errors goes above epsilon or true if reached end without such. */
-		static bool calcMaxQuantizationError(const SAttribTypeChoice& _srcType, const SAttribTypeChoice& _dstType, const core::vector<core::vectorSIMDf>& _data, const SErrorMetric& _errMetric, CQuantNormalCache& _cache);
+		/** Vertex ranges are checked in parallel, each with its own `CQuantNormalCache` because the cache is not thread-safe.
+		@returns false when first of calculated errors goes above epsilon or true if reached end without such. */
+		static bool calcMaxQuantizationError(const SAttribTypeChoice& _srcType, const SAttribTypeChoice& _dstType, const SAttribSource& _src, const core::vector<SVertexRange>& _ranges, const SErrorMetric& _errMetric);
 
 		template<typename InType, typename OutType>
 		static inline core::smart_refctd_ptr<ICPUBuffer> lineStripsToLines(const void* _input, size_t& _idxCount)
@@ -129,7 +129,12 @@ asset::SAssetBundle COBJMeshFileLoader::loadAsset(io::IReadFile* _file, const as
     core::vector<core::smart_refctd_ptr<ICPUMeshBuffer>> submeshes;
     core::vector<core::vector<uint32_t>> indices;
     core::vector<SObjVertex> vertices;
-    core::map<SObjVertex, uint32_t> map_vtx2ix;
+    // one node per unique vertex, all dead by the time we return, so they come from a per-load arena
+    core::MonotonicArena<> scratch;
+    using vtx2ix_allocator_t = core::monotonic_arena_allocator<std::pair<const SObjVertex,uint32_t>>;
+    core::map<SObjVertex, uint32_t, std::less<SObjVertex>, vtx2ix_allocator_t> map_vtx2ix(vtx2ix_allocator_t{scratch});
+    core::vector<uint32_t> faceCorners;
+    faceCorners.reserve(32ull);
     core::vector<bool> recalcNormals;
     core::vector<bool> submeshWasLoadedFromCache;
     core::vector<std::string> submeshCacheKeys;
@@ -156,7 +161,7 @@ asset::SAssetBundle COBJMeshFileLoader::loadAsset(io::IReadFile* _file, const as
                 std::replace(mtllib.begin(), mtllib.end(), '\\', '/');
                 SAssetLoadParams loadParams;
                 auto bundle = interm_getAssetInHierarchy(AssetManager, mtllib, loadParams, _hierarchyLevel+ICPUMesh::PIPELINE_HIERARCHYLEVELS_BELOW, _override);
-				for (auto ass : bundle.getContents())
+				for (const auto& ass : bundle.getContents())
                 {
                     auto pipeln = core::smart_refctd_ptr_static_cast<ICPURenderpassIndependentPipeline>(ass);
                     auto metadata = static_cast<const CMTLPipelineMetadata*>(pipeln->getMetadata());
@@ -273,8 +278,7 @@ asset::SAssetBundle COBJMeshFileLoader::loadAsset(io::IReadFile* _file, const as
 			const char* linePtr = wordBuffer.c_str();
 			const char* const endPtr = linePtr+wordBuffer.size();
 
-			core::vector<uint32_t> faceCorners;
-			faceCorners.reserve(32ull);
+			faceCorners.clear();
 
 			// read in all vertices
 			linePtr = goNextWord(linePtr, endPtr);
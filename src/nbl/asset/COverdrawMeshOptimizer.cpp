@@ -15,7 +15,7 @@
 namespace nbl { namespace asset
 {
 
-core::smart_refctd_ptr<asset::ICPUMeshBuffer> COverdrawMeshOptimizer::createOptimized(asset::ICPUMeshBuffer* _inbuffer, bool _createNew, float _threshold)
+core::smart_refctd_ptr<asset::ICPUMeshBuffer> COverdrawMeshOptimizer::createOptimized(asset::ICPUMeshBuffer* _inbuffer, bool _createNew, float _threshold, uint32_t _cacheSize, const core::vector<uint32_t>* _hardBoundaries)
 {
 	if (!_inbuffer)
 		return nullptr;
@@ -52,14 +52,22 @@ core::smart_refctd_ptr<asset::ICPUMeshBuffer> COverdrawMeshOptimizer::createOpti
 	}
 
 	uint32_t* const hardClusters = (uint32_t*)_NBL_ALIGNED_MALLOC((idxCount/3) * 4,_NBL_SIMD_ALIGNMENT);
-	const size_t hardClusterCount = indexType == asset::EIT_16BIT ?
-		genHardBoundaries(hardClusters, (uint16_t*)indices, idxCount, vertexCount) :
-		genHardBoundaries(hardClusters, (uint32_t*)indices, idxCount, vertexCount);
+	size_t hardClusterCount = 0u;
+	if (_hardBoundaries && !_hardBoundaries->empty())
+	{
+		_NBL_DEBUG_BREAK_IF(_hardBoundaries->front()!=0u || _hardBoundaries->size()>idxCount/3);
+		hardClusterCount = _hardBoundaries->size();
+		memcpy(hardClusters, _hardBoundaries->data(), hardClusterCount*sizeof(uint32_t));
+	}
+	else
+		hardClusterCount = indexType == asset::EIT_16BIT ?
+			genHardBoundaries(hardClusters, (uint16_t*)indices, idxCount, vertexCount, _cacheSize) :
+			genHardBoundaries(hardClusters, (uint32_t*)indices, idxCount, vertexCount, _cacheSize);
 
 	uint32_t* const softClusters = (uint32_t*)_NBL_ALIGNED_MALLOC((idxCount/3 + 1) * 4,_NBL_SIMD_ALIGNMENT);
 	const size_t softClusterCount = indexType == asset::EIT_16BIT ?
-		genSoftBoundaries(softClusters, (uint16_t*)indices, idxCount, vertexCount, hardClusters, hardClusterCount, _threshold) :
-		genSoftBoundaries(softClusters, (uint32_t*)indices, idxCount, vertexCount, hardClusters, hardClusterCount, _threshold);
+		genSoftBoundaries(softClusters, (uint16_t*)indices, idxCount, vertexCount, hardClusters, hardClusterCount, _threshold, _cacheSize) :
+		genSoftBoundaries(softClusters, (uint32_t*)indices, idxCount, vertexCount, hardClusters, hardClusterCount, _threshold, _cacheSize);
 
 	ClusterSortData* sortedData = (ClusterSortData*)_NBL_ALIGNED_MALLOC(softClusterCount*sizeof(ClusterSortData),_NBL_SIMD_ALIGNMENT);
 	if (indexType == asset::EIT_16BIT)
@@ -105,19 +113,19 @@ core::smart_refctd_ptr<asset::ICPUMeshBuffer> COverdrawMeshOptimizer::createOpti
 }
 
 template<typename IdxT>
-size_t COverdrawMeshOptimizer::genHardBoundaries(uint32_t* _dst, const IdxT* _indices, size_t _idxCount, size_t _vtxCount)
+size_t COverdrawMeshOptimizer::genHardBoundaries(uint32_t* _dst, const IdxT* _indices, size_t _idxCount, size_t _vtxCount, size_t _cacheSize)
 {
 	size_t* cacheTimestamps = (size_t*)_NBL_ALIGNED_MALLOC(sizeof(size_t)*_vtxCount,_NBL_SIMD_ALIGNMENT);
 	memset(cacheTimestamps, 0, sizeof(size_t)*_vtxCount);
 
-	size_t timestamp = CACHE_SIZE + 1;
+	size_t timestamp = _cacheSize + 1;
 
 	const size_t faceCount = _idxCount / 3;
 
 	size_t retval = 0u;
 	for (size_t i = 0u; i < faceCount; ++i)
 	{
-		size_t misses = updateCache(_indices[3*i + 0], _indices[3*i + 1], _indices[3*i + 2], cacheTimestamps, timestamp);
+		size_t misses = updateCache(_indices[3*i + 0], _indices[3*i + 1], _indices[3*i + 2], cacheTimestamps, timestamp, _cacheSize);
 
 		// when all three vertices are not in the cache it's usually relatively safe to assume that this is a new patch in the mesh
 		// that is disjoint from previous vertices; sometimes it might come back to reference existing vertices but that frequently
@@ -133,7 +141,7 @@ size_t COverdrawMeshOptimizer::genHardBoundaries(uint32_t* _dst, const IdxT* _in
 }
 
 template<typename IdxT>
-size_t COverdrawMeshOptimizer::genSoftBoundaries(uint32_t* _dst, const IdxT* _indices, size_t _idxCount, size_t _vtxCount, const uint32_t* _clusters, size_t _clusterCount, float _threshold)
+size_t COverdrawMeshOptimizer::genSoftBoundaries(uint32_t* _dst, const IdxT* _indices, size_t _idxCount, size_t _vtxCount, const uint32_t* _clusters, size_t _clusterCount, float _threshold, size_t _cacheSize)
 {
 	size_t* cacheTimestamps = (size_t*)_NBL_ALIGNED_MALLOC(sizeof(size_t)*_vtxCount,_NBL_SIMD_ALIGNMENT);
 	memset(cacheTimestamps, 0, sizeof(size_t)*_vtxCount);
@@ -149,23 +157,23 @@ size_t COverdrawMeshOptimizer::genSoftBoundaries(uint32_t* _dst, const IdxT* _in
 
 		_NBL_DEBUG_BREAK_IF(start > end);
 
-		timestamp += CACHE_SIZE + 1; // reset cache
+		timestamp += _cacheSize + 1; // reset cache
 
 		size_t clusterMisses = 0u; // cluster ACMR
 		for (size_t j = start; j < end; ++j)
-			clusterMisses += updateCache(_indices[j*3 + 0], _indices[j*3 + 1], _indices[j*3 + 2], cacheTimestamps, timestamp);
+			clusterMisses += updateCache(_indices[j*3 + 0], _indices[j*3 + 1], _indices[j*3 + 2], cacheTimestamps, timestamp, _cacheSize);
 
 		const float clusterThreshold = _threshold * (float(clusterMisses) / (end - start));
 
 		_dst[retval++] = (uint32_t)start;
 
-		timestamp += CACHE_SIZE + 1; // reset cache
+		timestamp += _cacheSize + 1; // reset cache
 
 		size_t runningMisses = 0u;
 		size_t runningFaces = 0u;
 		for (size_t j = start; j < end; ++j)
 		{
-			runningMisses += updateCache(_indices[j*3 + 0], _indices[j*3 + 1], _indices[j*3 + 2], cacheTimestamps, timestamp);
+			runningMisses += updateCache(_indices[j*3 + 0], _indices[j*3 + 1], _indices[j*3 + 2], cacheTimestamps, timestamp, _cacheSize);
 			++runningFaces;
 
 			if (float(runningMisses)/runningFaces <= clusterThreshold)
@@ -175,7 +183,7 @@ size_t COverdrawMeshOptimizer::genSoftBoundaries(uint32_t* _dst, const IdxT* _in
 				// cluster is empty; however, the 'pop back' after the loop will clean it up
 				_dst[retval++] = (uint32_t)j + 1;
 
-				timestamp += CACHE_SIZE + 1; // reset cache
+				timestamp += _cacheSize + 1; // reset cache
 
 				runningMisses = 0u;
 				runningFaces = 0u;
@@ -245,21 +253,21 @@ void COverdrawMeshOptimizer::calcSortData(ClusterSortData* _dst, const IdxT* _in
 	}
 }
 
-size_t COverdrawMeshOptimizer::updateCache(uint32_t _a, uint32_t _b, uint32_t _c, size_t* _cacheTimestamps, size_t& _timestamp)
+size_t COverdrawMeshOptimizer::updateCache(uint32_t _a, uint32_t _b, uint32_t _c, size_t* _cacheTimestamps, size_t& _timestamp, size_t _cacheSize)
 {
 	size_t cacheMisses = 0u;
 
-	if (_timestamp - _cacheTimestamps[_a] > CACHE_SIZE)
+	if (_timestamp - _cacheTimestamps[_a] > _cacheSize)
 	{
 		_cacheTimestamps[_a] = _timestamp++;
 		++cacheMisses;
 	}
-	if (_timestamp - _cacheTimestamps[_b] > CACHE_SIZE)
+	if (_timestamp - _cacheTimestamps[_b] > _cacheSize)
 	{
 		_cacheTimestamps[_b] = _timestamp++;
 		++cacheMisses;
 	}
-	if (_timestamp - _cacheTimestamps[_c] > CACHE_SIZE)
+	if (_timestamp - _cacheTimestamps[_c] > _cacheSize)
 	{
 		_cacheTimestamps[_c] = _timestamp++;
 		++cacheMisses;
@@ -14,10 +14,7 @@ namespace nbl { namespace asset
 
 class COverdrawMeshOptimizer
 {
-	enum
-	{
-		CACHE_SIZE = 16
-	};
+	_NBL_STATIC_INLINE_CONSTEXPR uint32_t DefaultCacheSize = 16u;
 
 	struct ClusterSortData
 	{
@@ -40,19 +37,22 @@ public:
 	@param _inbuffer Input mesh buffer.
 	@param _createNew Flag deciding whether to create new mesh (not modifying given one) or just optimize given mesh. Defaulted to true (i.e. create new).
 	@param _threshold Indicates how much the overdraw optimizer can degrade vertex cache efficiency (1.05 = up to 5%) to reduce overdraw more efficiently. Defaulted to 1.05 (i.e. 5%).
+	@param _cacheSize Size of the FIFO vertex cache the ACMR gets measured against, should match the one the triangle order was optimized for.
+	@param _hardBoundaries Optional sorted list of first triangles of clusters which are independent from the cache's point of view (as output by `CTipsifyVertexCacheOptimizer`).
+		If null, the boundaries get guessed by looking for triangles with 3 cache misses.
 	*/
-	static core::smart_refctd_ptr<asset::ICPUMeshBuffer> createOptimized(asset::ICPUMeshBuffer* _inbuffer, bool _createNew = true, float _threshold = 1.05f);
+	static core::smart_refctd_ptr<asset::ICPUMeshBuffer> createOptimized(asset::ICPUMeshBuffer* _inbuffer, bool _createNew = true, float _threshold = 1.05f, uint32_t _cacheSize = DefaultCacheSize, const core::vector<uint32_t>* _hardBoundaries = nullptr);
 
 private:
 	template<typename IdxT>
-	static size_t genHardBoundaries(uint32_t* _dst, const IdxT* _indices, size_t _idxCount, size_t _vtxCount);
+	static size_t genHardBoundaries(uint32_t* _dst, const IdxT* _indices, size_t _idxCount, size_t _vtxCount, size_t _cacheSize);
 	template<typename IdxT>
-	static size_t genSoftBoundaries(uint32_t* _dst, const IdxT* _indices, size_t _idxCount, size_t _vtxCount, const uint32_t* _clusters, size_t _clusterCount, float _threshold);
+	static size_t genSoftBoundaries(uint32_t* _dst, const IdxT* _indices, size_t _idxCount, size_t _vtxCount, const uint32_t* _clusters, size_t _clusterCount, float _threshold, size_t _cacheSize);
 
 	template<typename IdxT>
 	static void calcSortData(ClusterSortData* _dst, const IdxT* _indices, size_t _idxCount, const core::vector<core::vectorSIMDf>& _positions, const uint32_t* _clusters, size_t _clusterCount);
 
-	static size_t updateCache(uint32_t _a, uint32_t _b, uint32_t _c, size_t* _cacheTimestamps, size_t& _timestamp);
+	static size_t updateCache(uint32_t _a, uint32_t _b, uint32_t _c, size_t* _cacheTimestamps, size_t& _timestamp, size_t _cacheSize);
 };
 
 }}
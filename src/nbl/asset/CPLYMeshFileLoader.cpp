@@ -254,13 +254,16 @@ asset::SAssetBundle CPLYMeshFileLoader::loadAsset(io::IReadFile* _file, const as
 				// do we want this element type?
 				if (ctx.ElementList[i]->Name == "vertex")
 				{
+					// the counts are known upfront, don't regrow the biggest temporaries of the load over and over
+					attribs[E_POS].reserve(attribs[E_POS].size()+ctx.ElementList[i]->Count);
 					// loop through vertex properties
 					for (uint32_t j=0; j<ctx.ElementList[i]->Count; ++j)
 						hasNormals &= readVertex(ctx, *ctx.ElementList[i], attribs, _params);
 				}
 				else if (ctx.ElementList[i]->Name == "face")
 				{
-					// read faces
+					// read faces, assume triangles
+					indices.reserve(indices.size()+3ull*ctx.ElementList[i]->Count);
 					for (uint32_t j=0; j < ctx.ElementList[i]->Count; ++j)
 						readFace(ctx, *ctx.ElementList[i], indices);
 				}
@@ -0,0 +1,310 @@
+// Copyright (C) 2018-2020 - DevSH Graphics Programming Sp. z O.O.
+// This file is part of the "Nabla Engine".
+// For conditions of distribution and use, see copyright notice in nabla.h
+
+#include "nbl/core/core.h"
+
+#include "CQuadricMeshSimplifier.h"
+
+#include <numeric>
+#include <algorithm>
+
+namespace nbl { namespace asset
+{
+
+CQuadricMeshSimplifier::SVertexData::SVertexData(const ICPUMeshBuffer* _meshbuffer) : scale(0.f)
+{
+	const uint32_t indexCount = _meshbuffer->getIndexCount()/3u*3u;
+	const size_t vertexCount = _meshbuffer->calcVertexCount();
+
+	positions.resize(vertexCount);
+	const uint32_t posAttr = _meshbuffer->getPositionAttributeIx();
+	for (size_t i=0u; i<vertexCount; i++)
+	{
+		_meshbuffer->getAttribute(positions[i],posAttr,i);
+		positions[i].w = 0.f;
+	}
+
+	core::vector<bool> referenced(vertexCount,false);
+	for (uint32_t i=0u; i<indexCount; i++)
+		referenced[_meshbuffer->getIndexValue(i)] = true;
+
+	// group vertices by exact position, ties broken by index so that the first of every group is the lowest vertex
+	core::vector<uint32_t> order(vertexCount);
+	std::iota(order.begin(),order.end(),0u);
+	auto positionKey = [this](const uint32_t _vx)
+	{
+		const core::vectorSIMDf& p = positions[_vx];
+		// +0.f turns -0 into 0
+		return std::make_tuple(core::floatBitsToUint(p.x+0.f),core::floatBitsToUint(p.y+0.f),core::floatBitsToUint(p.z+0.f),_vx);
+	};
+	core::CWorkStealingScheduler::getDefault()->parallel_sort(order.begin(),order.end(),[&positionKey](const uint32_t _a, const uint32_t _b) {return positionKey(_a)<positionKey(_b);});
+
+	positionRemap.resize(vertexCount);
+	seam.resize(vertexCount,false);
+	core::aabbox3df bbox;
+	bool bboxEmpty = true;
+	for (size_t groupBegin=0u; groupBegin<vertexCount;)
+	{
+		const uint32_t first = order[groupBegin];
+		size_t groupEnd = groupBegin+1u;
+		uint32_t referencedCount = referenced[first] ? 1u:0u;
+		for (; groupEnd<vertexCount && (positions[order[groupEnd]]==positions[first]).all(); groupEnd++)
+			referencedCount += referenced[order[groupEnd]] ? 1u:0u;
+
+		for (size_t i=groupBegin; i<groupEnd; i++)
+		{
+			positionRemap[order[i]] = first;
+			seam[order[i]] = referencedCount>1u;
+		}
+		if (referencedCount)
+		{
+			const core::vector3df p(positions[first].x,positions[first].y,positions[first].z);
+			if (bboxEmpty)
+				bbox.reset(p);
+			else
+				bbox.addInternalPoint(p);
+			bboxEmpty = false;
+		}
+		groupBegin = groupEnd;
+	}
+	if (!bboxEmpty)
+	{
+		const core::vector3df extent = bbox.getExtent();
+		scale = core::max(core::max(extent.X,extent.Y),extent.Z);
+	}
+}
+
+auto CQuadricMeshSimplifier::SQuadric::fromPlane(const core::vectorSIMDf& _n, const float _d, const float _w) -> SQuadric
+{
+	SQuadric q;
+	q.a00 = _w*_n.x*_n.x;
+	q.a11 = _w*_n.y*_n.y;
+	q.a22 = _w*_n.z*_n.z;
+	q.a10 = _w*_n.y*_n.x;
+	q.a20 = _w*_n.z*_n.x;
+	q.a21 = _w*_n.z*_n.y;
+	q.b0 = _w*_n.x*_d;
+	q.b1 = _w*_n.y*_d;
+	q.b2 = _w*_n.z*_d;
+	q.c = _w*_d*_d;
+	q.w = _w;
+	return q;
+}
+
+auto CQuadricMeshSimplifier::SQuadric::operator+=(const SQuadric& _other) -> SQuadric&
+{
+	a00 += _other.a00;
+	a11 += _other.a11;
+	a22 += _other.a22;
+	a10 += _other.a10;
+	a20 += _other.a20;
+	a21 += _other.a21;
+	b0 += _other.b0;
+	b1 += _other.b1;
+	b2 += _other.b2;
+	c += _other.c;
+	w += _other.w;
+	return *this;
+}
+
+float CQuadricMeshSimplifier::SQuadric::error(const core::vectorSIMDf& _p) const
+{
+	const float x = _p.x, y = _p.y, z = _p.z;
+	float r = a00*x*x+a11*y*y+a22*z*z;
+	r += 2.f*(a10*x*y+a20*x*z+a21*y*z);
+	r += 2.f*(b0*x+b1*y+b2*z);
+	r += c;
+	return w!=0.f ? core::abs(r)/w:0.f;
+}
+
+float CQuadricMeshSimplifier::simplify(const SVertexData& _vertices, core::vector<uint32_t>& _indices, const uint32_t _targetTriangleCount, const float _targetError, const bool _lockBorders)
+{
+	// how much more a border edge's plane weighs than a face of similar size
+	constexpr float BorderWeight = 10.f;
+
+	const auto& positions = _vertices.positions;
+	const auto& remap = _vertices.positionRemap;
+	const size_t vertexCount = positions.size();
+	_indices.resize(_indices.size()/3u*3u);
+
+	// directed edges between positions (not vertices) sorted for binary search
+	core::vector<uint64_t> edges;
+	auto makeEdge = [](const uint32_t _from, const uint32_t _to) -> uint64_t {return (uint64_t(_from)<<32ull)|_to;};
+	auto hasEdge = [&edges](const uint64_t _edge) -> bool {return std::binary_search(edges.begin(),edges.end(),_edge);};
+	auto isBorderEdge = [&](const uint32_t _a, const uint32_t _b) -> bool {return !hasEdge(makeEdge(_a,_b)) || !hasEdge(makeEdge(_b,_a));};
+	auto collectEdges = [&]() -> void
+	{
+		edges.resize(_indices.size());
+		for (size_t t=0u; t<_indices.size(); t+=3u)
+		for (uint32_t c=0u; c<3u; c++)
+			edges[t+c] = makeEdge(remap[_indices[t+c]],remap[_indices[t+(c+1u)%3u]]);
+		core::CWorkStealingScheduler::getDefault()->parallel_sort(edges.begin(),edges.end());
+	};
+	auto triangleNormal = [&](const core::vectorSIMDf& _p0, const core::vectorSIMDf& _p1, const core::vectorSIMDf& _p2) -> core::vectorSIMDf
+	{
+		return core::cross(_p1-_p0,_p2-_p0);
+	};
+
+	// accumulate face and border quadrics on the positions
+	core::vector<SQuadric> quadrics(vertexCount);
+	collectEdges();
+	for (size_t t=0u; t<_indices.size(); t+=3u)
+	{
+		const uint32_t r[3] = {remap[_indices[t]],remap[_indices[t+1u]],remap[_indices[t+2u]]};
+		const core::vectorSIMDf normal = triangleNormal(positions[r[0]],positions[r[1]],positions[r[2]]);
+		const float area = core::length(normal)[0];
+		if (area==0.f)
+			continue;
+		const core::vectorSIMDf n = normal/area;
+
+		const SQuadric face = SQuadric::fromPlane(n,-core::dot(n,positions[r[0]])[0],area);
+		for (uint32_t c=0u; c<3u; c++)
+			quadrics[r[c]] += face;
+
+		for (uint32_t c=0u; c<3u; c++)
+		{
+			const uint32_t a = r[c], b = r[(c+1u)%3u];
+			if (hasEdge(makeEdge(b,a)))
+				continue;
+			const core::vectorSIMDf edge = positions[b]-positions[a];
+			const float lengthSq = core::dot(edge,edge)[0];
+			if (lengthSq==0.f)
+				continue;
+			const core::vectorSIMDf borderNormal = core::normalize(core::cross(edge,n));
+			const SQuadric border = SQuadric::fromPlane(borderNormal,-core::dot(borderNormal,positions[a])[0],lengthSq*BorderWeight);
+			quadrics[a] += border;
+			quadrics[b] += border;
+		}
+	}
+
+	struct SCollapse
+	{
+		uint32_t src;
+		uint32_t dst;
+		float error;
+	};
+	const float errorLimit = (_targetError*_vertices.scale)*(_targetError*_vertices.scale);
+	float maxError = 0.f;
+
+	core::vector<E_VERTEX_KIND> kinds(vertexCount);
+	core::vector<SCollapse> collapses;
+	core::vector<uint32_t> adjacencyOffsets(vertexCount+1u);
+	core::vector<uint32_t> adjacency;
+	core::vector<uint32_t> collapseRemap(vertexCount);
+	core::vector<bool> touched(vertexCount);
+	for (size_t triangleCount=_indices.size()/3u; triangleCount>_targetTriangleCount; triangleCount=_indices.size()/3u)
+	{
+		// classify positions, the edges of the first pass were already collected for the quadrics
+		if (edges.empty())
+			collectEdges();
+		std::fill(kinds.begin(),kinds.end(),EVK_MANIFOLD);
+		for (size_t i=0u; i<vertexCount; i++)
+		if (_vertices.seam[i])
+			kinds[remap[i]] = EVK_LOCKED;
+		for (size_t i=0u; i<edges.size(); i++)
+		{
+			const uint32_t a = edges[i]>>32ull, b = edges[i]&0xffffffffull;
+			const bool complex = (i && edges[i-1u]==edges[i]) || (i+1u<edges.size() && edges[i+1u]==edges[i]);
+			if (complex)
+				kinds[a] = kinds[b] = EVK_LOCKED;
+			else if (!hasEdge(makeEdge(b,a)))
+			{
+				const E_VERTEX_KIND borderKind = _lockBorders ? EVK_LOCKED:EVK_BORDER;
+				kinds[a] = core::max(kinds[a],borderKind);
+				kinds[b] = core::max(kinds[b],borderKind);
+			}
+		}
+
+		// gather and rank candidate collapses
+		collapses.clear();
+		for (size_t t=0u; t<_indices.size(); t+=3u)
+		for (uint32_t c=0u; c<3u; c++)
+		{
+			const uint32_t ends[2] = {_indices[t+c],_indices[t+(c+1u)%3u]};
+			for (uint32_t e=0u; e<2u; e++)
+			{
+				const uint32_t src = ends[e], dst = ends[e^1u];
+				const uint32_t rs = remap[src], rd = remap[dst];
+				if (rs==rd || kinds[rs]==EVK_LOCKED)
+					continue;
+				if (kinds[rs]==EVK_BORDER && !isBorderEdge(rs,rd))
+					continue;
+				collapses.push_back({src,dst,quadrics[rs].error(positions[dst])});
+			}
+		}
+		// stable, so collapses with the same error keep the order they were found in
+		core::CWorkStealingScheduler::getDefault()->parallel_sort(collapses.begin(),collapses.end(),[](const SCollapse& _a, const SCollapse& _b) {return _a.error<_b.error;});
+
+		// triangles around every vertex for the flip test
+		std::fill(adjacencyOffsets.begin(),adjacencyOffsets.end(),0u);
+		for (const uint32_t ix : _indices)
+			adjacencyOffsets[ix+1u]++;
+		std::partial_sum(adjacencyOffsets.begin(),adjacencyOffsets.end(),adjacencyOffsets.begin());
+		adjacency.resize(_indices.size());
+		{
+			core::vector<uint32_t> fill(adjacencyOffsets.begin(),adjacencyOffsets.end()-1u);
+			for (size_t i=0u; i<_indices.size(); i++)
+				adjacency[fill[_indices[i]]++] = i/3u;
+		}
+		auto flips = [&](const uint32_t _src, const uint32_t _dst) -> bool
+		{
+			const uint32_t rd = remap[_dst];
+			for (uint32_t i=adjacencyOffsets[_src]; i<adjacencyOffsets[_src+1u]; i++)
+			{
+				const uint32_t* tri = _indices.data()+adjacency[i]*3u;
+				if (remap[tri[0]]==rd || remap[tri[1]]==rd || remap[tri[2]]==rd)
+					continue; // will become degenerate
+				core::vectorSIMDf p[3] = {positions[tri[0]],positions[tri[1]],positions[tri[2]]};
+				const core::vectorSIMDf before = triangleNormal(p[0],p[1],p[2]);
+				for (uint32_t c=0u; c<3u; c++)
+				if (tri[c]==_src)
+					p[c] = positions[_dst];
+				if (core::dot(before,triangleNormal(p[0],p[1],p[2]))[0]<=0.f)
+					return true;
+			}
+			return false;
+		};
+
+		// every collapse removes up to two triangles, the endpoints of a collapse are left alone for the rest of the pass
+		const size_t budget = core::max<size_t>((triangleCount-_targetTriangleCount)/2u,1u);
+		size_t performed = 0u;
+		std::iota(collapseRemap.begin(),collapseRemap.end(),0u);
+		std::fill(touched.begin(),touched.end(),false);
+		for (const auto& collapse : collapses)
+		{
+			if (collapse.error>errorLimit)
+				break;
+			const uint32_t rs = remap[collapse.src], rd = remap[collapse.dst];
+			if (touched[rs] || touched[rd] || flips(collapse.src,collapse.dst))
+				continue;
+
+			collapseRemap[collapse.src] = collapse.dst;
+			quadrics[rd] += quadrics[rs];
+			touched[rs] = touched[rd] = true;
+			maxError = core::max(maxError,collapse.error);
+			if (++performed>=budget)
+				break;
+		}
+		if (!performed)
+			break;
+
+		// apply and drop the triangles which lost an edge
+		size_t outIx = 0u;
+		for (size_t t=0u; t<_indices.size(); t+=3u)
+		{
+			const uint32_t a = collapseRemap[_indices[t]], b = collapseRemap[_indices[t+1u]], c = collapseRemap[_indices[t+2u]];
+			if (remap[a]==remap[b] || remap[b]==remap[c] || remap[c]==remap[a])
+				continue;
+			_indices[outIx++] = a;
+			_indices[outIx++] = b;
+			_indices[outIx++] = c;
+		}
+		_indices.resize(outIx);
+		edges.clear();
+	}
+
+	return _vertices.scale>0.f ? core::sqrt(maxError)/_vertices.scale:0.f;
+}
+
+}} // nbl::asset
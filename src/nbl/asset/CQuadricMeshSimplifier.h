@@ -0,0 +1,73 @@
+// Copyright (C) 2018-2020 - DevSH Graphics Programming Sp. z O.O.
+// This file is part of the "Nabla Engine".
+// For conditions of distribution and use, see copyright notice in nabla.h
+
+#ifndef __NBL_ASSET_C_QUADRIC_MESH_SIMPLIFIER_H_INCLUDED__
+#define __NBL_ASSET_C_QUADRIC_MESH_SIMPLIFIER_H_INCLUDED__
+
+#include "nbl/asset/ICPUMeshBuffer.h"
+
+// Garland & Heckbert "Surface Simplification Using Quadric Error Metrics" restricted to collapses onto existing vertices,
+// the seam and border classification follows zeux's meshoptimizer (https://github.com/zeux/meshoptimizer) available under MIT license
+
+namespace nbl { namespace asset
+{
+
+class CQuadricMeshSimplifier
+{
+	// private, undefined constructor
+	CQuadricMeshSimplifier() = delete;
+
+public:
+	//! Everything about the vertices which does not change between simplifications of the same meshbuffer
+	struct SVertexData
+	{
+		SVertexData(const ICPUMeshBuffer* _meshbuffer);
+
+		core::vector<core::vectorSIMDf> positions;
+		//! Lowest vertex with the same position, all collapses and the topology work on these
+		core::vector<uint32_t> positionRemap;
+		//! Vertex shares its position with a vertex of different attributes (UV seam, hard edge, etc.)
+		core::vector<bool> seam;
+		//! Largest extent of the bounding box of the referenced vertices
+		float scale;
+	};
+
+	//! Collapses edges in `_indices` (32bit triangle list) until `_targetTriangleCount` is reached or the next collapse would exceed `_targetError`.
+	/**
+	Vertices only ever collapse onto other existing vertices, so the vertex buffers can be shared with the input.
+	Seam vertices are never removed, open border vertices only slide along the border (or stay put if `_lockBorders`).
+	@param _targetError Maximum error relative to SVertexData::scale.
+	@returns Largest relative error among the collapses performed.
+	*/
+	static float simplify(const SVertexData& _vertices, core::vector<uint32_t>& _indices, const uint32_t _targetTriangleCount, const float _targetError, const bool _lockBorders);
+
+private:
+	struct SQuadric
+	{
+		float a00 = 0.f, a11 = 0.f, a22 = 0.f;
+		float a10 = 0.f, a20 = 0.f, a21 = 0.f;
+		float b0 = 0.f, b1 = 0.f, b2 = 0.f;
+		float c = 0.f;
+		float w = 0.f;
+
+		//! Quadric of the plane `dot(_n,p)+_d==0` weighted by `_w`, `_n` has to be normalized
+		static SQuadric fromPlane(const core::vectorSIMDf& _n, const float _d, const float _w);
+
+		SQuadric& operator+=(const SQuadric& _other);
+
+		//! Weighted mean squared distance of `_p` to the planes
+		float error(const core::vectorSIMDf& _p) const;
+	};
+
+	enum E_VERTEX_KIND : uint8_t
+	{
+		EVK_MANIFOLD,
+		EVK_BORDER,
+		EVK_LOCKED
+	};
+};
+
+}}
+
+#endif
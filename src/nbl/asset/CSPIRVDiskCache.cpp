@@ -0,0 +1,250 @@
+// Copyright (C) 2018-2020 - DevSH Graphics Programming Sp. z O.O.
+// This file is part of the "Nabla Engine".
+// For conditions of distribution and use, see copyright notice in nabla.h
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+
+#include "nbl/asset/CSPIRVDiskCache.h"
+#include "nbl/core/xxHash256.h"
+#include "nbl/asset/shadercUtils.h"
+#include "nbl/asset/fileUtils.h"
+
+#include "spirv-tools/libspirv.h"
+
+#include "os.h"
+
+namespace nbl
+{
+namespace asset
+{
+
+namespace impl
+{
+	namespace fs = std::filesystem;
+
+	_NBL_STATIC_INLINE_CONSTEXPR uint32_t SPIRV_CACHE_MAGIC = 0x43565053u; // "SPVC"
+	_NBL_STATIC_INLINE_CONSTEXPR const char* SPIRV_CACHE_EXTENSION = ".spv";
+	_NBL_STATIC_INLINE_CONSTEXPR const char* SPIRV_CACHE_TMP_EXTENSION = ".tmp";
+	// temporaries this old were left behind by a crashed process
+	_NBL_STATIC_INLINE_CONSTEXPR auto SPIRV_CACHE_TMP_LIFETIME = std::chrono::hours(1);
+
+	struct SEntryHeader
+	{
+		uint32_t magic;
+		uint32_t formatVersion;
+		uint64_t spirvSize;
+		uint64_t assemblySize;
+		uint64_t key[4];
+	};
+}
+
+std::string CSPIRVDiskCache::SKey::toString() const
+{
+	constexpr char digits[] = "0123456789abcdef";
+	std::string retval(hash.size()*sizeof(uint64_t)*2u,'0');
+	auto out = retval.begin();
+	for (const auto word : hash)
+	for (int32_t shift=60; shift>=0; shift-=4)
+		*(out++) = digits[(word>>shift)&0xfull];
+	return retval;
+}
+
+CSPIRVDiskCache::CSPIRVDiskCache(std::string&& _directory, const uint64_t _maxSize) : m_directory(std::move(_directory)), m_maxSize(_maxSize), m_size(0ull)
+{
+	std::error_code ec;
+	impl::fs::create_directories(m_directory,ec);
+	if (ec)
+		os::Printer::log("CSPIRVDiskCache: could not create directory "+m_directory,ec.message(),ELL_ERROR);
+	// counts what's already there and gets rid of leftovers
+	trim(m_maxSize);
+}
+
+const std::string& CSPIRVDiskCache::getCompilerVersion()
+{
+	static const std::string version = []() -> std::string
+	{
+		uint32_t shadercSpvVersion = 0u, shadercSpvRevision = 0u;
+		shaderc_get_spv_version(&shadercSpvVersion,&shadercSpvRevision);
+		return "Nabla "+std::to_string(NABLA_VERSION_MAJOR)+"."+std::to_string(NABLA_VERSION_MINOR)+"."+std::to_string(NABLA_VERSION_REVISION)+
+			" target SPIR-V "+std::to_string(TARGET_SPIRV_VERSION)+
+			" shaderc SPIR-V "+std::to_string(shadercSpvVersion)+"."+std::to_string(shadercSpvRevision)+
+			" "+spvSoftwareVersionDetailsString()+
+			" cache format "+std::to_string(FormatVersion);
+	}();
+	return version;
+}
+
+CSPIRVDiskCache::SKey CSPIRVDiskCache::computeKey(const char* _resolvedGLSL, const size_t _length, ISpecializedShader::E_SHADER_STAGE _stage, const char* _entryPoint, const char* _compilationId, const bool _genDebugInfo, const ISPIRVOptimizer* _opt)
+{
+	// everything the output depends on, null-separated so fields can't run into each other
+	const auto& version = getCompilerVersion();
+	const size_t entryPointLen = strlen(_entryPoint);
+	const size_t passCount = _opt ? _opt->getPasses().size():0u;
+
+	core::vector<uint8_t> blob;
+	blob.reserve(version.size()+entryPointLen+passCount*sizeof(uint32_t)+_length+32u);
+	auto append = [&blob](const void* data, const size_t size) -> void
+	{
+		const auto* bytes = reinterpret_cast<const uint8_t*>(data);
+		blob.insert(blob.end(),bytes,bytes+size);
+	};
+	append(version.c_str(),version.size()+1u);
+	const uint32_t stage = _stage;
+	append(&stage,sizeof(stage));
+	const uint8_t debugInfo = _genDebugInfo;
+	append(&debugInfo,sizeof(debugInfo));
+	// names the source in OpString/OpSource, so debug SPIR-V of another compilation isn't the same
+	if (_genDebugInfo)
+	{
+		const char* compilationId = _compilationId ? _compilationId:"";
+		append(compilationId,strlen(compilationId)+1u);
+	}
+	append(_entryPoint,entryPointLen+1u);
+	// no optimizer and an optimizer with no passes produce the same SPIR-V
+	append(&passCount,sizeof(passCount));
+	for (size_t i=0u; i<passCount; i++)
+	{
+		const uint32_t pass = _opt->getPasses()[i];
+		append(&pass,sizeof(pass));
+	}
+	append(_resolvedGLSL,_length);
+
+	SKey key;
+	core::XXHash_256(blob.data(),blob.size(),key.hash.data());
+	return key;
+}
+
+std::string CSPIRVDiskCache::getEntryPath(const SKey& _key) const
+{
+	return (impl::fs::path(m_directory)/(_key.toString()+impl::SPIRV_CACHE_EXTENSION)).string();
+}
+
+core::smart_refctd_ptr<ICPUBuffer> CSPIRVDiskCache::find(const SKey& _key, std::string* _outAssembly) const
+{
+	const auto path = getEntryPath(_key);
+	std::ifstream file(path,std::ios::binary);
+	if (!file.is_open())
+		return nullptr;
+
+	impl::SEntryHeader header;
+	if (!file.read(reinterpret_cast<char*>(&header),sizeof(header)))
+		return nullptr;
+	// a hash collision on the file name or an entry from an incompatible build
+	if (header.magic!=impl::SPIRV_CACHE_MAGIC || header.formatVersion!=FormatVersion || memcmp(header.key,_key.hash.data(),sizeof(header.key))!=0)
+		return nullptr;
+	if (header.spirvSize==0ull || header.spirvSize%sizeof(uint32_t) || (_outAssembly && header.assemblySize==0ull))
+		return nullptr;
+
+	std::error_code ec;
+	const auto fileSize = impl::fs::file_size(path,ec);
+	if (ec || fileSize!=sizeof(header)+header.spirvSize+header.assemblySize)
+		return nullptr;
+
+	auto spirv = core::make_smart_refctd_ptr<ICPUBuffer>(header.spirvSize);
+	if (!file.read(reinterpret_cast<char*>(spirv->getPointer()),header.spirvSize))
+		return nullptr;
+	if (_outAssembly)
+	{
+		_outAssembly->resize(header.assemblySize);
+		if (!file.read(_outAssembly->data(),header.assemblySize))
+			return nullptr;
+	}
+	file.close();
+
+	// modification time is what the eviction goes by, failing to refresh it only makes the entry go sooner
+	impl::fs::last_write_time(path,impl::fs::file_time_type::clock::now(),ec);
+	return spirv;
+}
+
+bool CSPIRVDiskCache::insert(const SKey& _key, const ICPUBuffer* _spirv, const std::string* _assembly)
+{
+	if (!_spirv || _spirv->getSize()==0ull)
+		return false;
+
+	const impl::fs::path path = getEntryPath(_key);
+
+	impl::SEntryHeader header;
+	header.magic = impl::SPIRV_CACHE_MAGIC;
+	header.formatVersion = FormatVersion;
+	header.spirvSize = _spirv->getSize();
+	header.assemblySize = _assembly ? _assembly->size():0ull;
+	memcpy(header.key,_key.hash.data(),sizeof(header.key));
+	const uint64_t entrySize = sizeof(header)+header.spirvSize+header.assemblySize;
+
+	std::error_code ec;
+	const auto oldSize = impl::fs::file_size(path,ec);
+	const uint64_t replacedSize = ec ? 0ull:oldSize;
+	// readers see either the old or the new entry, if the replace fails it's the other writer's entry that stays
+	if (!writeFileAtomically(path,{{&header,sizeof(header)},{_spirv->getPointer(),header.spirvSize},{_assembly ? _assembly->data():nullptr,header.assemblySize}},ec,impl::SPIRV_CACHE_TMP_EXTENSION))
+		return false;
+
+	bool overBudget;
+	{
+		std::unique_lock<std::mutex> lock(m_lock);
+		m_size = m_size-core::min(replacedSize,m_size)+entrySize;
+		overBudget = m_size>m_maxSize;
+	}
+	// trim below the cap, so the directory isn't scanned on every insert from then on
+	if (overBudget)
+		trim(m_maxSize-m_maxSize/8ull);
+	return true;
+}
+
+void CSPIRVDiskCache::trim(const uint64_t _targetSize)
+{
+	struct SEntry
+	{
+		impl::fs::path path;
+		impl::fs::file_time_type lastUse;
+		uint64_t size;
+	};
+	core::vector<SEntry> entries;
+	uint64_t totalSize = 0ull;
+
+	std::unique_lock<std::mutex> lock(m_lock);
+	// other processes can add and delete files while we iterate, so all errors just skip the file
+	std::error_code ec;
+	const auto now = impl::fs::file_time_type::clock::now();
+	for (impl::fs::directory_iterator it(m_directory,ec), end; !ec && it!=end; it.increment(ec))
+	{
+		std::error_code fileEc;
+		if (!it->is_regular_file(fileEc) || fileEc)
+			continue;
+		const auto& path = it->path();
+		const auto lastWrite = it->last_write_time(fileEc);
+		if (fileEc)
+			continue;
+		if (path.extension()==impl::SPIRV_CACHE_TMP_EXTENSION)
+		{
+			if (now-lastWrite>impl::SPIRV_CACHE_TMP_LIFETIME)
+				impl::fs::remove(path,fileEc);
+			continue;
+		}
+		if (path.extension()!=impl::SPIRV_CACHE_EXTENSION)
+			continue;
+		const auto size = it->file_size(fileEc);
+		if (fileEc)
+			continue;
+		entries.push_back({path,lastWrite,size});
+		totalSize += size;
+	}
+
+	if (totalSize>_targetSize)
+	{
+		std::sort(entries.begin(),entries.end(),[](const SEntry& lhs, const SEntry& rhs) {return lhs.lastUse<rhs.lastUse;});
+		for (auto it=entries.begin(); it!=entries.end() && totalSize>_targetSize; it++)
+		{
+			std::error_code fileEc;
+			// someone else might have gotten to it first, either way its gone
+			impl::fs::remove(it->path,fileEc);
+			totalSize -= it->size;
+		}
+	}
+	m_size = totalSize;
+}
+
+}
+}
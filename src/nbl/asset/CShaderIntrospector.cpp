@@ -2,14 +2,21 @@
 // This file is part of the "Nabla Engine".
 // For conditions of distribution and use, see copyright notice in nabla.h
 
+#include <fstream>
+
 #include "nbl/asset/CShaderIntrospector.h"
+#include "nbl/core/xxHash256.h"
 
 #include "nbl/asset/ICPUMeshBuffer.h"
+#include "nbl/asset/CSPIRVDiskCache.h"
 
 #include "nbl/asset/spvUtils.h"
+#include "nbl/asset/fileUtils.h"
 #include "spirv_cross/spirv_parser.hpp"
 #include "spirv_cross/spirv_cross.hpp"
 
+#include "os.h"
+
 namespace nbl
 {
 namespace asset
@@ -68,14 +75,52 @@ E_FORMAT spvImageFormat2E_FORMAT(spv::ImageFormat _imgfmt)
 }
 }//anonymous ns
 
+CIntrospectionCache::hash_t CShaderIntrospector::computeKey(const ICPUShader* _shader, const SIntrospectionParams& _params)
+{
+    const ICPUBuffer* code = _shader->getSPVorGLSL();
+    const bool glsl = _shader->containsGLSL();
+
+    // null-separated so fields can't run into each other
+    core::vector<uint8_t> blob;
+    blob.reserve(code->getSize()+_params.entryPoint.size()+8u);
+    auto append = [&blob](const void* data, const size_t size) -> void
+    {
+        const auto* bytes = reinterpret_cast<const uint8_t*>(data);
+        blob.insert(blob.end(),bytes,bytes+size);
+    };
+    const uint8_t isGLSL = glsl;
+    append(&isGLSL,sizeof(isGLSL));
+    const uint32_t stage = _params.stage;
+    append(&stage,sizeof(stage));
+    append(_params.entryPoint.c_str(),_params.entryPoint.size()+1u);
+    append(code->getPointer(),code->getSize());
+
+    CIntrospectionCache::hash_t key;
+    core::XXHash_256(blob.data(),blob.size(),key.data());
+    return key;
+}
+
 const CIntrospectionData* CShaderIntrospector::introspect(const ICPUShader* _shader, const SIntrospectionParams& _params)
 {
     if (!_shader)
         return nullptr;
 
-    auto found = findIntrospection(_shader, _params);
-    if (found)
-        return found.get();
+    // GLSL gets keyed after the extension defines went in and the #includes got resolved, so editing an included file is a miss
+    core::smart_refctd_ptr<ICPUShader> glslShader_woIncludes;
+    if (_shader->containsGLSL())
+    {
+        auto begin = reinterpret_cast<const char*>(_shader->getSPVorGLSL()->getPointer());
+        auto end = begin+_shader->getSPVorGLSL()->getSize();
+        std::string glsl(begin,end);
+        ICPUShader::insertGLSLExtensionsDefines(glsl, _params.GLSLextensions.get());
+        glslShader_woIncludes = m_glslCompiler->resolveIncludeDirectives(glsl.c_str(), _params.stage, _params.filePathHint.c_str());
+        if (!glslShader_woIncludes)
+            return nullptr;
+    }
+
+    const auto key = computeKey(glslShader_woIncludes ? glslShader_woIncludes.get():_shader, _params);
+    if (auto found = m_cache->find(key))
+        return found;
 
     auto introspectSPV = [this,&_params](const ICPUShader* _spvshader) {
         const ICPUBuffer* spv = _spvshader->getSPVorGLSL();
@@ -83,13 +128,9 @@ const CIntrospectionData* CShaderIntrospector::introspect(const ICPUShader* _sha
         return doIntrospection(comp, _params);
     };
 
-    if (_shader->containsGLSL())
+    core::smart_refctd_ptr<CIntrospectionData> introspection;
+    if (glslShader_woIncludes)
     {
-        auto begin = reinterpret_cast<const char*>(_shader->getSPVorGLSL()->getPointer());
-        auto end = begin+_shader->getSPVorGLSL()->getSize();
-        std::string glsl(begin,end);
-        ICPUShader::insertGLSLExtensionsDefines(glsl, _params.GLSLextensions.get());
-        auto glslShader_woIncludes = m_glslCompiler->resolveIncludeDirectives(glsl.c_str(), _params.stage, _params.filePathHint.c_str());
         auto spvShader = m_glslCompiler->createSPIRVFromGLSL(
             reinterpret_cast<const char*>(glslShader_woIncludes->getSPVorGLSL()->getPointer()),
             _params.stage,
@@ -99,13 +140,16 @@ const CIntrospectionData* CShaderIntrospector::introspect(const ICPUShader* _sha
         if (!spvShader)
             return nullptr;
 
-        return cacheIntrospection(introspectSPV(spvShader.get()), _shader, _params);
+        introspection = introspectSPV(spvShader.get());
     }
     else
     {
         // TODO (?) when we have enabled_extensions_list it may validate whether all extensions in list are also present in spv
-        return cacheIntrospection(introspectSPV(_shader), _shader, _params);
+        introspection = introspectSPV(_shader);
     }
+    if (!introspection)
+        return nullptr;
+    return m_cache->insert(key, std::move(introspection));
 }
 
 bool CShaderIntrospector::introspectAllShaders(const CIntrospectionData** introspection, ICPUSpecializedShader** const begin, ICPUSpecializedShader** const end, const std::string* _extensionsBegin, const std::string* _extensionsEnd)
@@ -833,5 +877,419 @@ CIntrospectionData::~CIntrospectionData()
     deinitIntrospectionData(this);
 }
 
+const CIntrospectionData* CIntrospectionCache::find(const hash_t& _key) const
+{
+    {
+        std::shared_lock<std::shared_mutex> lock(m_lock);
+        auto found = m_entries.find(_key);
+        if (found != m_entries.end())
+        {
+            m_hits.fetch_add(1u, std::memory_order_relaxed);
+            return found->second.get();
+        }
+    }
+    m_misses.fetch_add(1u, std::memory_order_relaxed);
+    return nullptr;
+}
+
+const CIntrospectionData* CIntrospectionCache::insert(const hash_t& _key, core::smart_refctd_ptr<CIntrospectionData>&& _introspection)
+{
+    std::unique_lock<std::shared_mutex> lock(m_lock);
+    return m_entries.emplace(_key, std::move(_introspection)).first->second.get();
+}
+
+void CIntrospectionCache::clear()
+{
+    std::unique_lock<std::shared_mutex> lock(m_lock);
+    m_entries.clear();
+}
+
+CIntrospectionCache::SStatistics CIntrospectionCache::getStatistics() const
+{
+    SStatistics retval;
+    retval.hits = m_hits.load(std::memory_order_relaxed);
+    retval.misses = m_misses.load(std::memory_order_relaxed);
+    std::shared_lock<std::shared_mutex> lock(m_lock);
+    retval.entryCount = static_cast<uint32_t>(m_entries.size());
+    return retval;
+}
+
+namespace
+{
+    _NBL_STATIC_INLINE_CONSTEXPR uint32_t INTROSPECTION_CACHE_MAGIC = 0x49525053u; // "SPRI"
+    // deeper nesting than this can only come from a corrupted file
+    _NBL_STATIC_INLINE_CONSTEXPR uint32_t MAX_MEMBER_NESTING = 64u;
+
+    struct SFileHeader
+    {
+        uint32_t magic;
+        uint32_t formatVersion;
+        uint64_t versionStringSize;
+        uint64_t payloadSize;
+        //! of the payload, catches truncated and corrupted files
+        uint64_t checksum[4];
+    };
+
+    class CWriter
+    {
+        public:
+            core::vector<uint8_t> data;
+
+            template<typename T>
+            void write(const T& _val)
+            {
+                static_assert(std::is_trivially_copyable_v<T>);
+                const auto* bytes = reinterpret_cast<const uint8_t*>(&_val);
+                data.insert(data.end(), bytes, bytes+sizeof(T));
+            }
+            void write(const std::string& _str)
+            {
+                write<uint64_t>(_str.size());
+                data.insert(data.end(), _str.begin(), _str.end());
+            }
+
+            void write(const impl::SShaderMemoryBlock::SMember::SMembers& _members)
+            {
+                write<uint64_t>(_members.count);
+                for (size_t i = 0u; i < _members.count; ++i)
+                {
+                    const auto& m = _members.array[i];
+                    write<uint32_t>(m.count);
+                    write<uint8_t>(m.countIsSpecConstant);
+                    write<uint32_t>(m.offset);
+                    write<uint32_t>(m.size);
+                    write<uint32_t>(m.arrayStride);
+                    write<uint32_t>(m.mtxStride);
+                    write<uint32_t>(m.mtxRowCnt);
+                    write<uint32_t>(m.mtxColCnt);
+                    write<uint8_t>(m.rowMajor);
+                    write<uint32_t>(m.type);
+                    write(m.name);
+                    write(m.members);
+                }
+            }
+            void write(const impl::SShaderMemoryBlock& _block)
+            {
+                write<uint8_t>(_block.restrict_);
+                write<uint8_t>(_block.volatile_);
+                write<uint8_t>(_block.coherent);
+                write<uint8_t>(_block.readonly);
+                write<uint8_t>(_block.writeonly);
+                write(_block.name);
+                write<uint64_t>(_block.size);
+                write<uint64_t>(_block.rtSizedArrayOneElementSize);
+                write(_block.members);
+            }
+            void write(const CIntrospectionData& _data)
+            {
+                write<uint64_t>(_data.specConstants.size());
+                for (const auto& sc : _data.specConstants)
+                {
+                    write<uint32_t>(sc.id);
+                    write<uint64_t>(sc.byteSize);
+                    write<uint32_t>(sc.type);
+                    write(sc.name);
+                    write<uint64_t>(sc.defaultValue.u64);
+                }
+                for (const auto& descSet : _data.descriptorSetBindings)
+                {
+                    write<uint64_t>(descSet.size());
+                    for (const auto& res : descSet)
+                    {
+                        write<uint32_t>(res.binding);
+                        write<uint8_t>(res.type);
+                        write<uint32_t>(res.descriptorCount);
+                        write<uint8_t>(res.descCountIsSpecConstant);
+                        switch (res.type)
+                        {
+                        case ESRT_COMBINED_IMAGE_SAMPLER:
+                            write<uint8_t>(res.get<ESRT_COMBINED_IMAGE_SAMPLER>().multisample);
+                            write<uint32_t>(res.get<ESRT_COMBINED_IMAGE_SAMPLER>().viewType);
+                            write<uint8_t>(res.get<ESRT_COMBINED_IMAGE_SAMPLER>().shadow);
+                            break;
+                        case ESRT_STORAGE_IMAGE:
+                            write<uint32_t>(res.get<ESRT_STORAGE_IMAGE>().format);
+                            write<uint32_t>(res.get<ESRT_STORAGE_IMAGE>().viewType);
+                            write<uint8_t>(res.get<ESRT_STORAGE_IMAGE>().shadow);
+                            break;
+                        case ESRT_INPUT_ATTACHMENT:
+                            write<uint32_t>(res.get<ESRT_INPUT_ATTACHMENT>().inputAttachmentIndex);
+                            break;
+                        case ESRT_UNIFORM_BUFFER:
+                            write(static_cast<const impl::SShaderMemoryBlock&>(res.get<ESRT_UNIFORM_BUFFER>()));
+                            break;
+                        case ESRT_STORAGE_BUFFER:
+                            write(static_cast<const impl::SShaderMemoryBlock&>(res.get<ESRT_STORAGE_BUFFER>()));
+                            break;
+                        default: break;
+                        }
+                    }
+                }
+                write<uint64_t>(_data.inputOutput.size());
+                for (const auto& info : _data.inputOutput)
+                {
+                    write<uint32_t>(info.location);
+                    write<uint32_t>(info.glslType.basetype);
+                    write<uint32_t>(info.glslType.elements);
+                    write<uint8_t>(info.type);
+                    if (info.type == ESIT_STAGE_OUTPUT)
+                        write<uint32_t>(info.get<ESIT_STAGE_OUTPUT>().colorIndex);
+                }
+                write<uint8_t>(_data.pushConstant.present);
+                if (_data.pushConstant.present)
+                    write(static_cast<const impl::SShaderMemoryBlock&>(_data.pushConstant.info));
+            }
+    };
+
+    //! Every read is bounds checked, whatever got read before a failure is left in a state `~CIntrospectionData` can deal with
+    class CReader
+    {
+        public:
+            CReader(const uint8_t* _begin, const uint8_t* _end) : m_ptr(_begin), m_end(_begin ? _end:_begin) {}
+
+            template<typename T>
+            bool read(T& _val)
+            {
+                static_assert(std::is_trivially_copyable_v<T>);
+                if (size_t(m_end-m_ptr) < sizeof(T))
+                    return false;
+                memcpy(&_val, m_ptr, sizeof(T));
+                m_ptr += sizeof(T);
+                return true;
+            }
+            template<typename Stored, typename T>
+            bool readAs(T& _val)
+            {
+                Stored tmp;
+                if (!read(tmp))
+                    return false;
+                _val = static_cast<T>(tmp);
+                return true;
+            }
+            bool read(std::string& _str)
+            {
+                uint64_t size;
+                if (!read(size) || size > uint64_t(m_end-m_ptr))
+                    return false;
+                _str.assign(reinterpret_cast<const char*>(m_ptr), size);
+                m_ptr += size;
+                return true;
+            }
+
+            bool read(impl::SShaderMemoryBlock::SMember::SMembers& _members, const uint32_t _depth)
+            {
+                using MembT = impl::SShaderMemoryBlock::SMember;
+
+                uint64_t count;
+                // every member takes at least 50 bytes, which also stops absurd allocations
+                if (_depth > MAX_MEMBER_NESTING || !read(count) || count > uint64_t(m_end-m_ptr)/50ull)
+                    return false;
+                if (count == 0ull)
+                    return true;
+                _members.array = _NBL_NEW_ARRAY(MembT, count);
+                for (size_t i = 0u; i < count; ++i)
+                {
+                    _members.array[i].members.array = nullptr;
+                    _members.array[i].members.count = 0u;
+                }
+                _members.count = count;
+                for (size_t i = 0u; i < count; ++i)
+                {
+                    auto& m = _members.array[i];
+                    if (!read(m.count) || !readAs<uint8_t>(m.countIsSpecConstant) || !read(m.offset) || !read(m.size) ||
+                        !read(m.arrayStride) || !read(m.mtxStride) || !read(m.mtxRowCnt) || !read(m.mtxColCnt) ||
+                        !readAs<uint8_t>(m.rowMajor) || !readAs<uint32_t>(m.type) || !read(m.name) || !read(m.members, _depth+1u))
+                        return false;
+                }
+                return true;
+            }
+            bool read(impl::SShaderMemoryBlock& _block)
+            {
+                return readAs<uint8_t>(_block.restrict_) && readAs<uint8_t>(_block.volatile_) && readAs<uint8_t>(_block.coherent) &&
+                    readAs<uint8_t>(_block.readonly) && readAs<uint8_t>(_block.writeonly) && read(_block.name) &&
+                    readAs<uint64_t>(_block.size) && readAs<uint64_t>(_block.rtSizedArrayOneElementSize) && read(_block.members, 0u);
+            }
+            bool read(CIntrospectionData& _data)
+            {
+                uint64_t count;
+                if (!read(count) || count > uint64_t(m_end-m_ptr))
+                    return false;
+                _data.specConstants.resize(count);
+                for (auto& sc : _data.specConstants)
+                if (!read(sc.id) || !readAs<uint64_t>(sc.byteSize) || !readAs<uint32_t>(sc.type) || !read(sc.name) || !read(sc.defaultValue.u64))
+                    return false;
+
+                for (auto& descSet : _data.descriptorSetBindings)
+                {
+                    if (!read(count) || count > uint64_t(m_end-m_ptr))
+                        return false;
+                    descSet.reserve(count);
+                    for (uint64_t i = 0u; i < count; ++i)
+                    {
+                        descSet.emplace_back();
+                        SShaderResourceVariant& res = descSet.back();
+                        // harmless to the destructor until the variant is constructed
+                        res.type = ESRT_SAMPLER;
+                        uint8_t type;
+                        if (!read(res.binding) || !read(type) || !read(res.descriptorCount) || !readAs<uint8_t>(res.descCountIsSpecConstant))
+                            return false;
+                        switch (type)
+                        {
+                        case ESRT_COMBINED_IMAGE_SAMPLER:
+                            if (!readAs<uint8_t>(res.get<ESRT_COMBINED_IMAGE_SAMPLER>().multisample) || !readAs<uint32_t>(res.get<ESRT_COMBINED_IMAGE_SAMPLER>().viewType) || !readAs<uint8_t>(res.get<ESRT_COMBINED_IMAGE_SAMPLER>().shadow))
+                                return false;
+                            break;
+                        case ESRT_STORAGE_IMAGE:
+                            if (!readAs<uint32_t>(res.get<ESRT_STORAGE_IMAGE>().format) || !readAs<uint32_t>(res.get<ESRT_STORAGE_IMAGE>().viewType) || !readAs<uint8_t>(res.get<ESRT_STORAGE_IMAGE>().shadow))
+                                return false;
+                            break;
+                        case ESRT_INPUT_ATTACHMENT:
+                            if (!read(res.get<ESRT_INPUT_ATTACHMENT>().inputAttachmentIndex))
+                                return false;
+                            break;
+                        case ESRT_UNIFORM_BUFFER:
+                            new (&res.variant.uniformBuffer) SShaderResource<ESRT_UNIFORM_BUFFER>();
+                            res.type = ESRT_UNIFORM_BUFFER;
+                            if (!read(static_cast<impl::SShaderMemoryBlock&>(res.get<ESRT_UNIFORM_BUFFER>())))
+                                return false;
+                            break;
+                        case ESRT_STORAGE_BUFFER:
+                            new (&res.variant.storageBuffer) SShaderResource<ESRT_STORAGE_BUFFER>();
+                            res.type = ESRT_STORAGE_BUFFER;
+                            if (!read(static_cast<impl::SShaderMemoryBlock&>(res.get<ESRT_STORAGE_BUFFER>())))
+                                return false;
+                            break;
+                        case ESRT_SAMPLED_IMAGE:
+                        case ESRT_UNIFORM_TEXEL_BUFFER:
+                        case ESRT_STORAGE_TEXEL_BUFFER:
+                        case ESRT_SAMPLER:
+                            break;
+                        default:
+                            return false;
+                        }
+                        res.type = static_cast<E_SHADER_RESOURCE_TYPE>(type);
+                    }
+                }
+
+                if (!read(count) || count > uint64_t(m_end-m_ptr))
+                    return false;
+                _data.inputOutput.resize(count);
+                for (auto& info : _data.inputOutput)
+                {
+                    if (!read(info.location) || !readAs<uint32_t>(info.glslType.basetype) || !read(info.glslType.elements) || !readAs<uint8_t>(info.type))
+                        return false;
+                    if (info.type == ESIT_STAGE_OUTPUT && !read(info.get<ESIT_STAGE_OUTPUT>().colorIndex))
+                        return false;
+                }
+
+                uint8_t present;
+                if (!read(present))
+                    return false;
+                if (present)
+                {
+                    _data.pushConstant.info.members.array = nullptr;
+                    _data.pushConstant.info.members.count = 0u;
+                    _data.pushConstant.present = true;
+                    return read(static_cast<impl::SShaderMemoryBlock&>(_data.pushConstant.info));
+                }
+                return true;
+            }
+
+            bool atEnd() const { return m_ptr == m_end; }
+
+        private:
+            const uint8_t* m_ptr;
+            const uint8_t* m_end;
+    };
+}
+
+bool CIntrospectionCache::serialize(const std::string& _path) const
+{
+    CWriter payload;
+    {
+        std::shared_lock<std::shared_mutex> lock(m_lock);
+        payload.write<uint64_t>(m_entries.size());
+        for (const auto& entry : m_entries)
+        {
+            payload.write(entry.first);
+            payload.write(*entry.second);
+        }
+    }
+
+    // introspection of GLSL depends on the compiler which produced the SPIR-V
+    const auto& version = CSPIRVDiskCache::getCompilerVersion();
+    SFileHeader header;
+    header.magic = INTROSPECTION_CACHE_MAGIC;
+    header.formatVersion = FormatVersion;
+    header.versionStringSize = version.size();
+    header.payloadSize = payload.data.size();
+    core::XXHash_256(payload.data.data(), payload.data.size(), header.checksum);
+
+    std::error_code ec;
+    if (!writeFileAtomically(_path, {{&header,sizeof(header)},{version.data(),version.size()},{payload.data.data(),payload.data.size()}}, ec))
+    {
+        os::Printer::log("CIntrospectionCache: could not write "+_path, ec.message(), ELL_ERROR);
+        return false;
+    }
+    return true;
+}
+
+bool CIntrospectionCache::deserialize(const std::string& _path)
+{
+    std::ifstream file(_path, std::ios::binary|std::ios::ate);
+    if (!file.is_open())
+        return false;
+    const uint64_t fileSize = file.tellg();
+    file.seekg(0);
+
+    SFileHeader header;
+    if (fileSize < sizeof(header) || !file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+        return false;
+    const auto& version = CSPIRVDiskCache::getCompilerVersion();
+    if (header.magic != INTROSPECTION_CACHE_MAGIC || header.formatVersion != FormatVersion || header.versionStringSize != version.size() ||
+        fileSize != sizeof(header)+header.versionStringSize+header.payloadSize)
+        return false;
+    std::string fileVersion(header.versionStringSize, '\0');
+    if (!file.read(fileVersion.data(), fileVersion.size()) || fileVersion != version)
+        return false;
+
+    core::vector<uint8_t> payload(header.payloadSize);
+    if (!file.read(reinterpret_cast<char*>(payload.data()), payload.size()))
+        return false;
+    uint64_t checksum[4];
+    core::XXHash_256(payload.data(), payload.size(), checksum);
+    if (memcmp(checksum, header.checksum, sizeof(checksum)) != 0)
+    {
+        os::Printer::log("CIntrospectionCache: corrupted file "+_path, ELL_ERROR);
+        return false;
+    }
+
+    // decode everything first, a broken file mustn't leave half of its entries in the cache
+    CReader reader(payload.data(), payload.data()+payload.size());
+    uint64_t entryCount;
+    if (!reader.read(entryCount))
+        return false;
+    core::vector<std::pair<hash_t,core::smart_refctd_ptr<CIntrospectionData>>> entries;
+    for (uint64_t i = 0u; i < entryCount; ++i)
+    {
+        hash_t key;
+        auto introspection = core::make_smart_refctd_ptr<CIntrospectionData>();
+        introspection->pushConstant.present = false;
+        if (!reader.read(key) || !reader.read(*introspection))
+        {
+            os::Printer::log("CIntrospectionCache: corrupted file "+_path, ELL_ERROR);
+            return false;
+        }
+        entries.emplace_back(key, std::move(introspection));
+    }
+    if (!reader.atEnd())
+        return false;
+
+    std::unique_lock<std::shared_mutex> lock(m_lock);
+    for (auto& entry : entries)
+        m_entries.emplace(entry.first, std::move(entry.second));
+    return true;
+}
+
 }//asset
 }//nbl
@@ -0,0 +1,133 @@
+// Copyright (C) 2018-2020 - DevSH Graphics Programming Sp. z O.O.
+// This file is part of the "Nabla Engine".
+// For conditions of distribution and use, see copyright notice in nabla.h
+
+#include "nbl/asset/CTipsifyVertexCacheOptimizer.h"
+
+#include <algorithm>
+
+namespace nbl { namespace asset
+{
+
+template<typename IdxT>
+void CTipsifyVertexCacheOptimizer::optimizeTriangleOrdering(const size_t _numVerts, const size_t _numIndices, const IdxT* _indices, IdxT* _outIndices, core::vector<uint32_t>* _outClusters) const
+{
+	if (_outClusters)
+		_outClusters->clear();
+
+	const size_t numTriangles = _numIndices/3u;
+	if (_numVerts==0u || numTriangles==0u)
+	{
+		std::copy(_indices,_indices+_numIndices,_outIndices);
+		if (_outClusters && numTriangles)
+			_outClusters->push_back(0u);
+		return;
+	}
+	_NBL_DEBUG_BREAK_IF(_indices==_outIndices);
+
+	// vertex-triangle adjacency in CSR form, `liveTriangles` counts the not yet emitted triangles of each vertex
+	core::vector<uint32_t> liveTriangles(_numVerts,0u);
+	for (size_t i=0u; i<numTriangles*3u; i++)
+	{
+		_NBL_DEBUG_BREAK_IF(_indices[i]>=_numVerts); // Out of range index.
+		liveTriangles[_indices[i]]++;
+	}
+	core::vector<uint32_t> adjacencyOffsets(_numVerts+1u);
+	adjacencyOffsets[0] = 0u;
+	for (size_t v=0u; v<_numVerts; v++)
+		adjacencyOffsets[v+1u] = adjacencyOffsets[v]+liveTriangles[v];
+	core::vector<uint32_t> adjacency(adjacencyOffsets.back());
+	{
+		core::vector<uint32_t> fill(adjacencyOffsets.begin(),adjacencyOffsets.end()-1u);
+		for (uint32_t t=0u; t<numTriangles; t++)
+		for (uint32_t c=0u; c<3u; c++)
+			adjacency[fill[_indices[t*3u+c]]++] = t;
+	}
+
+	const size_t cacheSize = m_fifoSize;
+	core::vector<size_t> cacheTimestamps(_numVerts,0u);
+	core::vector<bool> emitted(numTriangles,false);
+	core::vector<uint32_t> deadEnds;
+	core::vector<uint32_t> candidates;
+	deadEnds.reserve(_numIndices);
+	candidates.reserve(64u);
+
+	size_t timestamp = cacheSize+1u;
+	size_t cursor = 0u;
+	size_t outTriangle = 0u;
+	IdxT* out = _outIndices;
+
+	auto skipDeadEnd = [&]() -> int64_t
+	{
+		while (!deadEnds.empty())
+		{
+			const uint32_t d = deadEnds.back();
+			deadEnds.pop_back();
+			if (liveTriangles[d])
+				return d;
+		}
+		for (; cursor<_numVerts; cursor++)
+		if (liveTriangles[cursor])
+			return cursor;
+		return -1;
+	};
+
+	int64_t fanningVertex = skipDeadEnd();
+	if (_outClusters)
+		_outClusters->push_back(0u);
+	while (fanningVertex>=0)
+	{
+		candidates.clear();
+		// emit all live triangles around the fanning vertex
+		for (uint32_t i=adjacencyOffsets[fanningVertex]; i<adjacencyOffsets[fanningVertex+1u]; i++)
+		{
+			const uint32_t t = adjacency[i];
+			if (emitted[t])
+				continue;
+			for (uint32_t c=0u; c<3u; c++)
+			{
+				const IdxT v = _indices[t*3u+c];
+				*(out++) = v;
+				deadEnds.push_back(v);
+				candidates.push_back(v);
+				liveTriangles[v]--;
+				if (timestamp-cacheTimestamps[v]>cacheSize)
+					cacheTimestamps[v] = timestamp++;
+			}
+			emitted[t] = true;
+			outTriangle++;
+		}
+
+		// pick the candidate which will still be in the cache after its remaining fan gets emitted, and had been in there longest
+		int64_t next = -1;
+		int64_t bestPriority = -1;
+		for (const uint32_t v : candidates)
+		{
+			if (!liveTriangles[v])
+				continue;
+			int64_t priority = 0;
+			if (timestamp-cacheTimestamps[v]+2u*liveTriangles[v]<=cacheSize)
+				priority = timestamp-cacheTimestamps[v];
+			if (priority>bestPriority)
+			{
+				bestPriority = priority;
+				next = v;
+			}
+		}
+		if (next<0)
+		{
+			next = skipDeadEnd();
+			// dead ends are recently emitted vertices and often still in the cache, then the fans carry on from it
+			// only skipping to a vertex which is out of the cache (any the sequential cursor finds usually is) starts a new cluster
+			if (_outClusters && next>=0 && outTriangle<numTriangles && timestamp-cacheTimestamps[next]>cacheSize)
+				_outClusters->push_back(outTriangle);
+		}
+		fanningVertex = next;
+	}
+	_NBL_DEBUG_BREAK_IF(outTriangle!=numTriangles);
+}
+
+template void CTipsifyVertexCacheOptimizer::optimizeTriangleOrdering<uint16_t>(const size_t, const size_t, const uint16_t*, uint16_t*, core::vector<uint32_t>*) const;
+template void CTipsifyVertexCacheOptimizer::optimizeTriangleOrdering<uint32_t>(const size_t, const size_t, const uint32_t*, uint32_t*, core::vector<uint32_t>*) const;
+
+}} // nbl::asset
@@ -103,7 +103,7 @@ std::function<void(SAssetBundle&)> nbl::asset::makeAssetDisposeFunc(const IAsset
 	return [_mgr](SAssetBundle& _asset) {
 		_mgr->setAssetCached(_asset, false);
 		auto rng = _asset.getContents();
-        for (auto ass : rng)
+        for (const auto& ass : rng)
 			_mgr->setAssetMutability(ass.get(), IAsset::EM_MUTABLE);
 	};
 }
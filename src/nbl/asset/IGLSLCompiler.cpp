@@ -5,6 +5,7 @@
 #include <sstream>
 #include <regex>
 #include <iterator>
+#include <algorithm>
 
 #include "nbl/asset/IGLSLCompiler.h"
 #include "nbl/asset/shadercUtils.h"
@@ -22,19 +23,36 @@ namespace nbl
 namespace asset
 {
 
-static constexpr shaderc_spirv_version TARGET_SPIRV_VERSION = shaderc_spirv_version_1_5;
-
-IGLSLCompiler::IGLSLCompiler(io::IFileSystem* _fs) : m_inclHandler(core::make_smart_refctd_ptr<CIncludeHandler>(_fs)), m_fs(_fs)
+IGLSLCompiler::IGLSLCompiler(io::IFileSystem* _fs) : m_inclHandler(core::make_smart_refctd_ptr<CIncludeHandler>(_fs)), m_fs(_fs), m_includeCache(core::make_smart_refctd_ptr<CGLSLIncludeCache>())
 {
     m_inclHandler->addBuiltinIncludeLoader(core::make_smart_refctd_ptr<asset::CGLSLVirtualTexturingBuiltinIncludeLoader>(_fs));
 }
 
-core::smart_refctd_ptr<ICPUBuffer> IGLSLCompiler::compileSPIRVFromGLSL(const char* _glslCode, ISpecializedShader::E_SHADER_STAGE _stage, const char* _entryPoint, const char* _compilationId, bool _genDebugInfo, std::string* _outAssembly) const
+//! Goes into `_outDiagnostics` when batch compiling, so messages of different shaders don't interleave
+static void reportDiagnostics(const std::string& _msg, std::string* _outDiagnostics, ELOG_LEVEL _lvl = ELL_ERROR)
+{
+    if (_msg.empty())
+        return;
+    if (_outDiagnostics)
+    {
+        _outDiagnostics->append(_msg);
+        if (_msg.back()!='\n')
+            _outDiagnostics->push_back('\n');
+    }
+    else
+        os::Printer::log(_msg, _lvl);
+}
+
+core::smart_refctd_ptr<ICPUBuffer> IGLSLCompiler::compileSPIRVFromGLSL(const char* _glslCode, ISpecializedShader::E_SHADER_STAGE _stage, const char* _entryPoint, const char* _compilationId, bool _genDebugInfo, std::string* _outAssembly, std::string* _outDiagnostics) const
 {
     //shaderc requires entry point to be "main" in GLSL
     if (strcmp(_entryPoint, "main") != 0)
+    {
+        reportDiagnostics(std::string(_compilationId ? _compilationId : "") + ": GLSL entry point has to be \"main\"", _outDiagnostics);
         return nullptr;
+    }
 
+    core::CMemoryStatistics::CSubsystemScope memoryScope(core::EMS_SHADER_COMPILER);
     shaderc::Compiler comp;
     shaderc::CompileOptions options;//default options
     options.SetTargetSpirv(TARGET_SPIRV_VERSION);
@@ -47,6 +65,12 @@ core::smart_refctd_ptr<ICPUBuffer> IGLSLCompiler::compileSPIRVFromGLSL(const cha
     shaderc::SpvCompilationResult bin_res;
     if (_outAssembly) {
         asm_res = comp.CompileGlslToSpvAssembly(_glslCode, glsl_len, stage, _compilationId ? _compilationId : "", options);
+        if (asm_res.GetCompilationStatus() != shaderc_compilation_status_success) {
+            reportDiagnostics(asm_res.GetErrorMessage(), _outDiagnostics);
+            return nullptr;
+        }
+        if (_outDiagnostics)
+            reportDiagnostics(asm_res.GetErrorMessage(), _outDiagnostics, ELL_WARNING);
         _outAssembly->resize(std::distance(asm_res.cbegin(), asm_res.cend()));
         memcpy(_outAssembly->data(), asm_res.cbegin(), _outAssembly->size());
         bin_res = comp.AssembleToSpv(_outAssembly->data(), _outAssembly->size(), options);
@@ -56,31 +80,52 @@ core::smart_refctd_ptr<ICPUBuffer> IGLSLCompiler::compileSPIRVFromGLSL(const cha
     }
 
     if (bin_res.GetCompilationStatus() != shaderc_compilation_status_success) {
-        os::Printer::log(bin_res.GetErrorMessage(), ELL_ERROR);
+        reportDiagnostics(bin_res.GetErrorMessage(), _outDiagnostics);
         return nullptr;
     }
+    // warnings never got logged, but whoever asked for diagnostics wants them
+    if (_outDiagnostics && !_outAssembly)
+        reportDiagnostics(bin_res.GetErrorMessage(), _outDiagnostics, ELL_WARNING);
 
     auto spirv = core::make_smart_refctd_ptr<ICPUBuffer>(std::distance(bin_res.cbegin(), bin_res.cend())*sizeof(uint32_t));
     memcpy(spirv->getPointer(), bin_res.cbegin(), spirv->getSize());
 	return spirv;
 }
 
-core::smart_refctd_ptr<ICPUShader> IGLSLCompiler::createSPIRVFromGLSL(const char* _glslCode, ISpecializedShader::E_SHADER_STAGE _stage, const char* _entryPoint, const char* _compilationId, const ISPIRVOptimizer* _opt, bool _genDebugInfo, std::string* _outAssembly) const
+core::smart_refctd_ptr<ICPUShader> IGLSLCompiler::createSPIRVFromGLSL_impl(const char* _glslCode, ISpecializedShader::E_SHADER_STAGE _stage, const char* _entryPoint, const char* _compilationId, const ISPIRVOptimizer* _opt, bool _genDebugInfo, std::string* _outAssembly, std::string* _outDiagnostics) const
 {
-    auto spirvBuffer = compileSPIRVFromGLSL(_glslCode,_stage,_entryPoint,_compilationId,_genDebugInfo,_outAssembly);
+    CSPIRVDiskCache::SKey key;
+    if (m_cache)
+    {
+        key = CSPIRVDiskCache::computeKey(_glslCode,strlen(_glslCode),_stage,_entryPoint,_compilationId,_genDebugInfo,_opt);
+        if (auto cached = m_cache->find(key,_outAssembly))
+            return core::make_smart_refctd_ptr<asset::ICPUShader>(std::move(cached));
+    }
+
+    auto spirvBuffer = compileSPIRVFromGLSL(_glslCode,_stage,_entryPoint,_compilationId,_genDebugInfo,_outAssembly,_outDiagnostics);
 	if (!spirvBuffer)
 		return nullptr;
     if (_opt)
-        spirvBuffer = _opt->optimize(spirvBuffer.get());
+        spirvBuffer = _opt->optimize(spirvBuffer.get(),_outDiagnostics);
+    if (!spirvBuffer)
+        return nullptr;
+
+    if (m_cache)
+        m_cache->insert(key,spirvBuffer.get(),_outAssembly);
 
     return core::make_smart_refctd_ptr<asset::ICPUShader>(std::move(spirvBuffer));
 }
 
+core::smart_refctd_ptr<ICPUShader> IGLSLCompiler::createSPIRVFromGLSL(const char* _glslCode, ISpecializedShader::E_SHADER_STAGE _stage, const char* _entryPoint, const char* _compilationId, const ISPIRVOptimizer* _opt, bool _genDebugInfo, std::string* _outAssembly) const
+{
+    return createSPIRVFromGLSL_impl(_glslCode,_stage,_entryPoint,_compilationId,_opt,_genDebugInfo,_outAssembly,nullptr);
+}
+
 core::smart_refctd_ptr<ICPUShader> IGLSLCompiler::createSPIRVFromGLSL(io::IReadFile* _sourcefile, ISpecializedShader::E_SHADER_STAGE _stage, const char* _entryPoint, const char* _compilationId, const ISPIRVOptimizer* _opt, bool _genDebugInfo, std::string* _outAssembly) const
 {
     std::string glsl(_sourcefile->getSize(), '\0');
     _sourcefile->read(glsl.data(), glsl.size());
-    return createSPIRVFromGLSL(glsl.c_str(), _stage, _entryPoint, _compilationId, _opt, _outAssembly);
+    return createSPIRVFromGLSL(glsl.c_str(), _stage, _entryPoint, _compilationId, _opt, _genDebugInfo, _outAssembly);
 }
 
 namespace impl
@@ -158,10 +203,11 @@ namespace impl
     {
         const asset::IIncludeHandler* m_inclHandler;
         const io::IFileSystem* m_fs;
+        asset::CGLSLIncludeCache* m_cache;
         const uint32_t m_maxInclCnt;
 
     public:
-        Includer(const asset::IIncludeHandler* _inclhndlr, const io::IFileSystem* _fs, uint32_t _maxInclCnt) : m_inclHandler(_inclhndlr), m_fs(_fs), m_maxInclCnt{_maxInclCnt} {}
+        Includer(const asset::IIncludeHandler* _inclhndlr, const io::IFileSystem* _fs, asset::CGLSLIncludeCache* _cache, uint32_t _maxInclCnt) : m_inclHandler(_inclhndlr), m_fs(_fs), m_cache(_cache), m_maxInclCnt{_maxInclCnt} {}
 
         //_requesting_source in top level #include's is what shaderc::Compiler's compiling functions get as `input_file_name` parameter
         //so in order for properly working relative #include's (""-type) `input_file_name` has to be path to file from which the GLSL source really come from
@@ -191,12 +237,32 @@ namespace impl
             if (!reqBuiltin)
                 name = m_fs->getAbsolutePath(name);
 
-            if (_type == shaderc_include_type_relative)
-                res_str = m_inclHandler->getIncludeRelative(_requested_source, relDir.c_str());
-            else //shaderc_include_type_standard
-                res_str = m_inclHandler->getIncludeStandard(_requested_source);
+            //builtins can't change, so they don't even get fetched again, files do in case they were edited but the costly part is skipped if they weren't
+            const std::string key = name.c_str();
+            bool found = reqBuiltin && m_cache->find(key, nullptr, res_str);
+            if (!found)
+            {
+                if (_type == shaderc_include_type_relative)
+                    res_str = m_inclHandler->getIncludeRelative(_requested_source, relDir.c_str());
+                else //shaderc_include_type_standard
+                    res_str = m_inclHandler->getIncludeStandard(_requested_source);
+
+                if (res_str.size())
+                {
+                    const auto contentHash = asset::CGLSLIncludeCache::hashContents(res_str);
+                    found = !reqBuiltin && m_cache->find(key, &contentHash, res_str);
+                    if (!found)
+                    {
+                        disableAllDirectivesExceptIncludes(res_str);
+                        m_cache->insert(key, {_requested_source, relDir.c_str(), _type == shaderc_include_type_relative, reqBuiltin}, contentHash, res_str);
+                        found = true;
+                    }
+                }
+            }
+            if (found)
+                m_cache->addDependency(_requesting_source, key);
 
-            if (!res_str.size()) {
+            if (!found) {
                 const char* error_str = "Could not open file";
                 res->content_length = strlen(error_str);
                 res->content = new char[res->content_length+1u];
@@ -206,7 +272,6 @@ namespace impl
             }
             else {
                 //employ encloseWithinExtraInclGuards() in order to prevent infinite loop of (not necesarilly direct) self-inclusions while other # directives (incl guards among them) are disabled
-                disableAllDirectivesExceptIncludes(res_str);
                 res_str = encloseWithinExtraInclGuards( std::move(res_str), m_maxInclCnt, name.c_str() );
 
                 res->content_length = res_str.size();
@@ -231,25 +296,32 @@ namespace impl
     };
 }
 
-core::smart_refctd_ptr<ICPUShader> IGLSLCompiler::resolveIncludeDirectives(std::string&& glslCode, ISpecializedShader::E_SHADER_STAGE _stage, const char* _originFilepath, uint32_t _maxSelfInclusionCnt) const
+bool IGLSLCompiler::resolveIncludeDirectives_impl(std::string& _glslCode, ISpecializedShader::E_SHADER_STAGE _stage, const char* _originFilepath, uint32_t _maxSelfInclusionCnt, std::string* _outDiagnostics) const
 {
-    impl::disableAllDirectivesExceptIncludes(glslCode);//all "#", except those in "#include"/"#version"/"#pragma shader_stage(...)", replaced with `PREPROC_DIRECTIVE_DISABLER`
+    impl::disableAllDirectivesExceptIncludes(_glslCode);//all "#", except those in "#include"/"#version"/"#pragma shader_stage(...)", replaced with `PREPROC_DIRECTIVE_DISABLER`
     shaderc::Compiler comp;
     shaderc::CompileOptions options;
     options.SetTargetSpirv(TARGET_SPIRV_VERSION);
-    options.SetIncluder(std::make_unique<impl::Includer>(m_inclHandler.get(), m_fs, _maxSelfInclusionCnt+1u));//custom #include handler
+    options.SetIncluder(std::make_unique<impl::Includer>(m_inclHandler.get(), m_fs, m_includeCache.get(), _maxSelfInclusionCnt+1u));//custom #include handler
     const shaderc_shader_kind stage = _stage==ISpecializedShader::ESS_UNKNOWN ? shaderc_glsl_infer_from_source : ESStoShadercEnum(_stage);
-    auto res = comp.PreprocessGlsl(glslCode, stage, _originFilepath, options);
+    auto res = comp.PreprocessGlsl(_glslCode, stage, _originFilepath, options);
 
     if (res.GetCompilationStatus() != shaderc_compilation_status_success) {
-        os::Printer::log(res.GetErrorMessage(), ELL_ERROR);
-        return nullptr;
+        reportDiagnostics(res.GetErrorMessage(), _outDiagnostics);
+        return false;
     }
 
-    std::string res_str(res.cbegin(), std::distance(res.cbegin(),res.cend()));
-    impl::reenableDirectives(res_str);
+    _glslCode.assign(res.cbegin(), std::distance(res.cbegin(),res.cend()));
+    impl::reenableDirectives(_glslCode);
+    return true;
+}
+
+core::smart_refctd_ptr<ICPUShader> IGLSLCompiler::resolveIncludeDirectives(std::string&& glslCode, ISpecializedShader::E_SHADER_STAGE _stage, const char* _originFilepath, uint32_t _maxSelfInclusionCnt) const
+{
+    if (!resolveIncludeDirectives_impl(glslCode, _stage, _originFilepath, _maxSelfInclusionCnt, nullptr))
+        return nullptr;
 
-    return core::make_smart_refctd_ptr<ICPUShader>(res_str.c_str());
+    return core::make_smart_refctd_ptr<ICPUShader>(glslCode.c_str());
 }
 
 core::smart_refctd_ptr<ICPUShader> IGLSLCompiler::resolveIncludeDirectives(io::IReadFile* _sourcefile, ISpecializedShader::E_SHADER_STAGE _stage, const char* _originFilepath, uint32_t _maxSelfInclusionCnt) const
@@ -259,4 +331,55 @@ core::smart_refctd_ptr<ICPUShader> IGLSLCompiler::resolveIncludeDirectives(io::I
     return resolveIncludeDirectives(std::move(glsl), _stage, _originFilepath, _maxSelfInclusionCnt);
 }
 
+core::vector<std::string> IGLSLCompiler::refreshIncludeCache()
+{
+    core::vector<std::string> retval;
+    for (const auto& include : m_includeCache->getFilesystemIncludes())
+    {
+        const auto& source = include.second;
+        const std::string contents = source.relative ? m_inclHandler->getIncludeRelative(source.requested, source.workingDirectory):m_inclHandler->getIncludeStandard(source.requested);
+        if (!m_includeCache->hasChanged(include.first, contents))
+            continue;
+
+        auto dependents = m_includeCache->getDependents(include.first);
+        retval.insert(retval.end(), std::make_move_iterator(dependents.begin()), std::make_move_iterator(dependents.end()));
+        retval.push_back(include.first);
+        m_includeCache->invalidate(include.first);
+    }
+    std::sort(retval.begin(), retval.end());
+    retval.erase(std::unique(retval.begin(), retval.end()), retval.end());
+    return retval;
+}
+
+core::vector<IGLSLCompiler::SCompilationResult> IGLSLCompiler::compileBatch(const core::SRange<const SCompilationJob>& _jobs, core::CWorkStealingScheduler* _scheduler) const
+{
+    core::vector<SCompilationResult> results(_jobs.size());
+    // every job only touches its own result, so the output does not depend on the order they run in
+    auto compileJob = [&](const size_t i) -> void
+    {
+        const SCompilationJob& job = _jobs.begin()[i];
+        SCompilationResult& result = results[i];
+        if (!job.glsl)
+        {
+            reportDiagnostics(std::string(job.originFilepath) + ": no GLSL source", &result.diagnostics);
+            return;
+        }
+
+        std::string glsl(job.glsl);
+        IShader::insertDefines(glsl, job.defines);
+        if (!resolveIncludeDirectives_impl(glsl, job.stage, job.originFilepath, job.maxSelfInclusionCnt, &result.diagnostics))
+            return;
+        result.shader = createSPIRVFromGLSL_impl(glsl.c_str(), job.stage, "main", job.originFilepath, job.optimizer, job.genDebugInfo, nullptr, &result.diagnostics);
+    };
+
+    if (_scheduler)
+        _scheduler->parallel_for(0u, results.size(), compileJob, 1u);
+    else
+    {
+        for (size_t i=0u; i<results.size(); i++)
+            compileJob(i);
+    }
+    return results;
+}
+
 }}
@@ -11,7 +11,7 @@ using namespace nbl::asset;
 
 static constexpr spv_target_env SPIRV_VERSION = spv_target_env::SPV_ENV_UNIVERSAL_1_5;
 
-nbl::core::smart_refctd_ptr<ICPUBuffer> ISPIRVOptimizer::optimize(const uint32_t* _spirv, uint32_t _dwordCount) const
+nbl::core::smart_refctd_ptr<ICPUBuffer> ISPIRVOptimizer::optimize(const uint32_t* _spirv, uint32_t _dwordCount, std::string* _outDiagnostics) const
 {
     //https://www.lunarg.com/wp-content/uploads/2020/05/SPIR-V-Shader-Legalization-and-Size-Reduction-Using-spirv-opt_v1.2.pdf
 
@@ -42,7 +42,7 @@ nbl::core::smart_refctd_ptr<ICPUBuffer> ISPIRVOptimizer::optimize(const uint32_t
         &spvtools::CreateIfConversionPass
     };
 
-    auto msgConsumer = [](spv_message_level_t level, const char* src, const spv_position_t& pos, const char* msg)
+    auto msgConsumer = [_outDiagnostics](spv_message_level_t level, const char* src, const spv_position_t& pos, const char* msg)
     {
         using namespace std::string_literals;
 
@@ -57,7 +57,10 @@ nbl::core::smart_refctd_ptr<ICPUBuffer> ISPIRVOptimizer::optimize(const uint32_t
         const auto lvl = lvl2lvl[level];
         const std::string location = src + ":"s + std::to_string(pos.line) + ":" + std::to_string(pos.column);
 
-        os::Printer::log(location, msg, lvl);
+        if (_outDiagnostics)
+            _outDiagnostics->append(location).append(": ").append(msg).append("\n");
+        else
+            os::Printer::log(location, msg, lvl);
     };
 
     spvtools::Optimizer opt(SPIRV_VERSION);
@@ -80,10 +83,10 @@ nbl::core::smart_refctd_ptr<ICPUBuffer> ISPIRVOptimizer::optimize(const uint32_t
     return result;
 }
 
-nbl::core::smart_refctd_ptr<ICPUBuffer> ISPIRVOptimizer::optimize(const ICPUBuffer* _spirv) const
+nbl::core::smart_refctd_ptr<ICPUBuffer> ISPIRVOptimizer::optimize(const ICPUBuffer* _spirv, std::string* _outDiagnostics) const
 {
     const uint32_t* spirv = reinterpret_cast<const uint32_t*>(_spirv->getPointer());
     const uint32_t count = _spirv->getSize() / sizeof(uint32_t);
 
-    return optimize(spirv, count);
+    return optimize(spirv, count, _outDiagnostics);
 }
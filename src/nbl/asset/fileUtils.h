@@ -0,0 +1,69 @@
+// Copyright (C) 2018-2020 - DevSH Graphics Programming Sp. z O.O.
+// This file is part of the "Nabla Engine".
+// For conditions of distribution and use, see copyright notice in nabla.h
+
+#ifndef __NBL_ASSET_FILE_UTILS_H_INCLUDED__
+#define __NBL_ASSET_FILE_UTILS_H_INCLUDED__
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <initializer_list>
+#include <random>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+
+namespace nbl
+{
+namespace asset
+{
+    //! Writes the `_chunks` one after another into a temporary next to `_path` and renames it over `_path`, readers see either the old or the new file
+    /** The temporary is named `_path.<unique><_tmpExtension>`, unique per process and thread so concurrent writers never share one,
+    whoever owns the directory can recognise the ones left behind by a crash by the extension. On failure the temporary is removed and `_ec` says why. */
+    inline bool writeFileAtomically(const std::filesystem::path& _path, std::initializer_list<std::pair<const void*,size_t>> _chunks, std::error_code& _ec, const char* _tmpExtension=".tmp")
+    {
+        namespace fs = std::filesystem;
+
+        fs::path tmpPath;
+        {
+            static std::atomic_uint32_t counter = 0u;
+            static const uint64_t processSalt = (uint64_t(std::random_device{}())<<32ull)^uint64_t(std::chrono::high_resolution_clock::now().time_since_epoch().count());
+            const uint64_t unique = processSalt^(uint64_t(std::hash<std::thread::id>{}(std::this_thread::get_id()))<<16ull)^counter++;
+            tmpPath = _path;
+            tmpPath += "."+std::to_string(unique)+_tmpExtension;
+        }
+
+        {
+            std::ofstream file(tmpPath,std::ios::binary|std::ios::trunc);
+            if (file.is_open())
+            {
+                for (const auto& chunk : _chunks)
+                if (chunk.second)
+                    file.write(reinterpret_cast<const char*>(chunk.first),chunk.second);
+                file.close();
+            }
+            if (!file)
+            {
+                fs::remove(tmpPath,_ec);
+                _ec = std::make_error_code(std::errc::io_error);
+                return false;
+            }
+        }
+        // atomic replace, if it fails (i.e. someone has the file open on Windows) the old file stays
+        fs::rename(tmpPath,_path,_ec);
+        if (_ec)
+        {
+            std::error_code ignored;
+            fs::remove(tmpPath,ignored);
+            return false;
+        }
+        return true;
+    }
+}
+}
+
+#endif
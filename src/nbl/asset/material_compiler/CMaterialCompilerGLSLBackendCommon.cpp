@@ -82,62 +82,50 @@ namespace material_compiler
 		core::unordered_map<const IR::INode*, id_t> m_cache;
 	};
 
-	template <typename stack_el_t>
-	class ITraversalGenerator
+	//everything compiling a single root produces, roots get compiled in parallel and merged in order afterwards
+	struct SRootContext
 	{
-	protected:
 		using SContext = CMaterialCompilerGLSLBackendCommon::SContext;
 
-		SContext* m_ctx;
-		IR* m_ir;
-		CIdGenerator* m_id_gen;
-		tmp_bxdf_translation_cache_t* m_translationCache;
-
-		core::stack<stack_el_t> m_stack;
-
-		//IDs in bumpmaps start with 0 (see writeBumpmapBitfields())
-		//rem_and_pdf: instructions not preceded with OP_BUMPMAP (resulting from node without any bumpmap above in tree) will have normal ID = ~0
-		uint32_t m_firstFreeNormalID = static_cast<uint32_t>(-1);
-
-		uint32_t m_registerPool;
-
-		/*template <typename ...Params>
-		static stack_el_t createStackEl(Params&& ...args)
-		{
-			return stack_el_t {std::forward<Params>(args)...};
-		}*/
+		//indices into these are local to the root until the merge
+		core::vector<instr_stream::intermediate::SBSDFUnion> bsdfData;
+		core::unordered_map<const IR::INode*, size_t> bsdfDataIndexMap;
+		//opcode and node each of the entries got made for
+		core::vector<std::pair<instr_stream::E_OPCODE, const IR::INode*>> bsdfDataSources;
+		//textures which weren't in the VT yet, in order of first use
+		core::vector<IR::INode::STextureSource> textureRequests;
+		core::unordered_set<SContext::VTallocKey, SContext::VTallocKeyHash> requestedTextures;
 
-		virtual void writeInheritableBitfields(instr_t& dst, instr_t parent) const
-		{
+		traversal_t rem_pdf_stream;
+		traversal_t gen_choice_stream;
+		traversal_t normal_precomp_stream;
+		instr_stream::tex_prefetch::prefetch_stream_t tex_prefetch_stream;
+		//`bsdfData` with texture parameters turned into prefetch registers
+		core::vector<instr_stream::SBSDFUnion> finalBSDFData;
+		uint32_t registerPool = instr_stream::MAX_REGISTER_COUNT;
+		uint32_t regCntFlags = 0u;
+	};
 
-		}
+	class CBSDFDataWriter
+	{
+		using SContext = CMaterialCompilerGLSLBackendCommon::SContext;
 
-		// Extra operations performed on instruction just before it is pushed on stack
-		virtual void onBeforeStackPush(instr_t& instr, const IR::INode* node) const
-		{
-			instr_stream::instr_id_t id = m_id_gen->get_id(node);
-			instr_stream::setInstrId(instr, id);
-		}
+		const SContext* m_ctx;
+		SRootContext* m_root;
 
-		void writeBumpmapBitfields(instr_t& dst)
+		//the VT is shared by all roots, so textures it doesn't have yet get requested and are written in once compile() allocated them
+		instr_stream::VTID packTexture(const IR::INode::STextureSource& tex)
 		{
-			++m_firstFreeNormalID;
-			dst = core::bitfieldInsert<instr_t>(dst, m_firstFreeNormalID, instr_stream::INSTR_NORMAL_ID_SHIFT, instr_stream::INSTR_NORMAL_ID_WIDTH);
-		}
+			if (auto found = m_ctx->VTallocMap.find({ tex.image.get(),tex.sampler.get() }); found != m_ctx->VTallocMap.end())
+				return found->second;
 
-		void filterNOOPs(traversal_t& _traversal)
-		{
-			_traversal.erase(
-				std::remove_if(_traversal.begin(), _traversal.end(), [](instr_t i) { return instr_stream::getOpcode(i) == instr_stream::OP_NOOP; }),
-				_traversal.end()
-			);
+			if (m_root->requestedTextures.insert({ tex.image.get(),tex.sampler.get() }).second)
+				m_root->textureRequests.push_back(tex);
+			return instr_stream::VTID::invalid();
 		}
 
-		std::pair<instr_t, const IR::INode*> processSubtree(const IR::INode* tree, IR::INode::children_array_t& next)
-		{
-			//TODO deduplication
-			return CInterpreter::processSubtree(m_ir, tree, next, m_translationCache);
-		}
+	public:
+		CBSDFDataWriter(const SContext* _ctx, SRootContext* _root) : m_ctx(_ctx), m_root(_root) {}
 
 		void setBSDFData(instr_stream::intermediate::SBSDFUnion& _dst, instr_stream::E_OPCODE _op, const IR::INode* _node)
 		{
@@ -250,32 +238,44 @@ namespace material_compiler
 			}
 		}
 
-		size_t getBSDFDataIndex(instr_stream::E_OPCODE _op, const IR::INode* _node)
+		//whether setBSDFData would pack any texture for the node
+		static bool usesTextures(instr_stream::E_OPCODE _op, const IR::INode* _node)
 		{
+			auto isTex = [](const auto& param) { return param.source == IR::INode::EPS_TEXTURE; };
 			switch (_op)
 			{
-			case instr_stream::OP_INVALID: [[fallthrough]];
-			case instr_stream::OP_NOOP:
-				return 0ull;
-			default: break;
+			case instr_stream::OP_DIFFUSE:
+			{
+				auto* node = static_cast<const IR::CMicrofacetDiffuseBSDFNode*>(_node);
+				return isTex(node->alpha_u) || isTex(node->reflectance);
+			}
+			case instr_stream::OP_DIELECTRIC: [[fallthrough]];
+			case instr_stream::OP_THINDIELECTRIC: [[fallthrough]];
+			case instr_stream::OP_CONDUCTOR:
+			{
+				auto* node = static_cast<const IR::CMicrofacetSpecularBSDFNode*>(_node);
+				return isTex(node->alpha_u) || isTex(node->alpha_v);
+			}
+			case instr_stream::OP_COATING:
+				return isTex(static_cast<const IR::CMicrofacetCoatingBSDFNode*>(_node)->thicknessSigmaA);
+			case instr_stream::OP_BLEND:
+				return isTex(static_cast<const IR::CBSDFBlendNode*>(_node)->weight);
+			case instr_stream::OP_DIFFTRANS:
+			{
+				auto* node = static_cast<const IR::CMicrofacetDifftransBSDFNode*>(_node);
+				return isTex(node->alpha_u) || isTex(node->transmittance);
+			}
+			case instr_stream::OP_BUMPMAP:
+				return true;
+			default:
+				return false;
 			}
-
-			auto found = m_ctx->bsdfDataIndexMap.find(_node);
-			if (found != m_ctx->bsdfDataIndexMap.end())
-				return found->second;
-
-			instr_stream::intermediate::SBSDFUnion data;
-			setBSDFData(data, _op, _node);
-			size_t ix = m_ctx->bsdfData.size();
-			m_ctx->bsdfDataIndexMap.insert({_node,ix});
-			m_ctx->bsdfData.push_back(data);
-
-			return ix;
 		}
 
-		instr_stream::VTID packTexture(const IR::INode::STextureSource& tex)
+		//allocates the texture in the VT unless it's there already
+		static instr_stream::VTID allocTexture(SContext* _ctx, const IR::INode::STextureSource& tex)
 		{
-			if (auto found = m_ctx->VTallocMap.find({ tex.image.get(),tex.sampler.get() }); found != m_ctx->VTallocMap.end())
+			if (auto found = _ctx->VTallocMap.find({ tex.image.get(),tex.sampler.get() }); found != _ctx->VTallocMap.end())
 				return found->second;
 
 			auto img = tex.image->getCreationParameters().image;
@@ -301,13 +301,96 @@ namespace material_compiler
 			alloc.subresource = subres;
 			alloc.uwrap = uwrap;
 			alloc.vwrap = vwrap;
-			auto addr = m_ctx->vt.alloc(alloc, std::move(img), border);
+			auto addr = _ctx->vt.alloc(alloc, std::move(img), border);
 
 			std::pair<SContext::VTallocKey, instr_stream::VTID> item{{tex.image.get(),tex.sampler.get()}, addr};
-			m_ctx->VTallocMap.insert(item);
+			_ctx->VTallocMap.insert(item);
 
 			return addr;
 		}
+	};
+
+	template <typename stack_el_t>
+	class ITraversalGenerator
+	{
+	protected:
+		using SContext = CMaterialCompilerGLSLBackendCommon::SContext;
+
+		SRootContext* m_root;
+		CBSDFDataWriter m_dataWriter;
+		IR* m_ir;
+		CIdGenerator* m_id_gen;
+		tmp_bxdf_translation_cache_t* m_translationCache;
+
+		core::stack<stack_el_t> m_stack;
+
+		//IDs in bumpmaps start with 0 (see writeBumpmapBitfields())
+		//rem_and_pdf: instructions not preceded with OP_BUMPMAP (resulting from node without any bumpmap above in tree) will have normal ID = ~0
+		uint32_t m_firstFreeNormalID = static_cast<uint32_t>(-1);
+
+		uint32_t m_registerPool;
+
+		/*template <typename ...Params>
+		static stack_el_t createStackEl(Params&& ...args)
+		{
+			return stack_el_t {std::forward<Params>(args)...};
+		}*/
+
+		virtual void writeInheritableBitfields(instr_t& dst, instr_t parent) const
+		{
+
+		}
+
+		// Extra operations performed on instruction just before it is pushed on stack
+		virtual void onBeforeStackPush(instr_t& instr, const IR::INode* node) const
+		{
+			instr_stream::instr_id_t id = m_id_gen->get_id(node);
+			instr_stream::setInstrId(instr, id);
+		}
+
+		void writeBumpmapBitfields(instr_t& dst)
+		{
+			++m_firstFreeNormalID;
+			dst = core::bitfieldInsert<instr_t>(dst, m_firstFreeNormalID, instr_stream::INSTR_NORMAL_ID_SHIFT, instr_stream::INSTR_NORMAL_ID_WIDTH);
+		}
+
+		void filterNOOPs(traversal_t& _traversal)
+		{
+			_traversal.erase(
+				std::remove_if(_traversal.begin(), _traversal.end(), [](instr_t i) { return instr_stream::getOpcode(i) == instr_stream::OP_NOOP; }),
+				_traversal.end()
+			);
+		}
+
+		std::pair<instr_t, const IR::INode*> processSubtree(const IR::INode* tree, IR::INode::children_array_t& next)
+		{
+			//TODO deduplication
+			return CInterpreter::processSubtree(m_ir, tree, next, m_translationCache);
+		}
+
+		size_t getBSDFDataIndex(instr_stream::E_OPCODE _op, const IR::INode* _node)
+		{
+			switch (_op)
+			{
+			case instr_stream::OP_INVALID: [[fallthrough]];
+			case instr_stream::OP_NOOP:
+				return 0ull;
+			default: break;
+			}
+
+			auto found = m_root->bsdfDataIndexMap.find(_node);
+			if (found != m_root->bsdfDataIndexMap.end())
+				return found->second;
+
+			instr_stream::intermediate::SBSDFUnion data;
+			m_dataWriter.setBSDFData(data, _op, _node);
+			size_t ix = m_root->bsdfData.size();
+			m_root->bsdfDataIndexMap.insert({_node,ix});
+			m_root->bsdfData.push_back(data);
+			m_root->bsdfDataSources.push_back({_op,_node});
+
+			return ix;
+		}
 
 		template <typename ...Params>
 		bool push(const instr_t _instr, const IR::INode* _node, const IR::INode::children_array_t& _children, instr_t _parent, Params&& ...args)
@@ -399,6 +482,7 @@ namespace material_compiler
 				if (static_cast<const IR::CBSDFBlendNode*>(_node)->weight.source == IR::INode::EPS_TEXTURE)
 					_instr = core::bitfieldInsert<instr_t>(_instr, 1u, instr_stream::BITFIELDS_SHIFT_WEIGHT_TEX, 1);
 			}
+			break;
 			case instr_stream::OP_DIFFTRANS:
 			{
 				auto* difftrans = static_cast<const IR::CMicrofacetDifftransBSDFNode*>(_node);
@@ -417,8 +501,8 @@ namespace material_compiler
 		}
 
 	public:
-		ITraversalGenerator(SContext* _ctx, IR* _ir, CIdGenerator* _id_gen, tmp_bxdf_translation_cache_t* _cache, uint32_t _regCount) : 
-			m_ctx(_ctx), m_ir(_ir), m_id_gen(_id_gen), m_translationCache(_cache), m_registerPool(_regCount) {}
+		ITraversalGenerator(const SContext* _ctx, SRootContext* _root, IR* _ir, CIdGenerator* _id_gen, tmp_bxdf_translation_cache_t* _cache, uint32_t _regCount) : 
+			m_root(_root), m_dataWriter(_ctx, _root), m_ir(_ir), m_id_gen(_id_gen), m_translationCache(_cache), m_registerPool(_regCount) {}
 
 		virtual traversal_t genTraversal(const IR::INode* _root, uint32_t& _out_usedRegs) = 0;
 	};
@@ -539,8 +623,8 @@ namespace remainder_and_pdf
 		CTraversalManipulator::id2pos_map_t m_id2pos;
 
 	public:
-		CTraversalGenerator(SContext* _ctx, IR* _ir, CIdGenerator* _id_gen, tmp_bxdf_translation_cache_t* _cache, uint32_t _regCount, uint32_t _regsPerResult) :
-			base_t(_ctx, _ir, _id_gen, _cache, _regCount), m_regsPerRes(_regsPerResult)
+		CTraversalGenerator(const SContext* _ctx, SRootContext* _root, IR* _ir, CIdGenerator* _id_gen, tmp_bxdf_translation_cache_t* _cache, uint32_t _regCount, uint32_t _regsPerResult) :
+			base_t(_ctx, _root, _ir, _id_gen, _cache, _regCount), m_regsPerRes(_regsPerResult)
 		{}
 
 		const auto& getId2PosMapping() const { return m_id2pos; }
@@ -1145,19 +1229,33 @@ std::string CMaterialCompilerGLSLBackendCommon::genPreprocDefinitions(const resu
 	return defs;
 }
 
-auto CMaterialCompilerGLSLBackendCommon::compile(SContext* _ctx, IR* _ir, bool _computeGenChoiceStream) -> result_t
+auto CMaterialCompilerGLSLBackendCommon::compile(SContext* _ctx, IR* _ir, bool _computeGenChoiceStream, core::CWorkStealingScheduler* _scheduler) -> result_t
 {
 	result_t res;
 	res.noNormPrecompStream = true;
 	res.noPrefetchStream = true;
 	res.usedRegisterCount = 0u;
 	res.globalPrefetchRegCountFlags = 0u;
+	memset(res.paramTexPresence, 0, sizeof(res.paramTexPresence));
 
-	for (const IR::INode* root : _ir->roots)
+	const auto& roots = _ir->roots;
+	core::vector<SRootContext> rootCtxs(roots.size());
+	auto forEachRoot = [&](const auto& body) -> void
 	{
-		uint32_t registerPool = instr_stream::MAX_REGISTER_COUNT;
+		if (_scheduler)
+			_scheduler->parallel_for(0u, roots.size(), body);
+		else
+		{
+			for (size_t i = 0u; i < roots.size(); ++i)
+				body(i);
+		}
+	};
 
-		const size_t interm_bsdf_data_begin_ix = _ctx->bsdfData.size();
+	//traversals of the roots don't depend on each other
+	forEachRoot([&](const size_t i) -> void
+	{
+		const IR::INode* root = roots[i];
+		SRootContext& rootCtx = rootCtxs[i];
 
 		CIdGenerator id_gen;
 
@@ -1165,7 +1263,6 @@ auto CMaterialCompilerGLSLBackendCommon::compile(SContext* _ctx, IR* _ir, bool _
 		tmp_bxdf_translation_cache_t translationCache;
 
 		uint32_t usedRegs{};
-		traversal_t rem_pdf_stream;
 		{
 			//In case of presence of generator choice stream, remainder_and_pdf stream has 2 roles in raster backend:
 			//* eval stream
@@ -1173,21 +1270,20 @@ auto CMaterialCompilerGLSLBackendCommon::compile(SContext* _ctx, IR* _ir, bool _
 			//In raytracing backend _computeGenChoiceStream is always true
 			const uint32_t regsPerRes = _computeGenChoiceStream ? 4u : 3u;
 
-			remainder_and_pdf::CTraversalGenerator gen(_ctx, _ir, &id_gen, &translationCache, registerPool, regsPerRes);
-			rem_pdf_stream = gen.genTraversal(root, usedRegs);
-			assert(usedRegs <= registerPool);
-			registerPool -= usedRegs;
+			remainder_and_pdf::CTraversalGenerator gen(_ctx, &rootCtx, _ir, &id_gen, &translationCache, rootCtx.registerPool, regsPerRes);
+			rootCtx.rem_pdf_stream = gen.genTraversal(root, usedRegs);
+			assert(usedRegs <= rootCtx.registerPool);
+			rootCtx.registerPool -= usedRegs;
 			id2pos = gen.getId2PosMapping();
 		}
-		traversal_t gen_choice_stream;
 		if (_computeGenChoiceStream)
 		{
-			gen_choice::CTraversalGenerator gen(_ctx, _ir, &id_gen, &translationCache, registerPool);
-			gen_choice_stream = gen.genTraversal(root, usedRegs);
-			assert(usedRegs <= registerPool);
-			registerPool -= usedRegs;
+			gen_choice::CTraversalGenerator gen(_ctx, &rootCtx, _ir, &id_gen, &translationCache, rootCtx.registerPool);
+			rootCtx.gen_choice_stream = gen.genTraversal(root, usedRegs);
+			assert(usedRegs <= rootCtx.registerPool);
+			rootCtx.registerPool -= usedRegs;
 
-			for (auto& instr : gen_choice_stream)
+			for (auto& instr : rootCtx.gen_choice_stream)
 			{
 				const instr_stream::instr_id_t id = instr_stream::getInstrId(instr);
 				uint32_t rnp_pos = static_cast<uint32_t>(-1);
@@ -1196,22 +1292,49 @@ auto CMaterialCompilerGLSLBackendCommon::compile(SContext* _ctx, IR* _ir, bool _
 				instr_stream::gen_choice::setOffsetIntoRemAndPdfStream(instr, rnp_pos);
 			}
 		}
+	});
 
-		instr_stream::tex_prefetch::prefetch_stream_t tex_prefetch_stream;
+	//VT addresses depend on the order of allocations, so it has to be the one of compiling the roots one after another
+	for (const SRootContext& rootCtx : rootCtxs)
+	for (const auto& tex : rootCtx.textureRequests)
+		CBSDFDataWriter::allocTexture(_ctx, tex);
+
+	forEachRoot([&](const size_t i) -> void
+	{
+		SRootContext& rootCtx = rootCtxs[i];
+		uint32_t& registerPool = rootCtx.registerPool;
+
+		//now that all textures are in the VT
+		if (!rootCtx.textureRequests.empty())
+		{
+			CBSDFDataWriter dataWriter(_ctx, &rootCtx);
+			for (size_t j = 0u; j < rootCtx.bsdfData.size(); ++j)
+			{
+				const auto& source = rootCtx.bsdfDataSources[j];
+				if (!CBSDFDataWriter::usesTextures(source.first, source.second))
+					continue;
+
+				instr_stream::intermediate::SBSDFUnion data;
+				dataWriter.setBSDFData(data, source.first, source.second);
+				rootCtx.bsdfData[j] = data;
+			}
+		}
+
+		uint32_t usedRegs{};
 		core::unordered_map<instr_stream::STextureData, uint32_t, instr_stream::STextureData::hash> tex2reg;
 		{
-			tex_prefetch_stream = tex_prefetch::genTraversal(rem_pdf_stream, _ctx->bsdfData, tex2reg, instr_stream::MAX_REGISTER_COUNT-registerPool, usedRegs, res.globalPrefetchRegCountFlags);
+			rootCtx.tex_prefetch_stream = tex_prefetch::genTraversal(rootCtx.rem_pdf_stream, rootCtx.bsdfData, tex2reg, instr_stream::MAX_REGISTER_COUNT-registerPool, usedRegs, rootCtx.regCntFlags);
 			assert(usedRegs <= registerPool);
 			registerPool -= usedRegs;
 		}
 
 		const uint32_t regNum = instr_stream::MAX_REGISTER_COUNT-registerPool;
 
-		traversal_t normal_precomp_stream;
+		traversal_t& normal_precomp_stream = rootCtx.normal_precomp_stream;
 		{
-			normal_precomp_stream.reserve(std::count_if(rem_pdf_stream.begin(), rem_pdf_stream.end(), [](instr_t i) {return instr_stream::getOpcode(i)==instr_stream::OP_BUMPMAP;}));
+			normal_precomp_stream.reserve(std::count_if(rootCtx.rem_pdf_stream.begin(), rootCtx.rem_pdf_stream.end(), [](instr_t i) {return instr_stream::getOpcode(i)==instr_stream::OP_BUMPMAP;}));
 			assert(regNum+3u*normal_precomp_stream.capacity() <= instr_stream::MAX_REGISTER_COUNT);
-			for (instr_t instr : rem_pdf_stream)
+			for (instr_t instr : rootCtx.rem_pdf_stream)
 			{
 				if (instr_stream::getOpcode(instr)==instr_stream::OP_BUMPMAP)
 				{
@@ -1226,13 +1349,12 @@ auto CMaterialCompilerGLSLBackendCommon::compile(SContext* _ctx, IR* _ir, bool _
 		}
 
 		//src1 reg for OP_BUMPMAPs is set to dst reg of corresponding instruction in normal precomp stream
-		setSourceRegForBumpmaps(rem_pdf_stream, regNum);
-		setSourceRegForBumpmaps(gen_choice_stream, regNum);
+		setSourceRegForBumpmaps(rootCtx.rem_pdf_stream, regNum);
+		setSourceRegForBumpmaps(rootCtx.gen_choice_stream, regNum);
 
-		for (auto it = _ctx->bsdfData.begin()+interm_bsdf_data_begin_ix; it != _ctx->bsdfData.end(); ++it)
+		rootCtx.finalBSDFData.reserve(rootCtx.bsdfData.size());
+		for (const auto& interm_bsdf_data : rootCtx.bsdfData)
 		{
-			const auto& interm_bsdf_data = *it;
-
 			instr_stream::SBSDFUnion bsdf_data;
 			for (uint32_t i = 0u; i < instr_stream::SBSDFUnion::MAX_TEXTURES; ++i)
 			{
@@ -1245,32 +1367,72 @@ auto CMaterialCompilerGLSLBackendCommon::compile(SContext* _ctx, IR* _ir, bool _
 			bsdf_data.common.extras[0] = interm_bsdf_data.common.extras[0];
 			bsdf_data.common.extras[1] = interm_bsdf_data.common.extras[1];
 
-			res.bsdfData.push_back(bsdf_data);
+			rootCtx.finalBSDFData.push_back(bsdf_data);
 		}
+	});
+
+	//merge in order of the roots, so the result doesn't depend on scheduling
+	for (size_t r = 0u; r < roots.size(); ++r)
+	{
+		SRootContext& rootCtx = rootCtxs[r];
+
+		core::vector<uint32_t> bsdfDataIx(rootCtx.bsdfData.size());
+		for (size_t j = 0u; j < rootCtx.bsdfData.size(); ++j)
+		{
+			//nodes shared between roots can share their data too, unless it refers to prefetch registers of another root
+			const auto& source = rootCtx.bsdfDataSources[j];
+			auto found = _ctx->bsdfDataIndexMap.find(source.second);
+			if (found != _ctx->bsdfDataIndexMap.end() && !CBSDFDataWriter::usesTextures(source.first, source.second))
+			{
+				bsdfDataIx[j] = found->second;
+				continue;
+			}
+
+			bsdfDataIx[j] = _ctx->bsdfData.size();
+			_ctx->bsdfDataIndexMap.insert_or_assign(source.second, bsdfDataIx[j]);
+			_ctx->bsdfData.push_back(rootCtx.bsdfData[j]);
+			res.bsdfData.push_back(rootCtx.finalBSDFData[j]);
+		}
+		auto renumberBSDFData = [&bsdfDataIx](traversal_t& _stream) -> void
+		{
+			for (instr_t& instr : _stream)
+			{
+				const instr_stream::E_OPCODE op = instr_stream::getOpcode(instr);
+				if (op==instr_stream::OP_NOOP || op==instr_stream::OP_INVALID || op==instr_stream::OP_SET_GEOM_NORMAL)
+					continue;
+
+				const uint32_t ix = core::bitfieldExtract(instr, instr_stream::BITFIELDS_BSDF_BUF_OFFSET_SHIFT, instr_stream::BITFIELDS_BSDF_BUF_OFFSET_WIDTH);
+				instr = core::bitfieldInsert<instr_t>(instr, bsdfDataIx[ix], instr_stream::BITFIELDS_BSDF_BUF_OFFSET_SHIFT, instr_stream::BITFIELDS_BSDF_BUF_OFFSET_WIDTH);
+			}
+		};
+		renumberBSDFData(rootCtx.rem_pdf_stream);
+		renumberBSDFData(rootCtx.gen_choice_stream);
+		renumberBSDFData(rootCtx.normal_precomp_stream);
 
 		result_t::instr_streams_t streams;
 		{
 			streams.offset = res.instructions.size();
 
-			streams.rem_and_pdf_count = rem_pdf_stream.size();
-			res.instructions.insert(res.instructions.end(), rem_pdf_stream.begin(), rem_pdf_stream.end());
+			streams.rem_and_pdf_count = rootCtx.rem_pdf_stream.size();
+			res.instructions.insert(res.instructions.end(), rootCtx.rem_pdf_stream.begin(), rootCtx.rem_pdf_stream.end());
 
-			streams.gen_choice_count = gen_choice_stream.size();
-			res.instructions.insert(res.instructions.end(), gen_choice_stream.begin(), gen_choice_stream.end());
+			streams.gen_choice_count = rootCtx.gen_choice_stream.size();
+			res.instructions.insert(res.instructions.end(), rootCtx.gen_choice_stream.begin(), rootCtx.gen_choice_stream.end());
 
-			streams.norm_precomp_count = normal_precomp_stream.size();
-			res.instructions.insert(res.instructions.end(), normal_precomp_stream.begin(), normal_precomp_stream.end());
+			streams.norm_precomp_count = rootCtx.normal_precomp_stream.size();
+			res.instructions.insert(res.instructions.end(), rootCtx.normal_precomp_stream.begin(), rootCtx.normal_precomp_stream.end());
 
 			streams.prefetch_offset = res.prefetch_stream.size();
-			streams.tex_prefetch_count = tex_prefetch_stream.size();
-			res.prefetch_stream.insert(res.prefetch_stream.end(), tex_prefetch_stream.begin(), tex_prefetch_stream.end());
+			streams.tex_prefetch_count = rootCtx.tex_prefetch_stream.size();
+			res.prefetch_stream.insert(res.prefetch_stream.end(), rootCtx.tex_prefetch_stream.begin(), rootCtx.tex_prefetch_stream.end());
 		}
 
-		res.streams.insert({root,streams});
+		res.streams.insert({roots[r],streams});
 
 		res.noNormPrecompStream = res.noNormPrecompStream && (streams.norm_precomp_count==0u);
 		res.noPrefetchStream = res.noPrefetchStream && (streams.tex_prefetch_count==0u);
-		res.usedRegisterCount = std::max(res.usedRegisterCount, instr_stream::MAX_REGISTER_COUNT-registerPool);
+		res.usedRegisterCount = std::max(res.usedRegisterCount, instr_stream::MAX_REGISTER_COUNT-rootCtx.registerPool);
+		res.globalPrefetchRegCountFlags |= rootCtx.regCntFlags;
 	}
 
 	_ir->deinitTmpNodes();
@@ -1304,9 +1466,10 @@ auto CMaterialCompilerGLSLBackendCommon::compile(SContext* _ctx, IR* _ir, bool _
 
 	res.allIsotropic = true;
 	res.noBSDF = true;
-	for (const auto& e : res.streams)
+	//in root order, so the definitions don't depend on where the nodes landed in memory
+	for (const IR::INode* root : _ir->roots)
 	{
-		const result_t::instr_streams_t& streams = e.second;
+		const result_t::instr_streams_t& streams = res.streams.find(root)->second;
 		auto rem_and_pdf = streams.get_rem_and_pdf();
 		for (uint32_t i = 0u; i < rem_and_pdf.count; ++i) 
 		{
@@ -48,8 +48,10 @@
 		#include "nbl/asset/CSTLMeshWriter.h"
 		// manipulation
 		#include "nbl/asset/CForsythVertexCacheOptimizer.h"
+		#include "nbl/asset/CTipsifyVertexCacheOptimizer.h"
 		#include "nbl/asset/CSmoothNormalGenerator.h"
 		#include "nbl/asset/COverdrawMeshOptimizer.h"
+		#include "nbl/asset/CQuadricMeshSimplifier.h"
 		#include "nbl/asset/CMeshManipulator.h"
 
 	// baw file format
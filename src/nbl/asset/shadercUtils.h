@@ -15,6 +15,8 @@ namespace nbl
 namespace asset
 {
 
+static constexpr shaderc_spirv_version TARGET_SPIRV_VERSION = shaderc_spirv_version_1_5;
+
 inline shaderc_shader_kind ESStoShadercEnum(ISpecializedShader::E_SHADER_STAGE _ss)
 {
     using T = std::underlying_type_t<ISpecializedShader::E_SHADER_STAGE>;
@@ -0,0 +1,264 @@
+// Copyright (C) 2018-2020 - DevSH Graphics Programming Sp. z O.O.
+// This file is part of the "Nabla Engine".
+// For conditions of distribution and use, see copyright notice in nabla.h
+
+#include "nbl/core/parallel/CWorkStealingScheduler.h"
+
+#ifdef _NBL_PLATFORM_WINDOWS_
+#include <windows.h>
+#elif defined(_NBL_PLATFORM_LINUX_)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace nbl
+{
+namespace core
+{
+
+namespace
+{
+	// which worker of which pool the current thread is
+	thread_local const CWorkStealingScheduler* tl_scheduler = nullptr;
+	thread_local uint32_t tl_workerIx = CWorkStealingScheduler::AnyWorker;
+	// xorshift for picking steal victims, seeded per thread so thieves spread out
+	thread_local uint32_t tl_victimSeed = 0u;
+
+	inline uint32_t nextVictimSeed()
+	{
+		if (!tl_victimSeed)
+			tl_victimSeed = static_cast<uint32_t>(std::hash<std::thread::id>()(std::this_thread::get_id()))|1u;
+		tl_victimSeed ^= tl_victimSeed<<13u;
+		tl_victimSeed ^= tl_victimSeed>>17u;
+		tl_victimSeed ^= tl_victimSeed<<5u;
+		return tl_victimSeed;
+	}
+
+	void setCurrentThreadAffinity(const uint64_t _mask)
+	{
+		if (!_mask)
+			return;
+#ifdef _NBL_PLATFORM_WINDOWS_
+		SetThreadAffinityMask(GetCurrentThread(),static_cast<DWORD_PTR>(_mask));
+#elif defined(_NBL_PLATFORM_LINUX_)
+		cpu_set_t cpuset;
+		CPU_ZERO(&cpuset);
+		for (uint32_t i=0u; i<64u; i++)
+		if (_mask&(0x1ull<<i))
+			CPU_SET(i,&cpuset);
+		pthread_setaffinity_np(pthread_self(),sizeof(cpu_set_t),&cpuset);
+#endif
+	}
+}
+
+CWorkStealingScheduler::CWorkStealingScheduler() : CWorkStealingScheduler(SCreationParams())
+{
+}
+
+CWorkStealingScheduler::CWorkStealingScheduler(SCreationParams&& _params) : m_pendingTasks(0u), m_sleepingWorkers(0u), m_stop(false)
+{
+	uint32_t workerCount = _params.workerCount;
+	if (!workerCount)
+		workerCount = std::max(std::thread::hardware_concurrency(),2u)-1u;
+
+	// all workers need to exist before any of them starts stealing
+	m_workers.resize(workerCount);
+	for (auto& worker : m_workers)
+		worker.reset(new SWorker());
+	for (uint32_t i=0u; i<workerCount; i++)
+	{
+		const uint64_t affinityMask = i<_params.workerAffinityMasks.size() ? _params.workerAffinityMasks[i]:0ull;
+		m_workers[i]->thread = std::thread(&CWorkStealingScheduler::workerMain,this,i,affinityMask);
+	}
+}
+
+CWorkStealingScheduler::~CWorkStealingScheduler()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_sleepLock);
+		m_stop.store(true,std::memory_order_release);
+	}
+	m_wakeUp.notify_all();
+	for (auto& worker : m_workers)
+		worker->thread.join();
+
+	// whatever got spawned without anyone waiting for it
+	for (auto& worker : m_workers)
+	{
+		while (STask* task = worker->deque.pop())
+			delete task;
+		for (STask* task : worker->mailbox)
+			delete task;
+	}
+	for (STask* task : m_injectionQueue)
+		delete task;
+}
+
+CWorkStealingScheduler* CWorkStealingScheduler::getDefault()
+{
+	static core::smart_refctd_ptr<CWorkStealingScheduler> defaultScheduler = core::make_smart_refctd_ptr<CWorkStealingScheduler>();
+	return defaultScheduler.get();
+}
+
+uint32_t CWorkStealingScheduler::getCurrentWorkerIndex() const
+{
+	return tl_scheduler==this ? tl_workerIx:AnyWorker;
+}
+
+bool CWorkStealingScheduler::runPendingTask()
+{
+	STask* task = findTask(getCurrentWorkerIndex());
+	if (!task)
+		return false;
+	execute(task);
+	return true;
+}
+
+void CWorkStealingScheduler::push(STask* _task, const uint32_t _preferredWorker)
+{
+	// counted before it becomes visible, so that whoever takes it never decrements below zero
+	m_pendingTasks.fetch_add(1u,std::memory_order_seq_cst);
+
+	const uint32_t self = getCurrentWorkerIndex();
+	if (_preferredWorker<getWorkerCount() && _preferredWorker!=self)
+	{
+		SWorker& target = *m_workers[_preferredWorker];
+		std::lock_guard<std::mutex> lock(target.mailboxLock);
+		target.mailbox.push_back(_task);
+	}
+	else if (self!=AnyWorker)
+		m_workers[self]->deque.push(_task);
+	else
+	{
+		std::lock_guard<std::mutex> lock(m_injectionLock);
+		m_injectionQueue.push_back(_task);
+	}
+
+	// pairs with the sleeping worker incrementing `m_sleepingWorkers` before checking `m_pendingTasks`
+	if (m_sleepingWorkers.load(std::memory_order_seq_cst))
+	{
+		std::lock_guard<std::mutex> lock(m_sleepLock);
+		m_wakeUp.notify_one();
+	}
+}
+
+auto CWorkStealingScheduler::findTask(const uint32_t _self) -> STask*
+{
+	auto popMailbox = [this](const uint32_t _worker) -> STask*
+	{
+		SWorker& worker = *m_workers[_worker];
+		std::lock_guard<std::mutex> lock(worker.mailboxLock);
+		if (worker.mailbox.empty())
+			return nullptr;
+		STask* retval = worker.mailbox.front();
+		worker.mailbox.pop_front();
+		return retval;
+	};
+
+	STask* task = nullptr;
+	if (_self!=AnyWorker)
+	{
+		task = m_workers[_self]->deque.pop();
+		if (!task)
+			task = popMailbox(_self);
+	}
+	if (!task)
+	{
+		// a thread from outside the pool waiting on its own tasks takes the newest like a worker would from its deque,
+		// taking the oldest would run the outermost tasks first and nest waits without bound
+		std::lock_guard<std::mutex> lock(m_injectionLock);
+		if (!m_injectionQueue.empty())
+		{
+			if (_self!=AnyWorker)
+			{
+				task = m_injectionQueue.front();
+				m_injectionQueue.pop_front();
+			}
+			else
+			{
+				task = m_injectionQueue.back();
+				m_injectionQueue.pop_back();
+			}
+		}
+	}
+	const uint32_t workerCount = getWorkerCount();
+	if (!task && workerCount)
+	{
+		const uint32_t firstVictim = nextVictimSeed()%workerCount;
+		for (uint32_t i=0u; i<workerCount && !task; i++)
+		{
+			const uint32_t victim = (firstVictim+i)%workerCount;
+			if (victim==_self)
+				continue;
+			task = m_workers[victim]->deque.steal();
+			if (!task)
+				task = popMailbox(victim);
+		}
+	}
+
+	if (task)
+		m_pendingTasks.fetch_sub(1u,std::memory_order_relaxed);
+	return task;
+}
+
+void CWorkStealingScheduler::execute(STask* _task)
+{
+	_task->func();
+	CTaskGroup* group = _task->group;
+	delete _task;
+	if (group)
+		group->taskFinished();
+}
+
+void CWorkStealingScheduler::workerMain(const uint32_t _ix, const uint64_t _affinityMask)
+{
+	tl_scheduler = this;
+	tl_workerIx = _ix;
+	setCurrentThreadAffinity(_affinityMask);
+
+	// how many times to look around before going to sleep, waking up costs a lot more than a few failed steals
+	constexpr uint32_t SpinCount = 64u;
+	while (!m_stop.load(std::memory_order_acquire))
+	{
+		bool found = false;
+		for (uint32_t spin=0u; spin<SpinCount && !found; spin++)
+		{
+			found = runPendingTask();
+			if (!found)
+				std::this_thread::yield();
+		}
+		if (found)
+			continue;
+
+		std::unique_lock<std::mutex> lock(m_sleepLock);
+		m_sleepingWorkers.fetch_add(1u,std::memory_order_seq_cst);
+		m_wakeUp.wait(lock,[this]() {return m_pendingTasks.load(std::memory_order_seq_cst)!=0u || m_stop.load(std::memory_order_acquire);});
+		m_sleepingWorkers.fetch_sub(1u,std::memory_order_relaxed);
+	}
+}
+
+
+void CTaskGroup::wait()
+{
+	while (!done())
+	{
+		if (!m_scheduler->runPendingTask())
+			std::this_thread::yield();
+	}
+}
+
+void CTaskGroup::taskFinished()
+{
+	m_finishing.fetch_add(1u,std::memory_order_relaxed);
+	CWorkStealingScheduler::STask* continuation = nullptr;
+	if (m_pending.fetch_sub(1u,std::memory_order_acq_rel)==1u)
+		continuation = m_continuation.exchange(nullptr,std::memory_order_acquire);
+	CWorkStealingScheduler* scheduler = m_scheduler;
+	// last access to the group, `wait()` may return and the group die right after
+	m_finishing.fetch_sub(1u,std::memory_order_release);
+	if (continuation)
+		scheduler->push(continuation,CWorkStealingScheduler::AnyWorker);
+}
+
+}
+}
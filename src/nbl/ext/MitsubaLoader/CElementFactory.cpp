@@ -36,8 +36,9 @@ CElementFactory::return_type CElementFactory::processAlias(const char** _atts, P
 	if (!id || !as)
 		return CElementFactory::return_type(nullptr,std::move(name));
 
-	auto* original = _util->handles[id];
-	_util->handles[as] = original;
+	auto found = _util->handles.find(_util->ids.find(id));
+	auto* original = found!=_util->handles.end() ? found->second:nullptr;
+	_util->handles[_util->ids.intern(as)] = original;
 	return CElementFactory::return_type(original,std::move(name));
 }
 
@@ -48,7 +49,8 @@ CElementFactory::return_type CElementFactory::processRef(const char** _atts, Par
 	if (!IElement::getIDAndName(id,name,_atts))
 		return CElementFactory::return_type(nullptr, std::move(name));
 
-	auto* original = _util->handles[id];
+	auto found = _util->handles.find(_util->ids.find(id));
+	auto* original = found!=_util->handles.end() ? found->second:nullptr;
 	return CElementFactory::return_type(original, std::move(name));
 }
 
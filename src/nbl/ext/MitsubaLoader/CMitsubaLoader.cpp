@@ -12,6 +12,7 @@
 #include "nbl/ext/MitsubaLoader/ParserUtil.h"
 #include "nbl/asset/IImageAssetHandlerBase.h"
 #include "nbl/ext/MitsubaLoader/CGLSLMitsubaLoaderBuiltinIncludeLoader.h"
+#include "nbl/core/xxHash256.h"
 
 
 #if defined(_NBL_DEBUG) || defined(_NBL_RELWITHDEBINFO)
@@ -586,7 +587,8 @@ core::smart_refctd_ptr<asset::ICPUPipelineLayout> CMitsubaLoader::createPipeline
 	return core::make_smart_refctd_ptr<asset::ICPUPipelineLayout>(nullptr, nullptr, std::move(ds0layout), std::move(ds1layout), nullptr, nullptr);
 }
 
-CMitsubaLoader::CMitsubaLoader(asset::IAssetManager* _manager, io::IFileSystem* _fs) : asset::IAssetLoader(), m_manager(_manager), m_filesystem(_fs)
+CMitsubaLoader::CMitsubaLoader(asset::IAssetManager* _manager, io::IFileSystem* _fs) : asset::IAssetLoader(), m_manager(_manager), m_filesystem(_fs),
+	m_serializedLoader(core::make_smart_refctd_ptr<CSerializedLoader>(_manager))
 {
 #ifdef _NBL_DEBUG
 	setDebugName("CMitsubaLoader");
@@ -684,7 +686,12 @@ asset::SAssetBundle CMitsubaLoader::loadAsset(io::IReadFile* _file, const asset:
 			createAndCacheVertexShader(m_manager, DUMMY_VERTEX_SHADER);
 		}
 
-		core::set<core::smart_refctd_ptr<asset::ICPUMesh>> meshes;
+		cacheSerializedMeshes(ctx, _hierarchyLevel, parserManager.shapegroups);
+		prefetchShapes(ctx, _hierarchyLevel, parserManager.shapegroups, core::CWorkStealingScheduler::getDefault());
+
+		// in the order the scene declares them, so the output doesn't depend on where the meshes got allocated
+		core::vector<core::smart_refctd_ptr<asset::ICPUMesh>> meshes;
+		core::unordered_set<const asset::ICPUMesh*> uniqueMeshes;
 
 		for (auto& shapepair : parserManager.shapegroups)
 		{
@@ -698,16 +705,18 @@ asset::SAssetBundle CMitsubaLoader::loadAsset(io::IReadFile* _file, const asset:
 				if (!mesh)
 					continue;
 
-				auto found = meshes.find(mesh);
-				if (found == meshes.end())
+				if (uniqueMeshes.insert(mesh.get()).second)
 				{
 					auto metadata = core::make_smart_refctd_ptr<IMeshMetadata>(
 						core::smart_refctd_ptr(parserManager.m_globalMetadata),
 						std::move(shapepair.second),
 						shapedef
 						);
+					auto foundHash = ctx.geometryHashes.find(mesh.get());
+					if (foundHash!=ctx.geometryHashes.end())
+						metadata->geometryHash = foundHash->second;
 					m_manager->setAssetMetadata(mesh.get(), std::move(metadata));
-					meshes.insert(std::move(mesh));
+					meshes.push_back(std::move(mesh));
 				}
 			}
 		}
@@ -741,10 +750,9 @@ asset::SAssetBundle CMitsubaLoader::loadAsset(io::IReadFile* _file, const asset:
 		ctx.globalMeta->materialCompilerGLSL_declarations = compResult.fragmentShaderSource_declarations;
 		ctx.globalMeta->materialCompilerGLSL_source = compResult.fragmentShaderSource;
 
-		for (const SContext::shape_ass_type& mesh_ : meshes)
+		for (SContext::shape_ass_type& mesh_ : meshes)
 		{
-			// need const_cast because core::set has only const iterators (or maybe we should reconsider if const smart_refctd_ptr::operator-> should return const ptr)
-			asset::ICPUMesh* const mesh = const_cast<asset::ICPUMesh*>(mesh_.get());
+			asset::ICPUMesh* const mesh = mesh_.get();
 
 			for (uint32_t i = 0u; i < mesh->getMeshBufferCount(); ++i)
 			{
@@ -831,6 +839,457 @@ core::vector<SContext::shape_ass_type> CMitsubaLoader::loadShapeGroup(SContext&
 	return meshes;
 }
 
+static asset::IAssetLoader::SAssetLoadParams getModelLoadParams(const SContext& ctx)
+{
+	auto loadParams = ctx.inner.params;
+	loadParams.loaderFlags = static_cast<IAssetLoader::E_LOADER_PARAMETER_FLAGS>(loadParams.loaderFlags | IAssetLoader::ELPF_RIGHT_HANDED_MESHES);
+	return loadParams;
+}
+
+void CMitsubaLoader::cacheSerializedMeshes(SContext& ctx, uint32_t hierarchyLevel, const core::vector<std::pair<CElementShape*,std::string>>& shapes)
+{
+	// every `shapeIndex` in use, per file
+	core::map<std::string,core::vector<uint32_t>> referenced;
+	core::stack<const CElementShape*> toVisit;
+	for (const auto& shapepair : shapes)
+		toVisit.push(shapepair.first);
+	while (!toVisit.empty())
+	{
+		const CElementShape* shape = toVisit.top();
+		toVisit.pop();
+		if (!shape)
+			continue;
+
+		if (shape->type==CElementShape::Type::SHAPEGROUP)
+		{
+			for (size_t i=0u; i<shape->shapegroup.childCount; i++)
+				toVisit.push(shape->shapegroup.children[i]);
+		}
+		else if (shape->type==CElementShape::Type::SERIALIZED)
+		{
+			assert(shape->serialized.filename.type==ext::MitsubaLoader::SPropertyElementData::Type::STRING);
+			referenced[shape->serialized.filename.svalue].push_back(core::max(shape->serialized.shapeIndex,0));
+		}
+	}
+
+	const auto loadParams = getModelLoadParams(ctx);
+	const uint64_t levelFlags = loadParams.cacheFlags>>(static_cast<uint64_t>(hierarchyLevel)*2ull);
+	for (auto& file : referenced)
+	{
+		auto& ids = file.second;
+		std::sort(ids.begin(),ids.end());
+		ids.erase(std::unique(ids.begin(),ids.end()),ids.end());
+		auto& cached = ctx.serializedMeshes[file.first];
+
+		// same lookup as the asset manager would do, a file which is already in the asset cache doesn't get decoded again
+		std::string filename = file.first;
+		ctx.override_->getLoadFilename(filename, asset::IAssetLoader::SAssetLoadContext(loadParams,nullptr), hierarchyLevel);
+		io::IReadFile* opened = m_filesystem->createAndOpenFile(filename.c_str());
+		const asset::IAssetLoader::SAssetLoadContext loadCtx(loadParams,opened);
+		io::IReadFile* serialized = ctx.override_->getLoadFile(opened, filename, loadCtx, hierarchyLevel);
+		const std::string cacheKey = serialized ? serialized->getFileName().c_str():filename;
+
+		asset::SAssetBundle bundle;
+		if ((levelFlags&IAssetLoader::ECF_DUPLICATE_TOP_LEVEL)!=IAssetLoader::ECF_DUPLICATE_TOP_LEVEL)
+		{
+			auto found = m_manager->findAssets(cacheKey);
+			if (found->size())
+				bundle = ctx.override_->chooseRelevantFromFound(found->begin(), found->end(), loadCtx, hierarchyLevel);
+			else
+				bundle = ctx.override_->handleSearchFail(cacheKey, loadCtx, hierarchyLevel);
+		}
+
+		if (!bundle.isEmpty())
+		{
+			for (const auto& asset : bundle.getContents())
+			{
+				auto meta = asset ? asset->getMetadata():nullptr;
+				if (!meta || asset->getAssetType()!=asset::IAsset::ET_MESH || core::strcmpi(meta->getLoaderName(),CSerializedMetadata::LoaderName))
+					continue;
+				const uint32_t id = static_cast<const CSerializedMetadata*>(meta)->id;
+				if (std::binary_search(ids.begin(),ids.end(),id))
+					cached[id] = core::smart_refctd_ptr_static_cast<asset::ICPUMesh>(asset);
+			}
+		}
+		// only what's referenced gets decoded, so it doesn't go into the asset cache as if it was the whole file
+		else if (serialized && m_serializedLoader->isALoadableFileFormat(serialized))
+		{
+			auto meshes = m_serializedLoader->loadMeshes(serialized, {ids.data(),ids.data()+ids.size()});
+			for (size_t i=0u; i<ids.size(); i++)
+			if (meshes[i])
+				cached[ids[i]] = std::move(meshes[i]);
+		}
+		else
+			os::Printer::log("Could not open serialized mesh file", file.first, ELL_ERROR);
+		if (opened)
+			opened->drop();
+	}
+}
+
+//! filenames of all bitmaps the BSDF or its children would have `cacheTexture` load, same properties as `genBSDFtreeTraversal` looks at
+static void collectBitmaps(const CElementBSDF* _bsdf, core::unordered_set<const CElementBSDF*>& visited, core::set<std::string>& out)
+{
+	auto addTexture = [&out](const CElementTexture* tex)
+	{
+		while (tex && tex->type==CElementTexture::SCALE)
+			tex = tex->scale.texture;
+		if (tex && tex->type==CElementTexture::BITMAP)
+			out.insert(tex->bitmap.filename.svalue);
+	};
+	auto addProperty = [&addTexture](const CElementTexture::FloatOrTexture& const_or_tex)
+	{
+		if (const_or_tex.value.type==SPropertyElementData::INVALID)
+			addTexture(const_or_tex.texture);
+	};
+
+	core::stack<const CElementBSDF*> stack;
+	stack.push(_bsdf);
+	while (!stack.empty())
+	{
+		auto* bsdf = stack.top();
+		stack.pop();
+		if (!bsdf || !visited.insert(bsdf).second)
+			continue;
+
+		switch (bsdf->type)
+		{
+			case CElementBSDF::COATING:
+			case CElementBSDF::ROUGHCOATING:
+			case CElementBSDF::BUMPMAP:
+			case CElementBSDF::BLEND_BSDF:
+			case CElementBSDF::MIXTURE_BSDF:
+			case CElementBSDF::MASK:
+			case CElementBSDF::TWO_SIDED:
+				for (uint32_t i = 0u; i < bsdf->meta_common.childCount; ++i)
+					stack.push(bsdf->meta_common.bsdf[i]);
+			default: break;
+		}
+
+		switch (bsdf->type)
+		{
+			case CElementBSDF::DIFFUSE:
+			case CElementBSDF::ROUGHDIFFUSE:
+				addProperty(bsdf->diffuse.reflectance);
+				addProperty(bsdf->diffuse.alpha);
+				break;
+			case CElementBSDF::DIFFUSE_TRANSMITTER:
+				addProperty(bsdf->difftrans.transmittance);
+				break;
+			case CElementBSDF::DIELECTRIC:
+			case CElementBSDF::THINDIELECTRIC:
+			case CElementBSDF::ROUGHDIELECTRIC:
+				addProperty(bsdf->dielectric.alphaU);
+				if (bsdf->dielectric.distribution == CElementBSDF::RoughSpecularBase::ASHIKHMIN_SHIRLEY)
+					addProperty(bsdf->dielectric.alphaV);
+				break;
+			case CElementBSDF::CONDUCTOR:
+				addProperty(bsdf->conductor.alphaU);
+				if (bsdf->conductor.distribution == CElementBSDF::RoughSpecularBase::ASHIKHMIN_SHIRLEY)
+					addProperty(bsdf->conductor.alphaV);
+				break;
+			case CElementBSDF::PLASTIC:
+			case CElementBSDF::ROUGHPLASTIC:
+				addProperty(bsdf->plastic.diffuseReflectance);
+				addProperty(bsdf->plastic.alphaU);
+				if (bsdf->plastic.distribution == CElementBSDF::RoughSpecularBase::ASHIKHMIN_SHIRLEY)
+					addProperty(bsdf->plastic.alphaV);
+				break;
+			case CElementBSDF::BUMPMAP:
+				addTexture(bsdf->bumpmap.texture);
+				break;
+			case CElementBSDF::BLEND_BSDF:
+				addProperty(bsdf->blendbsdf.weight);
+				break;
+			case CElementBSDF::MASK:
+				addProperty(bsdf->mask.opacity);
+				break;
+			default: break;
+		}
+	}
+}
+
+//! hash of everything about the geometry which ends up on the GPU, the same for meshes which can be drawn in place of one another
+static SContext::geometry_hash_t hashGeometry(const asset::ICPUMesh* mesh)
+{
+	auto hashBytes = [](const void* data, size_t size, core::vector<uint64_t>& out) -> void
+	{
+		out.resize(out.size()+4u);
+		core::XXHash_256(data,size,out.data()+out.size()-4u);
+	};
+
+	core::vector<uint64_t> digests;
+	for (auto i=0u; i<mesh->getMeshBufferCount(); i++)
+	{
+		const auto* mb = mesh->getMeshBuffer(i);
+		const auto* pipeline = mb->getPipeline();
+		// same bytes as `SContext::SPipelineCacheKey` compares
+		hashBytes(&pipeline->getVertexInputParams(),sizeof(asset::SVertexInputParams),digests);
+		hashBytes(&pipeline->getPrimitiveAssemblyParams(),sizeof(asset::SPrimitiveAssemblyParams),digests);
+		digests.push_back(mb->getIndexType());
+		digests.push_back(mb->getIndexCount());
+		digests.push_back(static_cast<uint64_t>(mb->getBaseVertex()));
+
+		// only the bytes the draw reads, meshbuffers often share one big buffer at different offsets
+		auto hashBinding = [&](const asset::SBufferBinding<asset::ICPUBuffer>& binding, const size_t usedSize) -> void
+		{
+			if (!binding.buffer || binding.offset>=binding.buffer->getSize() || usedSize==0ull)
+			{
+				digests.push_back(0ull);
+				return;
+			}
+			const size_t size = core::min<size_t>(usedSize,binding.buffer->getSize()-binding.offset);
+			hashBytes(reinterpret_cast<const uint8_t*>(binding.buffer->getPointer())+binding.offset,size,digests);
+		};
+		size_t indexSize = 0ull;
+		switch (mb->getIndexType())
+		{
+			case asset::EIT_16BIT:
+				indexSize = sizeof(uint16_t);
+				break;
+			case asset::EIT_32BIT:
+				indexSize = sizeof(uint32_t);
+				break;
+			default:
+				break;
+		}
+		hashBinding(*mb->getIndexBufferBinding(),mb->getIndexCount()*indexSize);
+
+		// vertices past `baseVertex+calcVertexCount()` and instances past `baseInstance+instanceCount` never get fetched
+		const size_t vertexCount = static_cast<size_t>(core::max(mb->getBaseVertex(),0))+mb->calcVertexCount();
+		const size_t instanceCount = mb->getBaseInstance()+mb->getInstanceCount();
+		const auto& bindingParams = pipeline->getVertexInputParams().bindings;
+		for (auto j=0u; j<asset::ICPUMeshBuffer::MAX_ATTR_BUF_BINDING_COUNT; j++)
+		if (mb->isVertexAttribBufferBindingEnabled(j))
+		{
+			const size_t count = bindingParams[j].inputRate==asset::EVIR_PER_INSTANCE ? instanceCount:vertexCount;
+			// a zero stride reads the same element for every vertex, we don't know its size so hash the rest of the buffer as before
+			const size_t usedSize = bindingParams[j].stride ? count*bindingParams[j].stride:~0ull;
+			hashBinding(mb->getVertexBufferBindings()[j],usedSize);
+		}
+	}
+
+	SContext::geometry_hash_t retval;
+	core::XXHash_256(digests.data(),digests.size()*sizeof(uint64_t),retval.data());
+	return retval;
+}
+
+void CMitsubaLoader::prefetchShapes(SContext& ctx, uint32_t hierarchyLevel, const core::vector<std::pair<CElementShape*,std::string>>& shapes, core::CWorkStealingScheduler* _scheduler)
+{
+	// first phase, find every shape which will need geometry (in the order `loadAsset` gets to them) and every file they need
+	core::vector<CElementShape*> basicShapes;
+	core::set<std::string> models, bitmaps;
+	{
+		core::unordered_set<const CElementShape*> visitedShapes;
+		core::unordered_set<const CElementBSDF*> visitedBSDFs;
+		core::stack<CElementShape*> toVisit;
+		for (auto it=shapes.rbegin(); it!=shapes.rend(); it++)
+			toVisit.push(it->first);
+		while (!toVisit.empty())
+		{
+			CElementShape* shape = toVisit.top();
+			toVisit.pop();
+			if (!shape || !visitedShapes.insert(shape).second)
+				continue;
+
+			switch (shape->type)
+			{
+				case CElementShape::Type::INSTANCE:
+					toVisit.push(shape->instance.parent);
+					continue;
+				case CElementShape::Type::SHAPEGROUP:
+					for (size_t i=shape->shapegroup.childCount; i--;)
+						toVisit.push(shape->shapegroup.children[i]);
+					continue;
+				case CElementShape::Type::OBJ:
+					models.insert(shape->obj.filename.svalue);
+					break;
+				case CElementShape::Type::PLY:
+					models.insert(shape->ply.filename.svalue);
+					break;
+				default:
+					break;
+			}
+			basicShapes.push_back(shape);
+			collectBitmaps(shape->bsdf, visitedBSDFs, bitmaps);
+		}
+	}
+
+	// second phase, load all files, the asset manager and its caches aren't thread-safe so only decoding runs concurrently
+	{
+		struct SFileLoad
+		{
+			const std::string* filename;
+			asset::IAssetLoader::SAssetLoadParams params;
+			uint32_t hierarchyLevel;
+			io::IReadFile* opened = nullptr;
+			//! what the override wants loaded in place of `opened`
+			io::IReadFile* file = nullptr;
+			std::string cacheKey = {};
+			asset::SAssetBundle bundle = {};
+			//! index of the load which decodes the same file, or itself
+			size_t decodedBy = ~0ull;
+		};
+		core::vector<SFileLoad> loads;
+		loads.reserve(models.size()+bitmaps.size());
+		// same parameters as `loadShapeSource` and `genBSDFtreeTraversal` use
+		for (const auto& model : models)
+			loads.push_back({&model,getModelLoadParams(ctx),hierarchyLevel});
+		for (const auto& bitmap : bitmaps)
+		if (models.find(bitmap)==models.end())
+			loads.push_back({&bitmap,ctx.inner.params,0u});
+
+		// open and look every file up in the cache on this thread, same lookup as the asset manager does
+		core::unordered_map<std::string,size_t> keyToLoad;
+		core::vector<size_t> decodes;
+		for (size_t i=0u; i<loads.size(); i++)
+		{
+			auto& fileLoad = loads[i];
+			std::string filename = *fileLoad.filename;
+			ctx.override_->getLoadFilename(filename, asset::IAssetLoader::SAssetLoadContext(fileLoad.params,nullptr), fileLoad.hierarchyLevel);
+			fileLoad.opened = m_filesystem->createAndOpenFile(filename.c_str());
+			const asset::IAssetLoader::SAssetLoadContext loadCtx(fileLoad.params,fileLoad.opened);
+			fileLoad.file = ctx.override_->getLoadFile(fileLoad.opened, filename, loadCtx, fileLoad.hierarchyLevel);
+			fileLoad.cacheKey = fileLoad.file ? fileLoad.file->getFileName().c_str():*fileLoad.filename;
+
+			// models get loaded on this thread too, their loaders load the files they reference through the asset manager
+			const bool isModel = i<models.size();
+			if (isModel || !fileLoad.file)
+			{
+				fileLoad.bundle = interm_getAssetInHierarchy(m_manager, fileLoad.opened, *fileLoad.filename, fileLoad.params, fileLoad.hierarchyLevel, ctx.override_);
+				continue;
+			}
+
+			// two spellings of the same file get decoded once
+			auto inFlight = keyToLoad.insert({fileLoad.cacheKey,i});
+			fileLoad.decodedBy = inFlight.first->second;
+			if (!inFlight.second)
+				continue;
+
+			const uint64_t levelFlags = fileLoad.params.cacheFlags>>(static_cast<uint64_t>(fileLoad.hierarchyLevel)*2ull);
+			if ((levelFlags&IAssetLoader::ECF_DUPLICATE_TOP_LEVEL)!=IAssetLoader::ECF_DUPLICATE_TOP_LEVEL)
+			{
+				auto found = m_manager->findAssets(fileLoad.cacheKey);
+				if (found->size())
+					fileLoad.bundle = ctx.override_->chooseRelevantFromFound(found->begin(), found->end(), loadCtx, fileLoad.hierarchyLevel);
+				else
+					fileLoad.bundle = ctx.override_->handleSearchFail(fileLoad.cacheKey, loadCtx, fileLoad.hierarchyLevel);
+			}
+			if (fileLoad.bundle.isEmpty())
+				decodes.push_back(i);
+		}
+
+		// image loaders don't reference other assets, with nothing to look up or cache (and the default override) they never touch the asset manager's state
+		{
+			IAssetLoader::IAssetLoaderOverride decodeOverride(m_manager);
+			auto decode = [&](const size_t i)
+			{
+				auto& fileLoad = loads[decodes[i]];
+				auto params = fileLoad.params;
+				params.cacheFlags = IAssetLoader::ECF_DUPLICATE_REFERENCES;
+				fileLoad.bundle = interm_getAssetInHierarchy(m_manager, fileLoad.file, fileLoad.cacheKey, params, fileLoad.hierarchyLevel, &decodeOverride);
+			};
+			if (_scheduler)
+				_scheduler->parallel_for(0u,decodes.size(),decode,1u);
+			else
+			for (size_t i=0u; i<decodes.size(); i++)
+				decode(i);
+		}
+
+		// cache what got decoded on this thread, same as the asset manager would have
+		for (const size_t i : decodes)
+		{
+			auto& fileLoad = loads[i];
+			const asset::IAssetLoader::SAssetLoadContext loadCtx(fileLoad.params,fileLoad.opened);
+			const uint64_t levelFlags = fileLoad.params.cacheFlags>>(static_cast<uint64_t>(fileLoad.hierarchyLevel)*2ull);
+			bool addToCache;
+			if (fileLoad.bundle.isEmpty())
+				fileLoad.bundle = ctx.override_->handleLoadFail(addToCache, fileLoad.file, fileLoad.cacheKey, fileLoad.cacheKey, loadCtx, fileLoad.hierarchyLevel);
+			else
+				addToCache = (levelFlags&IAssetLoader::ECF_DONT_CACHE_TOP_LEVEL)!=IAssetLoader::ECF_DONT_CACHE_TOP_LEVEL && (levelFlags&IAssetLoader::ECF_DUPLICATE_TOP_LEVEL)!=IAssetLoader::ECF_DUPLICATE_TOP_LEVEL;
+			if (fileLoad.bundle.isEmpty() || !addToCache)
+				continue;
+			ctx.override_->insertAssetIntoCache(fileLoad.bundle, fileLoad.cacheKey, loadCtx, fileLoad.hierarchyLevel);
+			// wasn't in the cache when we looked and each key gets decoded once, so nothing can have been put under it twice
+			assert(m_manager->findAssets(fileLoad.cacheKey)->size()==1u);
+		}
+
+		for (auto& fileLoad : loads)
+		{
+			const auto& bundle = fileLoad.decodedBy<loads.size() ? loads[fileLoad.decodedBy].bundle:fileLoad.bundle;
+			ctx.prefetchedAssets.insert({*fileLoad.filename,bundle});
+		}
+		for (auto& fileLoad : loads)
+		if (fileLoad.opened)
+			fileLoad.opened->drop();
+	}
+
+	// third phase, build the geometry of every shape
+	{
+		core::vector<SContext::shape_ass_type> meshes(basicShapes.size());
+		core::vector<SShapeProcessing> processing(basicShapes.size());
+		// `processShape` copies whatever it changes, so shapes made from the same mesh don't affect each other, shapes which want the same done to it share one result
+		core::vector<uint32_t> uniqueShapes;
+		core::vector<uint32_t> sameAs(basicShapes.size());
+		core::unordered_map<const void*,core::vector<uint32_t>> sourceToShapes;
+		for (uint32_t i=0u; i<basicShapes.size(); i++)
+		{
+			sameAs[i] = i;
+			meshes[i] = loadShapeSource(ctx, hierarchyLevel, basicShapes[i], processing[i]);
+			if (!meshes[i])
+				continue;
+
+			const void* source = meshes[i]->getMeshBufferCount() ? static_cast<const void*>(meshes[i]->getMeshBuffer(0u)):meshes[i].get();
+			auto& sameSource = sourceToShapes[source];
+			for (const auto j : sameSource)
+			if (processing[j]==processing[i])
+			{
+				sameAs[i] = j;
+				meshes[i] = nullptr;
+				break;
+			}
+			if (sameAs[i]==i)
+			{
+				sameSource.push_back(i);
+				uniqueShapes.push_back(i);
+			}
+		}
+
+		core::vector<SContext::geometry_hash_t> hashes(basicShapes.size());
+		auto process = [&](const size_t k)
+		{
+			const auto i = uniqueShapes[k];
+			meshes[i] = processShape(ctx, std::move(meshes[i]), processing[i]);
+			if (meshes[i])
+				hashes[i] = hashGeometry(meshes[i].get());
+		};
+		if (_scheduler)
+			_scheduler->parallel_for(0u,uniqueShapes.size(),process,1u);
+		else
+		for (size_t k=0u; k<uniqueShapes.size(); k++)
+			process(k);
+
+		// identical geometry (every sphere, the same model referenced with different transforms) resolves to the first mesh which had it
+		// instances get added to it when `loadBasicShape` finds these
+		core::unordered_map<SContext::geometry_hash_t,uint32_t,SContext::geometry_hash_hasher> hashToShape;
+		for (uint32_t i=0u; i<basicShapes.size(); i++)
+		{
+			const uint32_t j = sameAs[i];
+			if (!meshes[j])
+				continue;
+
+			if (j==i)
+			{
+				auto found = hashToShape.insert({hashes[i],i});
+				if (found.second)
+					ctx.geometryHashes.insert({meshes[i].get(),hashes[i]});
+				else
+					meshes[i] = meshes[found.first->second];
+			}
+			ctx.shapeCache.insert({basicShapes[i],meshes[j]});
+		}
+	}
+}
+
 static core::smart_refctd_ptr<ICPUMesh> createMeshFromGeomCreatorReturnType(IGeometryCreator::return_type&& _data, asset::IAssetManager* _manager)
 {
 	//creating pipeline just to forward vtx and primitive params
@@ -859,8 +1318,6 @@ static core::smart_refctd_ptr<ICPUMesh> createMeshFromGeomCreatorReturnType(IGeo
 
 SContext::shape_ass_type CMitsubaLoader::loadBasicShape(SContext& ctx, uint32_t hierarchyLevel, CElementShape* shape, const core::matrix3x4SIMD& relTform)
 {
-	constexpr uint32_t UV_ATTRIB_ID = 2U;
-
 	auto addInstance = [shape,&ctx,&relTform,this](SContext::shape_ass_type& mesh) {
 		assert(shape->bsdf);
 		auto bsdf = getBSDFtreeTraversal(ctx, shape->bsdf);
@@ -876,53 +1333,64 @@ SContext::shape_ass_type CMitsubaLoader::loadBasicShape(SContext& ctx, uint32_t
 		return found->second;
 	}
 
-	auto loadModel = [&](const ext::MitsubaLoader::SPropertyElementData& filename, int64_t index=-1) -> core::smart_refctd_ptr<asset::ICPUMesh>
+	SShapeProcessing processing;
+	auto mesh = loadShapeSource(ctx, hierarchyLevel, shape, processing);
+	if (!mesh)
+		return nullptr;
+	mesh = processShape(ctx, std::move(mesh), processing);
+
+	addInstance(mesh);
+	// cache and return
+	ctx.shapeCache.insert({ shape,mesh });
+	return mesh;
+}
+
+asset::SAssetBundle CMitsubaLoader::getFileAsset(SContext& ctx, const std::string& filename, const asset::IAssetLoader::SAssetLoadParams& params, uint32_t hierarchyLevel)
+{
+	auto found = ctx.prefetchedAssets.find(filename);
+	if (found!=ctx.prefetchedAssets.end())
+		return found->second;
+	return interm_getAssetInHierarchy(m_manager, filename, params, hierarchyLevel, ctx.override_);
+}
+
+SContext::shape_ass_type CMitsubaLoader::loadShapeSource(SContext& ctx, uint32_t hierarchyLevel, CElementShape* shape, SShapeProcessing& processing)
+{
+	// make a (shallow) copy because the mesh will get mutilated and abused for metadata
+	auto shallowCopy = [&](const asset::ICPUMesh* mesh) -> core::smart_refctd_ptr<asset::ICPUMesh>
+	{
+		auto copy = core::make_smart_refctd_ptr<asset::CCPUMesh>();
+		for (auto j=0u; j<mesh->getMeshBufferCount(); j++)
+			copy->addMeshBuffer(core::smart_refctd_ptr<asset::ICPUMeshBuffer>(mesh->getMeshBuffer(j)));
+		copy->recalculateBoundingBox();
+		m_manager->setAssetMetadata(copy.get(),core::smart_refctd_ptr<asset::IAssetMetadata>(mesh->getMetadata()));
+		return copy;
+	};
+	auto loadModel = [&](const ext::MitsubaLoader::SPropertyElementData& filename) -> core::smart_refctd_ptr<asset::ICPUMesh>
 	{
 		assert(filename.type==ext::MitsubaLoader::SPropertyElementData::Type::STRING);
-		auto loadParams = ctx.inner.params;
-		loadParams.loaderFlags = static_cast<IAssetLoader::E_LOADER_PARAMETER_FLAGS>(loadParams.loaderFlags | IAssetLoader::ELPF_RIGHT_HANDED_MESHES);
-		auto retval = interm_getAssetInHierarchy(m_manager, filename.svalue, loadParams, hierarchyLevel/*+ICPUSCene::MESH_HIERARCHY_LEVELS_BELOW*/, ctx.override_);
+		auto retval = getFileAsset(ctx, filename.svalue, getModelLoadParams(ctx), hierarchyLevel/*+ICPUSCene::MESH_HIERARCHY_LEVELS_BELOW*/);
 		auto contentRange = retval.getContents();
-		//
-		uint32_t actualIndex = 0;
-		if (index>=0ll)
-		for (auto it=contentRange.begin(); it!=contentRange.end(); it++)
-		{
-			auto meta = it->get()->getMetadata();
-			if (!meta || core::strcmpi(meta->getLoaderName(),ext::MitsubaLoader::CSerializedMetadata::LoaderName))
-				continue;
-			auto serializedMeta = static_cast<CSerializedMetadata*>(meta);
-			if (serializedMeta->id!=static_cast<uint32_t>(index))
-				continue;
-			actualIndex = it-contentRange.begin();
-			break;
-		}
-		//
-		if (contentRange.begin()+actualIndex < contentRange.end())
-		{
-			auto asset = contentRange.begin()[actualIndex];
-			if (asset && asset->getAssetType()==asset::IAsset::ET_MESH)
-			{
-				// make a (shallow) copy because the mesh will get mutilated and abused for metadata
-				auto mesh = core::smart_refctd_ptr_static_cast<asset::ICPUMesh>(asset);
-				auto copy = core::make_smart_refctd_ptr<asset::CCPUMesh>();
-				for (auto j=0u; j<mesh->getMeshBufferCount(); j++)
-					copy->addMeshBuffer(core::smart_refctd_ptr<asset::ICPUMeshBuffer>(mesh->getMeshBuffer(j)));
-				copy->recalculateBoundingBox();
-				m_manager->setAssetMetadata(copy.get(),core::smart_refctd_ptr<asset::IAssetMetadata>(mesh->getMetadata()));
-				return copy;
-			}
-			else
-				return nullptr;
-		}
-		else
+		if (contentRange.begin()==contentRange.end())
+			return nullptr;
+		auto asset = *contentRange.begin();
+		if (!asset || asset->getAssetType()!=asset::IAsset::ET_MESH)
+			return nullptr;
+		return shallowCopy(static_cast<const asset::ICPUMesh*>(asset.get()));
+	};
+	// decoded up front by `cacheSerializedMeshes`
+	auto loadSerialized = [&](const CElementShape::Serialized& serialized) -> core::smart_refctd_ptr<asset::ICPUMesh>
+	{
+		assert(serialized.filename.type==ext::MitsubaLoader::SPropertyElementData::Type::STRING);
+		auto file = ctx.serializedMeshes.find(serialized.filename.svalue);
+		if (file==ctx.serializedMeshes.end())
 			return nullptr;
+		auto found = file->second.find(core::max(serialized.shapeIndex,0));
+		if (found==file->second.end())
+			return nullptr;
+		return shallowCopy(found->second.get());
 	};
 
 	core::smart_refctd_ptr<asset::ICPUMesh> mesh;
-	bool flipNormals = false;
-	bool faceNormals = false;
-	float maxSmoothAngle = NAN;
 	switch (shape->type)
 	{
 		case CElementShape::Type::CUBE:
@@ -930,12 +1398,12 @@ SContext::shape_ass_type CMitsubaLoader::loadBasicShape(SContext& ctx, uint32_t
 			auto cubeData = ctx.creator->createCubeMesh(core::vector3df(2.f));
 
 			mesh = createMeshFromGeomCreatorReturnType(ctx.creator->createCubeMesh(core::vector3df(2.f)), m_manager);
-			flipNormals = flipNormals!=shape->cube.flipNormals;
+			processing.flipNormals = processing.flipNormals!=shape->cube.flipNormals;
 		}
 			break;
 		case CElementShape::Type::SPHERE:
 			mesh = createMeshFromGeomCreatorReturnType(ctx.creator->createSphereMesh(1.f,64u,64u), m_manager);
-			flipNormals = flipNormals!=shape->sphere.flipNormals;
+			processing.flipNormals = processing.flipNormals!=shape->sphere.flipNormals;
 			{
 				core::matrix3x4SIMD tform;
 				tform.setScale(core::vectorSIMDf(shape->sphere.radius,shape->sphere.radius,shape->sphere.radius));
@@ -964,82 +1432,38 @@ SContext::shape_ass_type CMitsubaLoader::loadBasicShape(SContext& ctx, uint32_t
 				scale.setScale(core::vectorSIMDf(shape->cylinder.radius,shape->cylinder.radius,core::length(diff).x));
 				shape->transform.matrix = core::concatenateBFollowedByA(shape->transform.matrix,core::matrix4SIMD(core::concatenateBFollowedByA(tform,scale)));
 			}
-			flipNormals = flipNormals!=shape->cylinder.flipNormals;
+			processing.flipNormals = processing.flipNormals!=shape->cylinder.flipNormals;
 			break;
 		case CElementShape::Type::RECTANGLE:
 			mesh = createMeshFromGeomCreatorReturnType(ctx.creator->createRectangleMesh(core::vector2df_SIMD(1.f,1.f)), m_manager);
-			flipNormals = flipNormals!=shape->rectangle.flipNormals;
+			processing.flipNormals = processing.flipNormals!=shape->rectangle.flipNormals;
 			break;
 		case CElementShape::Type::DISK:
 			mesh = createMeshFromGeomCreatorReturnType(ctx.creator->createDiskMesh(1.f,64u), m_manager);
-			flipNormals = flipNormals!=shape->disk.flipNormals;
+			processing.flipNormals = processing.flipNormals!=shape->disk.flipNormals;
 			break;
 		case CElementShape::Type::OBJ:
 			mesh = loadModel(shape->obj.filename);
-			flipNormals = flipNormals!=shape->obj.flipNormals;
-			faceNormals = shape->obj.faceNormals;
-			maxSmoothAngle = shape->obj.maxSmoothAngle;
-			if (mesh && shape->obj.flipTexCoords)
-			{
-				for (auto i = 0u; i < mesh->getMeshBufferCount(); i++)
-				{
-					auto meshbuffer = mesh->getMeshBuffer(i);
-					core::vectorSIMDf uv;
-					for (uint32_t i=0u; meshbuffer->getAttribute(uv, UV_ATTRIB_ID, i); i++)
-					{
-						uv.y = -uv.y;
-						meshbuffer->setAttribute(uv, UV_ATTRIB_ID, i);
-					}
-				}
-			}
+			processing.flipNormals = processing.flipNormals!=shape->obj.flipNormals;
+			processing.faceNormals = shape->obj.faceNormals;
+			processing.maxSmoothAngle = shape->obj.maxSmoothAngle;
+			processing.flipTexCoords = shape->obj.flipTexCoords;
 			// collapse parameter gets ignored
 			break;
 		case CElementShape::Type::PLY:
 			_NBL_DEBUG_BREAK_IF(true); // this code has never been tested
 			mesh = loadModel(shape->ply.filename);
-			mesh = core::smart_refctd_ptr_static_cast<asset::ICPUMesh>(mesh->clone(~0u));//clone everything
-			flipNormals = flipNormals!=shape->ply.flipNormals;
-			faceNormals = shape->ply.faceNormals;
-			maxSmoothAngle = shape->ply.maxSmoothAngle;
-			if (mesh && shape->ply.srgb)
-			{
-				uint32_t totalVertexCount = 0u;
-				for (auto i = 0u; i < mesh->getMeshBufferCount(); i++)
-					totalVertexCount += mesh->getMeshBuffer(i)->calcVertexCount();
-				if (totalVertexCount)
-				{
-					constexpr uint32_t hidefRGBSize = 4u;
-					auto newRGB = core::make_smart_refctd_ptr<asset::ICPUBuffer>(hidefRGBSize*totalVertexCount);
-					uint32_t* it = reinterpret_cast<uint32_t*>(newRGB->getPointer());
-					for (auto i = 0u; i < mesh->getMeshBufferCount(); i++)
-					{
-						auto meshbuffer = mesh->getMeshBuffer(i);
-						uint32_t offset = reinterpret_cast<uint8_t*>(it)-reinterpret_cast<uint8_t*>(newRGB->getPointer());
-						core::vectorSIMDf rgb;
-						for (uint32_t i=0u; meshbuffer->getAttribute(rgb, 1u, i); i++,it++)
-						{
-							for (auto i=0; i<3u; i++)
-								rgb[i] = core::srgb2lin(rgb[i]);
-							meshbuffer->setAttribute(rgb,it,asset::EF_A2B10G10R10_UNORM_PACK32);
-						}
-						constexpr uint32_t COLOR_BUF_BINDING = 15u;
-						auto& vtxParams = meshbuffer->getPipeline()->getVertexInputParams();
-						vtxParams.attributes[1].format = EF_A2B10G10R10_UNORM_PACK32;
-						vtxParams.attributes[1].relativeOffset = 0u;
-						vtxParams.attributes[1].binding = COLOR_BUF_BINDING;
-						vtxParams.bindings[COLOR_BUF_BINDING].inputRate = EVIR_PER_VERTEX;
-						vtxParams.bindings[COLOR_BUF_BINDING].stride = hidefRGBSize;
-						vtxParams.enabledBindingFlags |= (1u<<COLOR_BUF_BINDING);
-						meshbuffer->setVertexBufferBinding({0ull,core::smart_refctd_ptr(newRGB)}, COLOR_BUF_BINDING);
-					}
-				}
-			}
+			processing.flipNormals = processing.flipNormals!=shape->ply.flipNormals;
+			processing.faceNormals = shape->ply.faceNormals;
+			processing.maxSmoothAngle = shape->ply.maxSmoothAngle;
+			processing.clone = true;
+			processing.srgb = shape->ply.srgb;
 			break;
 		case CElementShape::Type::SERIALIZED:
-			mesh = loadModel(shape->serialized.filename,shape->serialized.shapeIndex);
-			flipNormals = flipNormals!=shape->serialized.flipNormals;
-			faceNormals = shape->serialized.faceNormals;
-			maxSmoothAngle = shape->serialized.maxSmoothAngle;
+			mesh = loadSerialized(shape->serialized);
+			processing.flipNormals = processing.flipNormals!=shape->serialized.flipNormals;
+			processing.faceNormals = shape->serialized.faceNormals;
+			processing.maxSmoothAngle = shape->serialized.maxSmoothAngle;
 			break;
 		case CElementShape::Type::SHAPEGROUP:
 			[[fallthrough]];
@@ -1050,18 +1474,102 @@ SContext::shape_ass_type CMitsubaLoader::loadBasicShape(SContext& ctx, uint32_t
 			_NBL_DEBUG_BREAK_IF(true);
 			break;
 	}
-	//
-	if (!mesh)
-		return nullptr;
+	return mesh;
+}
+
+SContext::shape_ass_type CMitsubaLoader::processShape(const SContext& ctx, SContext::shape_ass_type&& mesh, const SShapeProcessing& processing) const
+{
+	constexpr uint32_t UV_ATTRIB_ID = 2U;
+
+	// other shapes made from the same source share its meshbuffers and buffers, so they're copied before anything below changes them in place
+	// (otherwise the geometry other shapes got hashed with would change under them)
+	const bool recomputeNormals = processing.faceNormals || !std::isnan(processing.maxSmoothAngle);
+	if (processing.clone)
+		mesh = core::smart_refctd_ptr_static_cast<asset::ICPUMesh>(mesh->clone(~0u));//clone everything
+	else if (processing.flipTexCoords || processing.flipNormals || recomputeNormals)
+	{
+		auto copy = core::make_smart_refctd_ptr<asset::CCPUMesh>();
+		for (auto i=0u; i<mesh->getMeshBufferCount(); i++)
+		{
+			// shallow, `filterInvalidTriangles` and `flipSurfaces` rebind the index buffer of the meshbuffer
+			auto meshbuffer = core::smart_refctd_ptr_static_cast<asset::ICPUMeshBuffer>(mesh->getMeshBuffer(i)->clone(0u));
+			auto cloneBinding = [](asset::SBufferBinding<asset::ICPUBuffer> binding) -> asset::SBufferBinding<asset::ICPUBuffer>
+			{
+				if (binding.buffer)
+					binding.buffer = core::smart_refctd_ptr_static_cast<asset::ICPUBuffer>(binding.buffer->clone(0u));
+				return binding;
+			};
+			// `flipSurfaces` swaps indices in place
+			if (processing.flipNormals)
+				meshbuffer->setIndexBufferBinding(cloneBinding(*meshbuffer->getIndexBufferBinding()));
+			if (processing.flipTexCoords && meshbuffer->isAttributeEnabled(UV_ATTRIB_ID))
+			{
+				const uint32_t binding = meshbuffer->getPipeline()->getVertexInputParams().attributes[UV_ATTRIB_ID].binding;
+				meshbuffer->setVertexBufferBinding(cloneBinding(meshbuffer->getVertexBufferBindings()[binding]),binding);
+			}
+			copy->addMeshBuffer(std::move(meshbuffer));
+		}
+		m_manager->setAssetMetadata(copy.get(), core::smart_refctd_ptr<asset::IAssetMetadata>(mesh->getMetadata()));
+		mesh = std::move(copy);
+	}
+
+	if (processing.flipTexCoords)
+	{
+		for (auto i = 0u; i < mesh->getMeshBufferCount(); i++)
+		{
+			auto meshbuffer = mesh->getMeshBuffer(i);
+			core::vectorSIMDf uv;
+			for (uint32_t i=0u; meshbuffer->getAttribute(uv, UV_ATTRIB_ID, i); i++)
+			{
+				uv.y = -uv.y;
+				meshbuffer->setAttribute(uv, UV_ATTRIB_ID, i);
+			}
+		}
+	}
+	if (processing.srgb)
+	{
+		uint32_t totalVertexCount = 0u;
+		for (auto i = 0u; i < mesh->getMeshBufferCount(); i++)
+			totalVertexCount += mesh->getMeshBuffer(i)->calcVertexCount();
+		if (totalVertexCount)
+		{
+			constexpr uint32_t hidefRGBSize = 4u;
+			auto newRGB = core::make_smart_refctd_ptr<asset::ICPUBuffer>(hidefRGBSize*totalVertexCount);
+			uint32_t* it = reinterpret_cast<uint32_t*>(newRGB->getPointer());
+			for (auto i = 0u; i < mesh->getMeshBufferCount(); i++)
+			{
+				auto meshbuffer = mesh->getMeshBuffer(i);
+				uint32_t offset = reinterpret_cast<uint8_t*>(it)-reinterpret_cast<uint8_t*>(newRGB->getPointer());
+				core::vectorSIMDf rgb;
+				for (uint32_t i=0u; meshbuffer->getAttribute(rgb, 1u, i); i++,it++)
+				{
+					for (auto i=0; i<3u; i++)
+						rgb[i] = core::srgb2lin(rgb[i]);
+					meshbuffer->setAttribute(rgb,it,asset::EF_A2B10G10R10_UNORM_PACK32);
+				}
+				constexpr uint32_t COLOR_BUF_BINDING = 15u;
+				auto& vtxParams = meshbuffer->getPipeline()->getVertexInputParams();
+				vtxParams.attributes[1].format = EF_A2B10G10R10_UNORM_PACK32;
+				vtxParams.attributes[1].relativeOffset = 0u;
+				vtxParams.attributes[1].binding = COLOR_BUF_BINDING;
+				vtxParams.bindings[COLOR_BUF_BINDING].inputRate = EVIR_PER_VERTEX;
+				vtxParams.bindings[COLOR_BUF_BINDING].stride = hidefRGBSize;
+				vtxParams.enabledBindingFlags |= (1u<<COLOR_BUF_BINDING);
+				meshbuffer->setVertexBufferBinding({0ull,core::smart_refctd_ptr(newRGB)}, COLOR_BUF_BINDING);
+			}
+		}
+	}
 
 	// flip normals if necessary
-	if (flipNormals)
+	if (processing.flipNormals)
 	for (auto i=0u; i<mesh->getMeshBufferCount(); i++)
 		ctx.manipulator->flipSurfaces(mesh->getMeshBuffer(i));
 
 	//turned off by default, it's too slow (works though)
 //#define OPTIMIZE_MESHES
 
+	const bool faceNormals = processing.faceNormals;
+	const float maxSmoothAngle = processing.maxSmoothAngle;
 	auto newMesh = core::make_smart_refctd_ptr<asset::CCPUMesh>();
 	for (auto i = 0u; i < mesh->getMeshBufferCount(); ++i)
 	{
@@ -1072,7 +1580,7 @@ SContext::shape_ass_type CMitsubaLoader::loadBasicShape(SContext& ctx, uint32_t
 #else
 		auto newMeshBuffer = core::smart_refctd_ptr<asset::ICPUMeshBuffer>(mesh->getMeshBuffer(i));
 #endif
-		if (faceNormals || !std::isnan(maxSmoothAngle))
+		if (recomputeNormals)
 		{
 			const float smoothAngleCos = cos(core::radians(maxSmoothAngle));
 
@@ -1091,12 +1599,7 @@ SContext::shape_ass_type CMitsubaLoader::loadBasicShape(SContext& ctx, uint32_t
 	}
 	newMesh->recalculateBoundingBox();
 	m_manager->setAssetMetadata(newMesh.get(), core::smart_refctd_ptr<asset::IAssetMetadata>(mesh->getMetadata()));
-	mesh = std::move(newMesh);
-
-	addInstance(mesh);
-	// cache and return
-	ctx.shapeCache.insert({ shape,mesh });
-	return mesh;
+	return newMesh;
 }
 
 SContext::tex_ass_type CMitsubaLoader::cacheTexture(SContext& ctx, uint32_t hierarchyLevel, const CElementTexture* tex)
@@ -1157,7 +1660,7 @@ SContext::tex_ass_type CMitsubaLoader::cacheTexture(SContext& ctx, uint32_t hier
 				core::smart_refctd_ptr<asset::ICPUImage> img;
 				if (!view)
 				{
-					asset::SAssetBundle imgBundle = interm_getAssetInHierarchy(m_manager,tex->bitmap.filename.svalue,ctx.inner.params,hierarchyLevel,ctx.override_);
+					asset::SAssetBundle imgBundle = getFileAsset(ctx,tex->bitmap.filename.svalue,ctx.inner.params,hierarchyLevel);
 					auto contentRange = imgBundle.getContents();
 					if (contentRange.begin() < contentRange.end())
 					{
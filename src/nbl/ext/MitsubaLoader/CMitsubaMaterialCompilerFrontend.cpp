@@ -488,8 +488,8 @@ auto CMitsubaMaterialCompilerFrontend::compileToIRTree(asset::material_compiler:
         *dst = ir_node;
     }
 
-    ir->addRootNode(frontroot);
-    ir->addRootNode(backroot);
+    frontroot = ir->addRootNode(frontroot);
+    backroot = ir->addRootNode(backroot);
 
     return { frontroot, backroot };
 }
@@ -4,6 +4,8 @@
 
 #include "nbl/asset/compile_config.h"
 
+#include <numeric>
+
 #include "nbl/core/core.h"
 #include "IReadFile.h"
 #include "os.h"
@@ -54,362 +56,505 @@ constexpr auto COLOR_ATTRIBUTE = 1;
 constexpr auto UV_ATTRIBUTE = 2;
 constexpr auto NORMAL_ATTRIBUTE = 3;
 
-// maybe move to core
-#define PAGE_SIZE 4096
-struct alignas(PAGE_SIZE) Page_t
+// deflate can't do better than this, anything claiming more is corrupt
+constexpr size_t MAX_COMPRESSION_RATIO = 1032ull;
+// `avail_out` is only 32bit
+constexpr size_t MAX_INFLATE_CHUNK = 1ull<<30ull;
+
+//! the size of an inflated mesh worked out from its beginning, 0 if there's not enough of it yet and ~0 if it's invalid
+static size_t getInflatedSize(const uint8_t* _data, const size_t _size)
 {
-	uint8_t data[PAGE_SIZE];
-};
-#undef PAGE_SIZE
+	if (_size <= sizeof(uint32_t))
+		return 0ull;
+	const auto* nameEnd = reinterpret_cast<const uint8_t*>(memchr(_data+sizeof(uint32_t), 0, _size-sizeof(uint32_t)));
+	if (!nameEnd)
+		return 0ull;
+	const size_t headerSize = nameEnd+1-_data+sizeof(uint64_t)*2ull;
+	if (headerSize > _size)
+		return 0ull;
+
+	uint32_t flags;
+	uint64_t counts[2];
+	memcpy(&flags, _data, sizeof(flags));
+	memcpy(counts, nameEnd+1, sizeof(counts));
+
+	size_t typeSize;
+	if (flags & MF_SINGLE_FLOAT)
+		typeSize = sizeof(float);
+	else if (flags & MF_DOUBLE_FLOAT)
+		typeSize = sizeof(double);
+	else
+		return ~0ull;
+	size_t vertexAttributeCount = 3u;
+	if ((flags & MF_PER_VERTEX_NORMALS) || (flags & MF_FACE_NORMALS))
+		vertexAttributeCount += 3ull;
+	if (flags & MF_TEXTURE_COORDINATES)
+		vertexAttributeCount += 2ull;
+	if (flags & MF_VERTEX_COLORS)
+		vertexAttributeCount += 3ull;
+
+	if (counts[0]>0xFFFFFFFFull || counts[1]>0xFFFFFFFFull)
+		return ~0ull;
+	return headerSize+counts[0]*vertexAttributeCount*typeSize+counts[1]*3ull*sizeof(uint32_t);
+}
 
-//! creates/loads an animated mesh from the file.
-asset::SAssetBundle CSerializedLoader::loadAsset(io::IReadFile* _file, const asset::IAssetLoader::SAssetLoadParams& _params, asset::IAssetLoader::IAssetLoaderOverride* _override, uint32_t _hierarchyLevel)
+//! inflates a mesh into a buffer sized from the beginning of the mesh, so it only gets allocated once
+static bool inflateMesh(const uint8_t* _compressed, const size_t _compressedSize, core::vector<uint8_t>& _out)
 {
-	if (!_file)
-        return {};
+	z_stream stream = {};
+	stream.next_in = (Bytef*)_compressed;
+	stream.avail_in = (uInt)_compressedSize;
+	if (inflateInit(&stream, -MAX_WBITS) != Z_OK)
+		return false;
+
+	size_t produced = 0ull;
+	auto inflateUpTo = [&](const size_t size) -> int32_t
+	{
+		stream.next_out = reinterpret_cast<Bytef*>(_out.data())+produced;
+		stream.avail_out = static_cast<uInt>(core::min(size-produced,MAX_INFLATE_CHUNK));
+		const int32_t err = inflate(&stream, Z_SYNC_FLUSH);
+		produced = reinterpret_cast<uint8_t*>(stream.next_out)-_out.data();
+		return err;
+	};
+
+	// just enough for the flags, name, vertex and triangle counts
+	int32_t err = Z_OK;
+	size_t totalSize = 0ull;
+	_out.resize(256u);
+	while (err==Z_OK && !totalSize)
+	{
+		err = inflateUpTo(_out.size());
+		totalSize = getInflatedSize(_out.data(),produced);
+		// the name didn't fit
+		if (!totalSize && produced==_out.size())
+			_out.resize(_out.size()*2u);
+	}
+	// the sizes get validated again when the mesh is built, just don't allocate nonsense
+	if (totalSize && totalSize<=_compressedSize*MAX_COMPRESSION_RATIO+produced)
+	{
+		totalSize = core::max(totalSize,produced);
+		_out.resize(totalSize);
+		while (err==Z_OK && produced<totalSize)
+			err = inflateUpTo(totalSize);
+	}
+	else
+		err = Z_DATA_ERROR;
+	_out.resize(produced);
 
-	SContext ctx = {_file,0,nullptr};
+	const int32_t err2 = inflateEnd(&stream);
+	return (err==Z_OK || err==Z_STREAM_END) && err2==Z_OK;
+}
+
+bool CSerializedLoader::readMeshOffsets(SContext& _ctx) const
+{
+	FileHeader header;
+	_ctx.file->seek(0u);
+	_ctx.file->read(&header, sizeof(header));
+	if (header!=FileHeader())
+	{
+		os::Printer::log("Not a valid `.serialized` file", _ctx.file->getFileName().c_str(), ELL_ERROR);
+		return false;
+	}
+
+	size_t backPos = _ctx.file->getSize() - sizeof(uint32_t);
+	_ctx.file->seek(backPos);
+	_ctx.file->read(&_ctx.meshCount,sizeof(uint32_t));
+	if (_ctx.meshCount==0u || sizeof(uint64_t)*_ctx.meshCount>backPos)
+		return false;
+
+	_ctx.meshOffsets = core::make_refctd_dynamic_array<core::smart_refctd_dynamic_array<uint64_t> >(_ctx.meshCount*2u);
+	backPos -= sizeof(uint64_t)*_ctx.meshCount;
+	_ctx.file->seek(backPos);
+	_ctx.file->read(_ctx.meshOffsets->data(),sizeof(uint64_t)*_ctx.meshCount);
 	size_t maxSize = 0u;
+	for (uint32_t i=0; i<_ctx.meshCount; i++)
 	{
-		FileHeader header;
-		ctx.file->seek(0u);
-		ctx.file->read(&header, sizeof(header));
-		if (header!=FileHeader())
-		{
-			os::Printer::log("Not a valid `.serialized` file", ctx.file->getFileName().c_str(), ELL_ERROR);
-			return {};
-		}
+		const uint64_t begin = _ctx.meshOffsets->operator[](i);
+		const uint64_t end = i==_ctx.meshCount-1u ? backPos:_ctx.meshOffsets->operator[](i+1u);
+		// mangled offsets would make us read past the offset table
+		const size_t localSize = begin<end && end<=backPos ? (end-begin):0u;
+		_ctx.meshOffsets->operator[](i+_ctx.meshCount) = localSize;
+		if (localSize > maxSize)
+			maxSize = localSize;
+	}
+	return maxSize!=0u;
+}
+
+namespace
+{
+	//! assets every mesh uses, fetched before decoding starts because the asset manager is not thread-safe
+	struct SSharedAssets
+	{
+		_NBL_STATIC_INLINE_CONSTEXPR uint32_t SHADER_VARIANTS = 3u;
+		core::smart_refctd_ptr<ICPUSpecializedShader> vertexShaders[SHADER_VARIANTS];
+		core::smart_refctd_ptr<ICPUSpecializedShader> fragmentShaders[SHADER_VARIANTS];
+		core::smart_refctd_ptr<ICPUPipelineLayout> pipelineLayout;
+		core::smart_refctd_dynamic_array<asset::IPipelineMetadata::ShaderInputSemantic> shaderInputsMetadata;
+	};
+
+	struct SDecodedMesh
+	{
+		core::smart_refctd_ptr<asset::CCPUMesh> mesh;
+		std::string name;
+	};
+}
 
-		size_t backPos = ctx.file->getSize() - sizeof(uint32_t);
-		ctx.file->seek(backPos);
-		ctx.file->read(&ctx.meshCount,sizeof(uint32_t));
-		if (ctx.meshCount==0u)
+//! builds a mesh out of the inflated data, empty if it's invalid
+static SDecodedMesh decodeMesh(const uint8_t* _data, const size_t _size, const SSharedAssets& _shared)
+{
+	// too small to hold anything
+	if (_size < sizeof(uint8_t)+sizeof(uint64_t)*2ull)
+		return {};
+
+	// some tracking
+	const uint8_t* ptr = _data;
+	const uint8_t* streamEnd = ptr+_size;
+	// vertex size determination
+	auto flags = *(reinterpret_cast<const uint32_t*&>(ptr)++);
+	size_t typeSize;
+	size_t vertexAttributeCount = 3u;
+	size_t vertexSize;
+	{
+		if (flags & MF_SINGLE_FLOAT)
+			typeSize = sizeof(float);
+		else if (flags & MF_DOUBLE_FLOAT)
+			typeSize = sizeof(double);
+		else
 			return {};
 
-		ctx.meshOffsets = core::make_refctd_dynamic_array<core::smart_refctd_dynamic_array<uint64_t> >(ctx.meshCount*2u);
-		backPos -= sizeof(uint64_t)*ctx.meshCount;
-		ctx.file->seek(backPos);
-		ctx.file->read(ctx.meshOffsets->data(),sizeof(uint64_t)*ctx.meshCount);
-		for (uint32_t i=0; i<ctx.meshCount; i++)
-		{
-			size_t localSize;
-			if (i == ctx.meshCount-1u)
-				localSize = backPos;
-			else
-				localSize = ctx.meshOffsets->operator[](i+1u);
-			localSize -= ctx.meshOffsets->operator[](i);
-			ctx.meshOffsets->operator[](i+ctx.meshCount) = localSize;
-			if (localSize > maxSize)
-				maxSize = localSize;
-		}
+		if ((flags & MF_PER_VERTEX_NORMALS) || (flags & MF_FACE_NORMALS))
+			vertexAttributeCount += 3ull;
+		if (flags & MF_TEXTURE_COORDINATES)
+			vertexAttributeCount += 2ull;
+		if (flags & MF_VERTEX_COLORS)
+			vertexAttributeCount += 3ull;
+
+		vertexSize = vertexAttributeCount*typeSize;
 	}
-	if (maxSize==0u)
-		return {};
 
+	// get name
+	const char* stringPtr = reinterpret_cast<const char*>(ptr);
+	while (ptr < streamEnd)
+	if (! *(ptr++))
+			break;
+	// name too long
+	size_t stringLen = reinterpret_cast<const char*>(ptr)-stringPtr;
+	if (ptr+sizeof(uint64_t)*2ull > streamEnd)
+		return {};
 
-	core::vector<core::smart_refctd_ptr<asset::CCPUMesh> > meshes;
-	meshes.reserve(ctx.meshCount);
+	// 
+	uint64_t vertexCount = *(reinterpret_cast<const uint64_t*&>(ptr)++);
+	if (vertexCount<3ull || vertexCount>0xFFFFFFFFull)
+		return {};
+	uint64_t triangleCount = *(reinterpret_cast<const uint64_t*&>(ptr)++);
+	if (triangleCount<1ull)
+		return {};
+	size_t vertexDataSize = vertexCount*vertexSize;
+	if (ptr+vertexDataSize > streamEnd)
+		return {};
+	size_t indexDataSize = sizeof(uint32_t)*3ull*triangleCount;
+	size_t totalDataSize = vertexDataSize+indexDataSize;
+	if (ptr+totalDataSize > streamEnd)
+		return {};
 
-	uint8_t* data = reinterpret_cast<uint8_t*>(_NBL_ALIGNED_MALLOC(maxSize,alignof(double)));
-	constexpr size_t CHUNK = 256ull*1024ull;
-	core::vector<Page_t> decompressed(CHUNK/sizeof(Page_t));
-	for (uint32_t i=0; i<ctx.meshCount; i++)
+	auto buf = core::make_smart_refctd_ptr<asset::ICPUBuffer>(totalDataSize);
+	void* outPtr = buf->getPointer();
+	auto readAttributes = [&](auto* outPtr, size_t attrOffset, auto* &inPtr, uint32_t attrCount, core::aabbox3df* aabb=nullptr) -> void
 	{
-		auto localSize = ctx.meshOffsets->operator[](i+ctx.meshCount);
-		ctx.file->seek(sizeof(FileHeader)+ctx.meshOffsets->operator[](i));
-		ctx.file->read(data,localSize);
-		// decompress
-		size_t decompressSize;
+		for (uint64_t j=0ull; j<vertexCount; j++)
 		{
-			// Setup the inflate stream.
-			z_stream stream;
-			stream.next_in = (Bytef*)data;
-			stream.avail_in = (uInt)localSize;
-			stream.total_in = 0;
-			stream.next_out = (Bytef*)decompressed.data();
-			stream.avail_out = CHUNK;
-			stream.total_out = 0u;
-			stream.zalloc = (alloc_func)0;
-			stream.zfree = (free_func)0;
-
-			int32_t err = inflateInit(&stream, -MAX_WBITS);
-			if (err == Z_OK)
+			if (aabb)
 			{
-				while (err == Z_OK && err != Z_STREAM_END)
-				{
-					err = inflate(&stream, Z_SYNC_FLUSH);
-					if (err!=Z_OK || err==Z_STREAM_END || stream.avail_out)
-						continue;
-
-					if (stream.total_out+CHUNK>decompressed.size()*sizeof(Page_t))
-						decompressed.resize(decompressed.size()+CHUNK/sizeof(Page_t));
-					stream.next_out = reinterpret_cast<Bytef*>(decompressed.data())+stream.total_out;
-					stream.avail_out = CHUNK;
-				}
-			}
-			decompressSize = stream.total_out;
-			int32_t err2 = inflateEnd(&stream);
-
-			if (err == Z_OK || err == Z_STREAM_END)
-				err = err2;
-			if (err != Z_OK)
-			{
-				std::wstring msg(L"Error decompressing mesh ix ");
-				msg += std::to_wstring(i);
-				os::Printer::log(msg, ELL_ERROR);
-				continue;
+				if (j)
+					aabb->addInternalPoint(inPtr[0],inPtr[1],inPtr[2]);
+				else
+					aabb->reset(inPtr[0],inPtr[1],inPtr[2]);
 			}
+			for (auto k=0u; k<attrCount; k++)
+				outPtr[j*vertexAttributeCount+attrOffset+k] = *(inPtr++);
 		}
-		// too small to hold anything
-		if (decompressSize < sizeof(uint8_t)+sizeof(uint64_t)*2ull)
-			continue;
+	};
 
-		// some tracking
-		uint8_t* ptr = reinterpret_cast<uint8_t*>(decompressed.data());
-		uint8_t* streamEnd = ptr+decompressSize;
-		// vertex size determination
-		auto flags = *(reinterpret_cast<uint32_t*&>(ptr)++);
-		size_t typeSize;
-		size_t vertexAttributeCount = 3u;
-		size_t vertexSize;
-		{
-			if (flags & MF_SINGLE_FLOAT)
-				typeSize = sizeof(float);
-			else if (flags & MF_DOUBLE_FLOAT)
-				typeSize = sizeof(double);
-			else
-				continue;
+	auto meshBuffer = core::make_smart_refctd_ptr<asset::ICPUMeshBuffer>();
+	meshBuffer->setPositionAttributeIx(POSITION_ATTRIBUTE);
 
-			if ((flags & MF_PER_VERTEX_NORMALS) || (flags & MF_FACE_NORMALS))
-				vertexAttributeCount += 3ull;
-			if (flags & MF_TEXTURE_COORDINATES)
-				vertexAttributeCount += 2ull;
-			if (flags & MF_VERTEX_COLORS)
-				vertexAttributeCount += 3ull;
+	// debug shaders show vertex colors, UVs or normals in that order of preference, if only positions are present vertex colors are assumed
+	uint32_t shaderVariant = 0u;
+	if (!(flags & MF_VERTEX_COLORS))
+	{
+		if (flags & MF_TEXTURE_COORDINATES)
+			shaderVariant = 1u;
+		else if (flags & MF_PER_VERTEX_NORMALS)
+			shaderVariant = 2u;
+	}
+	auto mbPipelineLayout = _shared.pipelineLayout;
 
-			vertexSize = vertexAttributeCount*typeSize;
-		}
+	asset::SBlendParams blendParams;
+	asset::SRasterizationParams rastarizationParams;
+	asset::SPrimitiveAssemblyParams primitiveAssemblyParams;
+	asset::SVertexInputParams inputParams;
+
+	primitiveAssemblyParams.primitiveType = asset::EPT_TRIANGLE_LIST;
+	inputParams.enabledBindingFlags |= core::createBitmask({ 0 });
+	inputParams.bindings[0].inputRate = asset::EVIR_PER_VERTEX;
+	inputParams.bindings[0].stride = vertexSize;
 
-		// get name
-		char* stringPtr = reinterpret_cast<char*>(ptr);
-		while (ptr < streamEnd)
-		if (! *(ptr++))
+	size_t attrOffset = 0ull;
+	auto readAttributeDispatch = [&](auto attrId, size_t attrCount, core::aabbox3df* aabb, bool read = true) -> void
+	{
+		asset::E_FORMAT format = asset::EF_UNKNOWN;
+		switch (attrCount)
+		{
+			case 2ull:
+				format = typeSize==sizeof(double) ? asset::EF_R64G64_SFLOAT:asset::EF_R32G32_SFLOAT;
 				break;
-		// name too long
-		size_t stringLen = reinterpret_cast<char*>(ptr)-stringPtr;
-		if (ptr+sizeof(uint64_t)*2ull > streamEnd)
-			continue;
+			case 3ull:
+				format = typeSize==sizeof(double) ? asset::EF_R64G64B64_SFLOAT:asset::EF_R32G32B32_SFLOAT;
+				break;
+			default:
+				assert(false);
+				break;
+		}
 
-		// 
-		uint64_t vertexCount = *(reinterpret_cast<uint64_t*&>(ptr)++);
-		if (vertexCount<3ull || vertexCount>0xFFFFFFFFull)
-			continue;
-		uint64_t triangleCount = *(reinterpret_cast<uint64_t*&>(ptr)++);
-		if (triangleCount<1ull)
-			continue;
-		size_t vertexDataSize = vertexCount*vertexSize;
-		if (ptr+vertexDataSize > streamEnd)
-			continue;
-		size_t indexDataSize = sizeof(uint32_t)*3ull*triangleCount;
-		size_t totalDataSize = vertexDataSize+indexDataSize;
-		if (ptr+totalDataSize > streamEnd)
-			continue;
+		inputParams.enabledAttribFlags |= core::createBitmask({ attrId });
+		inputParams.attributes[attrId].binding = 0;
+		inputParams.attributes[attrId].format = format;
+		inputParams.attributes[attrId].relativeOffset = attrOffset * typeSize;
+		meshBuffer->setVertexBufferBinding({ 0, buf }, 0);
 
-		auto buf = core::make_smart_refctd_ptr<asset::ICPUBuffer>(totalDataSize);
-		void* outPtr = buf->getPointer();
-		auto readAttributes = [&](auto* outPtr, size_t attrOffset, auto* &inPtr, uint32_t attrCount, core::aabbox3df* aabb=nullptr) -> void
+		if (read)
+		{
+			if (flags & MF_SINGLE_FLOAT)
+				readAttributes(reinterpret_cast<float*>(outPtr), attrOffset, reinterpret_cast<const float*&>(ptr), attrCount, aabb);
+			else if (flags & MF_DOUBLE_FLOAT)
+				readAttributes(reinterpret_cast<double*>(outPtr), attrOffset, reinterpret_cast<const double*&>(ptr), attrCount, aabb);
+		}
+		attrOffset += attrCount;
+	};
+
+	core::aabbox3df aabb;
+	readAttributeDispatch(POSITION_ATTRIBUTE, 3ull, &aabb);
+	meshBuffer->setBoundingBox(aabb);
+	if ((flags & MF_PER_VERTEX_NORMALS) || (flags & MF_FACE_NORMALS))
+		readAttributeDispatch(NORMAL_ATTRIBUTE, 3ull, nullptr, flags&MF_PER_VERTEX_NORMALS); // TODO: normal quantization and optimization
+	if (flags & MF_TEXTURE_COORDINATES) // TODO: UV quantization and optimization
+		readAttributeDispatch(UV_ATTRIBUTE, 2ull, nullptr);
+	if (flags & MF_VERTEX_COLORS) // TODO: quantize to 32bit format like RGB9E5
+		readAttributeDispatch(COLOR_ATTRIBUTE, 3ull, nullptr);
+
+	auto mbPipeline = core::make_smart_refctd_ptr<asset::ICPURenderpassIndependentPipeline>(std::move(mbPipelineLayout), nullptr, nullptr, inputParams, blendParams, primitiveAssemblyParams, rastarizationParams);
+	mbPipeline->setShaderAtStage(asset::ISpecializedShader::E_SHADER_STAGE::ESS_VERTEX, _shared.vertexShaders[shaderVariant].get());
+	mbPipeline->setShaderAtStage(asset::ISpecializedShader::E_SHADER_STAGE::ESS_FRAGMENT, _shared.fragmentShaders[shaderVariant].get());
+
+	meshBuffer->setIndexBufferBinding({ vertexDataSize, std::move(buf) });
+	meshBuffer->setIndexCount(triangleCount * 3u);
+	meshBuffer->setIndexType(asset::EIT_32BIT);
+
+	// read indices and possibly create per-face normals
+	auto readIndices = [&]() -> bool
+	{
+		uint32_t* indexPtr = reinterpret_cast<uint32_t*>(outPtr)+vertexDataSize/sizeof(uint32_t);
+		for (uint64_t j=0ull; j<triangleCount; j++)
 		{
-			for (uint64_t j=0ull; j<vertexCount; j++)
+			uint32_t* triangleIndices = indexPtr;
+			for (uint64_t k=0ull; k<3ull; k++)
 			{
-				if (aabb)
-				{
-					if (j)
-						aabb->addInternalPoint(inPtr[0],inPtr[1],inPtr[2]);
-					else
-						aabb->reset(inPtr[0],inPtr[1],inPtr[2]);
-				}
-				for (auto k=0u; k<attrCount; k++)
-					outPtr[j*vertexAttributeCount+attrOffset+k] = *(inPtr++);
+				triangleIndices[k] = *(reinterpret_cast<const uint32_t*&>(ptr)++);
+				if (triangleIndices[k] >= static_cast<uint32_t>(vertexCount))
+					return false;
 			}
-		};
+			indexPtr += 3u;
 
-		auto meshBuffer = core::make_smart_refctd_ptr<asset::ICPUMeshBuffer>();
-		meshBuffer->setPositionAttributeIx(POSITION_ATTRIBUTE);
+			if (flags & MF_FACE_NORMALS)
+			{
+				core::vectorSIMDf pos[3];
+				for (uint64_t k=0ull; k<3ull; k++)
+					pos[k] = meshBuffer->getPosition(triangleIndices[k]);
+				auto normal = core::cross(pos[1]-pos[0],pos[2]-pos[0]);
+				for (uint64_t k=0ull; k<3ull; k++)
+					meshBuffer->setAttribute(normal,NORMAL_ATTRIBUTE,k);
+			}
+		}
+		return true;
+	};
+	if (!readIndices())
+		return {};
 
-		auto makeAvailableAttributesVector = [&]()
-		{
-			core::vector<uint8_t> vec;
-			vec.reserve(4);
-
-			vec.push_back(POSITION_ATTRIBUTE);
-			if (flags & MF_VERTEX_COLORS)
-				vec.push_back(COLOR_ATTRIBUTE);
-			if (flags & MF_TEXTURE_COORDINATES)
-				vec.push_back(UV_ATTRIBUTE);
-			if (flags & MF_PER_VERTEX_NORMALS)
-				vec.push_back(NORMAL_ATTRIBUTE);
-			return vec;
-		};
+	meshBuffer->setPipeline(std::move(mbPipeline));
 
-		const auto availableAttributes = makeAvailableAttributesVector();
+	SDecodedMesh retval;
+	retval.mesh = core::make_smart_refctd_ptr<asset::CCPUMesh>();
+	retval.mesh->addMeshBuffer(std::move(meshBuffer));
+	retval.mesh->recalculateBoundingBox();
+	retval.name = std::string(stringPtr, stringLen);
+	return retval;
+}
 
-		auto chooseShaderPath = [&]() -> std::string
-		{
-			constexpr std::array<std::pair<uint8_t, std::string_view>, 3> avaiableOptionsForShaders
-			{
-				std::make_pair(COLOR_ATTRIBUTE, "nbl/builtin/materials/debug/vertex_color/specializedshader"),
-				std::make_pair(UV_ATTRIBUTE, "nbl/builtin/materials/debug/vertex_uv/specializedshader"),
-				std::make_pair(NORMAL_ATTRIBUTE, "nbl/builtin/materials/debug/vertex_normal/specializedshader")
-			};
+//! creates/loads an animated mesh from the file.
+asset::SAssetBundle CSerializedLoader::loadAsset(io::IReadFile* _file, const asset::IAssetLoader::SAssetLoadParams& _params, asset::IAssetLoader::IAssetLoaderOverride* _override, uint32_t _hierarchyLevel)
+{
+	if (!_file)
+        return {};
 
-			for (auto& it : avaiableOptionsForShaders)
-			{
-				auto found = std::find(availableAttributes.begin(), availableAttributes.end(), it.first);
-				if (found != availableAttributes.end())
-					return it.second.data();
-			}
+	SContext ctx = {_file,0,nullptr};
+	if (!readMeshOffsets(ctx))
+		return {};
+
+	core::vector<uint32_t> ids(ctx.meshCount);
+	std::iota(ids.begin(), ids.end(), 0u);
+	auto decoded = loadMeshes_impl(ctx, {ids.data(),ids.data()+ids.size()}, core::CWorkStealingScheduler::getDefault());
+
+	core::vector<core::smart_refctd_ptr<asset::ICPUMesh> > meshes;
+	meshes.reserve(decoded.size());
+	for (auto& mesh : decoded)
+	if (mesh)
+		meshes.push_back(std::move(mesh));
+	return meshes;
+}
+
+core::vector<core::smart_refctd_ptr<asset::ICPUMesh>> CSerializedLoader::loadMeshes(io::IReadFile* _file, const core::SRange<const uint32_t>& _ids, core::CWorkStealingScheduler* _scheduler)
+{
+	SContext ctx = {_file,0,nullptr};
+	if (!_file || _ids.empty() || !readMeshOffsets(ctx))
+		return core::vector<core::smart_refctd_ptr<asset::ICPUMesh>>(_ids.size());
+	return loadMeshes_impl(ctx, _ids, _scheduler);
+}
+
+core::vector<core::smart_refctd_ptr<asset::ICPUMesh>> CSerializedLoader::loadMeshes_impl(SContext& ctx, const core::SRange<const uint32_t>& _ids, core::CWorkStealingScheduler* _scheduler)
+{
+	core::vector<core::smart_refctd_ptr<asset::ICPUMesh>> retval(_ids.size());
+	auto getOffset = [&ctx](const uint32_t id) -> size_t {return sizeof(FileHeader)+ctx.meshOffsets->operator[](id);};
+	auto getCompressedSize = [&ctx](const uint32_t id) -> size_t {return ctx.meshOffsets->operator[](id+ctx.meshCount);};
 
-			return avaiableOptionsForShaders[0].second.data(); // if only positions are present, shaders with debug vertex colors are assumed
+	SSharedAssets shared;
+	{
+		constexpr const char* shaderPaths[SSharedAssets::SHADER_VARIANTS] =
+		{
+			"nbl/builtin/materials/debug/vertex_color/specializedshader",
+			"nbl/builtin/materials/debug/vertex_uv/specializedshader",
+			"nbl/builtin/materials/debug/vertex_normal/specializedshader"
 		};
-		
-		core::smart_refctd_ptr<ICPUSpecializedShader> mbVertexShader;
-		core::smart_refctd_ptr<ICPUSpecializedShader> mbFragmentShader;
+		const IAsset::E_TYPE shaderTypes[]{ IAsset::E_TYPE::ET_SPECIALIZED_SHADER, IAsset::E_TYPE::ET_SPECIALIZED_SHADER, static_cast<IAsset::E_TYPE>(0u) };
+		for (uint32_t i=0u; i<SSharedAssets::SHADER_VARIANTS; i++)
 		{
-			const IAsset::E_TYPE types[]{ IAsset::E_TYPE::ET_SPECIALIZED_SHADER, IAsset::E_TYPE::ET_SPECIALIZED_SHADER, static_cast<IAsset::E_TYPE>(0u) };
-			const std::string basepath = chooseShaderPath();
-
-			auto bundle = manager->findAssets(basepath+".vert", types);
-			mbVertexShader = core::smart_refctd_ptr_static_cast<ICPUSpecializedShader>(bundle->begin()->getContents().begin()[0]);
-			bundle = manager->findAssets(basepath+".frag", types);
-			mbFragmentShader = core::smart_refctd_ptr_static_cast<ICPUSpecializedShader>(bundle->begin()->getContents().begin()[0]);
+			const std::string basepath = shaderPaths[i];
+			auto bundle = manager->findAssets(basepath+".vert", shaderTypes);
+			shared.vertexShaders[i] = core::smart_refctd_ptr_static_cast<ICPUSpecializedShader>(bundle->begin()->getContents().begin()[0]);
+			bundle = manager->findAssets(basepath+".frag", shaderTypes);
+			shared.fragmentShaders[i] = core::smart_refctd_ptr_static_cast<ICPUSpecializedShader>(bundle->begin()->getContents().begin()[0]);
 		}
-		auto mbPipelineLayout = getDefaultAsset<ICPUPipelineLayout, asset::IAsset::ET_PIPELINE_LAYOUT>("nbl/builtin/materials/lambertian/no_texture/pipelinelayout", manager);
+		shared.pipelineLayout = getDefaultAsset<ICPUPipelineLayout, asset::IAsset::ET_PIPELINE_LAYOUT>("nbl/builtin/materials/lambertian/no_texture/pipelinelayout", manager);
 
 		constexpr size_t DS1_METADATA_ENTRY_CNT = 3ull;
-		core::smart_refctd_dynamic_array<asset::IPipelineMetadata::ShaderInputSemantic> shaderInputsMetadata = core::make_refctd_dynamic_array<decltype(shaderInputsMetadata)>(DS1_METADATA_ENTRY_CNT);
-		{
-			asset::ICPUDescriptorSetLayout* ds1layout = mbPipelineLayout->getDescriptorSetLayout(1u);
+		shared.shaderInputsMetadata = core::make_refctd_dynamic_array<decltype(shared.shaderInputsMetadata)>(DS1_METADATA_ENTRY_CNT);
+		asset::ICPUDescriptorSetLayout* ds1layout = shared.pipelineLayout->getDescriptorSetLayout(1u);
 
-			constexpr asset::IPipelineMetadata::E_COMMON_SHADER_INPUT types[DS1_METADATA_ENTRY_CNT]{ asset::IPipelineMetadata::ECSI_WORLD_VIEW_PROJ, asset::IPipelineMetadata::ECSI_WORLD_VIEW, asset::IPipelineMetadata::ECSI_WORLD_VIEW_INVERSE_TRANSPOSE };
-			constexpr uint32_t sizes[DS1_METADATA_ENTRY_CNT]{ sizeof(asset::SBasicViewParameters::MVP), sizeof(asset::SBasicViewParameters::MV), sizeof(asset::SBasicViewParameters::NormalMat) };
-			constexpr uint32_t relOffsets[DS1_METADATA_ENTRY_CNT]{ offsetof(asset::SBasicViewParameters,MVP), offsetof(asset::SBasicViewParameters,MV), offsetof(asset::SBasicViewParameters,NormalMat) };
-			for (uint32_t i = 0u; i < DS1_METADATA_ENTRY_CNT; ++i)
-			{
-				auto& semantic = (shaderInputsMetadata->end() - i - 1u)[0];
-				semantic.type = types[i];
-				semantic.descriptorSection.type = asset::IPipelineMetadata::ShaderInput::ET_UNIFORM_BUFFER;
-				semantic.descriptorSection.uniformBufferObject.binding = ds1layout->getBindings().begin()[0].binding;
-				semantic.descriptorSection.uniformBufferObject.set = 1u;
-				semantic.descriptorSection.uniformBufferObject.relByteoffset = relOffsets[i];
-				semantic.descriptorSection.uniformBufferObject.bytesize = sizes[i];
-				semantic.descriptorSection.shaderAccessFlags = asset::ICPUSpecializedShader::ESS_VERTEX;
-			}
+		constexpr asset::IPipelineMetadata::E_COMMON_SHADER_INPUT types[DS1_METADATA_ENTRY_CNT]{ asset::IPipelineMetadata::ECSI_WORLD_VIEW_PROJ, asset::IPipelineMetadata::ECSI_WORLD_VIEW, asset::IPipelineMetadata::ECSI_WORLD_VIEW_INVERSE_TRANSPOSE };
+		constexpr uint32_t sizes[DS1_METADATA_ENTRY_CNT]{ sizeof(asset::SBasicViewParameters::MVP), sizeof(asset::SBasicViewParameters::MV), sizeof(asset::SBasicViewParameters::NormalMat) };
+		constexpr uint32_t relOffsets[DS1_METADATA_ENTRY_CNT]{ offsetof(asset::SBasicViewParameters,MVP), offsetof(asset::SBasicViewParameters,MV), offsetof(asset::SBasicViewParameters,NormalMat) };
+		for (uint32_t i = 0u; i < DS1_METADATA_ENTRY_CNT; ++i)
+		{
+			auto& semantic = (shared.shaderInputsMetadata->end() - i - 1u)[0];
+			semantic.type = types[i];
+			semantic.descriptorSection.type = asset::IPipelineMetadata::ShaderInput::ET_UNIFORM_BUFFER;
+			semantic.descriptorSection.uniformBufferObject.binding = ds1layout->getBindings().begin()[0].binding;
+			semantic.descriptorSection.uniformBufferObject.set = 1u;
+			semantic.descriptorSection.uniformBufferObject.relByteoffset = relOffsets[i];
+			semantic.descriptorSection.uniformBufferObject.bytesize = sizes[i];
+			semantic.descriptorSection.shaderAccessFlags = asset::ICPUSpecializedShader::ESS_VERTEX;
 		}
+	}
 
-		asset::SBlendParams blendParams;
-		asset::SRasterizationParams rastarizationParams;
-		asset::SPrimitiveAssemblyParams primitiveAssemblyParams;
-		asset::SVertexInputParams inputParams;
-
-		primitiveAssemblyParams.primitiveType = asset::EPT_TRIANGLE_LIST;
-		inputParams.enabledBindingFlags |= core::createBitmask({ 0 });
-		inputParams.bindings[0].inputRate = asset::EVIR_PER_VERTEX;
-		inputParams.bindings[0].stride = vertexSize;
-
-		size_t attrOffset = 0ull;
-		auto readAttributeDispatch = [&](auto attrId, size_t attrCount, core::aabbox3df* aabb, bool read = true) -> void
+	// zero-copy if the file is mapped, otherwise read the compressed meshes in file order, the reads can't go in parallel anyway
+	const uint8_t* compressed = reinterpret_cast<const uint8_t*>(ctx.file->getMappedContents());
+	core::vector<size_t> compressedOffsets(_ids.size(),~0ull);
+	core::vector<uint8_t> staging;
+	{
+		core::vector<uint32_t> order;
+		order.reserve(_ids.size());
+		size_t stagingSize = 0ull;
+		for (uint32_t i=0u; i<_ids.size(); i++)
 		{
-			asset::E_FORMAT format = asset::EF_UNKNOWN;
-			switch (attrCount)
-			{
-				case 2ull:
-					format = typeSize==sizeof(double) ? asset::EF_R64G64_SFLOAT:asset::EF_R32G32_SFLOAT;
-					break;
-				case 3ull:
-					format = typeSize==sizeof(double) ? asset::EF_R64G64B64_SFLOAT:asset::EF_R32G32B32_SFLOAT;
-					break;
-				default:
-					assert(false);
-					break;
-			}
-
-			inputParams.enabledAttribFlags |= core::createBitmask({ attrId });
-			inputParams.attributes[attrId].binding = 0;
-			inputParams.attributes[attrId].format = format;
-			inputParams.attributes[attrId].relativeOffset = attrOffset * typeSize;
-			meshBuffer->setVertexBufferBinding({ 0, buf }, 0);
-	
-			if (read)
+			const uint32_t id = _ids.begin()[i];
+			if (id>=ctx.meshCount || getCompressedSize(id)==0u)
 			{
-				if (flags & MF_SINGLE_FLOAT)
-					readAttributes(reinterpret_cast<float*>(outPtr), attrOffset, reinterpret_cast<float*&>(ptr), attrCount, aabb);
-				else if (flags & MF_DOUBLE_FLOAT)
-					readAttributes(reinterpret_cast<double*>(outPtr), attrOffset, reinterpret_cast<double*&>(ptr), attrCount, aabb);
+				std::wstring msg(L"Mesh ix ");
+				msg += std::to_wstring(id);
+				msg += L" not present in the file";
+				os::Printer::log(msg, ELL_ERROR);
+				continue;
 			}
-			attrOffset += attrCount;
-		};
+			order.push_back(i);
+			if (compressed)
+				compressedOffsets[i] = getOffset(id);
+			else
+				stagingSize += getCompressedSize(id);
+		}
 
-		core::aabbox3df aabb;
-		readAttributeDispatch(POSITION_ATTRIBUTE, 3ull, &aabb);
-		meshBuffer->setBoundingBox(aabb);
-		if ((flags & MF_PER_VERTEX_NORMALS) || (flags & MF_FACE_NORMALS))
-			readAttributeDispatch(NORMAL_ATTRIBUTE, 3ull, nullptr, flags&MF_PER_VERTEX_NORMALS); // TODO: normal quantization and optimization
-		if (flags & MF_TEXTURE_COORDINATES) // TODO: UV quantization and optimization
-			readAttributeDispatch(UV_ATTRIBUTE, 2ull, nullptr);
-		if (flags & MF_VERTEX_COLORS) // TODO: quantize to 32bit format like RGB9E5
-			readAttributeDispatch(COLOR_ATTRIBUTE, 3ull, nullptr);
-
-		auto mbPipeline = core::make_smart_refctd_ptr<asset::ICPURenderpassIndependentPipeline>(std::move(mbPipelineLayout), nullptr, nullptr, inputParams, blendParams, primitiveAssemblyParams, rastarizationParams);
-		mbPipeline->setShaderAtStage(asset::ISpecializedShader::E_SHADER_STAGE::ESS_VERTEX, mbVertexShader.get());
-		mbPipeline->setShaderAtStage(asset::ISpecializedShader::E_SHADER_STAGE::ESS_FRAGMENT, mbFragmentShader.get());
-
-		meshBuffer->setIndexBufferBinding({ vertexDataSize, std::move(buf) });
-		meshBuffer->setIndexCount(triangleCount * 3u);
-		meshBuffer->setIndexType(asset::EIT_32BIT);
-
-		// read indices and possibly create per-face normals
-		auto readIndices = [&]() -> bool
+		if (!compressed)
 		{
-			uint32_t* indexPtr = reinterpret_cast<uint32_t*>(outPtr)+vertexDataSize/sizeof(uint32_t);
-			for (uint64_t j=0ull; j<triangleCount; j++)
+			std::sort(order.begin(),order.end(),[&](const uint32_t lhs, const uint32_t rhs) {return _ids.begin()[lhs]<_ids.begin()[rhs];});
+			staging.resize(stagingSize);
+			size_t stagingOffset = 0ull;
+			uint32_t prevId = ~0u;
+			size_t prevOffset = ~0ull;
+			for (uint32_t i : order)
 			{
-				uint32_t* triangleIndices = indexPtr;
-				for (uint64_t k=0ull; k<3ull; k++)
+				const uint32_t id = _ids.begin()[i];
+				// same id asked for more than once
+				if (id!=prevId)
 				{
-					triangleIndices[k] = *(reinterpret_cast<uint32_t*&>(ptr)++);
-					if (triangleIndices[k] >= static_cast<uint32_t>(vertexCount))
-						return false;
-				}
-				indexPtr += 3u;
-
-				if (flags & MF_FACE_NORMALS)
-				{
-					core::vectorSIMDf pos[3];
-					for (uint64_t k=0ull; k<3ull; k++)
-						pos[k] = meshBuffer->getPosition(triangleIndices[k]);
-					auto normal = core::cross(pos[1]-pos[0],pos[2]-pos[0]);
-					for (uint64_t k=0ull; k<3ull; k++)
-						meshBuffer->setAttribute(normal,NORMAL_ATTRIBUTE,k);
+					prevId = id;
+					prevOffset = ~0ull;
+					const size_t localSize = getCompressedSize(id);
+					ctx.file->seek(getOffset(id));
+					if (ctx.file->read(staging.data()+stagingOffset,localSize)==static_cast<int32_t>(localSize))
+					{
+						prevOffset = stagingOffset;
+						stagingOffset += localSize;
+					}
 				}
+				compressedOffsets[i] = prevOffset;
 			}
-			return true;
-		};
-		if (!readIndices())
-			continue;
+			compressed = staging.data();
+		}
+	}
 
-		manager->setAssetMetadata(mbPipeline.get(), core::make_smart_refctd_ptr<nbl::ext::MitsubaLoader::CMitsubaSerializedPipelineMetadata>(std::move(shaderInputsMetadata)));
-		meshBuffer->setPipeline(std::move(mbPipeline));
+	core::vector<SDecodedMesh> decoded(_ids.size());
+	auto decode = [&](const size_t i) -> void
+	{
+		if (compressedOffsets[i]==~0ull)
+			return;
 
-		auto mesh = core::make_smart_refctd_ptr<asset::CCPUMesh>();
-		mesh->addMeshBuffer(std::move(meshBuffer));
-		mesh->recalculateBoundingBox();
-		manager->setAssetMetadata(mesh.get(), core::make_smart_refctd_ptr<CSerializedMetadata>(std::string(stringPtr, stringLen), i));
+		const uint32_t id = _ids.begin()[i];
+		core::vector<uint8_t> inflated;
+		if (!inflateMesh(compressed+compressedOffsets[i],getCompressedSize(id),inflated))
+		{
+			std::wstring msg(L"Error decompressing mesh ix ");
+			msg += std::to_wstring(id);
+			os::Printer::log(msg, ELL_ERROR);
+			return;
+		}
+		decoded[i] = decodeMesh(inflated.data(),inflated.size(),shared);
+	};
+	if (_scheduler)
+		_scheduler->parallel_for(0u,_ids.size(),decode,1u);
+	else
+	for (size_t i=0u; i<_ids.size(); i++)
+		decode(i);
+
+	// the asset manager isn't thread-safe
+	for (size_t i=0u; i<_ids.size(); i++)
+	{
+		auto& mesh = decoded[i].mesh;
+		if (!mesh)
+			continue;
 
-		meshes.push_back(std::move(mesh));
+		manager->setAssetMetadata(mesh->getMeshBuffer(0u)->getPipeline(), core::make_smart_refctd_ptr<nbl::ext::MitsubaLoader::CMitsubaSerializedPipelineMetadata>(core::smart_refctd_dynamic_array<asset::IPipelineMetadata::ShaderInputSemantic>(shared.shaderInputsMetadata)));
+		manager->setAssetMetadata(mesh.get(), core::make_smart_refctd_ptr<CSerializedMetadata>(std::move(decoded[i].name), _ids.begin()[i]));
+		retval[i] = std::move(mesh);
 	}
-	_NBL_ALIGNED_FREE(data);
-
-	return meshes;
+	return retval;
 }
 
 
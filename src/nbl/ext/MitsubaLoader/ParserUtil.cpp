@@ -30,14 +30,14 @@ void ParserLog::invalidXMLFileStructure(const std::string& errorMessage)
 
 void ParserManager::elementHandlerStart(void* _data, const char* _el, const char** _atts)
 {
-	auto ctx = *reinterpret_cast<Context*>(_data);
+	const auto& ctx = *reinterpret_cast<Context*>(_data);
 
 	ctx.manager->parseElement(ctx, _el, _atts);
 }
 
 void ParserManager::elementHandlerEnd(void* _data, const char* _el)
 {
-	auto ctx = *reinterpret_cast<Context*>(_data);
+	const auto& ctx = *reinterpret_cast<Context*>(_data);
 
 	ctx.manager->onEnd(ctx,_el);
 }
@@ -60,13 +60,43 @@ bool ParserManager::parse(io::IReadFile* _file)
 	XML_SetUserData(parser, &ctx);
 
 
-	char* buff = (char*)_NBL_ALIGNED_MALLOC(_file->getSize(), 4096u);
-
+	// feed expat in chunks, straight from memory if the file is mapped, otherwise read into expat's own buffer
+	constexpr size_t ChunkSize = 1u<<20u;
+	const size_t fileSize = _file->getSize();
+	const char* const mapped = reinterpret_cast<const char*>(_file->getMappedContents());
 	_file->seek(0u);
-	_file->read((void*)buff, _file->getSize());
+	XML_Status parseStatus = XML_STATUS_OK;
+	for (size_t offset=0u; parseStatus==XML_STATUS_OK && offset<fileSize;)
+	{
+		const size_t chunk = core::min(fileSize-offset,ChunkSize);
+		if (mapped)
+		{
+			parseStatus = XML_Parse(parser, mapped+offset, static_cast<int>(chunk), false);
+			offset += chunk;
+			continue;
+		}
 
-	XML_Status parseStatus = XML_Parse(parser, buff, _file->getSize(), 0);
-	_NBL_ALIGNED_FREE(buff);
+		void* buff = XML_GetBuffer(parser, static_cast<int>(chunk));
+		if (!buff)
+		{
+			parseStatus = XML_STATUS_ERROR;
+			break;
+		}
+		const int32_t readSize = _file->read(buff, static_cast<uint32_t>(chunk));
+		if (readSize<=0)
+			break;
+		parseStatus = XML_ParseBuffer(parser, readSize, false);
+		offset += readSize;
+	}
+	// always tell expat the document ended, even if it got no data (i.e. an empty file), so it can report an unfinished or missing root element
+	if (parseStatus==XML_STATUS_OK)
+		parseStatus = XML_Parse(parser, nullptr, 0, true);
+	if (parseStatus==XML_STATUS_ERROR)
+	{
+		const auto error = XML_GetErrorCode(parser);
+		if (error!=XML_ERROR_ABORTED) // the handlers log why they stopped the parser
+			os::Printer::log(std::string("Mitsuba loader - ")+XML_ErrorString(error)+" at line "+std::to_string(XML_GetCurrentLineNumber(parser)), _file->getFileName().c_str(), ELL_ERROR);
+	}
 	XML_ParserFree(parser);
 	switch (parseStatus)
 	{
@@ -168,7 +198,7 @@ void ParserManager::parseElement(const Context& ctx, const char* _el, const char
 	
 	elements.push(el);
 	if (el.first && el.first->id.size())
-		handles[el.first->id] = el.first;
+		handles[ids.intern(el.first->id.c_str())] = el.first;
 }
 
 void ParserManager::processProperty(const Context& ctx, const char* _el, const char** _atts)